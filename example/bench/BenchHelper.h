@@ -0,0 +1,66 @@
+#ifndef __BENCH_HELPER_H__
+#define __BENCH_HELPER_H__
+
+#include <stdio.h>
+#include <inttypes.h>
+#include <chrono>
+#include <string>
+
+namespace bench
+{
+
+// 防止被测代码的结果被编译器优化掉
+inline void DoNotOptimize(uint64_t v)
+{
+	static volatile uint64_t sink = 0;
+	sink = sink + v;
+}
+
+inline int64_t NowNanoseconds()
+{
+	return (int64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// 输出每次操作的平均耗时
+inline void PrintResult(const char * name, double ns_per_op)
+{
+	printf("%-48s %12.1f ns/op %14.0f op/s\n", name, ns_per_op, ns_per_op > 0 ? 1e9 / ns_per_op : 0.0);
+}
+
+/*
+	执行func共times次，输出每次的平均耗时
+	func返回一个会被累加到DoNotOptimize的值
+*/
+template<typename T_Func>
+inline double Run(const char * name, int64_t times, T_Func func)
+{
+	// 预热
+	uint64_t v = 0;
+	for (int64_t i = 0; i < times / 10 + 1; i++)
+	{
+		v += func();
+	}
+
+	int64_t start = NowNanoseconds();
+	for (int64_t i = 0; i < times; i++)
+	{
+		v += func();
+	}
+	int64_t cost = NowNanoseconds() - start;
+	DoNotOptimize(v);
+
+	double ns_per_op = (double)cost / (double)times;
+	PrintResult(name, ns_per_op);
+	return ns_per_op;
+}
+
+// 输出吞吐量(MB/s)
+inline void PrintThroughput(const char * name, double ns_per_op, size_t bytes_per_op)
+{
+	printf("%-48s %12.1f MB/s\n", name, ns_per_op > 0 ? (double)bytes_per_op * 1e3 / ns_per_op : 0.0);
+}
+
+}
+
+#endif
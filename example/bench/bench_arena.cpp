@@ -0,0 +1,124 @@
+#include <string>
+#include <vector>
+#include <map>
+#include "util/Serialization.h"
+#include "util/Arena.h"
+#include "BenchHelper.h"
+
+using namespace sframe;
+
+// 内存区基准测试：按WorkService的消息组合解码，处理函数的临时容器分别使用堆和MonotonicArena
+// 与Service::Process一样，每批(64条消息)处理完后Reset内存区
+
+struct HeapTypes
+{
+	typedef std::string String;
+	typedef std::vector<std::string> StringVector;
+	typedef std::map<int32_t, std::string> StringMap;
+};
+
+struct ArenaTypes
+{
+	typedef ArenaString String;
+	typedef ArenaVector<ArenaString> StringVector;
+	typedef ArenaMap<int32_t, ArenaString> StringMap;
+};
+
+// 客户端数据消息(同User::OnClientData)
+static std::vector<char> MakeClientData()
+{
+	std::string text(200, 'c');
+	std::string buf;
+	{
+		StreamWriter writer(buf);
+		AutoEncode(writer, (int32_t)7, (int32_t)12345, (int64_t)1600000000000LL, text);
+	}
+	return std::vector<char>(buf.begin(), buf.end());
+}
+
+// 带名字列表和属性表的消息
+static std::vector<char> MakeListMsg()
+{
+	std::vector<std::string> names;
+	std::map<int32_t, std::string> attrs;
+	for (int32_t i = 0; i < 16; i++)
+	{
+		names.push_back("member_name_" + std::to_string(i));
+		attrs[i] = "attribute_value_" + std::to_string(i * 31);
+	}
+
+	std::string buf;
+	{
+		StreamWriter writer(buf);
+		AutoEncode(writer, (int64_t)99887766, names, attrs);
+	}
+	return std::vector<char>(buf.begin(), buf.end());
+}
+
+template<typename T_Types>
+static uint64_t HandleClientData(const std::vector<char> & data)
+{
+	int32_t client_id = 0;
+	int32_t count = 0;
+	int64_t send_time = 0;
+	typename T_Types::String text;
+	StreamReader reader(&data[0], data.size());
+	if (!AutoDecode(reader, client_id, count, send_time, text))
+	{
+		return 0;
+	}
+
+	// 处理函数中的临时字符串
+	typename T_Types::String resp("Client ");
+	resp.append(std::to_string(client_id).c_str());
+	resp.append(", you are in gate, text length ");
+	resp.append(std::to_string(text.length()).c_str());
+	return resp.length() + (uint64_t)count;
+}
+
+template<typename T_Types>
+static uint64_t HandleListMsg(const std::vector<char> & data)
+{
+	int64_t group_id = 0;
+	typename T_Types::StringVector names;
+	typename T_Types::StringMap attrs;
+	StreamReader reader(&data[0], data.size());
+	if (!AutoDecode(reader, group_id, names, attrs))
+	{
+		return 0;
+	}
+	return names.size() + attrs.size() + (uint64_t)group_id;
+}
+
+int main()
+{
+	const int32_t kBatch = 64;
+	std::vector<char> client_data = MakeClientData();
+	std::vector<char> list_msg = MakeListMsg();
+
+	bench::Run("heap: client data + list message", 1000000, [&]() -> uint64_t
+	{
+		return HandleClientData<HeapTypes>(client_data) + HandleListMsg<HeapTypes>(list_msg);
+	});
+
+	MonotonicArena arena;
+	int32_t n = 0;
+	bench::Run("arena: client data + list message", 1000000, [&]() -> uint64_t
+	{
+		uint64_t v = 0;
+		{
+			ArenaScope scope(&arena);
+			v = HandleClientData<ArenaTypes>(client_data) + HandleListMsg<ArenaTypes>(list_msg);
+		}
+		if (++n == kBatch)
+		{
+			arena.Reset();
+			n = 0;
+		}
+		return v;
+	});
+
+	printf("arena peak bytes per batch: %llu\n", (unsigned long long)arena.GetPeakAllocatedBytes());
+
+	return 0;
+}
@@ -0,0 +1,74 @@
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include "util/Log.h"
+#include "util/BinaryLog.h"
+#include "util/FileHelper.h"
+#include "util/TimeHelper.h"
+#include "BenchHelper.h"
+
+using namespace sframe;
+
+// 二进制日志基准测试：BLOG与等价的FLOG每行的耗时和写入文件的字节数
+// 用法：bench_binary_log [日志目录(默认./bench_log)]
+
+static std::string s_log_dir;
+
+// 目录中匹配的文件的总大小
+static int64_t GetFilesSize(const std::string & match_name)
+{
+	int64_t total = 0;
+	std::vector<std::string> files = FileHelper::ScanDirectory(s_log_dir, match_name, FileHelper::kScanType_OnlyNotDirectory);
+	for (const std::string & name : files)
+	{
+		FILE * f = fopen((s_log_dir + "/" + name).c_str(), "rb");
+		if (f)
+		{
+			fseek(f, 0, SEEK_END);
+			total += (int64_t)ftell(f);
+			fclose(f);
+		}
+	}
+	return total;
+}
+
+template<typename T_Func>
+static void BenchLines(const char * name, const std::string & match_name, int32_t lines, T_Func func)
+{
+	int64_t old_size = GetFilesSize(match_name);
+
+	int64_t start = bench::NowNanoseconds();
+	for (int32_t i = 0; i < lines; i++)
+	{
+		func(i);
+	}
+	int64_t cost = bench::NowNanoseconds() - start;
+	bench::PrintResult(name, (double)cost / lines);
+
+	// 等刷新线程写完再统计文件大小
+	TimeHelper::ThreadSleep(1000);
+	int64_t bytes = GetFilesSize(match_name) - old_size;
+	printf("%-48s %12.1f bytes/line\n", name, (double)bytes / lines);
+}
+
+int main(int argc, char * argv[])
+{
+	s_log_dir = argc > 1 ? argv[1] : "./bench_log";
+	INITIALIZE_LOG(s_log_dir, "bench");
+	LoggerMgr::Instance().SetOverflowPolicy(kLogOverflowPolicy_Block);
+
+	const int32_t kLines = 1000000;
+	const std::string role_name = "role_name";
+
+	BenchLines("FLOG (int64, string, int32)", "*bench_flog_*.log", kLines, [&role_name](int32_t i)
+	{
+		FLOG("bench_flog") << "login|uid=" << (int64_t)i * 1000003 << "|name=" << role_name << "|level=" << (i & 127) << std::endl;
+	});
+
+	BenchLines("BLOG (int64, string, int32)", "*bench_blog_*.blog", kLines, [&role_name](int32_t i)
+	{
+		BLOG("bench_blog", "login|uid={}|name={}|level={}", (int64_t)i * 1000003, role_name, (i & 127));
+	});
+
+	return 0;
+}
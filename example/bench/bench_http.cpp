@@ -0,0 +1,97 @@
+#include <string>
+#include <memory>
+#include "util/Http.h"
+#include "BenchHelper.h"
+
+using namespace sframe;
+
+// HTTP基准测试：请求解析(管线化、分段到达)，以及与HttpSession相同的解析-响应流程的每秒请求数
+
+static std::string MakeRequest(int32_t i)
+{
+	std::string req = "GET /api/user/info?uid=" + std::to_string(100000 + i) + "&token=abcdef0123456789&lang=zh-CN HTTP/1.1\r\n";
+	req += "Host: game.example.com:8888\r\n";
+	req += "User-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 (KHTML, like Gecko) Chrome/90.0 Safari/537.36\r\n";
+	req += "Accept: text/html,application/xhtml+xml,application/xml;q=0.9,*/*;q=0.8\r\n";
+	req += "Accept-Encoding: gzip, deflate\r\n";
+	req += "Accept-Language: zh-CN,zh;q=0.9,en;q=0.8\r\n";
+	req += "Cookie: session=0123456789abcdef0123456789abcdef\r\n";
+	req += "Connection: keep-alive\r\n";
+	req += "\r\n";
+	return req;
+}
+
+// 与HttpSession::OnReceived相同的循环，返回解析出的请求数
+template<typename T_Handler>
+static int32_t DecodeAll(HttpRequestDecoder & decoder, const char * data, size_t len, T_Handler handler)
+{
+	std::string err_msg;
+	size_t readed = 0;
+	int32_t count = 0;
+	while (readed < len)
+	{
+		readed += decoder.Decode(data + readed, len - readed, err_msg);
+		if (!err_msg.empty() || !decoder.IsDecodeCompleted())
+		{
+			break;
+		}
+
+		std::shared_ptr<HttpRequest> req = decoder.GetResult();
+		decoder.Reset();
+		handler(req);
+		count++;
+	}
+	return count;
+}
+
+int main()
+{
+	const int32_t kPipelined = 16;
+
+	std::string pipelined;
+	for (int32_t i = 0; i < kPipelined; i++)
+	{
+		pipelined += MakeRequest(i);
+	}
+
+	HttpRequestDecoder decoder;
+	double ns = bench::Run("decode 16 pipelined requests", 200000, [&]() -> uint64_t
+	{
+		return (uint64_t)DecodeAll(decoder, pipelined.data(), pipelined.length(), [](const std::shared_ptr<HttpRequest> &) {});
+	});
+	bench::PrintResult("decode per request", ns / kPipelined);
+
+	// 一个请求分两次到达
+	std::string single = MakeRequest(1);
+	size_t half = single.length() / 2;
+	bench::Run("decode request in 2 segments", 2000000, [&]() -> uint64_t
+	{
+		std::string err_msg;
+		size_t n = decoder.Decode(single.data(), half, err_msg);
+		n += decoder.Decode(single.data() + n, single.length() - n, err_msg);
+		bool completed = decoder.IsDecodeCompleted();
+		decoder.Reset();
+		return completed ? n : 0;
+	});
+
+	// 解析 + 构建响应 + 序列化(同HttpSession::OnMsg_HttpRequest)
+	std::string out;
+	ns = bench::Run("decode + respond 16 pipelined requests", 200000, [&]() -> uint64_t
+	{
+		out.clear();
+		DecodeAll(decoder, pipelined.data(), pipelined.length(), [&out](const std::shared_ptr<HttpRequest> & req)
+		{
+			HttpResponse resp;
+			resp.SetProtoVersion(req->GetProtoVersion());
+			resp.SetStatusCode(200);
+			resp.SetStatusDesc("OK");
+			resp.SetHeader("Connection", req->IsKeepAlive() ? "Keep-Alive" : "close");
+			resp.SetContent("Hello world");
+			resp.WriteTo(out);
+		});
+		return out.length();
+	});
+	bench::PrintResult("decode + respond per request", ns / kPipelined);
+
+	return 0;
+}
@@ -0,0 +1,62 @@
+#include <string>
+#include <vector>
+#include <thread>
+#include "util/Log.h"
+#include "util/TimeHelper.h"
+#include "BenchHelper.h"
+
+using namespace sframe;
+
+// 日志基准测试：多线程写日志的吞吐量
+// 用法：bench_log [日志目录(默认./bench_log)]
+
+static void WriteLines(int32_t thread_index, int32_t lines)
+{
+	std::string name = "role_" + std::to_string(thread_index);
+	for (int32_t i = 0; i < lines; i++)
+	{
+		FLOG_INFO("bench") << "login|thread|" << thread_index << "|uid|" << (int64_t)i * 1000003 << "|name|" << name << "|level|" << (i & 127) << std::endl;
+	}
+}
+
+static void BenchThreads(int32_t thread_count, int32_t lines_per_thread)
+{
+	std::vector<std::thread> threads;
+	int64_t start = bench::NowNanoseconds();
+	for (int32_t i = 0; i < thread_count; i++)
+	{
+		threads.push_back(std::thread(WriteLines, i, lines_per_thread));
+	}
+	for (std::thread & t : threads)
+	{
+		t.join();
+	}
+	int64_t cost = bench::NowNanoseconds() - start;
+
+	std::string name = "FLOG " + std::to_string(thread_count) + " threads x " + std::to_string(lines_per_thread) + " lines";
+	bench::PrintResult(name.c_str(), (double)cost / ((double)thread_count * lines_per_thread));
+
+	// 等刷新线程写完，避免影响下一组
+	TimeHelper::ThreadSleep(500);
+}
+
+int main(int argc, char * argv[])
+{
+	INITIALIZE_LOG(argc > 1 ? argv[1] : "./bench_log", "bench");
+	LoggerMgr::Instance().SetOverflowPolicy(kLogOverflowPolicy_Block);
+
+	BenchThreads(1, 1000000);
+	BenchThreads(4, 250000);
+	BenchThreads(16, 200000);
+
+	// 级别被关闭的日志
+	LoggerMgr::SetLogLevel(kLogLevel_Info);
+	int64_t i = 0;
+	bench::Run("disabled LOG_TRACE", 100000000, [&]() -> uint64_t
+	{
+		LOG_TRACE << "never written|" << i++ << std::endl;
+		return 1;
+	});
+
+	return 0;
+}
@@ -0,0 +1,159 @@
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include "util/ObjectPool.h"
+#include "util/Lock.h"
+#include "BenchHelper.h"
+
+using namespace sframe;
+
+// 对象池基准测试：多线程本线程创建/释放，以及跨线程释放，与new/delete对比
+
+struct BenchObject
+{
+	char data[128];
+};
+
+struct PoolAlloc
+{
+	static BenchObject * New()
+	{
+		return ObjectPool<BenchObject>::Instance().New();
+	}
+
+	static void Delete(BenchObject * obj)
+	{
+		ObjectPool<BenchObject>::Instance().Delete(obj);
+	}
+};
+
+struct HeapAlloc
+{
+	static BenchObject * New()
+	{
+		return new BenchObject();
+	}
+
+	static void Delete(BenchObject * obj)
+	{
+		delete obj;
+	}
+};
+
+// 每个线程每轮创建batch个对象再全部释放
+template<typename T_Alloc>
+static void AllocFreeLoop(int32_t batch, int32_t rounds)
+{
+	std::vector<BenchObject *> objs(batch);
+	for (int32_t r = 0; r < rounds; r++)
+	{
+		for (int32_t i = 0; i < batch; i++)
+		{
+			objs[i] = T_Alloc::New();
+			objs[i]->data[0] = (char)i;
+		}
+		for (int32_t i = 0; i < batch; i++)
+		{
+			T_Alloc::Delete(objs[i]);
+		}
+	}
+}
+
+template<typename T_Alloc>
+static void BenchSameThread(const char * tag, int32_t thread_count, int32_t batch, int64_t ops_per_thread)
+{
+	int32_t rounds = (int32_t)(ops_per_thread / batch);
+	std::vector<std::thread> threads;
+	int64_t start = bench::NowNanoseconds();
+	for (int32_t i = 0; i < thread_count; i++)
+	{
+		threads.push_back(std::thread(AllocFreeLoop<T_Alloc>, batch, rounds));
+	}
+	for (std::thread & t : threads)
+	{
+		t.join();
+	}
+	int64_t cost = bench::NowNanoseconds() - start;
+
+	std::string name = std::string(tag) + " " + std::to_string(thread_count) + " threads, batch " + std::to_string(batch);
+	bench::PrintResult(name.c_str(), (double)cost / ((double)thread_count * rounds * batch));
+}
+
+// 生产者创建对象，每批交给消费者线程释放
+template<typename T_Alloc>
+static void BenchCrossThread(const char * tag, int32_t batch, int64_t total)
+{
+	Lock lock;
+	std::vector<BenchObject *> pending;
+	std::atomic<bool> done(false);
+
+	std::thread consumer([&]()
+	{
+		std::vector<BenchObject *> objs;
+		while (true)
+		{
+			bool finished = done.load();
+			{
+				AUTO_LOCK(lock);
+				objs.swap(pending);
+			}
+
+			for (BenchObject * obj : objs)
+			{
+				T_Alloc::Delete(obj);
+			}
+
+			if (objs.empty())
+			{
+				if (finished)
+				{
+					break;
+				}
+				std::this_thread::yield();
+			}
+			objs.clear();
+		}
+	});
+
+	int64_t start = bench::NowNanoseconds();
+	std::vector<BenchObject *> objs;
+	for (int64_t n = 0; n < total; n += batch)
+	{
+		for (int32_t i = 0; i < batch; i++)
+		{
+			objs.push_back(T_Alloc::New());
+		}
+
+		AUTO_LOCK(lock);
+		pending.insert(pending.end(), objs.begin(), objs.end());
+		objs.clear();
+	}
+	done.store(true);
+	consumer.join();
+	int64_t cost = bench::NowNanoseconds() - start;
+
+	std::string name = std::string(tag) + " cross-thread free, batch " + std::to_string(batch);
+	bench::PrintResult(name.c_str(), (double)cost / total);
+}
+
+int main()
+{
+	const int32_t kThreadCounts[] = { 1, 2, 4, 8 };
+	for (int32_t thread_count : kThreadCounts)
+	{
+		BenchSameThread<PoolAlloc>("ObjectPool", thread_count, 1, 4000000);
+		BenchSameThread<PoolAlloc>("ObjectPool", thread_count, 64, 4000000);
+		BenchSameThread<HeapAlloc>("new/delete", thread_count, 1, 4000000);
+		BenchSameThread<HeapAlloc>("new/delete", thread_count, 64, 4000000);
+	}
+
+	BenchCrossThread<PoolAlloc>("ObjectPool", 64, 4000000);
+	BenchCrossThread<HeapAlloc>("new/delete", 64, 4000000);
+
+	ObjectPoolStats stats = ObjectPool<BenchObject>::Instance().GetStats();
+	printf("ObjectPool<BenchObject> live %lld, cached %lld, peak %lld, created %lld\n",
+		(long long)stats.live, (long long)stats.cached, (long long)stats.peak, (long long)stats.created);
+
+	return 0;
+}
@@ -0,0 +1,230 @@
+#include <string>
+#include <vector>
+#include <thread>
+#include "util/BlockingQueue.h"
+#include "util/MPMCQueue.h"
+#include "util/RingQueue.h"
+#include "util/ConditionVariable.h"
+#include "BenchHelper.h"
+
+using namespace sframe;
+
+// 队列基准测试：1~32线程下BlockingQueue、MPMCQueue与加锁队列的竞争开销
+
+// 加锁的阻塞队列(BlockingQueue改为无锁队列之前的实现，作为对照)
+template<typename T>
+class LockedBlockingQueue
+{
+public:
+	LockedBlockingQueue() : _ring_queue(32, 8), _stop(false) {}
+
+	void Push(const T & val)
+	{
+		AutoLock l(_lock);
+		if (_stop)
+		{
+			return;
+		}
+
+		_ring_queue.Push(val);
+		_cond.WakeUpOne();
+	}
+
+	bool Pop(T * val)
+	{
+		AutoLock l(_lock);
+		bool succ = false;
+		while (!_stop)
+		{
+			succ = _ring_queue.Pop(val);
+			if (succ)
+			{
+				break;
+			}
+
+			_cond.Wait(l);
+		}
+		return succ;
+	}
+
+private:
+	RingQueue<T> _ring_queue;
+	Lock _lock;
+	ConditionVariable _cond;
+	bool _stop;
+};
+
+// 非阻塞的MPMCQueue，满时/空时让出CPU重试
+template<typename T>
+class SpinMPMCQueue
+{
+public:
+	SpinMPMCQueue() : _queue(4096) {}
+
+	void Push(const T & val)
+	{
+		while (!_queue.TryPush(val))
+		{
+			std::this_thread::yield();
+		}
+	}
+
+	bool Pop(T * val)
+	{
+		while (!_queue.TryPop(val))
+		{
+			std::this_thread::yield();
+		}
+		return true;
+	}
+
+private:
+	MPMCQueue<T> _queue;
+};
+
+// 每个线程压入一个元素再弹出一个元素
+template<typename T_Queue>
+static void BenchPushPop(const char * tag, int32_t thread_count, int64_t total_ops)
+{
+	T_Queue queue;
+	int64_t ops_per_thread = total_ops / thread_count;
+	std::vector<std::thread> threads;
+	int64_t start = bench::NowNanoseconds();
+	for (int32_t i = 0; i < thread_count; i++)
+	{
+		threads.push_back(std::thread([&queue, ops_per_thread]()
+		{
+			int64_t v = 0;
+			for (int64_t n = 0; n < ops_per_thread; n++)
+			{
+				queue.Push(n);
+				queue.Pop(&v);
+			}
+		}));
+	}
+	for (std::thread & t : threads)
+	{
+		t.join();
+	}
+	int64_t cost = bench::NowNanoseconds() - start;
+
+	std::string name = std::string(tag) + " push+pop, " + std::to_string(thread_count) + " threads";
+	bench::PrintResult(name.c_str(), (double)cost / (ops_per_thread * thread_count));
+}
+
+// 一半线程生产、一半线程消费(消费者在空队列上阻塞)
+template<typename T_Queue>
+static void BenchProducerConsumer(const char * tag, int32_t thread_count, int64_t total_items)
+{
+	int32_t producer_count = thread_count / 2 > 0 ? thread_count / 2 : 1;
+	int32_t consumer_count = thread_count - producer_count > 0 ? thread_count - producer_count : 1;
+	int64_t items_per_producer = total_items / producer_count;
+
+	T_Queue queue;
+	std::vector<std::thread> producers;
+	std::vector<std::thread> consumers;
+	int64_t start = bench::NowNanoseconds();
+	for (int32_t i = 0; i < consumer_count; i++)
+	{
+		consumers.push_back(std::thread([&queue]()
+		{
+			int64_t v = 0;
+			while (queue.Pop(&v) && v >= 0) {}
+		}));
+	}
+	for (int32_t i = 0; i < producer_count; i++)
+	{
+		producers.push_back(std::thread([&queue, items_per_producer]()
+		{
+			for (int64_t n = 0; n < items_per_producer; n++)
+			{
+				queue.Push(n);
+			}
+		}));
+	}
+	for (std::thread & t : producers)
+	{
+		t.join();
+	}
+	// 每个消费者一个结束标记
+	for (int32_t i = 0; i < consumer_count; i++)
+	{
+		queue.Push(-1);
+	}
+	for (std::thread & t : consumers)
+	{
+		t.join();
+	}
+	int64_t cost = bench::NowNanoseconds() - start;
+
+	std::string name = std::string(tag) + " " + std::to_string(producer_count) + "P/" + std::to_string(consumer_count) + "C";
+	bench::PrintResult(name.c_str(), (double)cost / (items_per_producer * producer_count));
+}
+
+// 容量很小的BlockingQueue，多个生产者、一个消费者，检查每个生产者的元素按压入顺序弹出(溢出队列参与时也一样)
+static bool CheckBlockingQueueOrder(int32_t producer_count, int64_t items_per_producer)
+{
+	BlockingQueue<int64_t> queue(8);
+	std::vector<std::thread> producers;
+	for (int32_t i = 0; i < producer_count; i++)
+	{
+		producers.push_back(std::thread([&queue, i, items_per_producer]()
+		{
+			for (int64_t n = 0; n < items_per_producer; n++)
+			{
+				queue.Push(((int64_t)i << 40) | n);
+			}
+		}));
+	}
+
+	std::vector<int64_t> next(producer_count, 0);
+	bool ok = true;
+	int64_t v = 0;
+	for (int64_t k = 0; k < items_per_producer * producer_count && queue.Pop(&v); k++)
+	{
+		int32_t producer = (int32_t)(v >> 40);
+		int64_t n = v & (((int64_t)1 << 40) - 1);
+		if (n != next[producer]++)
+		{
+			ok = false;
+		}
+	}
+	for (std::thread & t : producers)
+	{
+		t.join();
+	}
+
+	printf("BlockingQueue FIFO check, %d producers: %s\n", producer_count, ok ? "ok" : "FAILED");
+	return ok;
+}
+
+int main()
+{
+	const int32_t kThreadCounts[] = { 1, 2, 4, 8, 16, 32 };
+	const int64_t kTotalOps = 2000000;
+
+	for (int32_t thread_count : kThreadCounts)
+	{
+		BenchPushPop<BlockingQueue<int64_t>>("BlockingQueue", thread_count, kTotalOps);
+		BenchPushPop<SpinMPMCQueue<int64_t>>("MPMCQueue", thread_count, kTotalOps);
+		BenchPushPop<LockedBlockingQueue<int64_t>>("locked queue", thread_count, kTotalOps);
+	}
+
+	for (int32_t thread_count : kThreadCounts)
+	{
+		if (thread_count < 2)
+		{
+			continue;
+		}
+		BenchProducerConsumer<BlockingQueue<int64_t>>("BlockingQueue", thread_count, kTotalOps);
+		BenchProducerConsumer<SpinMPMCQueue<int64_t>>("MPMCQueue", thread_count, kTotalOps);
+		BenchProducerConsumer<LockedBlockingQueue<int64_t>>("locked queue", thread_count, kTotalOps);
+	}
+
+	if (!CheckBlockingQueueOrder(4, 200000) || !CheckBlockingQueueOrder(8, 100000))
+	{
+		return 1;
+	}
+
+	return 0;
+}
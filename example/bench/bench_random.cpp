@@ -0,0 +1,58 @@
+#include <vector>
+#include <random>
+#include "util/RandomHelper.h"
+#include "BenchHelper.h"
+
+using namespace sframe;
+
+// 随机数基准测试：RandomHelper与每次构造分布的std::default_random_engine对比
+
+int main()
+{
+	const int64_t kTimes = 20000000;
+
+	bench::Run("Rand(0, 99)", kTimes, []() -> uint64_t
+	{
+		return (uint64_t)Rand(0, 99);
+	});
+
+	std::vector<int> arr(1024);
+	double ns = bench::Run("Rand(0, 99, arr, 1024)", kTimes / 1024, [&arr]() -> uint64_t
+	{
+		Rand(0, 99, &arr[0], (int)arr.size());
+		return (uint64_t)arr[0];
+	});
+	bench::PrintResult("Rand(0, 99, arr, 1024) per number", ns / arr.size());
+
+	std::vector<int> vec;
+	ns = bench::Run("Rand(0, 99, 1024, vector)", kTimes / 1024, [&vec]() -> uint64_t
+	{
+		// 结果追加到vector末尾
+		vec.clear();
+		Rand(0, 99, 1024, vec);
+		return (uint64_t)vec[0];
+	});
+	bench::PrintResult("Rand(0, 99, 1024, vector) per number", ns / 1024);
+
+	bench::Run("RandDouble()", kTimes, []() -> uint64_t
+	{
+		return (uint64_t)(RandDouble() * 100);
+	});
+
+	// 标准分布配合RandomEngine使用
+	std::uniform_int_distribution<int> dist(0, 99);
+	bench::Run("uniform_int_distribution + RandomEngine", kTimes, [&dist]() -> uint64_t
+	{
+		return (uint64_t)dist(GetThreadRandomEngine());
+	});
+
+	// 对照：RandomHelper原来的做法(每次调用构造分布)
+	std::default_random_engine engine((unsigned)bench::NowNanoseconds());
+	bench::Run("default_random_engine, distribution per call", kTimes, [&engine]() -> uint64_t
+	{
+		std::uniform_int_distribution<int> d(0, 99);
+		return (uint64_t)d(engine);
+	});
+
+	return 0;
+}
@@ -0,0 +1,462 @@
+#include <string.h>
+#include <string>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include "util/Buffer.h"
+#include "net/SendBuffer.h"
+#include "BenchHelper.h"
+
+using namespace sframe;
+
+// 环形缓冲区压力测试与基准测试：多生产者单读取者的FastRingBuffer和SendBuffer
+// 压力测试检查每个生产者的数据顺序和内容，读取时模拟socket只写出一部分的情况
+
+static const int32_t kRingCapacity = 65536;
+
+// 记录格式：生产者编号(4字节) + 序号(4字节) + 内容长度(4字节) + 内容
+static const int32_t kRecordHeadSize = 12;
+
+static char PayloadByte(int32_t producer, int32_t seq, int32_t i)
+{
+	return (char)(seq * 31 + i * 7 + producer);
+}
+
+static void MakeRecord(int32_t producer, int32_t seq, int32_t payload_len, std::string & out)
+{
+	out.resize(kRecordHeadSize + payload_len);
+	memcpy(&out[0], &producer, 4);
+	memcpy(&out[4], &seq, 4);
+	memcpy(&out[8], &payload_len, 4);
+	for (int32_t i = 0; i < payload_len; i++)
+	{
+		out[kRecordHeadSize + i] = PayloadByte(producer, seq, i);
+	}
+}
+
+// 简单的线性同余随机数(每个线程一个)
+struct FastRand
+{
+	explicit FastRand(uint32_t seed) : s(seed) {}
+
+	uint32_t Next()
+	{
+		s = s * 1103515245 + 12345;
+		return (s >> 8) & 0xffffff;
+	}
+
+	uint32_t s;
+};
+
+// 读取者拼接收到的字节流，解析出完整的记录并检查
+class RecordChecker
+{
+public:
+	explicit RecordChecker(int32_t producer_count) : _next_seq(producer_count, 0), _records(0), _error(false) {}
+
+	void Feed(const char * data, int32_t len)
+	{
+		_pending.append(data, len);
+
+		size_t pos = 0;
+		while (!_error && _pending.length() - pos >= (size_t)kRecordHeadSize)
+		{
+			int32_t producer = 0;
+			int32_t seq = 0;
+			int32_t payload_len = 0;
+			memcpy(&producer, &_pending[pos], 4);
+			memcpy(&seq, &_pending[pos + 4], 4);
+			memcpy(&payload_len, &_pending[pos + 8], 4);
+			if (producer < 0 || producer >= (int32_t)_next_seq.size() || payload_len < 0)
+			{
+				Fail("bad record head", producer, seq);
+				break;
+			}
+
+			if (_pending.length() - pos < (size_t)(kRecordHeadSize + payload_len))
+			{
+				break;
+			}
+
+			if (seq != _next_seq[producer])
+			{
+				Fail("out of order", producer, seq);
+				break;
+			}
+
+			const char * payload = &_pending[pos + kRecordHeadSize];
+			for (int32_t i = 0; i < payload_len; i++)
+			{
+				if (payload[i] != PayloadByte(producer, seq, i))
+				{
+					Fail("bad payload", producer, seq);
+					break;
+				}
+			}
+
+			_next_seq[producer]++;
+			_records++;
+			pos += kRecordHeadSize + payload_len;
+		}
+
+		_pending.erase(0, pos);
+	}
+
+	int64_t GetRecordCount() const
+	{
+		return _records;
+	}
+
+	bool HasError() const
+	{
+		return _error;
+	}
+
+	// 没有错误，且没有不完整的记录
+	bool IsOk() const
+	{
+		return !_error && _pending.empty();
+	}
+
+private:
+	void Fail(const char * reason, int32_t producer, int32_t seq)
+	{
+		printf("  %s: producer %d, seq %d, expected seq %d\n", reason, producer, seq,
+			(producer >= 0 && producer < (int32_t)_next_seq.size()) ? _next_seq[producer] : -1);
+		_error = true;
+	}
+
+private:
+	std::string _pending;
+	std::vector<int32_t> _next_seq;
+	int64_t _records;
+	bool _error;
+};
+
+// 单线程检查：部分Free后再次Peek到剩下的同一段数据、PeekAll绕回时分两段
+static bool CheckRingBasic()
+{
+	bool ok = true;
+
+	std::unique_ptr<FastRingBuffer<char, 64>> ring(new FastRingBuffer<char, 64>());
+	char data[64];
+	for (int32_t i = 0; i < 64; i++)
+	{
+		data[i] = (char)i;
+	}
+
+	// 部分Free
+	ring->Push(data, 40);
+	int32_t len = 0;
+	char * p = ring->Peek(len);
+	ok = ok && p && len == 40 && memcmp(p, data, 40) == 0;
+	ring->Free(15);
+	len = 0;
+	char * p2 = ring->Peek(len);
+	ok = ok && p2 == p + 15 && len == 25 && memcmp(p2, data + 15, 25) == 0;
+	len = 10;
+	p2 = ring->Peek(len);
+	ok = ok && p2 == p + 15 && len == 10;
+	ring->Free(25);
+	ok = ok && ring->GetUnReadLength() == 0;
+
+	// 读位置在40，再压入40个会绕回
+	ok = ok && ring->Push(data, 40);
+	ok = ok && !ring->Push(data, 25);
+	char * first = nullptr;
+	char * second = nullptr;
+	int32_t first_len = 0;
+	int32_t second_len = 0;
+	int32_t total = ring->PeekAll(first, first_len, second, second_len);
+	ok = ok && total == 40 && first_len == 24 && second_len == 16;
+	ok = ok && first && memcmp(first, data, 24) == 0 && second && memcmp(second, data + 24, 16) == 0;
+
+	// 绕回的数据部分Free后PeekAll只剩第二段
+	ring->Free(30);
+	total = ring->PeekAll(first, first_len, second, second_len);
+	ok = ok && total == 10 && first_len == 10 && second_len == 0 && second == nullptr && memcmp(first, data + 30, 10) == 0;
+	ring->Free(10);
+	ok = ok && ring->Push(data, 64) && !ring->Push(data, 1);
+
+	printf("FastRingBuffer partial Free / PeekAll wrap: %s\n", ok ? "ok" : "FAILED");
+	return ok;
+}
+
+// 多个生产者压入FastRingBuffer，一个读取者用Peek(部分Free)或PeekAll读取
+static bool StressRing(int32_t producer_count, int32_t records_per_producer, bool peek_all)
+{
+	typedef FastRingBuffer<char, kRingCapacity> Ring;
+	std::unique_ptr<Ring> ring(new Ring());
+	std::vector<std::thread> producers;
+	for (int32_t i = 0; i < producer_count; i++)
+	{
+		producers.push_back(std::thread([&ring, i, records_per_producer]()
+		{
+			FastRand rand(i + 1);
+			std::string record;
+			for (int32_t seq = 0; seq < records_per_producer; seq++)
+			{
+				MakeRecord(i, seq, (int32_t)(rand.Next() % 2000), record);
+				while (!ring->Push(record.data(), (int32_t)record.length()))
+				{
+					std::this_thread::yield();
+				}
+			}
+		}));
+	}
+
+	RecordChecker checker(producer_count);
+	FastRand rand(1000);
+	int64_t expected = (int64_t)producer_count * records_per_producer;
+	while (checker.GetRecordCount() < expected && !checker.HasError())
+	{
+		int32_t len = 0;
+		if (peek_all)
+		{
+			char * first = nullptr;
+			char * second = nullptr;
+			int32_t first_len = 0;
+			int32_t second_len = 0;
+			len = ring->PeekAll(first, first_len, second, second_len);
+			if (len > 0)
+			{
+				checker.Feed(first, first_len);
+				if (second_len > 0)
+				{
+					checker.Feed(second, second_len);
+				}
+				ring->Free(len);
+			}
+		}
+		else
+		{
+			char * data = ring->Peek(len);
+			if (data)
+			{
+				// 模拟socket只写出了一部分，剩下的下次再Peek
+				int32_t consumed = 1 + (int32_t)(rand.Next() % len);
+				checker.Feed(data, consumed);
+				ring->Free(consumed);
+			}
+		}
+
+		if (len == 0)
+		{
+			std::this_thread::yield();
+		}
+	}
+
+	for (std::thread & t : producers)
+	{
+		t.join();
+	}
+
+	bool ok = checker.IsOk() && checker.GetRecordCount() == expected && ring->GetUnReadLength() == 0;
+	printf("FastRingBuffer %d producers, %s: %s\n", producer_count, peek_all ? "PeekAll" : "Peek + partial Free", ok ? "ok" : "FAILED");
+	return ok;
+}
+
+/*
+	多个生产者压入SendBuffer，得到send_now的生产者把发送权交给读取线程，读取线程一直读到Peek返回空(交出发送状态)
+	部分记录比主缓冲区大，会放入备用缓冲区；检查同一时间只有一个发送者，以及结束后没有滞留的数据
+*/
+static bool StressSendBuffer(int32_t producer_count, int32_t records_per_producer)
+{
+	std::unique_ptr<SendBuffer> buf(new SendBuffer());
+	std::atomic<int32_t> grants(0);
+	std::atomic<bool> double_grant(false);
+	std::atomic<int32_t> finished(0);
+	std::atomic<int64_t> pushed(0);
+	std::atomic<int64_t> received(0);
+	int64_t deadline = bench::NowNanoseconds() + 60LL * 1000000000LL;
+
+	std::vector<std::thread> producers;
+	for (int32_t i = 0; i < producer_count; i++)
+	{
+		producers.push_back(std::thread([&, i]()
+		{
+			FastRand rand(i + 1);
+			std::string record;
+			for (int32_t seq = 0; seq < records_per_producer; seq++)
+			{
+				uint32_t r = rand.Next();
+				int32_t payload_len = (r % 64 == 0) ? kRingCapacity + (int32_t)(r % 40000) : (int32_t)(r % 3000);
+				MakeRecord(i, seq, payload_len, record);
+
+				bool send_now = false;
+				buf->Push(record.data(), (int32_t)record.length(), send_now);
+				if (send_now && grants.fetch_add(1) != 0)
+				{
+					double_grant.store(true);
+				}
+
+				// 时常等读取线程收完所有已压入的数据，再停一下，让它读空后交出发送状态
+				pushed.fetch_add(1);
+				if (seq % 32 == 31)
+				{
+					while (received.load() < pushed.load() && bench::NowNanoseconds() < deadline)
+					{
+						std::this_thread::yield();
+					}
+					std::this_thread::sleep_for(std::chrono::microseconds(100));
+				}
+			}
+			finished.fetch_add(1);
+		}));
+	}
+
+	RecordChecker checker(producer_count);
+	FastRand rand(1000);
+	int64_t sessions = 0;
+	int64_t expected = (int64_t)producer_count * records_per_producer;
+	while (checker.GetRecordCount() < expected && !checker.HasError() && bench::NowNanoseconds() < deadline)
+	{
+		if (grants.load() == 0)
+		{
+			// 生产者都结束、也没有发送权时还没收全，说明有数据滞留
+			if (finished.load() == producer_count && grants.load() == 0)
+			{
+				break;
+			}
+			std::this_thread::yield();
+			continue;
+		}
+
+		grants.fetch_sub(1);
+		sessions++;
+		while (true)
+		{
+			int32_t len = 0;
+			char * data = buf->Peek(len);
+			if (!data)
+			{
+				break;
+			}
+
+			// 模拟socket只写出了一部分，偶尔让出CPU使主缓冲区被压满
+			int32_t consumed = 1 + (int32_t)(rand.Next() % len);
+			checker.Feed(data, consumed);
+			buf->Free(consumed);
+			received.store(checker.GetRecordCount());
+			if (rand.Next() % 16 == 0)
+			{
+				std::this_thread::yield();
+			}
+		}
+	}
+
+	for (std::thread & t : producers)
+	{
+		t.join();
+	}
+
+	bool ok = checker.IsOk() && checker.GetRecordCount() == expected && !double_grant.load();
+	printf("SendBuffer %d producers, %lld send sessions: %s", producer_count, (long long)sessions, ok ? "ok\n" : "FAILED");
+	if (!ok)
+	{
+		printf(" (received %lld of %lld records%s)\n", (long long)checker.GetRecordCount(), (long long)expected,
+			double_grant.load() ? ", two senders at once" : "");
+	}
+	return ok;
+}
+
+// 压入耗时：producer_count个线程各压入times个64字节的数据，读取线程不停读取
+template<typename T_Push, typename T_Drain>
+static void BenchPush(const char * name, int32_t producer_count, int64_t times, T_Push push, T_Drain drain)
+{
+	std::atomic<bool> stop(false);
+	std::thread reader([&]()
+	{
+		while (!stop.load(std::memory_order_relaxed))
+		{
+			if (!drain())
+			{
+				std::this_thread::yield();
+			}
+		}
+	});
+
+	std::vector<std::thread> producers;
+	int64_t start = bench::NowNanoseconds();
+	for (int32_t i = 0; i < producer_count; i++)
+	{
+		producers.push_back(std::thread([&]()
+		{
+			char data[64] = { 0 };
+			for (int64_t n = 0; n < times; n++)
+			{
+				push(data, (int32_t)sizeof(data));
+			}
+		}));
+	}
+	for (std::thread & t : producers)
+	{
+		t.join();
+	}
+	int64_t cost = bench::NowNanoseconds() - start;
+	stop.store(true);
+	reader.join();
+
+	std::string full_name = std::string(name) + ", " + std::to_string(producer_count) + " producers";
+	bench::PrintResult(full_name.c_str(), (double)cost / ((double)producer_count * times));
+}
+
+int main()
+{
+	bool ok = CheckRingBasic();
+	ok = StressRing(4, 100000, false) && ok;
+	ok = StressRing(8, 50000, true) && ok;
+	ok = StressSendBuffer(4, 20000) && ok;
+	ok = StressSendBuffer(8, 10000) && ok;
+
+	const int32_t kProducerCounts[] = { 1, 4, 8 };
+	const int64_t kTotalPushes = 2000000;
+	for (int32_t producer_count : kProducerCounts)
+	{
+		std::unique_ptr<FastRingBuffer<char, kRingCapacity>> ring(new FastRingBuffer<char, kRingCapacity>());
+		BenchPush("FastRingBuffer push 64B", producer_count, kTotalPushes / producer_count,
+			[&ring](const char * data, int32_t len)
+		{
+			while (!ring->Push(data, len))
+			{
+				std::this_thread::yield();
+			}
+		},
+			[&ring]() -> bool
+		{
+			int32_t len = 0;
+			if (!ring->Peek(len))
+			{
+				return false;
+			}
+			ring->Free(len);
+			return true;
+		});
+	}
+
+	for (int32_t producer_count : kProducerCounts)
+	{
+		std::unique_ptr<SendBuffer> buf(new SendBuffer());
+		BenchPush("SendBuffer push 64B", producer_count, kTotalPushes / producer_count,
+			[&buf](const char * data, int32_t len)
+		{
+			bool send_now = false;
+			buf->Push(data, len, send_now);
+		},
+			[&buf]() -> bool
+		{
+			int32_t len = 0;
+			char * data = buf->Peek(len);
+			if (!data)
+			{
+				return false;
+			}
+			buf->Free(len);
+			return true;
+		});
+	}
+
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,291 @@
+#include <string.h>
+#include <string>
+#include <vector>
+#include <map>
+#include "util/Serialization.h"
+#include "BenchHelper.h"
+
+using namespace sframe;
+
+// 序列化基准测试：变长整数、字符串、嵌套结构体、批量/逐元素vector的编解码
+
+struct BenchItem
+{
+	DEFINE_SERIALIZE_INNER(id, count, name, attrs);
+
+	int32_t id;
+	int64_t count;
+	std::string name;
+	std::vector<int32_t> attrs;
+};
+
+struct BenchRole
+{
+	DEFINE_SERIALIZE_INNER(role_id, level, nick, items, attr_map);
+
+	int64_t role_id;
+	int32_t level;
+	std::string nick;
+	std::vector<BenchItem> items;
+	std::map<int32_t, BenchItem> attr_map;
+};
+
+// 嵌套深度为Depth的对象，每层两个子节点
+template<int Depth>
+struct BenchNode
+{
+	DEFINE_SERIALIZE_INNER(id, value, name, children);
+
+	int32_t id;
+	int64_t value;
+	std::string name;
+	std::vector<BenchNode<Depth - 1>> children;
+};
+
+template<>
+struct BenchNode<1>
+{
+	DEFINE_SERIALIZE_INNER(id, value, name);
+
+	int32_t id;
+	int64_t value;
+	std::string name;
+};
+
+template<int Depth>
+static void FillNode(BenchNode<Depth> & node, int32_t id);
+
+template<typename T>
+static void FillNodeFields(T & node, int32_t id)
+{
+	node.id = id;
+	node.value = (int64_t)id * 1000003;
+	node.name = "node_" + std::to_string(id);
+}
+
+template<>
+void FillNode<1>(BenchNode<1> & node, int32_t id)
+{
+	FillNodeFields(node, id);
+}
+
+template<int Depth>
+static void FillNode(BenchNode<Depth> & node, int32_t id)
+{
+	FillNodeFields(node, id);
+	node.children.resize(2);
+	FillNode<Depth - 1>(node.children[0], id * 2);
+	FillNode<Depth - 1>(node.children[1], id * 2 + 1);
+}
+
+static BenchRole MakeRole()
+{
+	BenchRole role;
+	role.role_id = 100000123456LL;
+	role.level = 87;
+	role.nick = "bench_role_nickname";
+
+	for (int32_t i = 0; i < 16; i++)
+	{
+		BenchItem item;
+		item.id = 1000 + i;
+		item.count = (int64_t)i * 70000;
+		item.name = "item_name_" + std::to_string(i);
+		for (int32_t j = 0; j < 8; j++)
+		{
+			item.attrs.push_back(i * 1000 + j);
+		}
+		role.items.push_back(item);
+		role.attr_map[i] = item;
+	}
+
+	return role;
+}
+
+static void BenchVarint()
+{
+	// 覆盖1/3/5/9字节各种长度
+	std::vector<uint64_t> nums;
+	for (int i = 0; i < 64; i++)
+	{
+		switch (i % 4)
+		{
+		case 0: nums.push_back((uint64_t)i); break;
+		case 1: nums.push_back((uint64_t)60000 + i); break;
+		case 2: nums.push_back((uint64_t)4000000000ULL + i); break;
+		default: nums.push_back((uint64_t)0x123456789abcULL + i); break;
+		}
+	}
+
+	char buf[1024];
+	size_t encoded_len = 0;
+
+	double ns = bench::Run("varint encode (64 x uint64)", 2000000, [&]() -> uint64_t
+	{
+		StreamWriter writer(buf, sizeof(buf));
+		for (uint64_t n : nums)
+		{
+			Encoder::Encode<uint64_t>(writer, n);
+		}
+		encoded_len = writer.GetStreamLength();
+		return encoded_len;
+	});
+	bench::PrintThroughput("varint encode", ns, encoded_len);
+
+	ns = bench::Run("varint decode (64 x uint64)", 2000000, [&]() -> uint64_t
+	{
+		StreamReader reader(buf, encoded_len);
+		uint64_t sum = 0;
+		for (size_t i = 0; i < nums.size(); i++)
+		{
+			uint64_t n = 0;
+			Decoder::Decode<uint64_t>(reader, n);
+			sum += n;
+		}
+		return sum;
+	});
+	bench::PrintThroughput("varint decode", ns, encoded_len);
+}
+
+static void BenchString(size_t len, int64_t times)
+{
+	std::string s(len, 'x');
+	std::string buf;
+	buf.reserve(len + 16);
+
+	std::string name = "string encode (" + std::to_string(len) + " bytes)";
+	double ns = bench::Run(name.c_str(), times, [&]() -> uint64_t
+	{
+		buf.clear();
+		{
+			StreamWriter writer(buf);
+			Encoder::Encode(writer, s);
+		}
+		return buf.size();
+	});
+	bench::PrintThroughput("string encode", ns, len);
+
+	std::string out;
+	name = "string decode (" + std::to_string(len) + " bytes)";
+	ns = bench::Run(name.c_str(), times, [&]() -> uint64_t
+	{
+		StreamReader reader(buf.data(), buf.size());
+		Decoder::Decode(reader, out);
+		return out.size();
+	});
+	bench::PrintThroughput("string decode", ns, len);
+
+	StringView view;
+	name = "StringView decode (" + std::to_string(len) + " bytes)";
+	bench::Run(name.c_str(), times, [&]() -> uint64_t
+	{
+		StreamReader reader(buf.data(), buf.size());
+		Decoder::Decode(reader, view);
+		return view.size();
+	});
+}
+
+static void BenchNestedStruct()
+{
+	BenchRole role = MakeRole();
+	std::string buf;
+
+	double ns = bench::Run("nested struct GetSize", 200000, [&]() -> uint64_t
+	{
+		return SizeGettor::GetSize(role);
+	});
+
+	ns = bench::Run("nested struct encode", 200000, [&]() -> uint64_t
+	{
+		buf.clear();
+		{
+			StreamWriter writer(buf);
+			Encoder::Encode(writer, role);
+		}
+		return buf.size();
+	});
+	bench::PrintThroughput("nested struct encode", ns, buf.size());
+
+	BenchRole out;
+	ns = bench::Run("nested struct decode", 200000, [&]() -> uint64_t
+	{
+		StreamReader reader(buf.data(), buf.size());
+		Decoder::Decode(reader, out);
+		return out.items.size();
+	});
+	bench::PrintThroughput("nested struct decode", ns, buf.size());
+}
+
+// 不同嵌套深度的编码耗时
+template<int Depth>
+static void BenchDepth(int64_t times)
+{
+	BenchNode<Depth> node;
+	FillNode<Depth>(node, 1);
+	std::string buf;
+
+	std::string name = "depth " + std::to_string(Depth) + " encode";
+	double ns = bench::Run(name.c_str(), times, [&]() -> uint64_t
+	{
+		buf.clear();
+		{
+			StreamWriter writer(buf);
+			Encoder::Encode(writer, node);
+		}
+		return buf.size();
+	});
+	bench::PrintThroughput(name.c_str(), ns, buf.size());
+}
+
+// 同一元素类型分别按逐元素格式与批量格式编解码
+template<bool Is_Bulk>
+static void BenchVector(const char * tag, size_t count, int64_t times)
+{
+	typedef Serializer_Vector<int32_t, std::allocator<int32_t>, Is_Bulk> VectorSerializer;
+
+	std::vector<int32_t> v;
+	for (size_t i = 0; i < count; i++)
+	{
+		v.push_back((int32_t)(i * 2654435761U));
+	}
+
+	std::string buf;
+	std::string name = std::string("vector<int32_t> encode ") + tag + " (" + std::to_string(count) + ")";
+	double ns = bench::Run(name.c_str(), times, [&]() -> uint64_t
+	{
+		buf.clear();
+		{
+			StreamWriter writer(buf);
+			VectorSerializer::Encode(writer, v);
+		}
+		return buf.size();
+	});
+	bench::PrintThroughput(name.c_str(), ns, count * sizeof(int32_t));
+
+	std::vector<int32_t> out;
+	name = std::string("vector<int32_t> decode ") + tag + " (" + std::to_string(count) + ")";
+	ns = bench::Run(name.c_str(), times, [&]() -> uint64_t
+	{
+		StreamReader reader(buf.data(), buf.size());
+		VectorSerializer::Decode(reader, out);
+		return out.size();
+	});
+	bench::PrintThroughput(name.c_str(), ns, count * sizeof(int32_t));
+}
+
+int main()
+{
+	BenchVarint();
+	BenchString(16, 5000000);
+	BenchString(1024, 2000000);
+	BenchNestedStruct();
+	BenchDepth<1>(5000000);
+	BenchDepth<2>(2000000);
+	BenchDepth<3>(1000000);
+	BenchDepth<4>(500000);
+	BenchDepth<5>(200000);
+	BenchDepth<6>(100000);
+	BenchVector<false>("per-element", 1024, 100000);
+	BenchVector<true>("bulk", 1024, 100000);
+	return 0;
+}
@@ -0,0 +1,141 @@
+#include <string>
+#include <vector>
+#include <memory>
+#include "util/Timer.h"
+#include "util/TimeHelper.h"
+#include "BenchHelper.h"
+
+using namespace sframe;
+
+// 定时器基准测试：注册/删除定时器的开销，空闲一段时间后Execute追赶的开销
+
+class BenchTimerObj : public SafeTimerRegistor<BenchTimerObj>
+{
+public:
+	BenchTimerObj() : _count(0) {}
+
+	int32_t OnTimer()
+	{
+		_count++;
+		return -1;
+	}
+
+	int32_t GetCount() const
+	{
+		return _count;
+	}
+
+private:
+	int32_t _count;
+};
+
+static int32_t OnNormalTimer()
+{
+	return -1;
+}
+
+// 每批注册batch个定时器后全部删除，重复rounds批
+template<typename T_Regist>
+static void BenchChurn(const char * name, int32_t batch, int32_t rounds, T_Regist regist)
+{
+	TimerManager timer_mgr;
+	std::vector<TimerHandle> handles;
+	handles.reserve(batch);
+
+	int64_t start = bench::NowNanoseconds();
+	for (int32_t r = 0; r < rounds; r++)
+	{
+		for (int32_t i = 0; i < batch; i++)
+		{
+			// 分散到时间轮的不同层
+			handles.push_back(regist(timer_mgr, 10 + (i * 7919) % 600000));
+		}
+
+		for (const TimerHandle & h : handles)
+		{
+			timer_mgr.DeleteTimer(h);
+		}
+		handles.clear();
+	}
+	int64_t cost = bench::NowNanoseconds() - start;
+
+	bench::PrintResult(name, (double)cost / ((double)batch * rounds));
+}
+
+// 稀疏定时器(10~60秒后执行)，每次空闲idle_msec毫秒后调用一次Execute，统计Execute的耗时
+static void BenchIdleExecute(int32_t idle_msec, int32_t times)
+{
+	BenchTimerObj obj;
+	TimerManager timer_mgr;
+	for (int32_t i = 0; i < 1000; i++)
+	{
+		timer_mgr.RegistObjectTimer(10000 + (i * 7919) % 50000, &BenchTimerObj::OnTimer, &obj);
+	}
+	timer_mgr.Execute();
+
+	int64_t cost = 0;
+	for (int32_t i = 0; i < times; i++)
+	{
+		TimeHelper::ThreadSleep(idle_msec);
+		int64_t start = bench::NowNanoseconds();
+		timer_mgr.Execute();
+		cost += bench::NowNanoseconds() - start;
+	}
+
+	std::string name = "Execute after " + std::to_string(idle_msec) + " ms idle";
+	bench::PrintResult(name.c_str(), (double)cost / times);
+}
+
+int main()
+{
+	const int32_t kBatch = 10000;
+	const int32_t kRounds = 100;
+
+	BenchTimerObj obj;
+	BenchChurn("normal timer regist+delete", kBatch, kRounds, [](TimerManager & timer_mgr, int32_t after) -> TimerHandle
+	{
+		return timer_mgr.RegistNormalTimer(after, &OnNormalTimer);
+	});
+
+	BenchChurn("object timer regist+delete", kBatch, kRounds, [&obj](TimerManager & timer_mgr, int32_t after) -> TimerHandle
+	{
+		return timer_mgr.RegistObjectTimer(after, &BenchTimerObj::OnTimer, &obj);
+	});
+
+	std::shared_ptr<BenchTimerObj> shared_obj = std::make_shared<BenchTimerObj>();
+	BenchChurn("shared_ptr object timer regist+delete", kBatch, kRounds, [&shared_obj](TimerManager & timer_mgr, int32_t after) -> TimerHandle
+	{
+		return timer_mgr.RegistObjectTimer(after, &BenchTimerObj::OnTimer, shared_obj);
+	});
+
+	BenchChurn("safe timer regist+delete", kBatch, kRounds, [&obj](TimerManager & timer_mgr, int32_t after) -> TimerHandle
+	{
+		obj.SetTimerManager(&timer_mgr);
+		return obj.RegistTimer(after, &BenchTimerObj::OnTimer);
+	});
+
+	// 句柄有效性检查
+	TimerManager timer_mgr;
+	std::vector<TimerHandle> handles;
+	for (int32_t i = 0; i < kBatch; i++)
+	{
+		handles.push_back(timer_mgr.RegistObjectTimer(1000 + i, &BenchTimerObj::OnTimer, &obj));
+	}
+	for (int32_t i = 0; i < kBatch; i += 2)
+	{
+		timer_mgr.DeleteTimer(handles[i]);
+	}
+	size_t pos = 0;
+	bench::Run("IsTimerAlive", 10000000, [&]() -> uint64_t
+	{
+		pos = (pos + 1) % handles.size();
+		return Timer::IsTimerAlive(handles[pos]) ? 1 : 0;
+	});
+
+	BenchIdleExecute(1, 500);
+	BenchIdleExecute(10, 100);
+	BenchIdleExecute(100, 20);
+	BenchIdleExecute(1000, 3);
+
+	return 0;
+}
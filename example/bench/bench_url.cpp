@@ -0,0 +1,170 @@
+#include <string>
+#include <sstream>
+#include "util/Http.h"
+#include "BenchHelper.h"
+
+using namespace sframe;
+
+// URL编解码基准测试：UrlEncode、UrlDecode、ParseHttpParam、HttpParamToString
+// 以ostringstream逐字符输出的实现(改为查表之前的做法)作为对照
+
+static std::string OssUrlEncode(const std::string & str)
+{
+	static char sHexTable[17] = "0123456789ABCDEF";
+
+	std::ostringstream oss;
+	for (size_t i = 0; i < str.length(); i++)
+	{
+		char cur_char = str[i];
+		if (cur_char == '-' || cur_char == '_' || cur_char == '.' ||
+			(cur_char >= '0' && cur_char <= '9') ||
+			(cur_char >= 'a' && cur_char <= 'z') ||
+			(cur_char >= 'A' && cur_char <= 'Z'))
+		{
+			oss << cur_char;
+		}
+		else
+		{
+			oss << '%' << (sHexTable[(cur_char >> 4) & 0x0f]) << (sHexTable[(cur_char & 0x0f)]);
+		}
+	}
+	return oss.str();
+}
+
+static std::string OssUrlDecode(const std::string & str)
+{
+	std::ostringstream oss;
+	size_t pos = 0;
+	while (pos < str.length())
+	{
+		char cur_char = str[pos];
+		if (cur_char == '%')
+		{
+			if (pos + 2 >= str.length())
+			{
+				break;
+			}
+
+			char c1 = str[pos + 1];
+			c1 = (c1 >= 'a' && c1 <= 'z') ? c1 - 32 : c1;
+			char c2 = str[pos + 2];
+			c2 = (c2 >= 'a' && c2 <= 'z') ? c2 - 32 : c2;
+
+			cur_char = (((c1 >= 'A' ? (c1 - 'A' + 10) : (c1 - '0')) << 4) & 0xf0);
+			cur_char += ((c2 >= 'A' ? (c2 - 'A' + 10) : (c2 - '0')) & 0x0f);
+			oss << cur_char;
+			pos += 3;
+		}
+		else
+		{
+			oss << cur_char;
+			pos++;
+		}
+	}
+	return oss.str();
+}
+
+int main()
+{
+	// 典型的查询字符串：纯ASCII、带少量转义、大量转义(中文及符号)
+	const std::string kPlain = "uid=100123&token=abcdef0123456789&lang=zh-CN&page=3&size=20";
+	const std::string kMixed = "q=hello%20world&redirect=http%3A%2F%2Fgame.example.com%2Flogin%3Ffrom%3Dapp&ts=1600000000";
+	const std::string kEscaped = Http::UrlEncode("name=玩家一号&guild=星辰大海&msg=你好，世界！ & see you") + "&k=v";
+	const std::string * const kQueries[] = { &kPlain, &kMixed, &kEscaped };
+	const size_t kQueryCount = sizeof(kQueries) / sizeof(kQueries[0]);
+	const int64_t kTimes = 1000000;
+
+	std::string decoded[kQueryCount];
+	for (size_t i = 0; i < kQueryCount; i++)
+	{
+		decoded[i] = Http::UrlDecode(*kQueries[i]);
+	}
+
+	bench::Run("UrlDecode (3 queries)", kTimes, [&]() -> uint64_t
+	{
+		uint64_t n = 0;
+		for (size_t i = 0; i < kQueryCount; i++)
+		{
+			n += Http::UrlDecode(*kQueries[i]).length();
+		}
+		return n;
+	});
+
+	std::string out;
+	bench::Run("UrlDecode append (3 queries)", kTimes, [&]() -> uint64_t
+	{
+		out.clear();
+		for (size_t i = 0; i < kQueryCount; i++)
+		{
+			Http::UrlDecode(kQueries[i]->data(), kQueries[i]->length(), out);
+		}
+		return out.length();
+	});
+
+	bench::Run("ostringstream UrlDecode (3 queries)", kTimes, [&]() -> uint64_t
+	{
+		uint64_t n = 0;
+		for (size_t i = 0; i < kQueryCount; i++)
+		{
+			n += OssUrlDecode(*kQueries[i]).length();
+		}
+		return n;
+	});
+
+	bench::Run("UrlEncode (3 queries)", kTimes, [&]() -> uint64_t
+	{
+		uint64_t n = 0;
+		for (size_t i = 0; i < kQueryCount; i++)
+		{
+			n += Http::UrlEncode(decoded[i]).length();
+		}
+		return n;
+	});
+
+	bench::Run("UrlEncode append (3 queries)", kTimes, [&]() -> uint64_t
+	{
+		out.clear();
+		for (size_t i = 0; i < kQueryCount; i++)
+		{
+			Http::UrlEncode(decoded[i].data(), decoded[i].length(), out);
+		}
+		return out.length();
+	});
+
+	bench::Run("ostringstream UrlEncode (3 queries)", kTimes, [&]() -> uint64_t
+	{
+		uint64_t n = 0;
+		for (size_t i = 0; i < kQueryCount; i++)
+		{
+			n += OssUrlEncode(decoded[i]).length();
+		}
+		return n;
+	});
+
+	bench::Run("ParseHttpParam (3 queries)", kTimes / 4, [&]() -> uint64_t
+	{
+		uint64_t n = 0;
+		for (size_t i = 0; i < kQueryCount; i++)
+		{
+			n += Http::ParseHttpParam(*kQueries[i]).size();
+		}
+		return n;
+	});
+
+	Http::Param params[kQueryCount];
+	for (size_t i = 0; i < kQueryCount; i++)
+	{
+		params[i] = Http::ParseHttpParam(*kQueries[i]);
+	}
+	bench::Run("HttpParamToString (3 queries)", kTimes / 4, [&]() -> uint64_t
+	{
+		uint64_t n = 0;
+		for (size_t i = 0; i < kQueryCount; i++)
+		{
+			n += Http::HttpParamToString(params[i]).length();
+		}
+		return n;
+	});
+
+	return 0;
+}
@@ -0,0 +1,148 @@
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include "util/WordFilter.h"
+#include "BenchHelper.h"
+
+using namespace sframe;
+
+// 敏感词过滤基准测试：ASCII和中文文本的查找、替换吞吐量，以及多线程并发查找
+
+static const char * const kCjkChars[] = { "你", "好", "世", "界", "游", "戏", "服", "务", "器", "测", "试", "文", "本", "过", "滤", "词" };
+static const size_t kCjkCharCount = sizeof(kCjkChars) / sizeof(kCjkChars[0]);
+
+static uint32_t s_seed = 12345;
+
+static uint32_t NextRand()
+{
+	s_seed = s_seed * 1103515245 + 12345;
+	return (s_seed >> 16) & 0x7fff;
+}
+
+static std::string MakeAsciiWord(size_t len)
+{
+	std::string s;
+	for (size_t i = 0; i < len; i++)
+	{
+		s.push_back((char)('a' + NextRand() % 26));
+	}
+	return s;
+}
+
+static std::string MakeCjkWord(size_t len)
+{
+	std::string s;
+	for (size_t i = 0; i < len; i++)
+	{
+		s.append(kCjkChars[NextRand() % kCjkCharCount]);
+	}
+	return s;
+}
+
+// 生成约len字节的文本，每隔一段混入一个敏感词
+static std::string MakeText(bool cjk, size_t len, const std::vector<std::string> & words)
+{
+	std::string text;
+	while (text.length() < len)
+	{
+		if (NextRand() % 64 == 0)
+		{
+			text.append(words[NextRand() % words.size()]);
+		}
+		else if (cjk)
+		{
+			text.append(kCjkChars[NextRand() % kCjkCharCount]);
+		}
+		else
+		{
+			text.push_back(NextRand() % 8 == 0 ? ' ' : (char)('a' + NextRand() % 26));
+		}
+	}
+	return text;
+}
+
+static void BenchText(const char * tag, const WordFilter & filter, const std::string & text)
+{
+	std::string name = std::string(tag) + " HaveBadWord";
+	double ns = bench::Run(name.c_str(), 20000, [&]() -> uint64_t
+	{
+		return filter.HaveBadWord(text) ? 1 : 0;
+	});
+	bench::PrintThroughput(name.c_str(), ns, text.length());
+
+	name = std::string(tag) + " ReplaceBadWord";
+	ns = bench::Run(name.c_str(), 20000, [&]() -> uint64_t
+	{
+		return filter.ReplaceBadWord(text).length();
+	});
+	bench::PrintThroughput(name.c_str(), ns, text.length());
+}
+
+// 多个线程同时对一个还没有编译的过滤器第一次查找，然后并发替换
+static void BenchConcurrent(const std::vector<std::string> & words, const std::string & text, int32_t thread_count)
+{
+	WordFilter filter;
+	for (const std::string & w : words)
+	{
+		filter.AddWord(w);
+	}
+
+	const int32_t kTimesPerThread = 2000;
+	std::atomic<int64_t> replaced(0);
+	std::vector<std::thread> threads;
+	int64_t start = bench::NowNanoseconds();
+	for (int32_t i = 0; i < thread_count; i++)
+	{
+		threads.push_back(std::thread([&]()
+		{
+			int64_t n = 0;
+			for (int32_t k = 0; k < kTimesPerThread; k++)
+			{
+				n += (int64_t)filter.ReplaceBadWord(text).length();
+			}
+			replaced.fetch_add(n);
+		}));
+	}
+	for (std::thread & t : threads)
+	{
+		t.join();
+	}
+	int64_t cost = bench::NowNanoseconds() - start;
+	bench::DoNotOptimize((uint64_t)replaced.load());
+
+	double ns = (double)cost / ((double)thread_count * kTimesPerThread);
+	std::string name = "ReplaceBadWord " + std::to_string(thread_count) + " threads (incl. compile)";
+	bench::PrintResult(name.c_str(), ns);
+	bench::PrintThroughput(name.c_str(), ns, text.length());
+}
+
+int main()
+{
+	std::vector<std::string> words;
+	for (int32_t i = 0; i < 2000; i++)
+	{
+		words.push_back(i % 2 == 0 ? MakeAsciiWord(3 + NextRand() % 6) : MakeCjkWord(2 + NextRand() % 3));
+	}
+
+	WordFilter filter;
+	for (const std::string & w : words)
+	{
+		filter.AddWord(w);
+	}
+	filter.AddIgnoreCharacters(" -_");
+
+	int64_t start = bench::NowNanoseconds();
+	filter.Compile();
+	bench::PrintResult("Compile (2000 words)", (double)(bench::NowNanoseconds() - start));
+
+	std::string ascii_text = MakeText(false, 4096, words);
+	std::string cjk_text = MakeText(true, 4096, words);
+	BenchText("ASCII 4KB", filter, ascii_text);
+	BenchText("CJK 4KB", filter, cjk_text);
+
+	BenchConcurrent(words, cjk_text, 1);
+	BenchConcurrent(words, cjk_text, 4);
+
+	return 0;
+}
@@ -0,0 +1,98 @@
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <iostream>
+#include "util/BinaryLog.h"
+
+// 二进制日志解码工具：blogdecode <二进制日志文件(.blog)> [输出文件]，不指定输出文件时输出到标准输出
+int main(int argc, char * argv[])
+{
+	if (argc < 2)
+	{
+		std::cerr << "usage: " << argv[0] << " <binary log file> [output file]" << std::endl;
+		return -1;
+	}
+
+	FILE * in = fopen(argv[1], "rb");
+	if (!in)
+	{
+		std::cerr << "open " << argv[1] << " error" << std::endl;
+		return -1;
+	}
+
+	FILE * out = stdout;
+	if (argc > 2)
+	{
+		out = fopen(argv[2], "wb");
+		if (!out)
+		{
+			std::cerr << "open " << argv[2] << " error" << std::endl;
+			fclose(in);
+			return -1;
+		}
+	}
+
+	sframe::BinaryLogDecoder decoder;
+	std::vector<char> buf(1024 * 1024);
+	size_t data_len = 0;
+	std::string text;
+	bool have_magic = false;
+
+	while (true)
+	{
+		if (data_len == buf.size())
+		{
+			// 单条记录比缓冲区还大
+			buf.resize(buf.size() * 2);
+		}
+
+		size_t n = fread(buf.data() + data_len, 1, buf.size() - data_len, in);
+		if (n == 0)
+		{
+			break;
+		}
+
+		if (data_len == 0 && !have_magic)
+		{
+			have_magic = n >= sframe::kBinaryLogMagicLength && memcmp(buf.data(), sframe::kBinaryLogMagic, sframe::kBinaryLogMagicLength) == 0;
+			if (!have_magic)
+			{
+				std::cerr << argv[1] << " is not a binary log file" << std::endl;
+				break;
+			}
+		}
+
+		data_len += n;
+		size_t decoded_len = decoder.Decode(buf.data(), data_len, text);
+		if (decoded_len > 0)
+		{
+			memmove(buf.data(), buf.data() + decoded_len, data_len - decoded_len);
+			data_len -= decoded_len;
+		}
+
+		if (!text.empty())
+		{
+			fwrite(text.data(), 1, text.length(), out);
+			text.clear();
+		}
+	}
+
+	if (data_len > 0)
+	{
+		std::cerr << "incomplete record at the end of file, " << data_len << " bytes" << std::endl;
+	}
+
+	if (decoder.GetErrorRecords() > 0)
+	{
+		std::cerr << decoder.GetErrorRecords() << " records can not be decoded" << std::endl;
+	}
+
+	fclose(in);
+	if (out != stdout)
+	{
+		fclose(out);
+	}
+
+	return have_magic ? 0 : -1;
+}
@@ -15,16 +15,24 @@ HttpSession::HttpSession(HttpService * http_service, const std::shared_ptr<sfram
 int32_t HttpSession::OnReceived(char * data, int32_t len)
 {
 	std::string err_msg;
-	size_t readed = _http_decoder.Decode(data, len, err_msg);
-	if (!err_msg.empty())
-	{
-		FLOG("HttpService") << "HttpSession " << _session_id << " decode http request error|" << err_msg << std::endl;
-		// 关闭连接
-		return -1;
-	}
+	size_t readed = 0;
 
-	if (_http_decoder.IsDecodeCompleted())
+	// 一次可能收到多个请求(管线化)，按顺序交给服务处理，响应也按顺序发送
+	while (readed < (size_t)len)
 	{
+		readed += _http_decoder.Decode(data + readed, len - readed, err_msg);
+		if (!err_msg.empty())
+		{
+			FLOG("HttpService") << "HttpSession " << _session_id << " decode http request error|" << err_msg << std::endl;
+			// 关闭连接
+			return -1;
+		}
+
+		if (!_http_decoder.IsDecodeCompleted())
+		{
+			break;
+		}
+
 		std::shared_ptr<sframe::HttpRequest> http_req = _http_decoder.GetResult();
 		_http_decoder.Reset();
 		assert(http_req);
@@ -62,10 +70,20 @@ void HttpSession::OnMsg_HttpRequest(std::shared_ptr<sframe::HttpRequest> http_re
 	http_resp.SetProtoVersion(http_req->GetProtoVersion());
 	http_resp.SetStatusCode(200);
 	http_resp.SetStatusDesc("OK");
-	http_resp.SetHeader("Connection", "Keep-Alive");
+	http_resp.SetHeader("Connection", http_req->IsKeepAlive() ? "Keep-Alive" : "close");
 	http_resp.SetContent("Hello world");
-	std::string data = http_resp.ToString();
+
+	// 序列化到本线程复用的缓冲区，一次压入socket的发送缓冲区
+	static thread_local std::string data;
+	data.clear();
+	http_resp.WriteTo(data);
 	_sock->Send(data.data(), (int32_t)data.length());
+
+	// 非长连接，发送完响应后关闭
+	if (!http_req->IsKeepAlive())
+	{
+		StartClose();
+	}
 }
 
 void HttpSession::OnMsg_HttpSessionClosed()
@@ -2,6 +2,7 @@
 #include <stdio.h>
 #include "User.h"
 #include "util/Serialization.h"
+#include "util/Arena.h"
 #include "util/Log.h"
 #include "serv/ServiceDispatcher.h"
 #include "../ssproto/SSMsg.h"
@@ -24,7 +25,7 @@ void User::OnClientData(const WorkMsg_ClientData & msg)
 	int32_t client_id;
 	int32_t count;
 	int64_t send_time;
-	std::string text;
+	ArenaString text;
 	uint32_t len = (uint32_t)data.size();
 	StreamReader stream_reader(len > 0 ? &data[0] : nullptr, len);
 	if (!AutoDecode(stream_reader, client_id, count, send_time, text))
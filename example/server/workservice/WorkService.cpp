@@ -16,6 +16,9 @@ void WorkService::Init()
 
 	std::function<User*(const int64_t &)> get_user_func = std::bind(&WorkService::GetUser, this, std::placeholders::_1);
 	RegistServiceMessageHandler(kWorkMsg_ClientData, &User::OnClientData, get_user_func);
+
+	// 处理客户端数据时的临时分配使用内存区
+	EnableArena();
 }
 
 
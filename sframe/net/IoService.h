@@ -24,6 +24,9 @@ public:
 
 	virtual void Close() = 0;
 
+	// 唤醒正在RunOnce中等待的线程（线程安全）
+	virtual void Wakeup() = 0;
+
 	bool IsOpen()
 	{
 		return _open;
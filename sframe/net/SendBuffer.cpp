@@ -14,110 +14,146 @@ SendBuffer::~SendBuffer()
 
 void SendBuffer::Push(const char * data, int32_t len, bool & send_now)
 {
-	send_now = false;
+	PushData(data, len);
 
-	AUTO_LOCK(_locker);
+	// 没有线程在发送时由本线程发起发送(与Peek中结束发送状态后的检查配对，数据和发送状态至少有一方能看到对方)
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	send_now = !_sending.load() && !_sending.exchange(true);
+}
+
+void SendBuffer::PushNotSend(const char * data, int32_t len)
+{
+	PushData(data, len);
+}
 
-	// 先尝试压入主缓冲区
-	int32_t pushed = _buf.Push(data, len);
-	if (pushed < len)
+// 读数据
+char * SendBuffer::Peek(int32_t & len)
+{
+	while (true)
 	{
-		if (pushed > 0)
+		char * data = PeekData(len);
+		if (data)
 		{
-			// 若压入了数据到主缓冲区，那么备用的链表必定为空
-			assert(_standby_list.empty());
+			return data;
 		}
 
-		const char * remain_data = data + pushed;
-		int32_t remain_len = len - pushed;
+		// 没有数据了，结束发送状态
+		_sending.store(false);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
 
-		while (remain_len > 0)
+		// 结束前压入数据的线程看到还在发送，不会发起发送，所以再检查一次，有数据时重新接手
+		if ((_buf.GetUnReadLength() == 0 && _standby_len.load() == 0) || _sending.exchange(true))
 		{
-			auto standby = GetStandbyBuffer();
-			pushed = standby->Push(remain_data, remain_len);
-			remain_data += pushed;
-			remain_len -= pushed;
+			len = 0;
+			return nullptr;
 		}
 	}
-
-	if (!_sending && !_buf.IsEmpty())
-	{
-		_sending = true;
-		send_now = true;
-	}
 }
 
-void SendBuffer::PushNotSend(const char * data, int32_t len)
+// 释放空间
+void SendBuffer::Free(int32_t len)
 {
-	AUTO_LOCK(_locker);
+	if (len <= 0)
+	{
+		return;
+	}
 
-	// 先尝试压入主缓冲区
-	int32_t pushed = _buf.Push(data, len);
-	if (pushed < len)
+	if (!_peek_standby)
 	{
-		if (pushed > 0)
-		{
-			// 若压入了数据到主缓冲区，那么备用的链表必定为空
-			assert(_standby_list.empty());
-		}
+		_buf.Free(len);
+		return;
+	}
 
-		const char * remain_data = data + pushed;
-		int32_t remain_len = len - pushed;
+	AUTO_LOCK(_locker);
 
-		while (remain_len > 0)
-		{
-			auto standby = GetStandbyBuffer();
-			pushed = standby->Push(remain_data, remain_len);
-			remain_data += pushed;
-			remain_len -= pushed;
-		}
+	assert(!_standby_list.empty());
+	StreamBuffer<kStandbyCapacity>* standby = _standby_list.front();
+	assert(len <= _standby_msg_left);
+	standby->Free(len);
+	_standby_len.fetch_sub(len);
+	_standby_msg_left -= len;
+
+	if (standby->IsEmpty())
+	{
+		ObjectPool<StreamBuffer<kStandbyCapacity>>::Instance().Delete(standby);
+		_standby_list.pop_front();
 	}
 }
 
-// 读数据
-char * SendBuffer::Peek(int32_t & len)
+void SendBuffer::PushData(const char * data, int32_t len)
 {
-	AUTO_LOCK(_locker);
+	if (data == nullptr || len <= 0)
+	{
+		return;
+	}
 
-	char * data = _buf.Peek(len);
-	if (data == nullptr)
+	// 备用缓冲区不为空时不能压入主缓冲区，否则会排到备用缓冲区中更早的数据前面
+	if (_standby_len.load() == 0 && _buf.Push(data, len))
 	{
-		assert(len == 0);
-		_sending = false;
+		return;
 	}
 
-	return data;
-}
+	AUTO_LOCK(_locker);
 
-// 释放空间
-void SendBuffer::Free(int32_t len)
-{
-	if (len <= 0)
+	if (_standby_len.load() == 0 && _buf.Push(data, len))
 	{
 		return;
 	}
 
-	AUTO_LOCK(_locker);
-	_buf.Free(len);
+	PushStandby(data, len);
+}
 
-	assert(!_buf.IsFull());
+char * SendBuffer::PeekData(int32_t & len)
+{
+	len = 0;
+	_peek_standby = false;
 
-	while (!_buf.IsFull() && !_standby_list.empty())
+	char * data = nullptr;
+	if (_standby_msg_left == 0)
 	{
-		StreamBuffer<kStandbyCapacity>* standby = _standby_list.front();
-		int32_t move_len = 0;
-		const char * data = standby->Peek(move_len);
-		assert(data && move_len > 0);
+		data = _buf.Peek(len);
+		if (data || _standby_len.load() == 0)
+		{
+			return data;
+		}
+	}
 
-		int32_t push_len = _buf.Push(data, move_len);
-		assert(push_len > 0);
-		standby->Free(push_len);
+	AUTO_LOCK(_locker);
 
-		if (standby->IsEmpty())
+	if (_standby_msg_left == 0)
+	{
+		// 加锁后再检查一次主缓冲区：压入备用缓冲区之前提交到主缓冲区的数据要先发送
+		data = _buf.Peek(len);
+		if (data || _standby_list.empty())
 		{
-			ObjectPool<StreamBuffer<kStandbyCapacity>>::Instance().Delete(standby);
-			_standby_list.pop_front();
+			return data;
 		}
+
+		assert(!_standby_msg_len.empty());
+		_standby_msg_left = _standby_msg_len.front();
+		_standby_msg_len.pop_front();
+	}
+
+	// 备用缓冲区中的一次压入没发完之前，期间提交到主缓冲区的数据要等它发完
+	data = _standby_list.front()->Peek(len);
+	assert(data && len > 0);
+	len = std::min(len, _standby_msg_left);
+	_peek_standby = true;
+
+	return data;
+}
+
+void SendBuffer::PushStandby(const char * data, int32_t len)
+{
+	_standby_len.fetch_add(len);
+	_standby_msg_len.push_back(len);
+
+	while (len > 0)
+	{
+		auto standby = GetStandbyBuffer();
+		int32_t pushed = standby->Push(data, len);
+		data += pushed;
+		len -= pushed;
 	}
 }
 
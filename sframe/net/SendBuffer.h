@@ -6,7 +6,10 @@
 #include <assert.h>
 #include <memory.h>
 #include <list>
+#include <deque>
+#include <atomic>
 #include "../util/Lock.h"
+#include "../util/Buffer.h"
 
 namespace sframe{
 
@@ -109,13 +112,16 @@ private:
 };
 
 // Socket发送缓冲区
+// 多个线程可以同时压入(主缓冲区无锁)，只有一个线程(持有发送状态的线程)读取
+// 主缓冲区放不下时放入备用缓冲区(加锁)，备用缓冲区不为空时后续数据也放入备用缓冲区，保证同一线程压入的数据有序
+// 开始发送备用缓冲区中的一次压入后要把它发完，才能再回到主缓冲区，避免与主缓冲区的数据交错
 class SendBuffer
 {
 	static const int32_t kBufferCapacity = 65536;
 	static const int32_t kStandbyCapacity = 1024 * 8;
 
 public:
-	SendBuffer() : _sending(false) {}
+	SendBuffer() : _sending(false), _standby_len(0), _peek_standby(false), _standby_msg_left(0) {}
 
 	~SendBuffer();
 
@@ -123,20 +129,33 @@ public:
 
 	void PushNotSend(const char * data, int32_t len);
 
-	// 读数据
+	// 读数据(没有数据时结束发送状态)
 	char * Peek(int32_t & len);
 
 	// 释放空间
 	void Free(int32_t len);
 
 private:
+	// 压入数据
+	void PushData(const char * data, int32_t len);
+
+	// 读数据(主缓冲区优先)
+	char * PeekData(int32_t & len);
+
+	// 压入备用缓冲区(需持有_locker)
+	void PushStandby(const char * data, int32_t len);
+
 	StreamBuffer<kStandbyCapacity> * GetStandbyBuffer();
 
 private:
-	Lock _locker;
-	bool _sending;
-	StreamBuffer<kBufferCapacity> _buf;
+	Lock _locker;                                              // 保护备用缓冲区
+	std::atomic<bool> _sending;                                // 是否有线程持有发送状态
+	FastRingBuffer<char, kBufferCapacity> _buf;                // 主缓冲区
 	std::list<StreamBuffer<kStandbyCapacity>*> _standby_list;  // 备用缓冲区链表
+	std::atomic<int32_t> _standby_len;                         // 备用缓冲区中的数据长度
+	std::deque<int32_t> _standby_msg_len;                      // 备用缓冲区中每次压入的长度
+	bool _peek_standby;                                        // 上次读取的是否为备用缓冲区(只有读取线程访问)
+	int32_t _standby_msg_left;                                 // 正在发送的备用缓冲区数据还剩的长度(只有读取线程访问)
 };
 
 }
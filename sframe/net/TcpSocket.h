@@ -67,6 +67,7 @@ public:
     // 关闭
 	// 返回true: 表示成功开始执行关闭操作，只有处于kState_Connecting、kState_ConnectFailed、kState_Opened的socket才会执行关闭，关闭完成后会执行OnClosed回调
 	// 返回false: 关闭失败，socket处于kState_Initial或kState_Closed状态，不会执行关闭操作，也不会执行OnClosed回调
+	// 关闭前已经Send的数据会尽量发出(不等待对方接收)，所以可以发送完响应后直接关闭
     virtual bool Close() = 0;
 
 	// 设置TCP_NODELAY
@@ -160,6 +160,22 @@ void IoService_Linux::Close()
 	}
 }
 
+void IoService_Linux::Wakeup()
+{
+	if (!_open)
+	{
+		return;
+	}
+
+	// 只写事件fd，RunOnce会取到一个空的消息列表并返回
+	uint64_t c = 1;
+	int ret = write(_msg_evt_fd, &c, sizeof(c));
+	if (ret < (int)sizeof(c))
+	{
+		assert(false);
+	}
+}
+
 // 添加监听事件
 bool IoService_Linux::AddIoEvent(const IoUnit & iounit, const IoEvent ioevt)
 {
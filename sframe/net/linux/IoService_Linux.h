@@ -30,6 +30,8 @@ public:
 
 	void Close() override;
 
+	void Wakeup() override;
+
 	// 添加监听事件
 	bool AddIoEvent(const IoUnit & iounit, const IoEvent ioevt);
 
@@ -233,6 +233,8 @@ void TcpSocket_Linux::OnMsg(IoMsg * io_msg)
 		if (_sock >= 0)
 		{
 			((IoService_Linux*)(_io_service.get()))->DeleteIoEvent(*this, _cur_events);
+			// 关闭前已投递的发送不再执行，这里把已经Send的数据(如最后一个响应)写出去
+			FlushSendData();
 			shutdown(_sock, SHUT_RDWR);
 			close(_sock);
 			_sock = -1;
@@ -399,6 +401,24 @@ bool TcpSocket_Linux::SendData()
     return true;
 }
 
+// 关闭前尽量发出发送缓冲区中的数据(不等待可写)
+void TcpSocket_Linux::FlushSendData()
+{
+	int32_t peek_len = 0;
+	char * buf = _send_buf.Peek(peek_len);
+	while (peek_len > 0)
+	{
+		int32_t ret = (int32_t)write(_sock, buf, peek_len);
+		if (ret <= 0)
+		{
+			break;
+		}
+
+		_send_buf.Free(ret);
+		buf = _send_buf.Peek(peek_len);
+	}
+}
+
 // 接收数据
 bool TcpSocket_Linux::RecvData()
 {
@@ -55,6 +55,9 @@ private:
     // 发送数据
     bool SendData();
 
+    // 关闭前尽量发出发送缓冲区中的数据(不等待可写)
+    void FlushSendData();
+
     // 接收数据
     bool RecvData();
 
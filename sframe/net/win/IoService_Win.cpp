@@ -120,6 +120,21 @@ void IoService_Win::Close()
 	}
 }
 
+void IoService_Win::Wakeup()
+{
+	if (!_open)
+	{
+		return;
+	}
+
+	// 投递一个没有关联IoUnit的消息，RunOnce取到后直接返回
+	static IoMsg wakeup_msg(kIoMsgType_NotifyError);
+	if (!PostQueuedCompletionStatus(_iocp, 0, (ULONG_PTR)0, (LPOVERLAPPED)&wakeup_msg))
+	{
+		assert(false);
+	}
+}
+
 // 注册Socket
 bool IoService_Win::RegistSocket(const IoUnit & sock)
 {
@@ -22,6 +22,8 @@ public:
 
 	void Close() override;
 
+	void Wakeup() override;
+
 	// 注册Socket
 	bool RegistSocket(const IoUnit & io_unit);
 
@@ -26,6 +26,7 @@ enum MessageType : int32_t
 	kMsgType_NetServiceMessage,       // 网络服务间消息
 	kMsgType_InsideServiceMessage,    // 内部服务间消息
 	kMsgType_ProxyServiceMessage,     // 代理服务消息
+	kMsgType_TimerMessage,            // 定时器到期消息
 };
 
 // 消息基类
@@ -108,7 +109,7 @@ public:
 	}
 
 public:
-	std::vector<char> data;
+	std::shared_ptr<std::vector<char>> data;   // 消息数据(消息处理期间一直有效，StringView等解码视图引用其中的数据)
 };
 
 // 内部服务间消息
@@ -168,27 +169,17 @@ public:
 	bool DoUnfoldTuple(Args&&... args)
 	{
 		assert(_str_buf);
-		size_t msg_size = AutoGetSize(src_sid, dest_sid, session_key, msg_id, args...);
-		size_t size_field_size = StreamWriter::GetSizeFieldSize(msg_size);
-		size_t buf_size = msg_size + size_field_size;
-		size_t old_buf_size = _str_buf->size();
-		_str_buf->resize(old_buf_size + buf_size);
-		StreamWriter writer(&(*_str_buf)[0] + old_buf_size, buf_size);
-		if (!writer.WriteSizeField(msg_size) || !AutoEncode(writer, src_sid, dest_sid, session_key, msg_id, args...))
+		// 一次遍历编码：长度字段使用定长格式，编码完成后回填
+		StreamWriter writer(*_str_buf);
+		size_t size_field_pos = writer.ReserveFixedSizeField();
+		if (size_field_pos == (size_t)-1 || !AutoEncode(writer, src_sid, dest_sid, session_key, msg_id, args...) ||
+			!writer.FillFixedSizeField(size_field_pos, writer.GetStreamLength() - size_field_pos - StreamWriter::kFixedSizeFieldSize))
 		{
 			LOG_ERROR << "Serialize mesage error|MsgId|" << msg_id << "|SrcServiceId|" << src_sid << "|DestServiceId|" << dest_sid
-				<< "|SessionKey|" << session_key << "|MsgSize|" << msg_size << "|SizeFieldSize|" << size_field_size
-				<< "|BufSize|" << buf_size << "|StreamWriterPos|" << writer.GetStreamLength() <<std::endl;
+				<< "|SessionKey|" << session_key << "|StreamWriterPos|" << writer.GetStreamLength() << std::endl;
 			return false;
 		}
 
-		if (buf_size != writer.GetStreamLength())
-		{
-			LOG_ERROR << "MsgSize error|MsgId|" << msg_id << "|SrcServiceId|" << src_sid << "|DestServiceId|" << dest_sid
-				<< "|SessionKey|" << session_key << "|MsgSize|" << msg_size << "|SizeFieldSize|" << size_field_size
-				<< "|BufSize|" << buf_size << "|StreamWriterPos|" << writer.GetStreamLength() << std::endl;
-		}
-
 		return true;
 	}
 
@@ -208,6 +199,17 @@ public:
 	}
 };
 
+// 定时器到期消息(服务绑定的定时器管理器有定时器到期)
+class TimerMessage : public Message
+{
+public:
+	// 获取消息类型
+	MessageType GetType() const
+	{
+		return kMsgType_TimerMessage;
+	}
+};
+
 // 监听地址
 struct ListenAddress
 {
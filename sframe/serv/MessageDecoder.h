@@ -63,7 +63,7 @@ public:
 	bool DoUnfoldTuple(Args&&... args)
 	{
 		NetServiceMessage * msg = dynamic_cast<NetServiceMessage*>(_msg);
-		if (msg == nullptr)
+		if (msg == nullptr || !msg->data)
 		{
 			return false;
 		}
@@ -72,7 +72,7 @@ public:
 		int32_t dest_sid = 0;
 		int64_t session_key = 0;
 		uint16_t msg_id = 0;
-		StreamReader stream_reader(&(msg->data)[0], (uint32_t)msg->data.size());
+		StreamReader stream_reader(msg->data->data(), msg->data->size());
 		return AutoDecode(stream_reader, src_sid, dest_sid, session_key, msg_id, args...);
 	}
 
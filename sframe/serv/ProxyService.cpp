@@ -1,18 +1,204 @@
 ﻿
 #include "ServiceDispatcher.h"
 #include "ProxyService.h"
+#include "ServiceStats.h"
 #include "../net/SocketAddr.h"
 #include "../util/Log.h"
+#include "../util/ObjectPool.h"
 #include "../util/TimeHelper.h"
 
 using namespace sframe;
 
 const std::string ProxyService::kAdminAddrDescName = "AdminAddr";
 
+// 管理命令：查看或设置日志级别
+// log_level                        查看全局级别和单独设置了级别的日志
+// log_level?level=warn             设置全局级别
+// log_level?name=xxx&level=info    设置分模块日志的级别(level=default恢复使用全局级别)
+static void AdminCmd_LogLevel(const AdminCmd & cmd)
+{
+	const std::string & level_text = cmd.GetCmdParam("level");
+	if (!level_text.empty())
+	{
+		const std::string & log_name = cmd.GetCmdParam("name");
+		int32_t level = kLogLevel_None;
+		if (!LoggerMgr::ParseLogLevel(level_text, level) || (log_name.empty() && level == kLogLevel_None))
+		{
+			cmd.SendResponse("Invalid log level: " + level_text + "\n");
+			return;
+		}
+
+		if (log_name.empty())
+		{
+			LoggerMgr::SetLogLevel(level);
+		}
+		else
+		{
+			LoggerMgr::Instance().SetLoggerLevel(log_name, level);
+		}
+
+		LOG_INFO << "Set log level|" << (log_name.empty() ? "*" : log_name) << '|' << LoggerMgr::GetLogLevelText(level) << std::endl;
+	}
+
+	std::ostringstream oss;
+	oss << "Log Level : " << LoggerMgr::GetLogLevelText(LoggerMgr::GetLogLevel()) << std::endl;
+	for (auto & pr : LoggerMgr::Instance().GetLoggerLevels())
+	{
+		oss << "    " << pr.first << " : " << LoggerMgr::GetLogLevelText(pr.second) << std::endl;
+	}
+
+	cmd.SendResponse(oss.str());
+}
+
+// 管理命令：查看日志丢弃统计或设置溢出策略
+// log_stats                                 查看暂存缓冲区大小、溢出策略和各日志的丢弃统计
+// log_stats?policy=drop_newest              设置全局溢出策略(block、drop_newest、drop_oldest)
+// log_stats?name=xxx&policy=block           设置分模块日志的溢出策略(policy=default恢复使用全局策略)
+static void AdminCmd_LogStats(const AdminCmd & cmd)
+{
+	const std::string & policy_text = cmd.GetCmdParam("policy");
+	if (!policy_text.empty())
+	{
+		const std::string & log_name = cmd.GetCmdParam("name");
+		int32_t policy = kLogOverflowPolicy_Default;
+		if (!LoggerMgr::ParseOverflowPolicy(policy_text, policy) || (log_name.empty() && policy == kLogOverflowPolicy_Default))
+		{
+			cmd.SendResponse("Invalid log overflow policy: " + policy_text + "\n");
+			return;
+		}
+
+		if (log_name.empty())
+		{
+			LoggerMgr::Instance().SetOverflowPolicy(policy);
+		}
+		else
+		{
+			LoggerMgr::Instance().SetLoggerOverflowPolicy(log_name, policy);
+		}
+
+		LOG_INFO << "Set log overflow policy|" << (log_name.empty() ? "*" : log_name) << '|' << LoggerMgr::GetOverflowPolicyText(policy) << std::endl;
+	}
+
+	std::ostringstream oss;
+	oss << "Thread Buffer Size : " << LoggerMgr::Instance().GetThreadBufferSize() << std::endl;
+	oss << "Overflow Policy : " << LoggerMgr::GetOverflowPolicyText(LoggerMgr::Instance().GetOverflowPolicy()) << std::endl;
+	oss << "Loggers :" << std::endl;
+	for (auto & stats : LoggerMgr::Instance().GetLoggerStats())
+	{
+		oss << "    " << (stats.name.empty() ? "(default)" : stats.name) << " : policy=" << LoggerMgr::GetOverflowPolicyText(stats.overflow_policy)
+			<< " dropped=" << stats.dropped_lines << " blocked=" << stats.blocked_times << std::endl;
+	}
+
+	cmd.SendResponse(oss.str());
+}
+
+// 管理命令：查看服务消息的排队时间、处理时间(微秒)和消息队列深度
+// service_stats                 查看统计(服务汇总以及每种消息)
+// service_stats?sid=xxx         只查看指定服务
+// service_stats?enable=1        开启统计(enable=0关闭)
+// service_stats?reset=1         重新开始统计
+static void AdminCmd_ServiceStats(const AdminCmd & cmd)
+{
+	const std::string & enable_text = cmd.GetCmdParam("enable");
+	if (!enable_text.empty())
+	{
+		ServiceStatsMgr::SetEnabled(enable_text != "0");
+		LOG_INFO << "Set service stats|" << (ServiceStatsMgr::IsEnabled() ? "on" : "off") << std::endl;
+	}
+
+	if (cmd.GetCmdParam("reset") == "1")
+	{
+		ServiceStatsMgr::Instance().Reset();
+	}
+
+	const std::string & sid_text = cmd.GetCmdParam("sid");
+	int32_t only_sid = sid_text.empty() ? -1 : atoi(sid_text.c_str());
+
+	auto depths = ServiceStatsMgr::Instance().GetMsgQueueDepths();
+	auto msg_stats = ServiceStatsMgr::Instance().GetMsgStats();
+	std::sort(depths.begin(), depths.end(), [](const ServiceStatsMgr::MsgQueueDepth & a, const ServiceStatsMgr::MsgQueueDepth & b) {
+		return a.sid < b.sid;
+	});
+	std::sort(msg_stats.begin(), msg_stats.end(), [](const ServiceStatsMgr::MsgStats & a, const ServiceStatsMgr::MsgStats & b) {
+		return a.sid < b.sid || (a.sid == b.sid && a.msg_key < b.msg_key);
+	});
+
+	auto write_stats = [](std::ostringstream & oss, const HistogramData & queue_time, const HistogramData & handle_time) {
+		oss << " count=" << handle_time.GetCount()
+			<< " queue(p50/p99/max)=" << queue_time.GetPercentile(50) << '/' << queue_time.GetPercentile(99) << '/' << queue_time.GetMax()
+			<< " handle(p50/p99/max)=" << handle_time.GetPercentile(50) << '/' << handle_time.GetPercentile(99) << '/' << handle_time.GetMax()
+			<< " handle_mean=" << handle_time.GetMean() << std::endl;
+	};
+
+	std::ostringstream oss;
+	oss << "Service Stats : " << (ServiceStatsMgr::IsEnabled() ? "on" : "off") << " (time in microseconds)" << std::endl;
+	for (auto & depth : depths)
+	{
+		if (only_sid >= 0 && depth.sid != only_sid)
+		{
+			continue;
+		}
+
+		// 服务汇总
+		HistogramData service_queue_time;
+		HistogramData service_handle_time;
+		for (auto & stats : msg_stats)
+		{
+			if (stats.sid == depth.sid)
+			{
+				service_queue_time.Merge(stats.queue_time);
+				service_handle_time.Merge(stats.handle_time);
+			}
+		}
+
+		oss << "Service " << depth.sid << " : depth=" << depth.depth << " peak_depth=" << depth.peak_depth;
+		write_stats(oss, service_queue_time, service_handle_time);
+
+		for (auto & stats : msg_stats)
+		{
+			if (stats.sid == depth.sid)
+			{
+				oss << "    " << ServiceStatsMgr::GetMsgKeyText(stats.msg_key) << " :";
+				write_stats(oss, stats.queue_time, stats.handle_time);
+			}
+		}
+	}
+
+	cmd.SendResponse(oss.str());
+}
+
+// 管理命令：查看各对象池的统计
+static void AdminCmd_ObjectPoolStats(const AdminCmd & cmd)
+{
+	std::ostringstream oss;
+
+	// 释放完全空闲的内存页
+	if (cmd.GetCmdParam("release") == "1")
+	{
+		oss << "Released Bytes : " << ObjectPoolMgr::Instance().ReleaseFreeMemory() << std::endl;
+	}
+
+	oss << "Object Pools :" << std::endl;
+	for (auto & stats : ObjectPoolMgr::Instance().GetAllStats())
+	{
+		oss << "    " << stats.name << " : chunk_size=" << stats.chunk_size << " live=" << stats.live << " cached=" << stats.cached
+			<< " peak=" << stats.peak << " created=" << stats.created << " slab_size=" << stats.slab_size << " slabs=" << stats.slabs << std::endl;
+	}
+
+	cmd.SendResponse(oss.str());
+}
+
 
 ProxyService::ProxyService() : _have_no_session(true), _listening(false), _cur_max_session_id(0), _session_id_first_loop(true)
 {
 	memset(_quick_find_session_arr, 0, sizeof(_quick_find_session_arr));
+	// 会话定时器由调度器按到期时间驱动
+	BindTimerManager(&_timer_mgr);
+	// 内置管理命令
+	RegistAdminCmd("log_level", &AdminCmd_LogLevel);
+	RegistAdminCmd("log_stats", &AdminCmd_LogStats);
+	RegistAdminCmd("service_stats", &AdminCmd_ServiceStats);
+	RegistAdminCmd("object_pool_stats", &AdminCmd_ObjectPoolStats);
 }
 
 ProxyService::~ProxyService()
@@ -54,12 +240,6 @@ bool ProxyService::IsDestroyCompleted() const
 
 #include <iostream>
 
-// 处理周期定时器
-void ProxyService::OnCycleTimer()
-{
-	_timer_mgr.Execute();
-}
-
 // 新连接到来
 void ProxyService::OnNewConnection(const ListenAddress & listen_addr_info, const std::shared_ptr<sframe::TcpSocket> & sock)
 {
@@ -358,7 +538,7 @@ void ProxyService::OnMsg_SessionRecvData(int32_t session_id, const std::shared_p
 		msg->src_sid = src_sid;
 		msg->session_key = msg_session_key;
 		msg->msg_id = msg_id;
-		msg->data = std::move(vec_data);
+		msg->data = data;
 		// 发送到目标服务
 		ServiceDispatcher::Instance().SendMsg(dest_sid, msg);
 	}
@@ -411,6 +591,23 @@ void ProxyService::OnMsg_SessionConnectCompleted(int32_t session_id, bool succes
 	}
 }
 
+// 发送管理命令的HTTP响应(序列化到本线程复用的缓冲区，一次压入会话的发送缓冲区)
+static void SendAdminHttpResponse(ServiceSession * session, const HttpResponse & http_resp)
+{
+	static const size_t kMaxRetainedBufferSize = 64 * 1024;
+	static thread_local std::string buf;
+
+	buf.clear();
+	http_resp.WriteTo(buf);
+	session->SendData(buf.data(), buf.length());
+
+	// 大的响应(如统计信息)发送后不保留缓冲区
+	if (buf.capacity() > kMaxRetainedBufferSize)
+	{
+		std::string().swap(buf);
+	}
+}
+
 void ProxyService::OnMsg_AdminCommand(int32_t admin_session_id, const std::shared_ptr<sframe::HttpRequest> & http_req)
 {
 	ServiceSession * session = GetServiceSession(admin_session_id);
@@ -430,8 +627,7 @@ void ProxyService::OnMsg_AdminCommand(int32_t admin_session_id, const std::share
 		http_resp.SetStatusDesc("Method Not Allowed");
 		http_resp.SetHeader("Connection", "Keep-Alive");
 		http_resp.SetHeader("Allow", "GET");
-		std::string resp_content = http_resp.ToString();
-		session->SendData(resp_content.data(), resp_content.length());
+		SendAdminHttpResponse(session, http_resp);
 		LOG_ERROR << "Recv method not allowed admin cmd from client(" << session->GetRemoteAddrText() << ")|" << http_req->GetMethod() << std::endl;
 		return;
 	}
@@ -444,8 +640,7 @@ void ProxyService::OnMsg_AdminCommand(int32_t admin_session_id, const std::share
 		http_resp.SetStatusCode(400);
 		http_resp.SetStatusDesc("Bad Request");
 		http_resp.SetHeader("Connection", "Keep-Alive");
-		std::string resp_content = http_resp.ToString();
-		session->SendData(resp_content.data(), resp_content.length());
+		SendAdminHttpResponse(session, http_resp);
 		LOG_ERROR << "Recv invalid admin cmd from client(" << session->GetRemoteAddrText() << ")|" << http_req->GetMethod() << '|'
 			<< http_req->GetRequestUrl() << '|' << http_req->GetRequestParam() << std::endl;
 		return;
@@ -459,8 +654,7 @@ void ProxyService::OnMsg_AdminCommand(int32_t admin_session_id, const std::share
 		http_resp.SetStatusCode(404);
 		http_resp.SetStatusDesc("Not Found");
 		http_resp.SetHeader("Connection", "Keep-Alive");
-		std::string resp_content = http_resp.ToString();
-		session->SendData(resp_content.data(), resp_content.length());
+		SendAdminHttpResponse(session, http_resp);
 		LOG_ERROR << "Recv unknown admin cmd from client(" << session->GetRemoteAddrText() << ")|" << admin_cmd.ToString() << std::endl;
 		return;
 	}
@@ -485,7 +679,6 @@ void ProxyService::OnMsg_SendAdminCommandResponse(int32_t admin_session_id, cons
 		http_resp.SetStatusDesc("OK");
 		http_resp.SetHeader("Connection", "Keep-Alive");
 		http_resp.SetContent(data); 
-		std::string resp_content = http_resp.ToString();
-		session->SendData(resp_content.data(), resp_content.length());
+		SendAdminHttpResponse(session, http_resp);
 	}
 }
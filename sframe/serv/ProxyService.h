@@ -32,14 +32,6 @@ public:
 
 	bool IsDestroyCompleted() const override;
 
-	int32_t GetCyclePeriod() const override
-	{
-		return 1000;
-	}
-
-	// 处理周期定时器
-	void OnCycleTimer() override;
-
 	// 新连接到来
 	void OnNewConnection(const ListenAddress & listen_addr_info, const std::shared_ptr<sframe::TcpSocket> & sock) override;
 
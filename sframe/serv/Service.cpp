@@ -10,8 +10,20 @@ using namespace sframe;
 
 void MessageQueue::Push(const std::shared_ptr<Message> & msg)
 {
+	bool stats_enabled = ServiceStatsMgr::IsEnabled();
+	int64_t enqueue_time = stats_enabled ? TimeHelper::GetSteadyMicroseconds() : 0;
+
 	AUTO_LOCK(_lock);
-	_buf_write->push_back(msg);
+	_buf_write->push_back(QueuedMessage{ msg, enqueue_time });
+	if (stats_enabled)
+	{
+		if (!_depth_gauge)
+		{
+			_depth_gauge = ServiceStatsMgr::Instance().GetMsgQueueDepthGauge(_related_service->GetServiceId());
+		}
+		_depth_gauge->Update((int32_t)_buf_write->size());
+	}
+
 	if (_state == kServiceState_Idle)
 	{
 		_state = kServiceState_WaitProcess;
@@ -20,7 +32,7 @@ void MessageQueue::Push(const std::shared_ptr<Message> & msg)
 	}
 }
 
-std::vector<std::shared_ptr<Message>> * MessageQueue::PopAll()
+std::vector<QueuedMessage> * MessageQueue::PopAll()
 {
 	AUTO_LOCK(_lock);
 	assert(_state == kServiceState_WaitProcess);
@@ -28,6 +40,10 @@ std::vector<std::shared_ptr<Message>> * MessageQueue::PopAll()
 	_buf_write = _buf_read;
 	_buf_read = temp;
 	_state = kServiceState_Processing;
+	if (_depth_gauge)
+	{
+		_depth_gauge->depth.store(0, std::memory_order_relaxed);
+	}
 
 	return _buf_read;
 }
@@ -51,85 +67,160 @@ void MessageQueue::EndProcess()
 	}
 }
 
+bool MessageQueue::IsIdle() const
+{
+	AUTO_LOCK(_lock);
+	return _state == kServiceState_Idle;
+}
+
 // 处理
 void Service::Process()
 {
 	auto msgs = _msg_queue.PopAll();
 	assert(msgs && !msgs->empty());
 
-	for (auto & msg : *msgs)
-	{
-		MessageType msg_type = msg->GetType();
+	// 本批消息处理期间的临时分配使用本服务的内存区(未开启时为nullptr，使用堆)
+	ArenaScope arena_scope(_arena.get());
 
-		// 服务销毁后，只能接受服务消息
-		if (IsDestroyed())
+	// 统计每条消息的排队时间和处理时间(上一条的结束时间即为下一条的开始时间)
+	int64_t begin_time = 0;
+	for (auto & queued_msg : *msgs)
+	{
+		if (queued_msg.enqueue_time > 0)
 		{
-			if (msg_type != sframe::kMsgType_InsideServiceMessage &&
-				msg_type != sframe::kMsgType_NetServiceMessage)
+			if (begin_time == 0)
 			{
-				continue;
+				begin_time = TimeHelper::GetSteadyMicroseconds();
 			}
+
+			ProcessMsg(queued_msg.msg);
+
+			int64_t end_time = TimeHelper::GetSteadyMicroseconds();
+			ServiceStatsMgr::Instance().Record(_sid, ServiceStatsMgr::GetMsgKey(queued_msg.msg.get()), begin_time - queued_msg.enqueue_time, end_time - begin_time);
+			begin_time = end_time;
+		}
+		else
+		{
+			ProcessMsg(queued_msg.msg);
+			begin_time = 0;
 		}
+	}
 
-		switch (msg_type)
+	// 本批消息处理中可能注册了新的定时器
+	if (!IsDestroyed())
+	{
+		RefreshTimerDeadline();
+	}
+
+	if (_arena)
+	{
+		_arena->Reset();
+	}
+
+	_msg_queue.EndProcess();
+}
+
+// 处理一条消息
+void Service::ProcessMsg(const std::shared_ptr<Message> & msg)
+{
+	MessageType msg_type = msg->GetType();
+
+	// 服务销毁后，只能接受服务消息
+	if (IsDestroyed())
+	{
+		if (msg_type != sframe::kMsgType_InsideServiceMessage &&
+			msg_type != sframe::kMsgType_NetServiceMessage)
 		{
-			case sframe::kMsgType_CycleMessage:
-			{
-				auto cycle_msg = std::static_pointer_cast<CycleMessage>(msg);
-				_cur_time = TimeHelper::GetEpochMilliseconds();
-				this->OnCycleTimer();
-				cycle_msg->Unlock();
-			}
-			break;
-			
-			case sframe::kMsgType_InsideServiceMessage:
-			{
-				auto service_msg = std::static_pointer_cast<ServiceMessage>(msg);
-				assert(service_msg->dest_sid == GetServiceId());
-				_sender_sid = service_msg->src_sid;
-				_cur_session_key = service_msg->session_key;
-				DelegateInsideServiceMsg(service_msg);
-				_sender_sid = 0;
-				_cur_session_key = 0;
-			}
-			break;
+			return;
+		}
+	}
 
-			case sframe::kMsgType_NetServiceMessage:
-			{
-				auto net_service_msg = std::static_pointer_cast<NetServiceMessage>(msg);
-				assert(net_service_msg->dest_sid == GetServiceId());
-				_sender_sid = net_service_msg->src_sid;
-				_cur_session_key = net_service_msg->session_key;
-				DelegateNetServiceMsg(net_service_msg);
-				_sender_sid = 0;
-				_cur_session_key = 0;
-			}
-			break;
+	switch (msg_type)
+	{
+		case sframe::kMsgType_CycleMessage:
+		{
+			auto cycle_msg = std::static_pointer_cast<CycleMessage>(msg);
+			_cur_time = TimeHelper::GetEpochMilliseconds();
+			this->OnCycleTimer();
+			cycle_msg->Unlock();
+		}
+		break;
+		
+		case sframe::kMsgType_InsideServiceMessage:
+		{
+			auto service_msg = std::static_pointer_cast<ServiceMessage>(msg);
+			assert(service_msg->dest_sid == GetServiceId());
+			_sender_sid = service_msg->src_sid;
+			_cur_session_key = service_msg->session_key;
+			DelegateInsideServiceMsg(service_msg);
+			_sender_sid = 0;
+			_cur_session_key = 0;
+		}
+		break;
 
-			case sframe::kMsgType_ProxyServiceMessage:
-			{
-				auto proxy_service_msg = std::static_pointer_cast<ProxyServiceMessage>(msg);
-				OnProxyServiceMessage(proxy_service_msg);
-			}
-			break;
+		case sframe::kMsgType_NetServiceMessage:
+		{
+			auto net_service_msg = std::static_pointer_cast<NetServiceMessage>(msg);
+			assert(net_service_msg->dest_sid == GetServiceId());
+			_sender_sid = net_service_msg->src_sid;
+			_cur_session_key = net_service_msg->session_key;
+			_cur_net_msg_buffer = net_service_msg->data;
+			DelegateNetServiceMsg(net_service_msg);
+			_cur_net_msg_buffer.reset();
+			_sender_sid = 0;
+			_cur_session_key = 0;
+		}
+		break;
 
-			case sframe::kMsgType_DestroyServiceMessage:
-			{
-				this->OnDestroy();
-				_destroyed = true;
-			}
-			break;
+		case sframe::kMsgType_ProxyServiceMessage:
+		{
+			auto proxy_service_msg = std::static_pointer_cast<ProxyServiceMessage>(msg);
+			OnProxyServiceMessage(proxy_service_msg);
+		}
+		break;
 
-			case sframe::kMsgType_NewConnectionMessage:
+		case sframe::kMsgType_DestroyServiceMessage:
+		{
+			this->OnDestroy();
+			_destroyed = true;
+		}
+		break;
+
+		case sframe::kMsgType_NewConnectionMessage:
+		{
+			auto new_conn_msg = std::static_pointer_cast<NewConnectionMessage>(msg);
+			this->OnNewConnection(new_conn_msg->GetListenAddress(), new_conn_msg->GetSocket());
+		}
+		break;
+
+		case sframe::kMsgType_TimerMessage:
+		{
+			// 调度器发送定时器消息时已清除记录的下次执行时间
+			_reported_timer_deadline = 0;
+			if (_timer_mgr)
 			{
-				auto new_conn_msg = std::static_pointer_cast<NewConnectionMessage>(msg);
-				this->OnNewConnection(new_conn_msg->GetListenAddress(), new_conn_msg->GetSocket());
+				_cur_time = TimeHelper::GetEpochMilliseconds();
+				_timer_mgr->Execute();
 			}
-			break;
 		}
+		break;
 	}
+}
 
-	_msg_queue.EndProcess();
+// 将绑定的定时器管理器的下次执行时间通知调度器
+void Service::RefreshTimerDeadline()
+{
+	if (_timer_mgr == nullptr)
+	{
+		return;
+	}
+
+	int64_t deadline = _timer_mgr->GetNextExecuteTime();
+	if (deadline > 0 && (_reported_timer_deadline <= 0 || deadline < _reported_timer_deadline))
+	{
+		_reported_timer_deadline = deadline;
+		ServiceDispatcher::Instance().SetTimerDeadline(GetServiceId(), deadline);
+	}
 }
 
 // 等待销毁完毕
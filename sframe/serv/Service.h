@@ -9,7 +9,10 @@
 #include "MessageDecoder.h"
 #include "../util/Delegate.h"
 #include "../util/Singleton.h"
+#include "../util/Timer.h"
+#include "../util/Arena.h"
 #include "ServiceDispatcher.h"
+#include "ServiceStats.h"
 #include "../net/net.h"
 
 namespace sframe{
@@ -24,31 +27,48 @@ enum ServiceState : int32_t
 
 class Service;
 
+// 队列中的消息
+struct QueuedMessage
+{
+	std::shared_ptr<Message> msg;
+	int64_t enqueue_time;      // 入队时间(steady微秒)，未开启服务统计时为0
+};
+
 // 服务消息队列
 class MessageQueue : public noncopyable
 {
 public:
-	MessageQueue(Service * service) : _related_service(service), _state(kServiceState_Idle)
+	MessageQueue(Service * service) : _related_service(service), _state(kServiceState_Idle), _depth_gauge(nullptr)
 	{
 		assert(_related_service);
-		_buf_write = new std::vector<std::shared_ptr<Message>>();
-		_buf_read = new std::vector<std::shared_ptr<Message>>();
+		_buf_write = new std::vector<QueuedMessage>();
+		_buf_read = new std::vector<QueuedMessage>();
 		_buf_write->reserve(1024);
 		_buf_read->reserve(1024);
 	}
 
+	~MessageQueue()
+	{
+		delete _buf_write;
+		delete _buf_read;
+	}
+
 	void Push(const std::shared_ptr<Message> & msg);
 
-	std::vector<std::shared_ptr<Message>> * PopAll();
+	std::vector<QueuedMessage> * PopAll();
 
 	void EndProcess();
 
+	// 是否空闲（没有待处理的消息，也没有在处理中）
+	bool IsIdle() const;
+
 private:
 	Service * _related_service;
 	Lock _lock;
-	std::vector<std::shared_ptr<Message>> * _buf_write;
-	std::vector<std::shared_ptr<Message>> * _buf_read;
+	std::vector<QueuedMessage> * _buf_write;
+	std::vector<QueuedMessage> * _buf_read;
 	ServiceState _state;
+	MsgQueueDepthGauge * _depth_gauge;    // 开启服务统计后才获取
 };
 
 // 工作服务
@@ -83,7 +103,7 @@ public:
 	virtual int32_t GetCyclePeriod() const { return 0; }
 	
 public:
-    Service() : _sid(0), _cur_time(0), _msg_queue(this), _sender_sid(0), _cur_session_key(0), _destroyed(false) {}
+    Service() : _sid(0), _cur_time(0), _msg_queue(this), _sender_sid(0), _cur_session_key(0), _destroyed(false), _timer_mgr(nullptr), _reported_timer_deadline(0) {}
 
     virtual ~Service() {}
 
@@ -112,9 +132,39 @@ public:
     // 处理
     void Process();
 
+	// 消息队列是否空闲
+	bool IsMsgQueueIdle() const
+	{
+		return _msg_queue.IsIdle();
+	}
+
 	// 等待销毁完毕
 	void WaitDestroyComplete();
 
+	// 绑定定时器管理器，调度器会在其最近的定时器到期时驱动执行(精度不受周期定时器的周期限制)
+	// 需在Init中或者之前调用，定时器管理器只能在本服务中使用
+	void BindTimerManager(TimerManager * timer_mgr)
+	{
+		_timer_mgr = timer_mgr;
+	}
+
+	// 将绑定的定时器管理器的下次执行时间通知调度器(只在提前时通知)
+	void RefreshTimerDeadline();
+
+	// 开启消息处理内存区，需在Init中或者之前调用
+	// 开启后每批消息处理期间，默认构造的ArenaAllocator(ArenaVector、ArenaString等容器)从该内存区分配，本批处理完后整体回收
+	// 处理函数的参数可以直接声明为这些容器，解码时不再逐个向系统申请内存；它们不能在本批处理之后继续持有
+	void EnableArena(size_t block_size = MonotonicArena::kDefaultBlockSize)
+	{
+		_arena.reset(new MonotonicArena(block_size));
+	}
+
+	// 获取消息处理内存区(未开启时为nullptr)
+	MonotonicArena * GetArena() const
+	{
+		return _arena.get();
+	}
+
 	// 获取当前正在处理的服务消息的发送者的ServiceId
 	// 只有在服务消息处理函数中，调用此方法有效
 	int32_t GetSenderServiceId() const
@@ -129,6 +179,13 @@ public:
 		return _cur_session_key;
 	}
 
+	// 获取当前正在处理的网络服务消息的数据缓冲区
+	// 只有在网络服务消息处理函数中，调用此方法有效；持有它可以让StringView等解码视图在处理函数返回后继续有效
+	const std::shared_ptr<std::vector<char>> & GetCurNetMessageBuffer() const
+	{
+		return _cur_net_msg_buffer;
+	}
+
 	// 获取当前时间
 	int64_t GetTime() const
 	{
@@ -201,6 +258,9 @@ public:
 	}
 
 private:
+	// 处理一条消息
+	void ProcessMsg(const std::shared_ptr<Message> & msg);
+
 	// 内部消息委托调用
 	void DelegateInsideServiceMsg(const std::shared_ptr<sframe::ServiceMessage> & msg);
 
@@ -213,7 +273,11 @@ private:
 	MessageQueue _msg_queue;         // 消息队列
 	int32_t _sender_sid;             // 当前正在处理的服务消息的源服务ID
 	int64_t _cur_session_key;        // 当前正在处理的服务消息中的会话ID
+	std::shared_ptr<std::vector<char>> _cur_net_msg_buffer;   // 当前正在处理的网络服务消息的数据缓冲区
 	bool _destroyed;                 // 是否已被销毁
+	TimerManager * _timer_mgr;       // 绑定的定时器管理器
+	int64_t _reported_timer_deadline;   // 已通知调度器的定时器下次执行时间(0表示没有)
+	std::unique_ptr<MonotonicArena> _arena;   // 消息处理内存区(每批消息处理完后回收)
 	DelegateManager<InsideServiceMessageDecoder> _inside_delegate_mgr;
 	DelegateManager<NetServiceMessageDecoder> _net_delegate_mgr;
 };
@@ -17,45 +17,45 @@ void ServiceDispatcher::ExecIO(ServiceDispatcher * dispatcher)
 {
 	try
 	{
-		int64_t min_next_timer_time = 0;
-
 		while (dispatcher->_ioservice->IsOpen())
 		{
-			int64_t now = TimeHelper::GetSteadyMiliseconds();
+			dispatcher->_io_wakeup_time.store(0);
 
-			// 检测定时器
-			if (now >= min_next_timer_time && !dispatcher->_cycle_timers.empty())
+			// 处理运行时的服务变更
+			bool service_changing = false;
+			if (dispatcher->_service_changed.load())
 			{
-				min_next_timer_time = 0;
-				for (CycleTimer * cur : dispatcher->_cycle_timers)
-				{
-					if (now >= cur->next_time)
-					{
-						// 发送周期消息到目标服务
-						if (cur->msg->TryLock())
-						{
-							std::shared_ptr<Message> cycle_msg(cur->msg);
-							dispatcher->SendMsg(cur->sid, cycle_msg);
-							// 调整下一次执行时间
-							cur->next_time = now + cur->msg->GetPeriod();
-						}
-					}
-
-					// 刷新最小的下次执行时间
-					if (min_next_timer_time <= 0 || cur->next_time < min_next_timer_time)
-					{
-						min_next_timer_time = cur->next_time;
-					}
-				}
+				service_changing = dispatcher->ProcessServiceChanges();
 			}
 
+			// 处理服务定时器下次执行时间的变更
+			dispatcher->ProcessTimerDeadlineUpdates();
+
+			// 处理到期的定时器
+			int64_t now = TimeHelper::GetSteadyMiliseconds();
+			int64_t next_deadline = dispatcher->ProcessDeadlines(now);
+
 			int64_t wait_timeout_milisec = kMaxWaitMiliseconds;
-			if (min_next_timer_time > 0)
+			if (next_deadline > 0)
 			{
-				int64_t next_timer_after_millisec = min_next_timer_time > now ? min_next_timer_time - now : 0;
+				int64_t next_timer_after_millisec = next_deadline > now ? next_deadline - now : 0;
 				wait_timeout_milisec = wait_timeout_milisec > next_timer_after_millisec ? next_timer_after_millisec : wait_timeout_milisec;
 			}
-			
+			if (service_changing && wait_timeout_milisec > kServiceChangeCheckMilliseconds)
+			{
+				wait_timeout_milisec = kServiceChangeCheckMilliseconds;
+			}
+
+			// 先公布醒来时间再检查变更，之后设置的更早的到期时间会唤醒IO线程
+			dispatcher->_io_wakeup_time.store(now + wait_timeout_milisec);
+			{
+				AUTO_LOCK(dispatcher->_timer_deadline_lock);
+				if (!dispatcher->_timer_deadline_updates.empty())
+				{
+					wait_timeout_milisec = 0;
+				}
+			}
+
 			Error err = ErrorSuccess;
 			dispatcher->_ioservice->RunOnce((int32_t)wait_timeout_milisec, err);
 			if (err)
@@ -101,22 +101,41 @@ void ServiceDispatcher::ExecWorker(ServiceDispatcher * dispatcher)
 }
 
 
-ServiceDispatcher::ServiceDispatcher() : _running(false), _io_thread(nullptr), _dispach_service_queue(128, 16)
+ServiceDispatcher::ServiceDispatcher() : _all_service(new ServiceMap()), _stopping(false), _service_changed(false), _running(false), _io_thread(nullptr), _dispach_service_queue(4096, 128), _io_wakeup_time(0)
 {
-	memset(_services_arr, 0, sizeof(_services_arr));
+	_timer_msg = std::make_shared<TimerMessage>();
+	for (int32_t i = 0; i < kServiceArrLen; i++)
+	{
+		_services_arr[i].store(nullptr, std::memory_order_relaxed);
+	}
 	_ioservice = IoService::Create();
 	assert(_ioservice);
 }
 
 ServiceDispatcher::~ServiceDispatcher()
 {
-	for (auto & it : _all_service)
+	ServiceMap * all_service = _all_service.load();
+	for (auto & it : *all_service)
 	{
 		if (it.second)
 		{
 			delete it.second;
 		}
 	}
+	delete all_service;
+
+	for (RetiringService & retiring : _retiring_services)
+	{
+		delete retiring.service;
+	}
+
+	for (CycleTimerOp & op : _cycle_timer_ops)
+	{
+		if (op.add_timer)
+		{
+			delete op.add_timer;
+		}
+	}
 
     for (auto t : _logic_threads)
     {
@@ -128,9 +147,9 @@ ServiceDispatcher::~ServiceDispatcher()
 		delete _io_thread;
 	}
 
-	for (auto cycle_timer : _cycle_timers)
+	for (auto & pr : _cycle_timers)
 	{
-		delete cycle_timer;
+		delete pr.second;
 	}
 }
 
@@ -146,6 +165,7 @@ void ServiceDispatcher::SendMsg(Service * s, const std::shared_ptr<Message> & ms
 // 发消息
 void ServiceDispatcher::SendMsg(int32_t sid, const std::shared_ptr<Message> & msg)
 {
+	EpochGuard epoch_guard;
 	Service *s = GetService(sid);
 	SendMsg(s, msg);
 }
@@ -230,21 +250,27 @@ bool ServiceDispatcher::Start(int32_t thread_num)
 		return false;
 	}
 
-	_running = true;
+	ServiceMap init_services;
+	{
+		AUTO_LOCK(_services_lock);
+		_running = true;
+		init_services = *_all_service.load();
+	}
 
 	// 初始化所有服务，并设置循环周期
-	for (auto & pr_service : _all_service)
+	for (auto & pr_service : init_services)
 	{
 		Service * s = pr_service.second;
 		if (s != nullptr)
 		{
 			// 初始化
 			s->Init();
+			s->RefreshTimerDeadline();
 			// 设置周期
 			int32_t period = s->GetCyclePeriod();
 			if (period > 0)
 			{
-				_cycle_timers.push_back(new CycleTimer(s->GetServiceId(), period));
+				AddCycleTimer(new CycleTimer(s->GetServiceId(), period));
 			}
 		}
 		else
@@ -291,18 +317,30 @@ void ServiceDispatcher::Stop()
 
 	// 确定所有服务的销毁优先级批次
 	std::map<int32_t, std::vector<Service*>> destroy_priority_to_service;
-	for (auto & pr_service : _all_service)
+	std::vector<Service*> retiring_services;
 	{
-		Service * s = pr_service.second;
-		if (s != nullptr)
+		AUTO_LOCK(_services_lock);
+
+		// 此后IO线程不再释放正在退休的服务(由析构函数释放)，也不再接受新的退休
+		_stopping = true;
+
+		for (auto & pr_service : *_all_service.load())
 		{
-			int32_t priority = s->GetDestroyPriority();
-			priority = priority > 0 ? priority : 0;
-			destroy_priority_to_service[priority].push_back(s);
+			Service * s = pr_service.second;
+			if (s != nullptr)
+			{
+				int32_t priority = s->GetDestroyPriority();
+				priority = priority > 0 ? priority : 0;
+				destroy_priority_to_service[priority].push_back(s);
+			}
+			else
+			{
+				assert(false);
+			}
 		}
-		else
+		for (RetiringService & retiring : _retiring_services)
 		{
-			assert(false);
+			retiring_services.push_back(retiring.service);
 		}
 	}
 
@@ -330,6 +368,12 @@ void ServiceDispatcher::Stop()
 		}
 	}
 
+	// 等待正在退休的服务销毁完成（已经收到过销毁消息）
+	for (Service * s : retiring_services)
+	{
+		s->WaitDestroyComplete();
+	}
+
     _running = false;
 	_dispach_service_queue.Stop();
     for (std::thread * t : _logic_threads)
@@ -362,19 +406,93 @@ void ServiceDispatcher::Dispatch(Service * s)
 // 注册工作服务
 bool ServiceDispatcher::RegistService(int32_t sid, Service * service)
 {
-	if (_running || !service || sid == 0 || _all_service.find(sid) != _all_service.end())
+	AUTO_LOCK(_services_lock);
+
+	ServiceMap * all_service = _all_service.load();
+	if (_running || !service || sid == 0 || all_service->find(sid) != all_service->end())
+	{
+		return false;
+	}
+
+	service->SetServiceId(sid);
+	PublishService(sid, service);
+
+	return true;
+}
+
+// 运行时创建服务
+bool ServiceDispatcher::SpawnService(int32_t sid, Service * service)
+{
+	AUTO_LOCK(_services_lock);
+
+	ServiceMap * all_service = _all_service.load();
+	if (!service || sid == 0 || all_service->find(sid) != all_service->end())
 	{
 		return false;
 	}
 
 	service->SetServiceId(sid);
-	_all_service[sid] = service;
-	// 若ID在[1,kServiceArrLen)区间中，拷贝一份在_service_arr
-	if (sid > 0 && sid < kServiceArrLen)
+
+	// 还未开始运行，Start时统一初始化
+	if (!_running)
+	{
+		PublishService(sid, service);
+		return true;
+	}
+
+	// 先初始化再发布，保证其他线程能找到该服务时，消息处理函数已经注册完毕
+	service->Init();
+	PublishService(sid, service);
+	service->RefreshTimerDeadline();
+
+	int32_t period = service->GetCyclePeriod();
+	if (period > 0)
+	{
+		CycleTimerOp op;
+		op.sid = sid;
+		op.add_timer = new CycleTimer(sid, period);
+		_cycle_timer_ops.push_back(op);
+		_service_changed.store(true);
+		_ioservice->Wakeup();
+	}
+
+	return true;
+}
+
+// 运行时移除服务
+bool ServiceDispatcher::RetireService(int32_t sid)
+{
+	AUTO_LOCK(_services_lock);
+
+	if (!_running || _stopping || sid == 0)
+	{
+		return false;
+	}
+
+	Service * service = UnpublishService(sid);
+	if (!service)
 	{
-		_services_arr[sid] = service;
+		return false;
 	}
 
+	// 此时已经找不到该服务，之后只需等待已拿到该服务指针的线程离开临界区
+	RetiringService retiring;
+	retiring.service = service;
+	retiring.epoch = EpochManager::Instance().Advance();
+	_retiring_services.push_back(retiring);
+
+	CycleTimerOp op;
+	op.sid = sid;
+	op.add_timer = nullptr;
+	_cycle_timer_ops.push_back(op);
+
+	service->PushMsg(std::make_shared<DestroyServiceMessage>());
+
+	_service_changed.store(true);
+	_ioservice->Wakeup();
+
+	LOG_INFO << "retire service " << sid << std::endl;
+
 	return true;
 }
 
@@ -411,21 +529,25 @@ void ServiceDispatcher::RegistAdminCmd(const std::string & cmd, const AdminCmdHa
 // 指定服务ID是否是本地服务
 bool ServiceDispatcher::IsLocalService(int32_t sid) const
 {
+	EpochGuard epoch_guard;
 	return (sid != 0 && GetService(sid) != nullptr);
 }
 
 // 准备代理服务
 Service * ServiceDispatcher::RepareProxyServer()
 {
-	if (_services_arr[0] == nullptr)
+	AUTO_LOCK(_services_lock);
+
+	Service * proxy_service = _services_arr[0].load();
+	if (proxy_service == nullptr)
 	{
-		assert(_all_service.find(0) == _all_service.end());
-		_services_arr[0] = new ProxyService();
-		assert(_services_arr[0]);
-		_all_service[0] = _services_arr[0];
+		assert(_all_service.load()->find(0) == _all_service.load()->end());
+		proxy_service = new ProxyService();
+		assert(proxy_service);
+		PublishService(0, proxy_service);
 	}
 
-	return _services_arr[0];
+	return proxy_service;
 }
 
 // 获取服务
@@ -433,14 +555,276 @@ Service * ServiceDispatcher::GetService(int32_t sid) const
 {
 	if (sid >= 0 && sid < kServiceArrLen)
 	{
-		return _services_arr[sid];
+		return _services_arr[sid].load();
 	}
 
-	auto it = _all_service.find(sid);
-	if (it != _all_service.end())
+	const ServiceMap * all_service = _all_service.load();
+	auto it = all_service->find(sid);
+	if (it != all_service->end())
 	{
 		return it->second;
 	}
 
 	return nullptr;
 }
+
+// 添加服务到服务表（需持有_services_lock）
+void ServiceDispatcher::PublishService(int32_t sid, Service * service)
+{
+	ServiceMap * old_all_service = _all_service.load();
+	ServiceMap * new_all_service = new ServiceMap(*old_all_service);
+	(*new_all_service)[sid] = service;
+	_all_service.store(new_all_service);
+	// 若ID在[0,kServiceArrLen)区间中，拷贝一份在_service_arr
+	if (sid >= 0 && sid < kServiceArrLen)
+	{
+		_services_arr[sid].store(service);
+	}
+
+	if (_running)
+	{
+		EpochManager::Instance().Retire([old_all_service]() { delete old_all_service; });
+		_service_changed.store(true);
+	}
+	else
+	{
+		delete old_all_service;
+	}
+}
+
+// 从服务表中移除服务（需持有_services_lock）
+Service * ServiceDispatcher::UnpublishService(int32_t sid)
+{
+	ServiceMap * old_all_service = _all_service.load();
+	auto it = old_all_service->find(sid);
+	if (it == old_all_service->end())
+	{
+		return nullptr;
+	}
+
+	Service * service = it->second;
+	ServiceMap * new_all_service = new ServiceMap(*old_all_service);
+	new_all_service->erase(sid);
+	_all_service.store(new_all_service);
+	if (sid >= 0 && sid < kServiceArrLen)
+	{
+		_services_arr[sid].store(nullptr);
+	}
+
+	EpochManager::Instance().Retire([old_all_service]() { delete old_all_service; });
+	_service_changed.store(true);
+
+	return service;
+}
+
+// 处理运行时的服务变更（IO线程调用），返回是否还有未完成的变更
+bool ServiceDispatcher::ProcessServiceChanges()
+{
+	std::vector<CycleTimerOp> cycle_timer_ops;
+	std::vector<Service*> free_services;
+	bool changing = false;
+
+	{
+		AUTO_LOCK(_services_lock);
+		_service_changed.store(false);
+		cycle_timer_ops.swap(_cycle_timer_ops);
+
+		// 没有线程还持有该服务的指针、消息队列已处理完毕(销毁消息也已处理)并且销毁完成，才能释放服务
+		// 正在停止时Stop还在等待这些服务，不能释放
+		size_t keep = 0;
+		for (size_t i = 0; i < _retiring_services.size(); i++)
+		{
+			RetiringService & retiring = _retiring_services[i];
+			if (!_stopping && EpochManager::Instance().IsSafe(retiring.epoch) &&
+				retiring.service->IsMsgQueueIdle() &&
+				retiring.service->IsDestroyCompleted())
+			{
+				free_services.push_back(retiring.service);
+			}
+			else
+			{
+				_retiring_services[keep++] = retiring;
+			}
+		}
+		_retiring_services.resize(keep);
+		changing = !_retiring_services.empty();
+	}
+
+	// 周期定时器变更，按顺序执行
+	for (CycleTimerOp & op : cycle_timer_ops)
+	{
+		if (op.add_timer)
+		{
+			AddCycleTimer(op.add_timer);
+			continue;
+		}
+
+		auto it = _cycle_timers.find(op.sid);
+		if (it != _cycle_timers.end())
+		{
+			delete it->second;
+			_cycle_timers.erase(it);
+		}
+		_timer_deadlines.erase(op.sid);
+	}
+
+	for (Service * s : free_services)
+	{
+		LOG_INFO << "free retired service " << s->GetServiceId() << std::endl;
+		delete s;
+	}
+
+	// 回收旧的服务表
+	EpochManager::Instance().Reclaim();
+	changing = changing || EpochManager::Instance().HasRetired();
+
+	if (changing)
+	{
+		_service_changed.store(true);
+	}
+
+	return changing;
+}
+
+// 添加周期定时器
+void ServiceDispatcher::AddCycleTimer(CycleTimer * cycle_timer)
+{
+	CycleTimer *& cur = _cycle_timers[cycle_timer->sid];
+	if (cur)
+	{
+		delete cur;
+	}
+	cur = cycle_timer;
+	PushDeadline(cycle_timer->next_time, cycle_timer->sid, true);
+}
+
+// 设置服务定时器管理器的下次执行时间
+void ServiceDispatcher::SetTimerDeadline(int32_t sid, int64_t deadline)
+{
+	{
+		AUTO_LOCK(_timer_deadline_lock);
+		_timer_deadline_updates.push_back(std::make_pair(sid, deadline));
+	}
+
+	// IO线程正在等待，并且会晚于该时间醒来
+	int64_t wakeup_time = _io_wakeup_time.load();
+	if (deadline > 0 && wakeup_time > 0 && deadline < wakeup_time)
+	{
+		_ioservice->Wakeup();
+	}
+}
+
+// 处理服务定时器下次执行时间的变更
+void ServiceDispatcher::ProcessTimerDeadlineUpdates()
+{
+	std::vector<std::pair<int32_t, int64_t>> updates;
+	{
+		AUTO_LOCK(_timer_deadline_lock);
+		if (_timer_deadline_updates.empty())
+		{
+			return;
+		}
+		updates.swap(_timer_deadline_updates);
+	}
+
+	for (auto & pr : updates)
+	{
+		if (pr.second <= 0)
+		{
+			_timer_deadlines.erase(pr.first);
+			continue;
+		}
+
+		_timer_deadlines[pr.first] = pr.second;
+		PushDeadline(pr.second, pr.first, false);
+	}
+}
+
+// 处理到期的周期定时器和服务定时器
+int64_t ServiceDispatcher::ProcessDeadlines(int64_t now)
+{
+	std::greater<DeadlineItem> cmp;
+
+	while (!_deadline_heap.empty() && _deadline_heap.front().time <= now)
+	{
+		DeadlineItem item = _deadline_heap.front();
+		std::pop_heap(_deadline_heap.begin(), _deadline_heap.end(), cmp);
+		_deadline_heap.pop_back();
+
+		if (item.is_cycle)
+		{
+			auto it = _cycle_timers.find(item.sid);
+			if (it == _cycle_timers.end() || it->second->next_time != item.time)
+			{
+				continue;
+			}
+
+			// 发送周期消息到目标服务(上一个周期消息还未处理时，跳过本次)
+			CycleTimer * cur = it->second;
+			if (cur->msg->TryLock())
+			{
+				std::shared_ptr<Message> cycle_msg(cur->msg);
+				SendMsg(cur->sid, cycle_msg);
+			}
+			// 调整下一次执行时间
+			cur->next_time = now + cur->msg->GetPeriod();
+			PushDeadline(cur->next_time, cur->sid, true);
+		}
+		else
+		{
+			auto it = _timer_deadlines.find(item.sid);
+			if (it == _timer_deadlines.end() || it->second != item.time)
+			{
+				continue;
+			}
+
+			// 服务处理定时器消息后会重新设置下次执行时间
+			_timer_deadlines.erase(it);
+			SendMsg(item.sid, _timer_msg);
+		}
+	}
+
+	return _deadline_heap.empty() ? 0 : _deadline_heap.front().time;
+}
+
+// 添加到期项到最小堆
+void ServiceDispatcher::PushDeadline(int64_t time, int32_t sid, bool is_cycle)
+{
+	DeadlineItem item;
+	item.time = time;
+	item.sid = sid;
+	item.is_cycle = is_cycle;
+	_deadline_heap.push_back(item);
+	std::push_heap(_deadline_heap.begin(), _deadline_heap.end(), std::greater<DeadlineItem>());
+
+	// 失效项过多时重建
+	if (_deadline_heap.size() > (_cycle_timers.size() + _timer_deadlines.size()) * 2 + 1024)
+	{
+		RebuildDeadlineHeap();
+	}
+}
+
+// 重建到期项最小堆
+void ServiceDispatcher::RebuildDeadlineHeap()
+{
+	_deadline_heap.clear();
+
+	DeadlineItem item;
+	for (auto & pr : _cycle_timers)
+	{
+		item.time = pr.second->next_time;
+		item.sid = pr.first;
+		item.is_cycle = true;
+		_deadline_heap.push_back(item);
+	}
+
+	for (auto & pr : _timer_deadlines)
+	{
+		item.time = pr.second;
+		item.sid = pr.first;
+		item.is_cycle = false;
+		_deadline_heap.push_back(item);
+	}
+
+	std::make_heap(_deadline_heap.begin(), _deadline_heap.end(), std::greater<DeadlineItem>());
+}
@@ -9,9 +9,12 @@
 #include <set>
 #include <unordered_map>
 #include <thread>
+#include <atomic>
 #include <algorithm>
+#include <functional>
 #include "../util/BlockingQueue.h"
 #include "../util/Singleton.h"
+#include "../util/Epoch.h"
 #include "../util/Serialization.h"
 #include "Message.h"
 #include "ProxyServiceMsg.h"
@@ -93,6 +96,12 @@ public:
     // 注册工作服务
 	bool RegistService(int32_t sid, Service * service);
 
+	// 运行时创建服务（线程安全，Start之前调用等同于RegistService），成功后service由调度器接管
+	bool SpawnService(int32_t sid, Service * service);
+
+	// 运行时移除服务（线程安全），服务收到销毁消息，处理完剩余消息并且销毁完成后被释放
+	bool RetireService(int32_t sid);
+
 	// 注册远程服务
 	bool RegistRemoteService(int32_t sid, const std::string & remote_ip, uint16_t remote_port);
 
@@ -102,6 +111,9 @@ public:
 	// 指定服务ID是否是本地服务
 	bool IsLocalService(int32_t sid) const;
 
+	// 设置服务定时器管理器的下次执行时间(线程安全，steady毫秒，小于等于0表示没有)，到期时向服务发送定时器消息
+	void SetTimerDeadline(int32_t sid, int64_t deadline);
+
 	// 获取IO服务
 	const std::shared_ptr<IoService> & GetIoService() const
 	{
@@ -120,22 +132,87 @@ private:
 	// 准备代理服务
 	Service * RepareProxyServer();
 
-	// 获取服务
+	// 获取服务（调用者需处于EpochGuard临界区中，保证返回的服务在离开临界区前不被释放）
 	Service * GetService(int32_t sid) const;
 
+	// 添加服务到服务表（需持有_services_lock）
+	void PublishService(int32_t sid, Service * service);
+
+	// 从服务表中移除服务（需持有_services_lock）
+	Service * UnpublishService(int32_t sid);
+
+	// 处理运行时的服务变更（IO线程调用），返回是否还有未完成的变更
+	bool ProcessServiceChanges();
+
+	// 添加周期定时器（IO线程调用，或者Start中IO线程开启之前调用）
+	void AddCycleTimer(CycleTimer * cycle_timer);
+
+	// 处理服务定时器下次执行时间的变更（IO线程调用）
+	void ProcessTimerDeadlineUpdates();
+
+	// 处理到期的周期定时器和服务定时器（IO线程调用），返回最近的下次到期时间，没有返回0
+	int64_t ProcessDeadlines(int64_t now);
+
+	// 添加到期项到最小堆
+	void PushDeadline(int64_t time, int32_t sid, bool is_cycle);
+
+	// 重建到期项最小堆（清除失效的项）
+	void RebuildDeadlineHeap();
+
 private:
 
-	static const int32_t kServiceArrLen = 10000;                  // 服务数组长度
+	typedef std::unordered_map<int32_t, Service*> ServiceMap;
+
+	// 正在退休的服务
+	struct RetiringService
+	{
+		Service * service;
+		uint64_t epoch;      // 从服务表移除时的纪元
+	};
+
+	// 周期定时器变更
+	struct CycleTimerOp
+	{
+		int32_t sid;
+		CycleTimer * add_timer;   // 为空表示删除该服务的周期定时器
+	};
+
+	// 到期项（周期定时器或者服务定时器管理器的下次执行时间），时间与记录的不一致时为失效项
+	struct DeadlineItem
+	{
+		int64_t time;
+		int32_t sid;
+		bool is_cycle;
 
-	std::unordered_map<int32_t, Service*> _all_service;           // 所有的本地服务
-    Service * _services_arr[kServiceArrLen];                      // 服务数组，将sid小于kServiceArrLen的服务，拷贝一份在数组中，便于快速查找
+		bool operator>(const DeadlineItem & other) const
+		{
+			return time > other.time;
+		}
+	};
+
+	static const int32_t kServiceArrLen = 10000;                  // 服务数组长度
+	static const int32_t kServiceChangeCheckMilliseconds = 20;    // 有未完成的服务变更时，IO线程的检测间隔
+
+	std::atomic<ServiceMap*> _all_service;                        // 所有的本地服务（写时复制，旧表延迟回收）
+	std::atomic<Service*> _services_arr[kServiceArrLen];          // 服务数组，将sid小于kServiceArrLen的服务，拷贝一份在数组中，便于快速查找
+	Lock _services_lock;                                          // 服务表写锁
+	std::vector<RetiringService> _retiring_services;              // 正在退休的服务
+	bool _stopping;                                               // 是否正在停止(受_services_lock保护，停止后不再退休和释放服务)
+	std::vector<CycleTimerOp> _cycle_timer_ops;                   // 待IO线程处理的周期定时器变更
+	std::atomic_bool _service_changed;                            // 是否有待IO线程处理的服务变更
     bool _running;                                                // 是否正在运行
     std::vector<std::thread*> _logic_threads;                     // 所有逻辑线程
 	std::thread * _io_thread;                                     // IO线程（IO操作，已经周期定时检测）
 	std::shared_ptr<IoService> _ioservice;                        // IO服务指针
 	std::vector<Listener*> _listeners;                            // 监听器
 	BlockingQueue<Service*> _dispach_service_queue;               // 服务调度队列
-	std::vector<CycleTimer*> _cycle_timers;                       // 周期定时器列表
+	std::unordered_map<int32_t, CycleTimer*> _cycle_timers;       // 周期定时器（IO线程访问）
+	std::unordered_map<int32_t, int64_t> _timer_deadlines;        // 各服务定时器管理器的下次执行时间（IO线程访问）
+	std::vector<DeadlineItem> _deadline_heap;                     // 到期项最小堆（IO线程访问）
+	std::vector<std::pair<int32_t, int64_t>> _timer_deadline_updates;   // 待IO线程处理的服务定时器下次执行时间变更
+	Lock _timer_deadline_lock;
+	std::atomic<int64_t> _io_wakeup_time;                         // IO线程计划醒来的时间（0表示未在等待）
+	std::shared_ptr<Message> _timer_msg;                          // 定时器到期消息（无状态，所有服务共用）
 };
 
 // 发送消息
@@ -176,6 +253,7 @@ void ServiceDispatcher::SendNetServiceMsg(int32_t src_sid, int32_t dest_sid, int
 template<typename... T_Args>
 void ServiceDispatcher::SendServiceMsg(int32_t src_sid, int32_t dest_sid, int64_t session_key, uint16_t msg_id, T_Args&... args)
 {
+	EpochGuard epoch_guard;
 	Service * s = GetService(dest_sid);
 	if (s)
 	{
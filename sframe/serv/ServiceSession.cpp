@@ -403,16 +403,24 @@ int32_t AdminSession::OnReceived(char * data, int32_t len)
 	int32_t session_id = GetSessionId();
 
 	std::string err_msg;
-	size_t readed = _http_decoder.Decode(data, len, err_msg);
-	if (!err_msg.empty())
-	{
-		LOG_ERROR << "AdminSession(" << session_id << ") decode http request error|" << err_msg << std::endl;
-		// 关闭连接
-		return -1;
-	}
+	size_t readed = 0;
 
-	if (_http_decoder.IsDecodeCompleted())
+	// 一次可能收到多个请求(管线化)
+	while (readed < (size_t)len)
 	{
+		readed += _http_decoder.Decode(data + readed, len - readed, err_msg);
+		if (!err_msg.empty())
+		{
+			LOG_ERROR << "AdminSession(" << session_id << ") decode http request error|" << err_msg << std::endl;
+			// 关闭连接
+			return -1;
+		}
+
+		if (!_http_decoder.IsDecodeCompleted())
+		{
+			break;
+		}
+
 		std::shared_ptr<sframe::HttpRequest> http_req = _http_decoder.GetResult();
 		_http_decoder.Reset();
 		assert(http_req);
@@ -0,0 +1,168 @@
+
+#include "ServiceStats.h"
+
+using namespace sframe;
+
+std::atomic<bool> ServiceStatsMgr::s_enabled(false);
+
+uint32_t ServiceStatsMgr::GetMsgKey(const Message * msg)
+{
+	MessageType msg_type = msg->GetType();
+	if (msg_type == kMsgType_InsideServiceMessage || msg_type == kMsgType_NetServiceMessage)
+	{
+		return static_cast<const ServiceMessage *>(msg)->msg_id;
+	}
+
+	return kOtherMsgKeyBegin + (uint32_t)msg_type;
+}
+
+std::string ServiceStatsMgr::GetMsgKeyText(uint32_t msg_key)
+{
+	if (msg_key < kOtherMsgKeyBegin)
+	{
+		return std::to_string(msg_key);
+	}
+
+	switch ((MessageType)(msg_key - kOtherMsgKeyBegin))
+	{
+	case kMsgType_CycleMessage: return "cycle";
+	case kMsgType_DestroyServiceMessage: return "destroy";
+	case kMsgType_NewConnectionMessage: return "new_connection";
+	case kMsgType_ProxyServiceMessage: return "proxy";
+	case kMsgType_TimerMessage: return "timer";
+	default: return "type_" + std::to_string(msg_key - kOtherMsgKeyBegin);
+	}
+}
+
+void ServiceStatsMgr::Record(int32_t sid, uint32_t msg_key, int64_t queue_time, int64_t handle_time)
+{
+	ThreadStatsTable & table = GetThreadStatsTable();
+	uint64_t key = MakeStatsKey(sid, msg_key);
+
+	// 只有本线程会插入，查找不需要加锁
+	auto it = table.stats.find(key);
+	if (it == table.stats.end())
+	{
+		AUTO_LOCK(table.lock);
+		it = table.stats.insert(std::make_pair(key, std::unique_ptr<LatencyStats>(new LatencyStats()))).first;
+	}
+
+	LatencyStats & stats = *it->second;
+	stats.queue_time.Record(queue_time > 0 ? (uint64_t)queue_time : 0);
+	stats.handle_time.Record(handle_time > 0 ? (uint64_t)handle_time : 0);
+}
+
+MsgQueueDepthGauge * ServiceStatsMgr::GetMsgQueueDepthGauge(int32_t sid)
+{
+	AUTO_LOCK(_lock);
+
+	std::unique_ptr<MsgQueueDepthGauge> & gauge = _depth_gauges[sid];
+	if (!gauge)
+	{
+		gauge.reset(new MsgQueueDepthGauge());
+	}
+
+	return gauge.get();
+}
+
+std::vector<ServiceStatsMgr::MsgStats> ServiceStatsMgr::GetMsgStats()
+{
+	std::unordered_map<uint64_t, MsgStats> merged;
+	MergeMsgStats(merged);
+
+	std::vector<MsgStats> result;
+	result.reserve(merged.size());
+
+	AUTO_LOCK(_lock);
+
+	for (auto & pr : merged)
+	{
+		auto it = _base_stats.find(pr.first);
+		if (it != _base_stats.end())
+		{
+			pr.second.queue_time.Subtract(it->second.queue_time);
+			pr.second.handle_time.Subtract(it->second.handle_time);
+		}
+
+		if (pr.second.handle_time.GetCount() > 0)
+		{
+			result.push_back(std::move(pr.second));
+		}
+	}
+
+	return result;
+}
+
+std::vector<ServiceStatsMgr::MsgQueueDepth> ServiceStatsMgr::GetMsgQueueDepths()
+{
+	std::vector<MsgQueueDepth> result;
+
+	AUTO_LOCK(_lock);
+
+	result.reserve(_depth_gauges.size());
+	for (auto & pr : _depth_gauges)
+	{
+		result.push_back(MsgQueueDepth{ pr.first, pr.second->depth.load(std::memory_order_relaxed), pr.second->peak_depth.load(std::memory_order_relaxed) });
+	}
+
+	return result;
+}
+
+void ServiceStatsMgr::Reset()
+{
+	std::unordered_map<uint64_t, MsgStats> merged;
+	MergeMsgStats(merged);
+
+	AUTO_LOCK(_lock);
+
+	_base_stats.swap(merged);
+	for (auto & pr : _depth_gauges)
+	{
+		pr.second->peak_depth.store(pr.second->depth.load(std::memory_order_relaxed), std::memory_order_relaxed);
+	}
+}
+
+ServiceStatsMgr::ThreadStatsTable & ServiceStatsMgr::GetThreadStatsTable()
+{
+	static thread_local ThreadStatsTable * table = nullptr;
+	if (!table)
+	{
+		// 线程退出后统计表保留，数据仍计入合并结果
+		table = new ThreadStatsTable();
+		AUTO_LOCK(_lock);
+		_thread_tables.push_back(std::unique_ptr<ThreadStatsTable>(table));
+	}
+
+	return *table;
+}
+
+void ServiceStatsMgr::MergeMsgStats(std::unordered_map<uint64_t, MsgStats> & merged)
+{
+	std::vector<ThreadStatsTable *> tables;
+	{
+		AUTO_LOCK(_lock);
+		for (auto & table : _thread_tables)
+		{
+			tables.push_back(table.get());
+		}
+	}
+
+	for (ThreadStatsTable * table : tables)
+	{
+		AUTO_LOCK(table->lock);
+		for (auto & pr : table->stats)
+		{
+			auto it = merged.find(pr.first);
+			if (it == merged.end())
+			{
+				MsgStats msg_stats;
+				msg_stats.sid = (int32_t)(uint32_t)(pr.first >> 32);
+				msg_stats.msg_key = (uint32_t)pr.first;
+				it = merged.insert(std::make_pair(pr.first, std::move(msg_stats))).first;
+			}
+
+			pr.second->queue_time.MergeTo(it->second.queue_time);
+			pr.second->handle_time.MergeTo(it->second.handle_time);
+		}
+	}
+}
@@ -0,0 +1,128 @@
+
+#ifndef SFRAME_SERVICE_STATS_H
+#define SFRAME_SERVICE_STATS_H
+
+#include <inttypes.h>
+#include <string>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <unordered_map>
+#include "../util/Lock.h"
+#include "../util/Singleton.h"
+#include "../util/Histogram.h"
+#include "Message.h"
+
+namespace sframe {
+
+// 服务消息队列深度
+struct MsgQueueDepthGauge
+{
+	MsgQueueDepthGauge() : depth(0), peak_depth(0) {}
+
+	// 压入消息后更新(持有消息队列的锁时调用)
+	void Update(int32_t cur_depth)
+	{
+		depth.store(cur_depth, std::memory_order_relaxed);
+		if (cur_depth > peak_depth.load(std::memory_order_relaxed))
+		{
+			peak_depth.store(cur_depth, std::memory_order_relaxed);
+		}
+	}
+
+	std::atomic<int32_t> depth;         // 等待处理的消息数
+	std::atomic<int32_t> peak_depth;    // 等待处理的消息数的峰值
+};
+
+// 服务消息处理统计(排队时间、处理时间的直方图，按服务和消息分别统计，单位微秒)
+// 各工作线程记录到自己的统计表，不加锁，读取时合并
+class ServiceStatsMgr : public singleton<ServiceStatsMgr>, public noncopyable
+{
+public:
+	// 统计项的消息键：服务消息为消息号，其他消息为kOtherMsgKeyBegin + 消息类型
+	static const uint32_t kOtherMsgKeyBegin = 0x10000;
+
+	// 一个服务的一种消息的统计
+	struct MsgStats
+	{
+		int32_t sid;
+		uint32_t msg_key;
+		HistogramData queue_time;      // 排队时间
+		HistogramData handle_time;     // 处理时间
+	};
+
+	struct MsgQueueDepth
+	{
+		int32_t sid;
+		int32_t depth;
+		int32_t peak_depth;
+	};
+
+	// 开启或关闭统计
+	static void SetEnabled(bool enabled)
+	{
+		s_enabled.store(enabled, std::memory_order_relaxed);
+	}
+
+	static bool IsEnabled()
+	{
+		return s_enabled.load(std::memory_order_relaxed);
+	}
+
+	static uint32_t GetMsgKey(const Message * msg);
+
+	// 消息键的文本(服务消息为消息号，其他消息为类型名)
+	static std::string GetMsgKeyText(uint32_t msg_key);
+
+	// 记录一条消息(处理服务的工作线程调用)
+	void Record(int32_t sid, uint32_t msg_key, int64_t queue_time, int64_t handle_time);
+
+	// 获取服务消息队列的深度计量(不会释放)
+	MsgQueueDepthGauge * GetMsgQueueDepthGauge(int32_t sid);
+
+	// 获取所有消息的统计(从上次Reset开始)
+	std::vector<MsgStats> GetMsgStats();
+
+	// 获取所有服务的消息队列深度
+	std::vector<MsgQueueDepth> GetMsgQueueDepths();
+
+	// 重新开始统计(直方图从现在开始计算，队列深度峰值从当前深度开始)
+	void Reset();
+
+private:
+
+	struct LatencyStats
+	{
+		LatencyHistogram queue_time;
+		LatencyHistogram handle_time;
+	};
+
+	// 工作线程的统计表(只有所属线程插入和记录；插入和其他线程的读取需要加锁)
+	struct ThreadStatsTable
+	{
+		Lock lock;
+		std::unordered_map<uint64_t, std::unique_ptr<LatencyStats>> stats;
+	};
+
+	static uint64_t MakeStatsKey(int32_t sid, uint32_t msg_key)
+	{
+		return ((uint64_t)(uint32_t)sid << 32) | msg_key;
+	}
+
+	ThreadStatsTable & GetThreadStatsTable();
+
+	// 合并所有线程的统计
+	void MergeMsgStats(std::unordered_map<uint64_t, MsgStats> & merged);
+
+	static std::atomic<bool> s_enabled;
+
+private:
+	Lock _lock;
+	std::vector<std::unique_ptr<ThreadStatsTable>> _thread_tables;
+	std::unordered_map<int32_t, std::unique_ptr<MsgQueueDepthGauge>> _depth_gauges;
+	std::unordered_map<uint64_t, MsgStats> _base_stats;     // Reset时的统计，读取时减去
+};
+
+}
+
+#endif
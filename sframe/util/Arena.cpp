@@ -0,0 +1,115 @@
+
+#include <stdlib.h>
+#include "Arena.h"
+
+using namespace sframe;
+
+MonotonicArena::MonotonicArena(size_t block_size)
+	: _block_size(block_size > kBlockHeaderSize * 2 ? block_size : kBlockHeaderSize * 2), _blocks(nullptr),
+	_cur(nullptr), _end(nullptr), _allocated_bytes(0), _peak_allocated_bytes(0)
+{
+	_next_block_size = _block_size;
+}
+
+MonotonicArena::~MonotonicArena()
+{
+	FreeBlocks(_blocks);
+}
+
+void MonotonicArena::Reset()
+{
+	if (_allocated_bytes > _peak_allocated_bytes)
+	{
+		_peak_allocated_bytes = _allocated_bytes;
+	}
+	_allocated_bytes = 0;
+
+	if (!_blocks)
+	{
+		return;
+	}
+
+	// 本批用了多个块，换成一个足够大的块，下一批不用再逐个申请
+	if (_blocks->next)
+	{
+		size_t total_size = 0;
+		for (Block * block = _blocks; block; block = block->next)
+		{
+			total_size += block->size;
+		}
+
+		FreeBlocks(_blocks);
+		_blocks = nullptr;
+
+		while (_block_size < total_size && _block_size < kMaxRetainedBlockSize)
+		{
+			_block_size *= 2;
+		}
+
+		_blocks = NewBlock(_block_size);
+	}
+
+	_cur = GetBlockData(_blocks);
+	_end = (char *)_blocks + _blocks->size;
+	_next_block_size = _block_size;
+}
+
+void * MonotonicArena::AllocateSlow(size_t size, size_t align)
+{
+	size_t need_size = kBlockHeaderSize + size + align;
+
+	// 大块单独申请，放在当前块后面，当前块还可以继续使用
+	if (_blocks && need_size > _next_block_size / 4)
+	{
+		Block * block = NewBlock(need_size);
+		block->next = _blocks->next;
+		_blocks->next = block;
+
+		uintptr_t p = ((uintptr_t)GetBlockData(block) + align - 1) & ~(uintptr_t)(align - 1);
+		_allocated_bytes += size;
+		return (void *)p;
+	}
+
+	size_t block_size = _next_block_size;
+	while (block_size < need_size)
+	{
+		block_size *= 2;
+	}
+
+	Block * block = NewBlock(block_size);
+	block->next = _blocks;
+	_blocks = block;
+	_cur = GetBlockData(block);
+	_end = (char *)block + block->size;
+
+	// 第一个块之后的新块逐次翻倍
+	if (block->next && _next_block_size < kMaxRetainedBlockSize)
+	{
+		_next_block_size *= 2;
+	}
+
+	return Allocate(size, align);
+}
+
+MonotonicArena::Block * MonotonicArena::NewBlock(size_t size)
+{
+	Block * block = (Block *)malloc(size);
+	if (!block)
+	{
+		throw std::bad_alloc();
+	}
+
+	block->next = nullptr;
+	block->size = size;
+	return block;
+}
+
+void MonotonicArena::FreeBlocks(Block * block)
+{
+	while (block)
+	{
+		Block * next = block->next;
+		free(block);
+		block = next;
+	}
+}
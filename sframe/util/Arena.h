@@ -0,0 +1,245 @@
+
+#ifndef SFRAME_ARENA_H
+#define SFRAME_ARENA_H
+
+#include <inttypes.h>
+#include <assert.h>
+#include <cstddef>
+#include <new>
+#include <utility>
+#include <string>
+#include <vector>
+#include <list>
+#include <map>
+#include <set>
+#include <unordered_map>
+#include <unordered_set>
+#include <functional>
+#include "Singleton.h"
+
+namespace sframe {
+
+/*
+	单调内存区：只分配不单独释放，Reset时整体回收
+	适合一批消息处理期间的临时分配(解码出的容器、处理函数中的临时对象)，不是线程安全的
+*/
+class MonotonicArena : public noncopyable
+{
+public:
+	static const size_t kDefaultBlockSize = 64 * 1024;
+
+	static const size_t kMaxRetainedBlockSize = 4 * 1024 * 1024;
+
+	explicit MonotonicArena(size_t block_size = kDefaultBlockSize);
+
+	~MonotonicArena();
+
+	// 分配内存(align为2的幂)
+	void * Allocate(size_t size, size_t align = alignof(std::max_align_t))
+	{
+		assert(align > 0 && (align & (align - 1)) == 0);
+		uintptr_t p = ((uintptr_t)_cur + align - 1) & ~(uintptr_t)(align - 1);
+		if (_cur && p + size <= (uintptr_t)_end)
+		{
+			_cur = (char *)(p + size);
+			_allocated_bytes += size;
+			return (void *)p;
+		}
+
+		return AllocateSlow(size, align);
+	}
+
+	// 回收所有分配，保留一个内存块(本批用了多个块时，保留块扩大到本批的用量，最大kMaxRetainedBlockSize)
+	void Reset();
+
+	// 从上次Reset到现在分配的字节数
+	size_t GetAllocatedBytes() const
+	{
+		return _allocated_bytes;
+	}
+
+	// 单批分配字节数的峰值
+	size_t GetPeakAllocatedBytes() const
+	{
+		return _peak_allocated_bytes > _allocated_bytes ? _peak_allocated_bytes : _allocated_bytes;
+	}
+
+	// 当前线程正在使用的内存区(ArenaAllocator默认从它分配，为nullptr时使用堆)
+	static MonotonicArena * GetCurrent()
+	{
+		return GetCurrentRef();
+	}
+
+private:
+	friend class ArenaScope;
+
+	struct Block
+	{
+		Block * next;
+		size_t size;
+	};
+
+	static MonotonicArena * & GetCurrentRef()
+	{
+		static thread_local MonotonicArena * current = nullptr;
+		return current;
+	}
+
+	void * AllocateSlow(size_t size, size_t align);
+
+	Block * NewBlock(size_t size);
+
+	void FreeBlocks(Block * block);
+
+	// 块中数据的起始地址
+	static char * GetBlockData(Block * block)
+	{
+		return (char *)block + kBlockHeaderSize;
+	}
+
+	static const size_t kBlockHeaderSize = (sizeof(Block) + alignof(std::max_align_t) - 1) & ~(alignof(std::max_align_t) - 1);
+
+private:
+	size_t _block_size;              // Reset后保留的内存块大小
+	size_t _next_block_size;         // 下一个新块的大小(逐次翻倍)
+	Block * _blocks;                 // 所有内存块，头部为当前块
+	char * _cur;                     // 当前块未分配部分
+	char * _end;
+	size_t _allocated_bytes;
+	size_t _peak_allocated_bytes;
+};
+
+// 在作用域内把当前线程的内存区设置为arena(可以为nullptr)，离开作用域时恢复
+class ArenaScope : public noncopyable
+{
+public:
+	explicit ArenaScope(MonotonicArena * arena) : _prev(MonotonicArena::GetCurrentRef())
+	{
+		MonotonicArena::GetCurrentRef() = arena;
+	}
+
+	~ArenaScope()
+	{
+		MonotonicArena::GetCurrentRef() = _prev;
+	}
+
+private:
+	MonotonicArena * _prev;
+};
+
+/*
+	从MonotonicArena分配的STL分配器(类似std::pmr::polymorphic_allocator)
+	默认构造时使用当前线程的内存区(MonotonicArena::GetCurrent())，没有时使用堆
+	释放为空操作，内存在内存区Reset时统一回收，所以容器不能比内存区的本批处理活得更久
+	拷贝构造的容器改用堆内存(可以安全地保存或发送给其他服务)，移动构造的容器沿用原来的内存区
+*/
+template<typename T>
+class ArenaAllocator
+{
+public:
+	typedef T value_type;
+	typedef T * pointer;
+	typedef const T * const_pointer;
+	typedef T & reference;
+	typedef const T & const_reference;
+	typedef size_t size_type;
+	typedef ptrdiff_t difference_type;
+
+	template<typename U>
+	struct rebind
+	{
+		typedef ArenaAllocator<U> other;
+	};
+
+	ArenaAllocator() : _arena(MonotonicArena::GetCurrent()) {}
+
+	explicit ArenaAllocator(MonotonicArena * arena) : _arena(arena) {}
+
+	template<typename U>
+	ArenaAllocator(const ArenaAllocator<U> & other) : _arena(other.GetArena()) {}
+
+	T * allocate(size_t n)
+	{
+		if (_arena)
+		{
+			return static_cast<T *>(_arena->Allocate(n * sizeof(T), alignof(T)));
+		}
+
+		return static_cast<T *>(::operator new(n * sizeof(T)));
+	}
+
+	void deallocate(T * p, size_t)
+	{
+		if (!_arena)
+		{
+			::operator delete(p);
+		}
+	}
+
+	template<typename U, typename... T_Args>
+	void construct(U * p, T_Args&&... args)
+	{
+		::new((void *)p) U(std::forward<T_Args>(args)...);
+	}
+
+	template<typename U>
+	void destroy(U * p)
+	{
+		p->~U();
+	}
+
+	size_t max_size() const
+	{
+		return (size_t)-1 / sizeof(T);
+	}
+
+	ArenaAllocator select_on_container_copy_construction() const
+	{
+		return ArenaAllocator(nullptr);
+	}
+
+	MonotonicArena * GetArena() const
+	{
+		return _arena;
+	}
+
+private:
+	MonotonicArena * _arena;
+};
+
+template<typename T, typename U>
+inline bool operator==(const ArenaAllocator<T> & a, const ArenaAllocator<U> & b)
+{
+	return a.GetArena() == b.GetArena();
+}
+
+template<typename T, typename U>
+inline bool operator!=(const ArenaAllocator<T> & a, const ArenaAllocator<U> & b)
+{
+	return a.GetArena() != b.GetArena();
+}
+
+// 使用内存区的容器(可以直接作为消息处理函数的参数解码)
+typedef std::basic_string<char, std::char_traits<char>, ArenaAllocator<char>> ArenaString;
+
+template<typename T>
+using ArenaVector = std::vector<T, ArenaAllocator<T>>;
+
+template<typename T>
+using ArenaList = std::list<T, ArenaAllocator<T>>;
+
+template<typename T>
+using ArenaSet = std::set<T, std::less<T>, ArenaAllocator<T>>;
+
+template<typename T_Key, typename T_Val>
+using ArenaMap = std::map<T_Key, T_Val, std::less<T_Key>, ArenaAllocator<std::pair<const T_Key, T_Val>>>;
+
+template<typename T>
+using ArenaUnorderedSet = std::unordered_set<T, std::hash<T>, std::equal_to<T>, ArenaAllocator<T>>;
+
+template<typename T_Key, typename T_Val>
+using ArenaUnorderedMap = std::unordered_map<T_Key, T_Val, std::hash<T_Key>, std::equal_to<T_Key>, ArenaAllocator<std::pair<const T_Key, T_Val>>>;
+
+}
+
+#endif
@@ -0,0 +1,440 @@
+
+#include <stdio.h>
+#include <algorithm>
+#include "BinaryLog.h"
+
+using namespace sframe;
+
+// 格式ID：格式内容的FNV-1a哈希
+static uint32_t HashBinaryLogFormat(const std::string & fmt, const std::string & arg_types, const std::string & file, int32_t line)
+{
+	uint32_t h = 2166136261u;
+	auto hash = [&h](const char * p, size_t len) {
+		for (size_t i = 0; i < len; i++)
+		{
+			h ^= (uint8_t)p[i];
+			h *= 16777619u;
+		}
+	};
+
+	hash(fmt.c_str(), fmt.length() + 1);
+	hash(arg_types.c_str(), arg_types.length() + 1);
+	hash(file.c_str(), file.length() + 1);
+	hash((const char *)&line, sizeof(line));
+
+	return h;
+}
+
+uint32_t BinaryLogFormatMgr::Regist(const char * fmt, const char * arg_types, const char * file, int32_t line)
+{
+	BinaryLogFormatInfo info;
+	info.fmt = fmt ? fmt : "";
+	info.arg_types = arg_types ? arg_types : "";
+	info.file = FileHelper::GetFileName(file ? file : "");
+	info.line = line;
+
+	uint32_t id = HashBinaryLogFormat(info.fmt, info.arg_types, info.file, info.line);
+
+	AUTO_LOCK(_lock);
+
+	// 哈希冲突时顺延
+	while (true)
+	{
+		if (id == 0)
+		{
+			id = 1;
+		}
+
+		auto it = _formats.find(id);
+		if (it == _formats.end())
+		{
+			_formats.insert(std::make_pair(id, std::move(info)));
+			return id;
+		}
+
+		const BinaryLogFormatInfo & exist = it->second;
+		if (exist.line == info.line && exist.fmt == info.fmt && exist.arg_types == info.arg_types && exist.file == info.file)
+		{
+			return id;
+		}
+
+		id++;
+	}
+}
+
+bool BinaryLogFormatMgr::GetFormat(uint32_t id, BinaryLogFormatInfo & info)
+{
+	AUTO_LOCK(_lock);
+
+	auto it = _formats.find(id);
+	if (it == _formats.end())
+	{
+		return false;
+	}
+
+	info = it->second;
+	return true;
+}
+
+bool BinaryLogFormatMgr::EncodeFormatRecord(uint32_t id, const BinaryLogFormatInfo & info, std::string & out)
+{
+	size_t start = out.size();
+	bool ok = false;
+
+	{
+		StreamWriter writer(out);
+		size_t size_pos = writer.ReserveFixedSizeField();
+		ok = size_pos != (size_t)-1 &&
+			AutoEncode(writer, (uint8_t)kBinaryLogRecord_Format, id, info.fmt, info.arg_types, info.file, info.line) &&
+			writer.FillFixedSizeField(size_pos, writer.GetStreamLength() - StreamWriter::kFixedSizeFieldSize);
+	}
+
+	if (!ok)
+	{
+		out.resize(start);
+	}
+
+	return ok;
+}
+
+
+
+
+uint32_t BinaryLogFormat::Regist(const char * arg_types)
+{
+	uint32_t id = BinaryLogFormatMgr::Instance().Regist(_fmt, arg_types, _file, _line);
+	_id.store(id, std::memory_order_release);
+	return id;
+}
+
+void BinaryLogFormat::Commit(Logger & logger, LogThreadBuffer & thread_buf, int64_t now_ms, size_t line_start, size_t len)
+{
+	std::string & line = thread_buf.GetLineBuffer();
+	assert(line.size() >= line_start);
+
+	if (len > 0)
+	{
+		// 二进制记录不能被分成多条，过长的丢弃
+		if (len > (size_t)thread_buf.GetMaxRecordLength())
+		{
+			logger.AddDroppedLines(1);
+		}
+		else if (LoggerMgr::Instance().IsRunning())
+		{
+			thread_buf.Push(&logger, now_ms / 1000, line.data() + line_start, (int32_t)len);
+		}
+	}
+
+	line.resize(line_start);
+}
+
+
+
+
+void BinaryLogger::Write(int64_t cur_time, const char * text, int32_t len)
+{
+	StreamReader reader(text, (size_t)len);
+	size_t record_size = 0;
+	uint8_t record_type = 0;
+	uint32_t id = 0;
+
+	if (reader.ReadSizeField(record_size) && AutoDecode(reader, record_type, id) &&
+		record_type == kBinaryLogRecord_Line && _format_ids.find(id) == _format_ids.end())
+	{
+		BinaryLogFormatInfo info;
+		std::string format_record;
+		if (BinaryLogFormatMgr::Instance().GetFormat(id, info) && BinaryLogFormatMgr::EncodeFormatRecord(id, info, format_record))
+		{
+			_format_ids.insert(id);
+			Logger::Write(cur_time, format_record.data(), (int32_t)format_record.length());
+		}
+	}
+
+	Logger::Write(cur_time, text, len);
+}
+
+void BinaryLogger::OnLogFileOpened(bool is_empty)
+{
+	std::string data;
+	if (is_empty)
+	{
+		data.append(kBinaryLogMagic, kBinaryLogMagicLength);
+	}
+
+	BinaryLogFormatInfo info;
+	for (uint32_t id : _format_ids)
+	{
+		if (BinaryLogFormatMgr::Instance().GetFormat(id, info))
+		{
+			BinaryLogFormatMgr::EncodeFormatRecord(id, info, data);
+		}
+	}
+
+	if (!data.empty())
+	{
+		WriteFile(data.data(), data.length());
+	}
+}
+
+void BinaryLogger::WriteReportText(int64_t cur_time, const std::string & text)
+{
+	std::string record;
+
+	{
+		StreamWriter writer(record);
+		size_t size_pos = writer.ReserveFixedSizeField();
+		if (size_pos == (size_t)-1 || !AutoEncode(writer, (uint8_t)kBinaryLogRecord_Text, text) ||
+			!writer.FillFixedSizeField(size_pos, writer.GetStreamLength() - StreamWriter::kFixedSizeFieldSize))
+		{
+			return;
+		}
+	}
+
+	Logger::Write(cur_time, record.data(), (int32_t)record.length());
+}
+
+
+
+
+size_t BinaryLogDecoder::Decode(const char * data, size_t len, std::string & out)
+{
+	size_t pos = 0;
+
+	while (pos < len)
+	{
+		// 文件头(记录总是以定长长度字段的0xfe开始，不会与文件头混淆)
+		if (data[pos] == kBinaryLogMagic[0])
+		{
+			size_t n = std::min(len - pos, kBinaryLogMagicLength);
+			if (memcmp(data + pos, kBinaryLogMagic, n) == 0)
+			{
+				if (n < kBinaryLogMagicLength)
+				{
+					break;
+				}
+				pos += kBinaryLogMagicLength;
+				continue;
+			}
+		}
+
+		if ((uint8_t)data[pos] != 0xfe)
+		{
+			// 数据损坏，逐字节向后找下一条记录
+			_error_records++;
+			pos++;
+			while (pos < len && (uint8_t)data[pos] != 0xfe && data[pos] != kBinaryLogMagic[0])
+			{
+				pos++;
+			}
+			continue;
+		}
+
+		if (len - pos < StreamWriter::kFixedSizeFieldSize)
+		{
+			break;
+		}
+
+		StreamReader reader(data + pos, StreamWriter::kFixedSizeFieldSize);
+		size_t record_size = 0;
+		if (!reader.ReadSizeField(record_size))
+		{
+			_error_records++;
+			pos++;
+			continue;
+		}
+
+		if (len - pos - StreamWriter::kFixedSizeFieldSize < record_size)
+		{
+			break;
+		}
+
+		if (!DecodeRecord(data + pos + StreamWriter::kFixedSizeFieldSize, record_size, out))
+		{
+			_error_records++;
+		}
+
+		pos += StreamWriter::kFixedSizeFieldSize + record_size;
+	}
+
+	return pos;
+}
+
+bool BinaryLogDecoder::DecodeRecord(const char * data, size_t len, std::string & out)
+{
+	StreamReader reader(data, len);
+	uint8_t record_type = 0;
+	if (!AutoDecode(reader, record_type))
+	{
+		return false;
+	}
+
+	switch (record_type)
+	{
+	case kBinaryLogRecord_Format:
+	{
+		uint32_t id = 0;
+		BinaryLogFormatInfo info;
+		if (!AutoDecode(reader, id, info.fmt, info.arg_types, info.file, info.line))
+		{
+			return false;
+		}
+		_formats[id] = std::move(info);
+		return true;
+	}
+	case kBinaryLogRecord_Line:
+		return DecodeLine(reader, out);
+	case kBinaryLogRecord_Text:
+	{
+		std::string text;
+		if (!AutoDecode(reader, text))
+		{
+			return false;
+		}
+		out.append(text);
+		return true;
+	}
+	default:
+		return false;
+	}
+}
+
+bool BinaryLogDecoder::DecodeLine(StreamReader & reader, std::string & out)
+{
+	uint32_t id = 0;
+	int64_t time_ms = 0;
+	if (!AutoDecode(reader, id, time_ms))
+	{
+		return false;
+	}
+
+	// 格式：2017-01-02 03:04:05.678|
+	tm cur_tm;
+	TimeHelper::LocalTime(time_ms / 1000, &cur_tm);
+	char time_text[64];
+	int time_len = snprintf(time_text, sizeof(time_text), "%04d-%02d-%02d %02d:%02d:%02d.%03d|",
+		cur_tm.tm_year + 1900, cur_tm.tm_mon + 1, cur_tm.tm_mday, cur_tm.tm_hour, cur_tm.tm_min, cur_tm.tm_sec, (int)(time_ms % 1000));
+	if (time_len > 0)
+	{
+		out.append(time_text, std::min((size_t)time_len, sizeof(time_text) - 1));
+	}
+
+	auto it = _formats.find(id);
+	if (it == _formats.end())
+	{
+		out.append("unknown format ").append(std::to_string(id)).append("\n");
+		return false;
+	}
+
+	const BinaryLogFormatInfo & info = it->second;
+	out.append(info.file).append(":").append(std::to_string(info.line)).append("|");
+
+	// 依次把参数替换到格式串中的{}，多出的参数用|分隔追加在后面
+	size_t arg_index = 0;
+	size_t fmt_pos = 0;
+	while (fmt_pos < info.fmt.length())
+	{
+		size_t placeholder = info.fmt.find("{}", fmt_pos);
+		if (placeholder == std::string::npos || arg_index >= info.arg_types.length())
+		{
+			out.append(info.fmt, fmt_pos, std::string::npos);
+			break;
+		}
+
+		out.append(info.fmt, fmt_pos, placeholder - fmt_pos);
+		if (!AppendArg(reader, info.arg_types[arg_index++], out))
+		{
+			out.append("\n");
+			return false;
+		}
+		fmt_pos = placeholder + 2;
+	}
+
+	for (; arg_index < info.arg_types.length(); arg_index++)
+	{
+		out.push_back('|');
+		if (!AppendArg(reader, info.arg_types[arg_index], out))
+		{
+			out.append("\n");
+			return false;
+		}
+	}
+
+	out.append("\n");
+	return true;
+}
+
+template<typename T>
+static bool AppendIntegerArg(StreamReader & reader, std::string & out)
+{
+	T v = 0;
+	if (!AutoDecode(reader, v))
+	{
+		return false;
+	}
+	out.append(std::to_string(v));
+	return true;
+}
+
+bool BinaryLogDecoder::AppendArg(StreamReader & reader, char type_code, std::string & out)
+{
+	switch (type_code)
+	{
+	case 'a':
+	{
+		char c = 0;
+		if (!AutoDecode(reader, c))
+		{
+			return false;
+		}
+		out.push_back(c);
+		return true;
+	}
+	case 'c': return AppendIntegerArg<int8_t>(reader, out);
+	case 'C': return AppendIntegerArg<uint8_t>(reader, out);
+	case 'h': return AppendIntegerArg<int16_t>(reader, out);
+	case 'H': return AppendIntegerArg<uint16_t>(reader, out);
+	case 'i': return AppendIntegerArg<int32_t>(reader, out);
+	case 'I': return AppendIntegerArg<uint32_t>(reader, out);
+	case 'q': return AppendIntegerArg<int64_t>(reader, out);
+	case 'Q': return AppendIntegerArg<uint64_t>(reader, out);
+	case 'b':
+	{
+		uint8_t b = 0;
+		if (!AutoDecode(reader, b))
+		{
+			return false;
+		}
+		out.push_back(b ? '1' : '0');
+		return true;
+	}
+	case 'd':
+	{
+		uint64_t bits = 0;
+		if (!AutoDecode(reader, bits))
+		{
+			return false;
+		}
+		double d;
+		memcpy(&d, &bits, sizeof(d));
+		char buf[64];
+		int len = snprintf(buf, sizeof(buf), "%g", d);
+		if (len > 0)
+		{
+			out.append(buf, std::min((size_t)len, sizeof(buf) - 1));
+		}
+		return true;
+	}
+	case 's':
+	{
+		std::string s;
+		if (!AutoDecode(reader, s))
+		{
+			return false;
+		}
+		out.append(s);
+		return true;
+	}
+	default:
+		return false;
+	}
+}
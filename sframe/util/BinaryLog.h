@@ -0,0 +1,284 @@
+
+#ifndef SFRAME_BINARY_LOG_H
+#define SFRAME_BINARY_LOG_H
+
+#include <string.h>
+#include <inttypes.h>
+#include <string>
+#include <atomic>
+#include <unordered_map>
+#include <unordered_set>
+#include <type_traits>
+#include "Log.h"
+#include "Serialization.h"
+#include "TimeHelper.h"
+
+namespace sframe {
+
+/*
+	二进制日志
+	每个BLOG调用点的格式串只登记一次(得到格式ID)，每行日志只记录格式ID、时间(毫秒)和参数原始值的编码，写日志时不做任何文本格式化
+	文件由BinaryLogDecoder(example/blogdecode工具)离线转换为文本
+	文件格式：文件头kBinaryLogMagic + 若干记录，每条记录为：定长长度字段 + 记录类型 + 记录内容(都使用Serialization的编码)
+	打开文件时写入已登记的格式定义，格式在文件中第一次使用前也会先写入其定义，每个文件都可以单独解码
+*/
+
+// 二进制日志文件头
+static const char kBinaryLogMagic[] = "SFBLOG1\n";
+static const size_t kBinaryLogMagicLength = sizeof(kBinaryLogMagic) - 1;
+
+// 二进制日志记录类型
+enum BinaryLogRecordType : uint8_t
+{
+	kBinaryLogRecord_Format = 1,       // 格式定义：格式ID、格式串、参数类型、文件名、行号
+	kBinaryLogRecord_Line,             // 日志行：格式ID、时间(毫秒)、参数
+	kBinaryLogRecord_Text,             // 文本(如丢弃日志的统计)
+};
+
+// 参数类型(格式定义中每个参数一个字符)：
+// 'a' char(按字符输出)  'c' int8  'C' uint8  'h' int16  'H' uint16  'i' int32  'I' uint32  'q' int64  'Q' uint64
+// 'b' bool  'd' 浮点数(按double的位编码)  's' 字符串
+
+// 整数按宽度和符号归一
+template<size_t Size, bool Signed> struct BinaryLogInteger;
+template<> struct BinaryLogInteger<1, true> { typedef int8_t Type; static const char kTypeCode = 'c'; };
+template<> struct BinaryLogInteger<1, false> { typedef uint8_t Type; static const char kTypeCode = 'C'; };
+template<> struct BinaryLogInteger<2, true> { typedef int16_t Type; static const char kTypeCode = 'h'; };
+template<> struct BinaryLogInteger<2, false> { typedef uint16_t Type; static const char kTypeCode = 'H'; };
+template<> struct BinaryLogInteger<4, true> { typedef int32_t Type; static const char kTypeCode = 'i'; };
+template<> struct BinaryLogInteger<4, false> { typedef uint32_t Type; static const char kTypeCode = 'I'; };
+template<> struct BinaryLogInteger<8, true> { typedef int64_t Type; static const char kTypeCode = 'q'; };
+template<> struct BinaryLogInteger<8, false> { typedef uint64_t Type; static const char kTypeCode = 'Q'; };
+
+// 日志参数转换为编码使用的类型
+template<typename T, typename Enable = void>
+struct BinaryLogArg
+{
+	static_assert(sizeof(T) == 0, "unsupported binary log argument type");
+};
+
+template<typename T>
+struct BinaryLogArg<T, typename std::enable_if<std::is_integral<T>::value && !std::is_same<T, bool>::value && !std::is_same<T, char>::value>::type>
+{
+	typedef BinaryLogInteger<sizeof(T), std::is_signed<T>::value> Integer;
+	typedef typename Integer::Type Type;
+	static const char kTypeCode = Integer::kTypeCode;
+	static Type Convert(T v) { return (Type)v; }
+};
+
+template<typename T>
+struct BinaryLogArg<T, typename std::enable_if<std::is_enum<T>::value>::type>
+{
+	typedef BinaryLogArg<typename std::underlying_type<T>::type> Underlying;
+	typedef typename Underlying::Type Type;
+	static const char kTypeCode = Underlying::kTypeCode;
+	static Type Convert(T v) { return (Type)v; }
+};
+
+template<typename T>
+struct BinaryLogArg<T, typename std::enable_if<std::is_floating_point<T>::value>::type>
+{
+	typedef uint64_t Type;
+	static const char kTypeCode = 'd';
+	static Type Convert(T v)
+	{
+		double d = (double)v;
+		uint64_t bits;
+		memcpy(&bits, &d, sizeof(bits));
+		return bits;
+	}
+};
+
+template<>
+struct BinaryLogArg<char>
+{
+	typedef char Type;
+	static const char kTypeCode = 'a';
+	static Type Convert(char v) { return v; }
+};
+
+template<>
+struct BinaryLogArg<bool>
+{
+	typedef uint8_t Type;
+	static const char kTypeCode = 'b';
+	static Type Convert(bool v) { return v ? 1 : 0; }
+};
+
+template<>
+struct BinaryLogArg<std::string>
+{
+	typedef StringView Type;
+	static const char kTypeCode = 's';
+	static Type Convert(const std::string & v) { return StringView(v); }
+};
+
+template<>
+struct BinaryLogArg<StringView>
+{
+	typedef StringView Type;
+	static const char kTypeCode = 's';
+	static Type Convert(const StringView & v) { return v; }
+};
+
+template<>
+struct BinaryLogArg<const char *>
+{
+	typedef StringView Type;
+	static const char kTypeCode = 's';
+	static Type Convert(const char * v) { return v ? StringView(v, strlen(v)) : StringView(); }
+};
+
+template<>
+struct BinaryLogArg<char *> : BinaryLogArg<const char *> {};
+
+// 二进制日志的格式信息
+struct BinaryLogFormatInfo
+{
+	std::string fmt;           // 格式串，{}为参数的位置
+	std::string arg_types;     // 参数类型，每个参数一个字符
+	std::string file;
+	int32_t line;
+};
+
+// 二进制日志格式登记表(全进程共享，格式ID由格式内容计算，进程重启后不变)
+class BinaryLogFormatMgr : public singleton<BinaryLogFormatMgr>
+{
+public:
+	// 登记格式，返回格式ID(内容相同的格式ID相同)
+	uint32_t Regist(const char * fmt, const char * arg_types, const char * file, int32_t line);
+
+	bool GetFormat(uint32_t id, BinaryLogFormatInfo & info);
+
+	// 格式定义记录的编码，追加到out
+	static bool EncodeFormatRecord(uint32_t id, const BinaryLogFormatInfo & info, std::string & out);
+
+private:
+	Lock _lock;
+	std::unordered_map<uint32_t, BinaryLogFormatInfo> _formats;
+};
+
+// 二进制日志格式(每个BLOG调用点一个，第一次写日志时登记)
+class BinaryLogFormat : public noncopyable
+{
+public:
+	BinaryLogFormat(const char * fmt, const char * file, int32_t line) : _fmt(fmt), _file(file), _line(line), _id(0) {}
+
+	template<typename... T_Args>
+	void Write(Logger & logger, const T_Args&... args)
+	{
+		uint32_t id = _id.load(std::memory_order_acquire);
+		if (id == 0)
+		{
+			static const char arg_types[] = { BinaryLogArg<typename std::decay<T_Args>::type>::kTypeCode..., '\0' };
+			id = Regist(arg_types);
+		}
+
+		WriteLine(logger, id, BinaryLogArg<typename std::decay<T_Args>::type>::Convert(args)...);
+	}
+
+private:
+
+	uint32_t Regist(const char * arg_types);
+
+	template<typename... T_Args>
+	static void WriteLine(Logger & logger, uint32_t id, const T_Args&... args)
+	{
+		LogThreadBuffer & thread_buf = LoggerMgr::Instance().GetThreadBuffer();
+		std::string & line = thread_buf.GetLineBuffer();
+		size_t line_start = line.size();
+		int64_t now_ms = TimeHelper::GetEpochMilliseconds();
+		size_t len = 0;
+
+		// 直接编码到线程的行缓冲区
+		{
+			StreamWriter writer(line);
+			size_t size_pos = writer.ReserveFixedSizeField();
+			if (size_pos != (size_t)-1 && AutoEncode(writer, (uint8_t)kBinaryLogRecord_Line, id, now_ms, args...) &&
+				writer.FillFixedSizeField(size_pos, writer.GetStreamLength() - StreamWriter::kFixedSizeFieldSize))
+			{
+				len = writer.GetStreamLength();
+			}
+		}
+
+		Commit(logger, thread_buf, now_ms, line_start, len);
+	}
+
+	// 把行缓冲区中编码好的记录提交到线程的暂存缓冲区
+	static void Commit(Logger & logger, LogThreadBuffer & thread_buf, int64_t now_ms, size_t line_start, size_t len);
+
+private:
+	const char * _fmt;
+	const char * _file;
+	int32_t _line;
+	std::atomic<uint32_t> _id;     // 0表示还未登记
+};
+
+// 二进制日志的Logger
+class BinaryLogger : public Logger
+{
+public:
+	BinaryLogger(const std::string & log_name) : Logger(log_name) {}
+
+	// 追加日志记录(每次都是一条完整的记录)，格式第一次出现时先追加格式定义
+	void Write(int64_t cur_time, const char * text, int32_t len) override;
+
+protected:
+
+	const char * GetLogFileExtension() const override
+	{
+		return ".blog";
+	}
+
+	void OnLogFileOpened(bool is_empty) override;
+
+	void WriteReportText(int64_t cur_time, const std::string & text) override;
+
+private:
+	std::unordered_set<uint32_t> _format_ids;    // 已写入过定义的格式
+};
+
+// 二进制日志解码器(离线把二进制日志转换为文本)
+// 输出格式：2017-01-02 03:04:05.678|文件名:行号|格式化后的内容
+class BinaryLogDecoder
+{
+public:
+	BinaryLogDecoder() : _error_records(0) {}
+
+	// 解码data中完整的记录，文本追加到out，返回处理了的长度(末尾不完整的记录留到下次和后续数据一起解码)
+	size_t Decode(const char * data, size_t len, std::string & out);
+
+	// 无法解码的记录数
+	uint64_t GetErrorRecords() const
+	{
+		return _error_records;
+	}
+
+private:
+
+	bool DecodeRecord(const char * data, size_t len, std::string & out);
+
+	bool DecodeLine(StreamReader & reader, std::string & out);
+
+	static bool AppendArg(StreamReader & reader, char type_code, std::string & out);
+
+private:
+	std::unordered_map<uint32_t, BinaryLogFormatInfo> _formats;
+	uint64_t _error_records;
+};
+
+// 二进制日志：BLOG("GateService", "login|uid={}|ip={}", uid, ip);
+// 格式串须是字符串常量，参数支持整数、枚举、bool、浮点数和字符串；按错误级别过滤
+#define BLOG(log_name, fmt, ...) \
+	do { \
+		static sframe::BinaryLogFormat sframe_blog_format_((fmt), __FILE__, __LINE__); \
+		sframe::Logger * sframe_blog_logger_ = sframe::LoggerMgr::Instance().GetEnabledBinaryLogger((log_name)); \
+		if (sframe_blog_logger_) \
+		{ \
+			sframe_blog_format_.Write(*sframe_blog_logger_, ##__VA_ARGS__); \
+		} \
+	} while (0)
+
+}
+
+#endif
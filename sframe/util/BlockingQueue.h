@@ -1,71 +1,155 @@
-﻿
-#ifndef SFRAME_BLOCKING_QUEUE_H
-#define SFRAME_BLOCKING_QUEUE_H
-
-#include "RingQueue.h"
-#include "ConditionVariable.h"
-
-namespace sframe {
-
-// 阻塞队列
-template<typename T>
-class BlockingQueue
-{
-public:
-
-	static const int32_t kDefaultInitCapacity = 32;
-
-	static const int32_t kDefaultIncSize = 8;
-
-	BlockingQueue(int32_t init_capacity = kDefaultInitCapacity, int32_t inc_size = kDefaultIncSize) 
-		: _ring_queue(init_capacity, inc_size), _stop(false) {}
-
-	~BlockingQueue() {}
-
-	void Push(const T & val)
-	{
-		AutoLock l(_lock);
-		if (_stop)
-		{
-			return;
-		}
-
-		_ring_queue.Push(val);
-		// 唤醒一个在等待的线程
-		_cond.WakeUpOne();
-	}
-
-	bool Pop(T * val)
-	{
-		AutoLock l(_lock);
-		bool succ = false;
-		while (!_stop)
-		{
-			succ = _ring_queue.Pop(val);
-			if (succ)
-			{
-				break;
-			}
-
-			_cond.Wait(l);
-		}
-		return succ;
-	}
-
-	void Stop()
-	{
-		AutoLock l(_lock);
-		_stop = true;
-		_cond.WakeUpAll();
-	}
-
-private:
-	RingQueue<T> _ring_queue;
-	Lock _lock;
-	ConditionVariable _cond;
-	bool _stop;
-};
-
-}
-
-#endif
\ No newline at end of file
+#ifndef SFRAME_BLOCKING_QUEUE_H
+#define SFRAME_BLOCKING_QUEUE_H
+
+#include <atomic>
+#include <thread>
+#include "RingQueue.h"
+#include "MPMCQueue.h"
+#include "ConditionVariable.h"
+
+namespace sframe {
+
+/*
+	阻塞队列
+	元素存放在有界无锁队列中，压入和弹出都不加锁；无锁队列满时才加锁放入溢出队列
+	溢出队列不为空时新元素也放入溢出队列，弹出时先取无锁队列，保证先进先出
+	弹出时队列为空先自旋一小段时间，仍然为空才在条件变量上等待，压入时只在有线程等待时才加锁唤醒
+*/
+template<typename T>
+class BlockingQueue
+{
+public:
+
+	static const int32_t kDefaultInitCapacity = 1024;
+
+	static const int32_t kDefaultIncSize = 8;
+
+	static const int32_t kSpinCount = 200;     // 单核时不自旋
+
+	// init_capacity为无锁队列容量(向上取整为2的幂)，inc_size为溢出队列每次扩充的容量
+	BlockingQueue(int32_t init_capacity = kDefaultInitCapacity, int32_t inc_size = kDefaultIncSize)
+		: _queue((size_t)(init_capacity > 0 ? init_capacity : 1)), _overflow_queue(kDefaultIncSize, inc_size), _overflow_len(0), _waiters(0), _stop(false)
+	{
+		_spin_count = std::thread::hardware_concurrency() > 1 ? kSpinCount : 0;
+	}
+
+	~BlockingQueue() {}
+
+	void Push(const T & val)
+	{
+		if (_stop.load(std::memory_order_relaxed))
+		{
+			return;
+		}
+
+		if (_overflow_len.load(std::memory_order_relaxed) > 0 || !_queue.TryPush(val))
+		{
+			AutoLock l(_lock);
+			// 溢出队列已清空时重新放入无锁队列
+			if (_overflow_len.load(std::memory_order_relaxed) > 0 || !_queue.TryPush(val))
+			{
+				_overflow_queue.Push(val);
+				_overflow_len.fetch_add(1, std::memory_order_relaxed);
+			}
+		}
+
+		// 与等待线程登记后的再次检查配对，保证不会漏掉唤醒
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (_waiters.load(std::memory_order_relaxed) > 0)
+		{
+			AutoLock l(_lock);
+			// 唤醒一个在等待的线程
+			_cond.WakeUpOne();
+		}
+	}
+
+	bool Pop(T * val)
+	{
+		for (int32_t i = 0; !_stop.load(std::memory_order_relaxed); i++)
+		{
+			if (TryPop(val))
+			{
+				return true;
+			}
+
+			if (i < _spin_count)
+			{
+				CpuRelax();
+				continue;
+			}
+
+			AutoLock l(_lock);
+			_waiters.fetch_add(1, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+
+			bool succ = PopLocked(val);
+			while (!succ && !_stop.load(std::memory_order_relaxed))
+			{
+				_cond.Wait(l);
+				succ = PopLocked(val);
+			}
+
+			_waiters.fetch_sub(1, std::memory_order_relaxed);
+			return succ;
+		}
+
+		return false;
+	}
+
+	void Stop()
+	{
+		AutoLock l(_lock);
+		_stop.store(true, std::memory_order_relaxed);
+		_cond.WakeUpAll();
+	}
+
+private:
+	// 溢出队列中的元素都比无锁队列中的晚，所以先取无锁队列
+	bool TryPop(T * val)
+	{
+		if (_queue.TryPop(val))
+		{
+			return true;
+		}
+
+		if (_overflow_len.load(std::memory_order_relaxed) > 0)
+		{
+			AutoLock l(_lock);
+			return PopLocked(val);
+		}
+
+		return false;
+	}
+
+	// 持有_lock时弹出
+	bool PopLocked(T * val)
+	{
+		return _queue.TryPop(val) || PopOverflow(val);
+	}
+
+	// 从溢出队列弹出(需持有_lock)
+	bool PopOverflow(T * val)
+	{
+		if (!_overflow_queue.Pop(val))
+		{
+			return false;
+		}
+
+		_overflow_len.fetch_sub(1, std::memory_order_relaxed);
+		return true;
+	}
+
+private:
+	MPMCQueue<T> _queue;
+	RingQueue<T> _overflow_queue;
+	std::atomic<int32_t> _overflow_len;
+	std::atomic<int32_t> _waiters;
+	Lock _lock;
+	ConditionVariable _cond;
+	std::atomic<bool> _stop;
+	int32_t _spin_count;
+};
+
+}
+
+#endif
@@ -1,175 +1,149 @@
-﻿
-#ifndef SFRAME_BUFFER_H
+﻿#ifndef SFRAME_BUFFER_H
 #define SFRAME_BUFFER_H
 
 #include <inttypes.h>
 #include <assert.h>
+#include <string.h>
 #include <atomic>
+#include <thread>
 #include <algorithm>
+#include <type_traits>
+#include "Lock.h"
 
 namespace sframe{
 
 
-// 环形缓冲区(同一时间只能有一个线程读)
+/*
+    多生产者单消费者环形缓冲区
+    生产者用CAS预留一段空间(空间不够时直接失败)，写入后按预留的顺序提交，提交时需要等前面的生产者先提交；
+    消费者Peek取已提交的数据(不移动读位置)，处理完后Free释放，释放的空间才能被生产者再次使用
+    同一时间只能有一个线程读
+*/
 template<typename T, int32_t Buffer_Capacity>
 class FastRingBuffer
 {
 public:
-    FastRingBuffer()
+    static const int32_t kSpinCount = 64;    // 等待前面的生产者提交时，超过此次数后让出CPU
+
+    FastRingBuffer() : _apply(0), _cursor(0), _released(0)
     {
         static_assert(std::is_pod<T>::value, "FastRingBuffer T must be pod type");
-        static_assert(Buffer_Capacity > 0 && Buffer_Capacity % 2 == 0, "This is a bad FastRingBuffer capacity");
-        _idle.store(Buffer_Capacity);
-        _apply.store(0);
-        _cursor.store(0);
-        _readed = 0;
+        static_assert(Buffer_Capacity > 0 && (Buffer_Capacity & (Buffer_Capacity - 1)) == 0, "FastRingBuffer capacity must be power of 2");
     }
 
     // 压入
     bool Push(const T & obj)
     {
-        // 首先占有需要的空闲长度，并比较空闲的长度是否足够
-        if (_idle.fetch_sub(1) < 1)
-        {
-            _idle.fetch_add(1);
-            return false;
-        }
-
-        // 申请一个位置
-        uint64_t apply_num = _apply.fetch_add(1);
-        // 写入位置
-        int32_t write_index = (int32_t)(apply_num & (Buffer_Capacity - 1));
-        // 写入
-        _buf[write_index] = obj;
-
-        // 提交写入的数据（使用CAS修改 _cursor）
-        while (true)
-        {
-            auto tmp = apply_num;
-            if (_cursor.compare_exchange_weak(tmp, apply_num + 1))
-            {
-                break;
-            }
-        }
-
-        return true;
+        return Push(&obj, 1);
     }
 
-    // 压入
+    // 压入(全部压入或者全部不压入)
     bool Push(const T * data, int32_t len)
     {
-        if (data == nullptr || len <= 0)
+        if (data == nullptr || len <= 0 || len > Buffer_Capacity)
         {
             return false;
         }
-    
-        // 首先占有需要的空闲长度，并比较空闲的长度是否足够
-        if (_idle.fetch_sub(len) < len)
+
+        // 预留空间
+        uint64_t before_apply = _apply.load(std::memory_order_relaxed);
+        do
         {
-            _idle.fetch_add(len);
-            return false;
-        }
-    
-        // 申请一块缓冲区
-        uint64_t before_apply = _apply.fetch_add((uint32_t)len);
+            if (before_apply + len - _released.load(std::memory_order_acquire) > (uint64_t)Buffer_Capacity)
+            {
+                return false;
+            }
+        } while (!_apply.compare_exchange_weak(before_apply, before_apply + len, std::memory_order_relaxed));
+
         uint64_t after_apply = before_apply + len;
-        // 计算写入位置
+
+        // 写入(可能分两段)
         int32_t begin_write_index = (int32_t)(before_apply & (Buffer_Capacity - 1));
-        int32_t end_write_index = (int32_t)(after_apply & (Buffer_Capacity - 1));
-    
-        // 不需分两次写入
-        if (end_write_index > begin_write_index)
+        int32_t first_write_len = std::min(len, Buffer_Capacity - begin_write_index);
+        memcpy(_buf + begin_write_index, data, sizeof(T) * first_write_len);
+        if (first_write_len < len)
         {
-            memcpy(_buf + begin_write_index, data, len);
+            memcpy(_buf, data + first_write_len, sizeof(T) * (len - first_write_len));
         }
-        // 需要分两次写入
-        else
-        {
-            int32_t first_write_len = Buffer_Capacity - begin_write_index;
-            memcpy(_buf + begin_write_index, data, first_write_len);
-            memcpy(_buf, data + first_write_len, len - first_write_len);
-        }
-    
-        // 提交写入的数据（循环CAS修改_cursor）
-        while (true)
+
+        // 等前面的生产者都提交后再提交
+        for (int32_t i = 0; _cursor.load(std::memory_order_acquire) != before_apply; i++)
         {
-            auto tmp = before_apply;
-            if (_cursor.compare_exchange_weak(tmp, after_apply))
+            if (i < kSpinCount)
+            {
+                CpuRelax();
+            }
+            else
             {
-                break;
+                std::this_thread::yield();
             }
         }
-    
+
+        _cursor.store(after_apply, std::memory_order_release);
+
         return true;
     }
 
-    // 读取数据，读取后，缓冲区依然锁定(不空闲)
+    // 读取连续的一段数据(不移动读位置，处理完后调用Free)，len大于0时最多读取len个
     T * Peek(int32_t & len)
     {
-        uint64_t cursor = _cursor.load();
-
-        if (_readed >= cursor)
+        uint64_t cursor = _cursor.load(std::memory_order_acquire);
+        uint64_t readed = _released.load(std::memory_order_relaxed);
+        if (readed >= cursor)
         {
             len = 0;
             return nullptr;
         }
 
-        // 可读数据
-        int32_t can_read = (int32_t)(cursor - _readed);
-        // 读取开始索引
-        int32_t begin_index = (int32_t)(_readed & (Buffer_Capacity - 1));
-        int32_t end_index = (int32_t)(cursor & (Buffer_Capacity - 1));
-
-        T * ret_buf = nullptr;
-
-        if (end_index <= begin_index)
-        {
-            // 只返回第一段数据
-            can_read = Buffer_Capacity - begin_index;
-        }
-
+        int32_t begin_index = (int32_t)(readed & (Buffer_Capacity - 1));
+        int32_t can_read = (int32_t)std::min(cursor - readed, (uint64_t)(Buffer_Capacity - begin_index));
         len = (len > 0 && len < can_read) ? len : can_read;
-        _readed += len;
-        ret_buf = _buf + begin_index;
 
-        return ret_buf;
+        return _buf + begin_index;
     }
 
-    // 加读取游标
-    void AddRead(int32_t val)
+    // 读取所有数据(不移动读位置，处理完后调用Free)，绕回时分为两段，返回总长度
+    int32_t PeekAll(T *& first, int32_t & first_len, T *& second, int32_t & second_len)
     {
-        _readed += val;
+        uint64_t cursor = _cursor.load(std::memory_order_acquire);
+        uint64_t readed = _released.load(std::memory_order_relaxed);
+        int32_t total = (int32_t)(cursor - readed);
+        int32_t begin_index = (int32_t)(readed & (Buffer_Capacity - 1));
+
+        first_len = std::min(total, Buffer_Capacity - begin_index);
+        first = first_len > 0 ? _buf + begin_index : nullptr;
+        second_len = total - first_len;
+        second = second_len > 0 ? _buf : nullptr;
+
+        return total;
     }
 
     // 获取未读取的长度
     int32_t GetUnReadLength() const
     {
-        uint64_t cursor = _cursor.load();
-        return (int32_t)(cursor - _readed);
+        uint64_t cursor = _cursor.load(std::memory_order_acquire);
+        return (int32_t)(cursor - _released.load(std::memory_order_relaxed));
     }
 
-    // 将指定缓冲区变为空闲状态，使生产者可以写入
+    // 释放已读取的数据，使生产者可以写入
     void Free(int32_t len)
     {
-        int64_t idle = _idle.load();
-        while (idle < 0)
-        {
-            idle = _idle.load();
-        }
-
-        assert(len + idle <= Buffer_Capacity);
-
-        _idle.fetch_add(len);
+        uint64_t readed = _released.load(std::memory_order_relaxed);
+        assert(len >= 0 && readed + len <= _cursor.load(std::memory_order_relaxed));
+        _released.store(readed + len, std::memory_order_release);
     }
 
 private:
     T _buf[Buffer_Capacity];
-    std::atomic_llong _idle;      // 空闲的长度（为了保证未处理的数据不会备覆盖）
-    std::atomic_ullong _apply;    // 申请缓冲区的游标（生产者申请区域的记录）
-    std::atomic_ullong _cursor;   // 数据游标（指示可用数据）
-    uint64_t _readed;            // 读取游标，指示当前读取位置
+    char _pad0[64];
+    std::atomic<uint64_t> _apply;       // 生产者预留空间的位置
+    char _pad1[64 - sizeof(std::atomic<uint64_t>)];
+    std::atomic<uint64_t> _cursor;      // 已提交数据的位置
+    char _pad2[64 - sizeof(std::atomic<uint64_t>)];
+    std::atomic<uint64_t> _released;    // 消费者已释放的位置(也是读取位置)
+    char _pad3[64 - sizeof(std::atomic<uint64_t>)];
 };
 
 }
 
-#endif
\ No newline at end of file
+#endif
@@ -94,7 +94,7 @@ public:
 		int64_t nsec = ((int64_t)now.tv_usec + (int64_t)milliseconds * 1000) * 1000;
 
 		timespec abstime;
-		abstime.tv_sec += now.tv_sec + (__time_t)(nsec / 1000000000);
+		abstime.tv_sec = now.tv_sec + (__time_t)(nsec / 1000000000);
 		abstime.tv_nsec = (nsec % 1000000000);
 
 		int ret = pthread_cond_timedwait(&_cond_var, &lock.GetLock()->_mutex, &abstime);
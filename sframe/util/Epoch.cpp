@@ -0,0 +1,189 @@
+
+#include <assert.h>
+#include "Epoch.h"
+
+using namespace sframe;
+
+// 线程槽（每个线程一个）
+struct EpochManager::ThreadSlot
+{
+	ThreadSlot() : index(-1), depth(0) {}
+
+	~ThreadSlot()
+	{
+		if (index >= 0)
+		{
+			EpochManager::Instance()._slot_used[index].store(false);
+		}
+	}
+
+	int32_t index;   // 槽索引，小于0表示没有分配到槽
+	int32_t depth;   // 临界区嵌套深度
+};
+
+EpochManager::EpochManager() : _global_epoch(1), _overflow_active(0)
+{
+	for (int32_t i = 0; i < kMaxThreadSlot; i++)
+	{
+		_slot_epoch[i].store(0);
+		_slot_used[i].store(false);
+	}
+}
+
+EpochManager::~EpochManager()
+{
+	for (RetiredItem & item : _retired)
+	{
+		item.reclaim_func();
+	}
+	_retired.clear();
+}
+
+// 进入临界区（可嵌套）
+void EpochManager::Enter()
+{
+	ThreadSlot & slot = GetThreadSlot();
+	if (slot.depth++ > 0)
+	{
+		return;
+	}
+
+	if (slot.index >= 0)
+	{
+		_slot_epoch[slot.index].store(_global_epoch.load());
+	}
+	else
+	{
+		_overflow_active.fetch_add(1);
+	}
+}
+
+// 离开临界区
+void EpochManager::Leave()
+{
+	ThreadSlot & slot = GetThreadSlot();
+	assert(slot.depth > 0);
+	if (--slot.depth > 0)
+	{
+		return;
+	}
+
+	if (slot.index >= 0)
+	{
+		_slot_epoch[slot.index].store(0);
+	}
+	else
+	{
+		_overflow_active.fetch_sub(1);
+	}
+}
+
+// 推进纪元，返回推进前的纪元
+uint64_t EpochManager::Advance()
+{
+	return _global_epoch.fetch_add(1);
+}
+
+// 指定纪元之前进入临界区的线程是否都已离开
+bool EpochManager::IsSafe(uint64_t epoch) const
+{
+	if (_overflow_active.load() > 0)
+	{
+		return false;
+	}
+
+	uint64_t min_epoch = GetMinActiveEpoch();
+	return min_epoch == 0 || min_epoch > epoch;
+}
+
+// 延迟回收
+void EpochManager::Retire(const std::function<void()> & reclaim_func)
+{
+	AUTO_LOCK(_retired_lock);
+	RetiredItem item;
+	item.epoch = Advance();
+	item.reclaim_func = reclaim_func;
+	_retired.push_back(item);
+}
+
+// 执行可以执行的回收，返回回收的数量
+size_t EpochManager::Reclaim()
+{
+	std::vector<RetiredItem> reclaim_items;
+
+	{
+		AUTO_LOCK(_retired_lock);
+		if (_retired.empty())
+		{
+			return 0;
+		}
+
+		size_t keep = 0;
+		for (size_t i = 0; i < _retired.size(); i++)
+		{
+			if (IsSafe(_retired[i].epoch))
+			{
+				reclaim_items.push_back(_retired[i]);
+			}
+			else
+			{
+				_retired[keep++] = _retired[i];
+			}
+		}
+		_retired.resize(keep);
+	}
+
+	// 在锁外执行回收，回收函数中可以再次调用Retire
+	for (RetiredItem & item : reclaim_items)
+	{
+		item.reclaim_func();
+	}
+
+	return reclaim_items.size();
+}
+
+// 是否还有待回收的对象
+bool EpochManager::HasRetired() const
+{
+	AUTO_LOCK(_retired_lock);
+	return !_retired.empty();
+}
+
+// 获取当前线程的槽
+EpochManager::ThreadSlot & EpochManager::GetThreadSlot()
+{
+	static thread_local ThreadSlot slot;
+
+	// 没有分配到槽的线程，在最外层进入临界区时重试
+	if (slot.index < 0 && slot.depth == 0)
+	{
+		for (int32_t i = 0; i < kMaxThreadSlot; i++)
+		{
+			bool expected = false;
+			if (!_slot_used[i].load() && _slot_used[i].compare_exchange_strong(expected, true))
+			{
+				slot.index = i;
+				break;
+			}
+		}
+	}
+
+	return slot;
+}
+
+// 获取所有活跃线程中最小的纪元，没有活跃线程返回0
+uint64_t EpochManager::GetMinActiveEpoch() const
+{
+	uint64_t min_epoch = 0;
+
+	for (int32_t i = 0; i < kMaxThreadSlot; i++)
+	{
+		uint64_t e = _slot_epoch[i].load();
+		if (e != 0 && (min_epoch == 0 || e < min_epoch))
+		{
+			min_epoch = e;
+		}
+	}
+
+	return min_epoch;
+}
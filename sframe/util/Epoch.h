@@ -0,0 +1,90 @@
+
+#ifndef SFRAME_EPOCH_H
+#define SFRAME_EPOCH_H
+
+#include <inttypes.h>
+#include <atomic>
+#include <vector>
+#include <functional>
+#include "Lock.h"
+#include "Singleton.h"
+
+namespace sframe {
+
+/*
+	基于纪元(epoch)的延迟回收
+	读线程在访问共享对象前进入临界区(EpochGuard)，写线程摘除共享对象后调用Retire，
+	回收函数会在所有可能看到该对象的临界区都退出后才被调用
+*/
+class EpochManager : public singleton<EpochManager>, public noncopyable
+{
+public:
+	static const int32_t kMaxThreadSlot = 256;   // 最大线程槽数量
+
+	EpochManager();
+
+	~EpochManager();
+
+	// 进入临界区（可嵌套）
+	void Enter();
+
+	// 离开临界区
+	void Leave();
+
+	// 推进纪元，返回推进前的纪元(在此之前进入临界区的线程都离开后，IsSafe(返回值)为true)
+	uint64_t Advance();
+
+	// 指定纪元之前进入临界区的线程是否都已离开
+	bool IsSafe(uint64_t epoch) const;
+
+	// 延迟回收
+	void Retire(const std::function<void()> & reclaim_func);
+
+	// 执行可以执行的回收，返回回收的数量
+	size_t Reclaim();
+
+	// 是否还有待回收的对象
+	bool HasRetired() const;
+
+private:
+	struct ThreadSlot;
+
+	struct RetiredItem
+	{
+		uint64_t epoch;
+		std::function<void()> reclaim_func;
+	};
+
+	// 获取当前线程的槽
+	ThreadSlot & GetThreadSlot();
+
+	// 获取所有活跃线程中最小的纪元，没有活跃线程返回0
+	uint64_t GetMinActiveEpoch() const;
+
+private:
+	std::atomic<uint64_t> _global_epoch;                  // 全局纪元
+	std::atomic<uint64_t> _slot_epoch[kMaxThreadSlot];    // 每个线程槽的纪元(0表示不在临界区)
+	std::atomic<bool> _slot_used[kMaxThreadSlot];         // 线程槽是否被占用
+	std::atomic<int32_t> _overflow_active;                // 没有分配到槽的线程在临界区中的数量
+	std::vector<RetiredItem> _retired;                    // 待回收列表
+	Lock _retired_lock;
+};
+
+// 纪元临界区守卫
+class EpochGuard : public noncopyable
+{
+public:
+	EpochGuard()
+	{
+		EpochManager::Instance().Enter();
+	}
+
+	~EpochGuard()
+	{
+		EpochManager::Instance().Leave();
+	}
+};
+
+}
+
+#endif
@@ -0,0 +1,192 @@
+
+#ifndef SFRAME_HISTOGRAM_H
+#define SFRAME_HISTOGRAM_H
+
+#include <inttypes.h>
+#include <assert.h>
+#include <vector>
+#include <atomic>
+#include "Singleton.h"
+
+namespace sframe {
+
+// 对数线性分桶(HDR风格)：小于kSubBucketCount的值每个值一个桶，之后每个2的幂区间再分成kSubBucketCount个桶
+// 相对误差不超过1/kSubBucketCount，超出范围的值计入最后一个桶
+struct HistogramBuckets
+{
+	static const int32_t kSubBucketBits = 4;
+	static const uint64_t kSubBucketCount = (uint64_t)1 << kSubBucketBits;
+	static const int32_t kMaxValueBits = 32;
+	static const int32_t kBucketCount = (int32_t)((kMaxValueBits - kSubBucketBits + 1) * kSubBucketCount);
+
+	static int32_t GetBucketIndex(uint64_t v)
+	{
+		if (v < kSubBucketCount)
+		{
+			return (int32_t)v;
+		}
+
+		if (v >> kMaxValueBits)
+		{
+			return kBucketCount - 1;
+		}
+
+		int32_t shift = GetHighestBit(v) - kSubBucketBits;
+		return (int32_t)((uint64_t)shift * kSubBucketCount + (v >> shift));
+	}
+
+	// 桶内的最大值
+	static uint64_t GetBucketUpperBound(int32_t index)
+	{
+		assert(index >= 0 && index < kBucketCount);
+		if ((uint64_t)index < kSubBucketCount)
+		{
+			return (uint64_t)index;
+		}
+
+		int32_t shift = (int32_t)(index / kSubBucketCount) - 1;
+		uint64_t sub = (uint64_t)index - (uint64_t)shift * kSubBucketCount;
+		return ((sub + 1) << shift) - 1;
+	}
+
+	static int32_t GetHighestBit(uint64_t v)
+	{
+		int32_t bit = 0;
+		while (v >>= 1)
+		{
+			bit++;
+		}
+		return bit;
+	}
+};
+
+// 直方图数据(可合并的快照)
+class HistogramData
+{
+public:
+	HistogramData() : _buckets(HistogramBuckets::kBucketCount, 0), _count(0), _sum(0) {}
+
+	void Add(uint64_t v)
+	{
+		_buckets[HistogramBuckets::GetBucketIndex(v)]++;
+		_count++;
+		_sum += v;
+	}
+
+	void Merge(const HistogramData & other)
+	{
+		for (int32_t i = 0; i < HistogramBuckets::kBucketCount; i++)
+		{
+			_buckets[i] += other._buckets[i];
+		}
+		_count += other._count;
+		_sum += other._sum;
+	}
+
+	// 减去之前的快照(用于从某个时间点开始统计)
+	void Subtract(const HistogramData & base)
+	{
+		for (int32_t i = 0; i < HistogramBuckets::kBucketCount; i++)
+		{
+			_buckets[i] = _buckets[i] >= base._buckets[i] ? _buckets[i] - base._buckets[i] : 0;
+		}
+		_count = _count >= base._count ? _count - base._count : 0;
+		_sum = _sum >= base._sum ? _sum - base._sum : 0;
+	}
+
+	uint64_t GetCount() const
+	{
+		return _count;
+	}
+
+	uint64_t GetMean() const
+	{
+		return _count > 0 ? _sum / _count : 0;
+	}
+
+	// 百分位数(percent为0到100)，返回所在桶的最大值
+	uint64_t GetPercentile(double percent) const
+	{
+		if (_count == 0)
+		{
+			return 0;
+		}
+
+		uint64_t rank = (uint64_t)(percent / 100.0 * (double)_count + 0.5);
+		rank = rank < 1 ? 1 : (rank > _count ? _count : rank);
+		uint64_t n = 0;
+		for (int32_t i = 0; i < HistogramBuckets::kBucketCount; i++)
+		{
+			n += _buckets[i];
+			if (n >= rank)
+			{
+				return HistogramBuckets::GetBucketUpperBound(i);
+			}
+		}
+
+		return HistogramBuckets::GetBucketUpperBound(HistogramBuckets::kBucketCount - 1);
+	}
+
+	uint64_t GetMax() const
+	{
+		for (int32_t i = HistogramBuckets::kBucketCount - 1; i >= 0; i--)
+		{
+			if (_buckets[i] > 0)
+			{
+				return HistogramBuckets::GetBucketUpperBound(i);
+			}
+		}
+
+		return 0;
+	}
+
+private:
+	friend class LatencyHistogram;
+
+	std::vector<uint64_t> _buckets;
+	uint64_t _count;
+	uint64_t _sum;
+};
+
+// 延迟直方图
+// 只有一个线程记录(计数只做relaxed读写，没有原子读改写指令，足够便宜可以一直开启)，其他线程可以随时取快照
+class LatencyHistogram : public noncopyable
+{
+public:
+	LatencyHistogram() : _count(0), _sum(0)
+	{
+		for (auto & bucket : _buckets)
+		{
+			bucket.store(0, std::memory_order_relaxed);
+		}
+	}
+
+	// 记录一个值(只能由一个线程调用)
+	void Record(uint64_t v)
+	{
+		std::atomic<uint64_t> & bucket = _buckets[HistogramBuckets::GetBucketIndex(v)];
+		bucket.store(bucket.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+		_sum.store(_sum.load(std::memory_order_relaxed) + v, std::memory_order_relaxed);
+		_count.store(_count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	}
+
+	// 把当前数据合并到data
+	void MergeTo(HistogramData & data) const
+	{
+		for (int32_t i = 0; i < HistogramBuckets::kBucketCount; i++)
+		{
+			data._buckets[i] += _buckets[i].load(std::memory_order_relaxed);
+		}
+		data._count += _count.load(std::memory_order_relaxed);
+		data._sum += _sum.load(std::memory_order_relaxed);
+	}
+
+private:
+	std::atomic<uint64_t> _buckets[HistogramBuckets::kBucketCount];
+	std::atomic<uint64_t> _count;
+	std::atomic<uint64_t> _sum;
+};
+
+}
+
+#endif
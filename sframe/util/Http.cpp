@@ -1,22 +1,23 @@
 ﻿
+#include <stdio.h>
+#include <string.h>
 #include <algorithm>
 #include "Http.h"
 #include "Convert.h"
 #include "StringHelper.h"
+#include "TimeHelper.h"
 
 using namespace sframe;
 
-// 标准化头部Key
-std::string Http::StandardizeHeaderKey(const std::string & key)
+// 标准化头部Key，追加到out
+static void AppendStandardizedHeaderKey(const char * key, size_t len, std::string & out)
 {
 	static const char kUpperLower = 'a' - 'A';
-	std::string standardized_key;
-	standardized_key.reserve(key.size());
 
 	bool upper = true;
-	for (std::string::const_iterator it = key.begin(); it != key.end(); it++)
+	for (size_t i = 0; i < len; i++)
 	{
-		char c = *it;
+		char c = key[i];
 		if (c >= 'a' && c <= 'z')
 		{
 			c = upper ? c - kUpperLower : c;
@@ -26,74 +27,236 @@ std::string Http::StandardizeHeaderKey(const std::string & key)
 			c = !upper ? c + kUpperLower : c;
 		}
 
-		standardized_key.push_back(c);
+		out.push_back(c);
 		upper = (c == '-');
 	}
+}
+
+// 去掉两边的空格和制表符
+static void TrimSpace(const char * & str, size_t & len)
+{
+	while (len > 0 && (str[0] == ' ' || str[0] == '\t'))
+	{
+		str++;
+		len--;
+	}
+
+	while (len > 0 && (str[len - 1] == ' ' || str[len - 1] == '\t'))
+	{
+		len--;
+	}
+}
+
+// 不区分大小写比较(token为小写)
+static bool EqualsIgnoreCase(const char * str, size_t len, const char * token)
+{
+	size_t i = 0;
+	for (; i < len && token[i] != '\0'; i++)
+	{
+		char c = str[i];
+		if (c >= 'A' && c <= 'Z')
+		{
+			c += 'a' - 'A';
+		}
+
+		if (c != token[i])
+		{
+			return false;
+		}
+	}
+
+	return i == len && token[i] == '\0';
+}
+
+// 逗号分隔的头部值中是否有指定的项(不区分大小写，token为小写)
+static bool HaveHeaderToken(const std::string & value, const char * token)
+{
+	const char * p = value.data();
+	size_t remain = value.length();
+	while (remain > 0)
+	{
+		const char * comma = (const char *)memchr(p, ',', remain);
+		size_t item_len = comma ? (size_t)(comma - p) : remain;
+		const char * item = p;
+		size_t trimmed_len = item_len;
+		TrimSpace(item, trimmed_len);
+		if (EqualsIgnoreCase(item, trimmed_len, token))
+		{
+			return true;
+		}
+
+		if (!comma)
+		{
+			break;
+		}
+		p = comma + 1;
+		remain -= item_len + 1;
+	}
+
+	return false;
+}
+
+// URL编解码用的字符表
+struct UrlCharTable
+{
+	UrlCharTable()
+	{
+		for (int i = 0; i < 256; i++)
+		{
+			unreserved[i] = i == '-' || i == '_' || i == '.' || (i >= '0' && i <= '9') || (i >= 'a' && i <= 'z') || (i >= 'A' && i <= 'Z');
+			hex_value[i] = (i >= '0' && i <= '9') ? (int8_t)(i - '0') : (i >= 'a' && i <= 'f') ? (int8_t)(i - 'a' + 10) :
+				(i >= 'A' && i <= 'F') ? (int8_t)(i - 'A' + 10) : (int8_t)-1;
+		}
+	}
 
+	bool unreserved[256];      // 不需要编码的字符
+	int8_t hex_value[256];     // 十六进制数字的值，不是十六进制数字时为-1
+};
+
+static const UrlCharTable & GetUrlCharTable()
+{
+	static const UrlCharTable table;
+	return table;
+}
+
+// 整数转换为十进制文本，返回长度(buf至少24字节)
+static size_t FormatInteger(int64_t val, char * buf)
+{
+	char tmp[24];
+	size_t len = 0;
+	uint64_t v = val < 0 ? (uint64_t)0 - (uint64_t)val : (uint64_t)val;
+	do
+	{
+		tmp[len++] = (char)('0' + v % 10);
+		v /= 10;
+	} while (v > 0);
+
+	size_t n = 0;
+	if (val < 0)
+	{
+		buf[n++] = '-';
+	}
+	while (len > 0)
+	{
+		buf[n++] = tmp[--len];
+	}
+
+	return n;
+}
+
+// 标准化头部Key
+std::string Http::StandardizeHeaderKey(const std::string & key)
+{
+	std::string standardized_key;
+	standardized_key.reserve(key.size());
+	AppendStandardizedHeaderKey(key.data(), key.size(), standardized_key);
 	return standardized_key;
 }
 
 // URL编码
 std::string Http::UrlEncode(const std::string & str)
 {
-	static char sHexTable[17] = "0123456789ABCDEF";
+	std::string result;
+	UrlEncode(str.data(), str.length(), result);
+	return result;
+}
+
+// URL编码，追加到out
+void Http::UrlEncode(const char * str, size_t len, std::string & out)
+{
+	static const char sHexTable[17] = "0123456789ABCDEF";
+	const UrlCharTable & table = GetUrlCharTable();
 
-	std::ostringstream oss;
+	// 先计算编码后的长度
+	size_t escaped = 0;
+	for (size_t i = 0; i < len; i++)
+	{
+		escaped += !table.unreserved[(uint8_t)str[i]];
+	}
 
-	for (size_t i = 0; i < str.length(); i++)
+	size_t pos = out.length();
+	out.resize(pos + len + escaped * 2);
+	if (len == 0)
 	{
-		char cur_char = str[i];
-		if (cur_char == '-' || cur_char == '_' || cur_char == '.' ||
-			(cur_char >= '0' && cur_char <= '9') ||
-			(cur_char >= 'a' && cur_char <= 'z') ||
-			(cur_char >= 'A' && cur_char <= 'Z'))
+		return;
+	}
+
+	char * p = &out[pos];
+	for (size_t i = 0; i < len; i++)
+	{
+		uint8_t c = (uint8_t)str[i];
+		if (table.unreserved[c])
 		{
-			oss << cur_char;
+			*p++ = (char)c;
 		}
 		else
 		{
-			oss << '%' << (sHexTable[(cur_char >> 4) & 0x0f]) << (sHexTable[(cur_char & 0x0f)]);
+			p[0] = '%';
+			p[1] = sHexTable[c >> 4];
+			p[2] = sHexTable[c & 0x0f];
+			p += 3;
 		}
 	}
-
-	return oss.str();
 }
 
 // URL解码
 std::string Http::UrlDecode(const std::string & str)
 {
-	std::ostringstream oss;
-	size_t pos = 0;
+	std::string result;
+	UrlDecode(str.data(), str.length(), result);
+	return result;
+}
 
-	while (pos < str.length())
+// URL解码，追加到out
+void Http::UrlDecode(const char * str, size_t len, std::string & out)
+{
+	if (len == 0)
 	{
-		char cur_char = str[pos];
-		if (cur_char == '%')
-		{
-			if (pos + 2 >= str.length())
-			{
-				break;
-			}
+		return;
+	}
 
-			char c1 = str[pos + 1];
-			c1 = (c1 >= 'a' && c1 <= 'z') ? c1 - 32 : c1;
-			char c2 = str[pos + 2];
-			c2 = (c2 >= 'a' && c2 <= 'z') ? c2 - 32 : c2;
+	const UrlCharTable & table = GetUrlCharTable();
+	size_t pos = out.length();
+	out.resize(pos + len);
+	char * begin = &out[pos];
+	char * p = begin;
+	size_t i = 0;
 
-			cur_char = (((c1 >= 'A' ? (c1 - 'A' + 10) : (c1 - '0')) << 4) & 0xf0);
-			cur_char += ((c2 >= 'A' ? (c2 - 'A' + 10) : (c2 - '0')) & 0x0f);
-			oss << cur_char;
+	while (i < len)
+	{
+		// 复制到下一个%
+		const char * percent = (const char *)memchr(str + i, '%', len - i);
+		size_t run_len = percent ? (size_t)(percent - str) - i : len - i;
+		memcpy(p, str + i, run_len);
+		p += run_len;
+		i += run_len;
+		if (percent == nullptr)
+		{
+			break;
+		}
 
-			pos += 3;
+		int8_t h = i + 2 < len ? table.hex_value[(uint8_t)str[i + 1]] : (int8_t)-1;
+		int8_t l = i + 2 < len ? table.hex_value[(uint8_t)str[i + 2]] : (int8_t)-1;
+		if (h >= 0 && l >= 0)
+		{
+			*p++ = (char)((h << 4) | l);
+			i += 3;
 		}
 		else
 		{
-			oss << cur_char;
-			pos++;
+			*p++ = '%';
+			i++;
 		}
 	}
 
-	return oss.str();
+	out.resize(pos + (size_t)(p - begin));
+}
+
+// 解码参数中的一段，覆盖out
+static void DecodeParamPart(const std::string & para_str, size_t begin, size_t end, std::string & out)
+{
+	out.clear();
+	Http::UrlDecode(para_str.data() + begin, end - begin, out);
 }
 
 // 解析HTTP参数
@@ -120,7 +283,7 @@ Http::Param Http::ParseHttpParam(const std::string para_str)
 
 			if (i > cur_word_start_pos)
 			{
-				k = UrlDecode(para_str.substr(cur_word_start_pos, i - cur_word_start_pos));
+				DecodeParamPart(para_str, cur_word_start_pos, i, k);
 			}
 			cur_word_start_pos = i + 1;
 
@@ -131,11 +294,14 @@ Http::Param Http::ParseHttpParam(const std::string para_str)
 			assert(i >= cur_word_start_pos);
 			if (!k.empty())
 			{
-				para[std::move(k)] = UrlDecode(para_str.substr(cur_word_start_pos, i - cur_word_start_pos));
+				DecodeParamPart(para_str, cur_word_start_pos, i, para[std::move(k)]);
+				k.clear();
 			}
 			else if (i > cur_word_start_pos)
 			{
-				para[UrlDecode(para_str.substr(cur_word_start_pos, i - cur_word_start_pos))] = std::string();
+				std::string key;
+				DecodeParamPart(para_str, cur_word_start_pos, i, key);
+				para[std::move(key)].clear();
 			}
 			cur_word_start_pos = i + 1;
 
@@ -146,11 +312,13 @@ Http::Param Http::ParseHttpParam(const std::string para_str)
 	assert(i == para_str.length() && i >= cur_word_start_pos);
 	if (!k.empty())
 	{
-		para[std::move(k)] = UrlDecode(para_str.substr(cur_word_start_pos, i - cur_word_start_pos));
+		DecodeParamPart(para_str, cur_word_start_pos, i, para[std::move(k)]);
 	}
 	else if (i > cur_word_start_pos)
 	{
-		para[UrlDecode(para_str.substr(cur_word_start_pos, i - cur_word_start_pos))] = std::string();
+		std::string key;
+		DecodeParamPart(para_str, cur_word_start_pos, i, key);
+		para[std::move(key)].clear();
 	}
 
 	return para;
@@ -159,7 +327,8 @@ Http::Param Http::ParseHttpParam(const std::string para_str)
 // HttpParam转换为string
 std::string Http::HttpParamToString(const Http::Param & para)
 {
-	std::ostringstream oss;
+	std::string result;
+	bool first = true;
 
 	for (Http::Param::const_iterator it = para.begin(); it != para.end(); it++)
 	{
@@ -168,14 +337,55 @@ std::string Http::HttpParamToString(const Http::Param & para)
 			continue;
 		}
 
-		if (it != para.begin())
+		if (!first)
 		{
-			oss << '&';
+			result.push_back('&');
 		}
-		oss << UrlEncode(it->first) << '=' << UrlEncode(it->second);
+		first = false;
+
+		UrlEncode(it->first.data(), it->first.length(), result);
+		result.push_back('=');
+		UrlEncode(it->second.data(), it->second.length(), result);
 	}
 
-	return oss.str();
+	return result;
+}
+
+const std::string & Http::GetCurrentDate()
+{
+	static const char * kWeekDays[] = { "Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat" };
+	static const char * kMonths[] = { "Jan", "Feb", "Mar", "Apr", "May", "Jun", "Jul", "Aug", "Sep", "Oct", "Nov", "Dec" };
+	static thread_local int64_t cached_time = -1;
+	static thread_local std::string cached_date;
+
+	int64_t now = TimeHelper::GetEpochSeconds();
+	if (now == cached_time)
+	{
+		return cached_date;
+	}
+	cached_time = now;
+
+	int64_t days = now / TimeHelper::kOneDaySeconds;
+	int32_t secs = (int32_t)(now % TimeHelper::kOneDaySeconds);
+	int32_t week_day = (int32_t)((days + 4) % 7);     // 1970-01-01为星期四
+
+	// 由天数计算公历日期(以3月1日为一年的开始，闰日在年末)
+	int64_t z = days + 719468;
+	int64_t era = z / 146097;
+	int64_t day_of_era = z - era * 146097;
+	int64_t year_of_era = (day_of_era - day_of_era / 1460 + day_of_era / 36524 - day_of_era / 146096) / 365;
+	int64_t day_of_year = day_of_era - (365 * year_of_era + year_of_era / 4 - year_of_era / 100);
+	int64_t mp = (5 * day_of_year + 2) / 153;
+	int32_t day = (int32_t)(day_of_year - (153 * mp + 2) / 5 + 1);
+	int32_t month = (int32_t)(mp < 10 ? mp + 3 : mp - 9);
+	int32_t year = (int32_t)(year_of_era + era * 400 + (month <= 2 ? 1 : 0));
+
+	char buf[64];
+	int len = snprintf(buf, sizeof(buf), "%s, %02d %s %04d %02d:%02d:%02d GMT", kWeekDays[week_day], day, kMonths[month - 1], year,
+		secs / 3600, secs / 60 % 60, secs % 60);
+	cached_date.assign(buf, len > 0 ? (size_t)len : 0);
+
+	return cached_date;
 }
 
 
@@ -209,11 +419,22 @@ const std::vector<std::string> & Http::GetHeaders(const std::string & key) const
 
 void Http::SetHeader(const std::string & key, const std::string &value)
 {
-	std::string standardized_key = StandardizeHeaderKey(Trim(key));
-	if (!standardized_key.empty())
+	const char * k = key.data();
+	size_t k_len = key.length();
+	TrimSpace(k, k_len);
+	if (k_len == 0)
 	{
-		_header[standardized_key].push_back(Trim(value));
+		return;
 	}
+
+	const char * v = value.data();
+	size_t v_len = value.length();
+	TrimSpace(v, v_len);
+
+	std::string standardized_key;
+	standardized_key.reserve(k_len);
+	AppendStandardizedHeaderKey(k, k_len, standardized_key);
+	_header[std::move(standardized_key)].emplace_back(v, v_len);
 }
 
 const std::string & Http::GetContent() const
@@ -233,10 +454,17 @@ void Http::SetContent(std::string && data)
 
 std::string Http::ToString() const
 {
-	std::ostringstream oss;
+	std::string result;
+	WriteTo(result);
+	return result;
+}
+
+void Http::WriteTo(std::string & out) const
+{
 	bool have_conetnt_len = false;
+	bool need_date = GetHttpType() == kHttpType_Response;
+	size_t total_len = GetFirstLineLength() + 2 + _content.length();
 
-	WriteFirstLine(oss);
 	for (auto & pr : _header)
 	{
 		if (pr.first.empty())
@@ -245,30 +473,68 @@ std::string Http::ToString() const
 			continue;
 		}
 
-		if (pr.first == "Content-Length" && !pr.second.empty())
+		if (pr.second.empty())
+		{
+			continue;
+		}
+
+		if (pr.first == "Content-Length")
 		{
 			have_conetnt_len = true;
 		}
+		else if (pr.first == "Date")
+		{
+			need_date = false;
+		}
 
 		for (const std::string & v : pr.second)
 		{
-			oss << pr.first << ": " << v << "\r\n";
+			total_len += pr.first.length() + 2 + v.length() + 2;
 		}
 	}
 
+	const std::string * date = need_date ? &GetCurrentDate() : nullptr;
+	if (date)
+	{
+		total_len += 6 + date->length() + 2;
+	}
+
+	char content_len_str[24];
+	size_t content_len_str_len = 0;
 	if (!have_conetnt_len)
 	{
-		oss << "Content-Length: " << _content.length() << "\r\n";
+		content_len_str_len = FormatInteger((int64_t)_content.length(), content_len_str);
+		total_len += 16 + content_len_str_len + 2;
+	}
+
+	out.reserve(out.length() + total_len);
+
+	WriteFirstLine(out);
+	for (auto & pr : _header)
+	{
+		if (pr.first.empty())
+		{
+			continue;
+		}
+
+		for (const std::string & v : pr.second)
+		{
+			out.append(pr.first).append(": ", 2).append(v).append("\r\n", 2);
+		}
 	}
 
-	oss << "\r\n";
+	if (date)
+	{
+		out.append("Date: ", 6).append(*date).append("\r\n", 2);
+	}
 
-	if (!_content.empty())
+	if (!have_conetnt_len)
 	{
-		oss << _content;
+		out.append("Content-Length: ", 16).append(content_len_str, content_len_str_len).append("\r\n", 2);
 	}
 
-	return oss.str();
+	out.append("\r\n", 2);
+	out.append(_content);
 }
 
 
@@ -328,15 +594,34 @@ const std::string & HttpRequest::GetProtoVersion() const
 	return _proto_ver;
 }
 
-void HttpRequest::WriteFirstLine(std::ostringstream & oss) const
+bool HttpRequest::IsKeepAlive() const
+{
+	const std::string & conn = GetHeader("Connection");
+	if (_proto_ver == "HTTP/1.0")
+	{
+		return HaveHeaderToken(conn, "keep-alive");
+	}
+
+	return !HaveHeaderToken(conn, "close");
+}
+
+size_t HttpRequest::GetFirstLineLength() const
+{
+	return _method.length() + 1 + _req_url.length() + (_req_param.empty() ? 0 : 1 + _req_param.length()) + 1 + _proto_ver.length() + 2;
+}
+
+void HttpRequest::WriteFirstLine(std::string & out) const
 {
 	assert(!_method.empty() && !_req_url.empty() && !_proto_ver.empty());
-	oss << _method << ' ' << _req_url;
+	out.append(_method).push_back(' ');
+	out.append(_req_url);
 	if (!_req_param.empty())
 	{
-		oss << '?' << _req_param;
+		out.push_back('?');
+		out.append(_req_param);
 	}
-	oss << ' ' << _proto_ver << "\r\n";
+	out.push_back(' ');
+	out.append(_proto_ver).append("\r\n", 2);
 }
 
 
@@ -372,30 +657,30 @@ const std::string & HttpResponse::GetStatusDesc() const
 	return _status_desc;
 }
 
-void HttpResponse::WriteFirstLine(std::ostringstream & oss) const
+size_t HttpResponse::GetFirstLineLength() const
+{
+	char buf[24];
+	return (_proto_ver.empty() ? 0 : _proto_ver.length() + 1) + FormatInteger(_status_code, buf) + 1 + _status_desc.length() + 2;
+}
+
+void HttpResponse::WriteFirstLine(std::string & out) const
 {
 	assert(!_proto_ver.empty() && !_status_desc.empty());
 	if (!_proto_ver.empty())
 	{
-		oss << _proto_ver << ' ';
+		out.append(_proto_ver).push_back(' ');
 	}
-	oss << _status_code << ' ' << _status_desc << "\r\n";
+
+	char buf[24];
+	out.append(buf, FormatInteger(_status_code, buf)).push_back(' ');
+	out.append(_status_desc).append("\r\n", 2);
 }
 
 
 
-HttpDecoder::HttpDecoder(int32_t http_type) : _http_type(http_type), _state(kDecodeState_FirstLine), _remain_content_len(0)
+HttpDecoder::HttpDecoder(int32_t http_type) : _http_type(http_type)
 {
-	if (_http_type == kHttpType_Request)
-	{
-		_http_request = std::make_shared<HttpRequest>();
-	}
-	else
-	{
-		_http_response = std::make_shared<HttpResponse>();
-	}
-
-	_data_list.reserve(32);
+	Reset();
 }
 
 void HttpDecoder::Reset()
@@ -409,70 +694,50 @@ void HttpDecoder::Reset()
 	{
 		_http_response = std::make_shared<HttpResponse>();
 	}
+	_content_state = kContentState_Length;
 	_remain_content_len = 0;
-	_data_list.clear();
+	_scan_pos = 0;
+	_head_len = 0;
 }
 
 size_t HttpDecoder::Decode(const char * data, size_t len, std::string & err_msg)
 {
 	size_t readed = 0;
-	bool conn = true;
 
-	while (conn)
+	while (_state != kDecodeState_Completed)
 	{
+		int32_t last_state = _state;
 		size_t tmp = 0;
-		conn = false;
 
 		switch (_state)
 		{
 		case kDecodeState_FirstLine:
 			tmp = DecodeFirstLine(data + readed, len - readed, err_msg);
-			readed += tmp;
-			assert(readed <= len);
-			if (!err_msg.empty())
-			{
-				return readed;
-			}
-
-			if (_state == kDecodeState_HttpHeader)
-			{
-				conn = len > readed ? true : false;
-			}
-			else
-			{
-				assert(_state == kDecodeState_FirstLine);
-			}
-
 			break;
 
 		case kDecodeState_HttpHeader:
 			tmp = DecodeHttpHeader(data + readed, len - readed, err_msg);
-			readed += tmp;
-			assert(readed <= len);
-			if (!err_msg.empty())
-			{
-				return readed;
-			}
-
-			if (_state == kDecodeState_Content)
-			{
-				conn = len > readed ? true : false;
-			}
-			else
-			{
-				assert(_state == kDecodeState_HttpHeader || _state == kDecodeState_Completed);
-			}
-
 			break;
 
 		case kDecodeState_Content:
 			tmp = DecodeContent(data + readed, len - readed, err_msg);
-			readed += tmp;
-			assert(readed <= len);
-			if (!err_msg.empty())
-			{
-				return readed;
-			}
+			break;
+
+		default:
+			assert(false);
+			break;
+		}
+
+		readed += tmp;
+		assert(readed <= len);
+		if (!err_msg.empty())
+		{
+			return readed;
+		}
+
+		// 数据不够
+		if (tmp == 0 && _state == last_state)
+		{
 			break;
 		}
 	}
@@ -480,109 +745,126 @@ size_t HttpDecoder::Decode(const char * data, size_t len, std::string & err_msg)
 	return readed;
 }
 
-struct StrLocation
+bool HttpDecoder::FindLine(const char * data, size_t len, size_t & line_len, size_t & next)
 {
-	size_t start_index;
-	size_t len;
-};
+	if (_scan_pos > len)
+	{
+		_scan_pos = 0;
+	}
 
-size_t HttpDecoder::DecodeFirstLine(const char * data, size_t len, std::string & err_msg)
-{
-	if (_state != kDecodeState_FirstLine)
+	const char * lf = (const char *)memchr(data + _scan_pos, '\n', len - _scan_pos);
+	if (lf == nullptr)
+	{
+		_scan_pos = len;
+		return false;
+	}
+
+	_scan_pos = 0;
+	next = (size_t)(lf - data) + 1;
+	line_len = next - 1;
+	if (line_len > 0 && data[line_len - 1] == '\r')
 	{
-		assert(false);
-		return 0;
+		line_len--;
 	}
 
-	StrLocation loc_word1 = { 0 };
-	StrLocation loc_word2 = { 0 };
-	StrLocation loc_word3 = { 0 };
-	int cur_read = 0;   //正在读什么, 0.请求方法, 1.URL, 2. 协议版本, 3. 完成
+	return true;
+}
+
+size_t HttpDecoder::DecodeFirstLine(const char * data, size_t len, std::string & err_msg)
+{
+	assert(_state == kDecodeState_FirstLine);
+
 	size_t readed = 0;
+	size_t line_len = 0;
+	size_t next = 0;
 
-	for (size_t i = 0; i < len; i++)
+	// 跳过首行前的空行
+	while (true)
 	{
-		if (data[i] == ' ')
+		if (!FindLine(data + readed, len - readed, line_len, next))
 		{
-			switch (cur_read)
+			if (_head_len + len > kMaxHeadLength)
 			{
-			case 0:
-				loc_word1.len = i;
-				if (loc_word1.len == 0)
-				{
-					err_msg = "http first line error";
-					return 0;
-				}
-				loc_word2.start_index = i + 1;
-				cur_read = 1;
-				break;
-			case 1:
-				loc_word2.len = i - loc_word2.start_index;
-				if (loc_word2.len == 0)
-				{
-					err_msg = "http first line error";
-					return 0;
-				}
-				loc_word3.start_index = i + 1;
-				cur_read = 2;
-				break;
+				err_msg = "http head too large";
 			}
+			return readed;
 		}
-		else if (data[i] == '\r' && i + 1 < len && data[i + 1] == '\n')
-		{
-			if (cur_read != 2)
-			{
-				err_msg = "http first line error";
-				return 0;
-			}
 
-			loc_word3.len = i - loc_word3.start_index;
-			if (loc_word2.len == 0)
-			{
-				err_msg = "http first line error";
-				return 0;
-			}
-
-			cur_read = 3;
-			readed = i + 2;
+		if (line_len > 0)
+		{
 			break;
 		}
+		readed += next;
 	}
 
-	assert(cur_read >= 0 && cur_read <= 3);
-	if (cur_read < 3)
+	const char * line = data + readed;
+	readed += next;
+	_head_len += next;
+
+	// 按前两个空格分为三部分，第三部分可以包含空格
+	const char * sp1 = (const char *)memchr(line, ' ', line_len);
+	const char * sp2 = sp1 ? (const char *)memchr(sp1 + 1, ' ', line_len - (sp1 + 1 - line)) : nullptr;
+	if (sp1 == nullptr || sp2 == nullptr || sp1 == line || sp2 == sp1 + 1)
 	{
-		return 0;
+		err_msg = "http first line error";
+		return readed;
 	}
 
-	assert(readed > 0);
+	const char * word1 = line;
+	size_t word1_len = (size_t)(sp1 - line);
+	const char * word2 = sp1 + 1;
+	size_t word2_len = (size_t)(sp2 - word2);
+	const char * word3 = sp2 + 1;
+	size_t word3_len = line_len - (size_t)(word3 - line);
 
 	if (_http_type == kHttpType_Request)
 	{
 		assert(_http_request);
+		HttpRequest & req = *_http_request;
 
-		_http_request->SetMethod(std::string(data + loc_word1.start_index, loc_word1.len));
+		req._method.assign(word1, word1_len);
+		for (char & c : req._method)
+		{
+			c = (c >= 'a' && c <= 'z') ? c - ('a' - 'A') : c;
+		}
 
-		std::string url_str(data + loc_word2.start_index, loc_word2.len);
-		size_t param_pos = url_str.find('?');
-		if (param_pos == std::string::npos)
+		const char * param = (const char *)memchr(word2, '?', word2_len);
+		size_t url_len = param ? (size_t)(param - word2) : word2_len;
+		req._req_url.clear();
+		if (url_len == 0 || word2[0] != '/')
 		{
-			_http_request->SetRequestUrl(url_str);
+			req._req_url.push_back('/');
 		}
-		else
+		req._req_url.append(word2, url_len);
+		if (param)
 		{
-			_http_request->SetRequestUrl(url_str.substr(0, param_pos));
-			_http_request->SetRequestParam(url_str.substr(param_pos + 1));
+			req._req_param.assign(param + 1, word2_len - url_len - 1);
 		}
 
-		_http_request->SetProtoVersion(std::string(data + loc_word3.start_index, loc_word3.len));
+		if (word3_len > 0)
+		{
+			req._proto_ver.assign(word3, word3_len);
+		}
 	}
 	else
 	{
 		assert(_http_response);
-		_http_response->SetProtoVersion(std::string(data + loc_word1.start_index, loc_word1.len));
-		_http_response->SetStatusCode(StrToAny<int32_t>(std::string(data + loc_word2.start_index, loc_word2.len)));
-		_http_response->SetStatusDesc(std::string(data + loc_word3.start_index, loc_word3.len));
+		HttpResponse & resp = *_http_response;
+
+		int32_t status_code = 0;
+		for (size_t i = 0; i < word2_len; i++)
+		{
+			if (word2[i] < '0' || word2[i] > '9' || i >= 3)
+			{
+				err_msg = "http status code error";
+				return readed;
+			}
+			status_code = status_code * 10 + (word2[i] - '0');
+		}
+
+		resp._proto_ver.assign(word1, word1_len);
+		resp._status_code = status_code;
+		resp._status_desc.assign(word3, word3_len);
 	}
 
 	// 转换状态为解析请求头部
@@ -593,236 +875,242 @@ size_t HttpDecoder::DecodeFirstLine(const char * data, size_t len, std::string &
 
 size_t HttpDecoder::DecodeHttpHeader(const char * data, size_t len, std::string & err_msg)
 {
-	if (_state != kDecodeState_HttpHeader)
-	{
-		assert(false);
-		return 0;
-	}
+	assert(_state == kDecodeState_HttpHeader);
 
+	Http & http = GetHttp();
 	size_t readed = 0;
+	size_t line_len = 0;
+	size_t next = 0;
 
-	while (readed < len)
+	while (FindLine(data + readed, len - readed, line_len, next))
 	{
 		const char * p = data + readed;
-		int32_t remain_len = (int32_t)(len - readed);
-		int32_t line_len = FindFirstSubstr(p, remain_len, "\r\n");
-		if (line_len < 0)
+		readed += next;
+		_head_len += next;
+		if (_head_len > kMaxHeadLength)
 		{
-			break;
+			err_msg = "http head too large";
+			return readed;
 		}
 
-		readed += (line_len + 2);
-
-		if (line_len > 0)
+		if (line_len == 0)
 		{
-			int32_t kv_sep_pos = FindFirstSubstr(p, line_len, ":");
-			if (kv_sep_pos < 0)
-			{
-				continue;
-			}
-
-			std::string k = std::string(p, kv_sep_pos);
-			std::string v = std::string(p + kv_sep_pos + 1, line_len - (kv_sep_pos + 1));
-			if (!k.empty())
-			{
-				if (_http_type == kHttpType_Request)
-				{
-					assert(_http_request);
-					_http_request->SetHeader(k, v);
-				}
-				else
-				{
-					assert(_http_response);
-					_http_response->SetHeader(k, v);
-				}
-			}
+			// 空行, 解析头部结束，确定是否有数据部分
+			OnHeadCompleted(err_msg);
+			return readed;
 		}
-		else
+
+		const char * colon = (const char *)memchr(p, ':', line_len);
+		if (colon == nullptr)
 		{
-			// 空行, 解析头部结束，确定是否有数据部分
-			const std::string trans_encoding = ToLower(GetHeader("Transfer-Encoding"));
-			if (trans_encoding == "chunked")
-			{
-				_state = kDecodeState_Content;
-				_remain_content_len = -1;
-			}
-			else
-			{
-				const std::string & content_len_str = GetHeader("Content-Length");
-				if (content_len_str.empty())
-				{
-					if (_http_type == kHttpType_Request)
-					{
-						_state = kDecodeState_Completed;
-					}
-					else
-					{
-						_state = kDecodeState_Content;
-						_remain_content_len = -2;
-					}
-				}
-				else
-				{
-					_remain_content_len = std::max(0, StrToAny<int32_t>(content_len_str));
-					if (_remain_content_len > 0)
-					{
-						_state = kDecodeState_Content;
-					}
-					else
-					{
-						_state = kDecodeState_Completed;
-					}
-				}
-			}
+			continue;
+		}
 
-			// 退出循环
-			break;
+		const char * k = p;
+		size_t k_len = (size_t)(colon - p);
+		const char * v = colon + 1;
+		size_t v_len = line_len - k_len - 1;
+		TrimSpace(k, k_len);
+		TrimSpace(v, v_len);
+		if (k_len == 0)
+		{
+			continue;
 		}
+
+		std::string key;
+		key.reserve(k_len);
+		AppendStandardizedHeaderKey(k, k_len, key);
+		http._header[std::move(key)].emplace_back(v, v_len);
+	}
+
+	if (_head_len + (len - readed) > kMaxHeadLength)
+	{
+		err_msg = "http head too large";
 	}
 
 	return readed;
 }
 
-
-size_t HttpDecoder::DecodeContent(const char * data, size_t len, std::string & err_msg)
+void HttpDecoder::OnHeadCompleted(std::string & err_msg)
 {
-	if (_state != kDecodeState_Content)
+	Http & http = GetHttp();
+
+	if (HaveHeaderToken(http.GetHeader("Transfer-Encoding"), "chunked"))
 	{
-		assert(false);
-		return 0;
+		_state = kDecodeState_Content;
+		_content_state = kContentState_ChunkSize;
+		return;
 	}
 
-	size_t readed = 0;
+	const std::string & content_len_str = http.GetHeader("Content-Length");
+	if (content_len_str.empty())
+	{
+		if (_http_type == kHttpType_Request)
+		{
+			_state = kDecodeState_Completed;
+		}
+		else
+		{
+			_state = kDecodeState_Content;
+			_content_state = kContentState_UntilClose;
+		}
+		return;
+	}
 
-	if (_remain_content_len > 0)
+	size_t content_len = 0;
+	for (size_t i = 0; i < content_len_str.length(); i++)
 	{
-		readed = std::min(len, (size_t)_remain_content_len);
-		if (readed > 0)
+		char c = content_len_str[i];
+		if (c < '0' || c > '9' || i >= 18)
 		{
-			_data_list.push_back(std::string(data, readed));
-			_remain_content_len -= (int32_t)readed;
+			err_msg = "http content length error";
+			return;
 		}
+		content_len = content_len * 10 + (c - '0');
+	}
+
+	if (content_len == 0)
+	{
+		_state = kDecodeState_Completed;
+		return;
 	}
-	else if (_remain_content_len == -1)
+
+	_state = kDecodeState_Content;
+	_content_state = kContentState_Length;
+	_remain_content_len = content_len;
+	http._content.reserve(content_len < kMaxHeadLength ? content_len : kMaxHeadLength);
+}
+
+size_t HttpDecoder::DecodeContent(const char * data, size_t len, std::string & err_msg)
+{
+	assert(_state == kDecodeState_Content);
+
+	std::string & content = GetHttp()._content;
+	size_t readed = 0;
+	size_t line_len = 0;
+	size_t next = 0;
+
+	while (_state == kDecodeState_Content)
 	{
-		size_t surplus = len;
-		const char * p = data;
+		const char * p = data + readed;
+		size_t remain = len - readed;
 
-		while (surplus > 2)
+		switch (_content_state)
+		{
+		case kContentState_Length:
+		case kContentState_ChunkData:
 		{
-			// 块的长度
-			uint32_t chunk_len = 0;
-			char chunk_len_str[9];
-			int chunk_len_str_len = 0;
+			size_t n = std::min(remain, _remain_content_len);
+			content.append(p, n);
+			readed += n;
+			_remain_content_len -= n;
+			if (_remain_content_len > 0)
+			{
+				return readed;
+			}
 
-			while (surplus >= 2 && !(p[0] == '\r' && p[1] == '\n'))
+			if (_content_state == kContentState_Length)
+			{
+				_state = kDecodeState_Completed;
+			}
+			else
+			{
+				_content_state = kContentState_ChunkDataEnd;
+			}
+		}
+		break;
+
+		case kContentState_ChunkSize:
+		{
+			if (!FindLine(p, remain, line_len, next))
 			{
-				if (chunk_len_str_len < ((int)sizeof(chunk_len_str) - 1))
+				if (remain > 1024)
 				{
-					chunk_len_str[chunk_len_str_len++] = p[0];
+					err_msg = "http chunk size error";
 				}
-				surplus--;
-				p++;
+				return readed;
 			}
 
-			// 长度是否读取完全
-			if (surplus < 2 || !(p[0] == '\r' && p[1] == '\n'))
+			// 长度为十六进制，后面可以有扩展(;开始)
+			size_t chunk_len = 0;
+			size_t digits = 0;
+			for (; digits < line_len; digits++)
 			{
-				break;
+				char c = p[digits];
+				int32_t v = (c >= '0' && c <= '9') ? c - '0' : (c >= 'a' && c <= 'f') ? c - 'a' + 10 : (c >= 'A' && c <= 'F') ? c - 'A' + 10 : -1;
+				if (v < 0)
+				{
+					break;
+				}
+				chunk_len = chunk_len * 16 + (size_t)v;
 			}
 
-			surplus -= 2;
-			p += 2;
-
-			// 转换chunk_len
-			if (chunk_len_str_len > 0)
+			if (digits == 0 || digits > 15 || (digits < line_len && p[digits] != ';' && p[digits] != ' ' && p[digits] != '\t'))
 			{
-				chunk_len_str[chunk_len_str_len] = 0;
-				chunk_len = (uint32_t)strtol(chunk_len_str, nullptr, 16);
+				err_msg = "http chunk size error";
+				return readed;
 			}
 
-			// 数据若不够
-			if (surplus < chunk_len + 2)
+			readed += next;
+			_remain_content_len = chunk_len;
+			_content_state = chunk_len > 0 ? kContentState_ChunkData : kContentState_Trailer;
+		}
+		break;
+
+		case kContentState_ChunkDataEnd:
+			if (!FindLine(p, remain, line_len, next))
 			{
-				break;
+				if (remain >= 2)
+				{
+					err_msg = "http chunk data error";
+				}
+				return readed;
 			}
 
-			if (chunk_len > 0)
+			if (line_len != 0)
 			{
-				_data_list.push_back(std::string(p, chunk_len));
+				err_msg = "http chunk data error";
+				return readed;
 			}
 
-			readed += (chunk_len_str_len + 2 + chunk_len + 2);
-			surplus -= (chunk_len + 2);
-			p += (chunk_len + 2);
+			readed += next;
+			_content_state = kContentState_ChunkSize;
+			break;
 
-			// chunk_len 为0，表是为结尾的chunk
-			if (chunk_len == 0)
+		case kContentState_Trailer:
+			// 忽略尾部字段，空行结束
+			if (!FindLine(p, remain, line_len, next))
 			{
-				_remain_content_len = 0; // 读取完成
-				break;
+				if (remain > kMaxHeadLength)
+				{
+					err_msg = "http chunk trailer too large";
+				}
+				return readed;
 			}
-		}
-	}
-	else if (_remain_content_len == -2)
-	{
-		if (len > 0)
-		{
-			readed = len;
-			_data_list.push_back(std::string(data, readed));
-		}
-		else
-		{
-			_remain_content_len = 0;    // 内容读取结束
-		}
-	}
-	else
-	{
-		assert(false);
-	}
 
-	// 数据部分是否完成
-	if (_remain_content_len == 0)
-	{
-		_state = kDecodeState_Completed;
-		size_t all_len = 0;
-		for (const std::string & s : _data_list)
-		{
-			assert(!s.empty());
-			all_len += s.size();
-		}
+			readed += next;
+			if (line_len == 0)
+			{
+				_state = kDecodeState_Completed;
+			}
+			break;
 
-		std::string content;
-		assert(all_len > 0);
-		content.reserve(all_len);
-		for (const std::string & s : _data_list)
-		{
-			content.append(s);
-		}
+		case kContentState_UntilClose:
+			if (len == 0)
+			{
+				// 连接关闭，内容读取结束
+				_state = kDecodeState_Completed;
+				return readed;
+			}
 
-		if (_http_type == kHttpType_Request)
-		{
-			assert(_http_request);
-			_http_request->SetContent(std::move(content));
-		}
-		else
-		{
-			assert(_http_response);
-			_http_response->SetContent(std::move(content));
+			content.append(p, remain);
+			return len;
+
+		default:
+			assert(false);
+			return readed;
 		}
 	}
 
 	return readed;
 }
-
-const std::string & HttpDecoder::GetHeader(const std::string & k)
-{
-	if (_http_type == kHttpType_Request)
-	{
-		assert(_http_request);
-		return _http_request->GetHeader(k);
-	}
-
-	assert(_http_response);
-	return _http_response->GetHeader(k);
-}
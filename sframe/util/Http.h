@@ -32,15 +32,24 @@ public:
 	// URL编码
 	static std::string UrlEncode(const std::string & str);
 
+	// URL编码，追加到out
+	static void UrlEncode(const char * str, size_t len, std::string & out);
+
 	// URL解码
 	static std::string UrlDecode(const std::string & str);
 
+	// URL解码，追加到out(不合法的%编码原样保留)
+	static void UrlDecode(const char * str, size_t len, std::string & out);
+
 	// 解析HTTP参数
 	static Http::Param ParseHttpParam(const std::string para_str);
 
 	// HttpParam转换为string
 	static std::string HttpParamToString(const Http::Param & para);
 
+	// 当前时间的HTTP日期(如"Sun, 06 Nov 1994 08:49:37 GMT")，每个线程缓存，每秒更新一次
+	static const std::string & GetCurrentDate();
+
 
 
 	Http() {}
@@ -63,9 +72,15 @@ public:
 
 	std::string ToString() const;
 
+	// 序列化，追加到out(先计算总长度，只分配一次)；响应没有设置Date时写入当前时间
+	void WriteTo(std::string & out) const;
+
 private:
+	friend class HttpDecoder;
+
+	virtual size_t GetFirstLineLength() const = 0;
 
-	virtual void WriteFirstLine(std::ostringstream & oss) const = 0;
+	virtual void WriteFirstLine(std::string & out) const = 0;
 
 protected:
 	Header _header;
@@ -101,9 +116,15 @@ public:
 
 	const std::string & GetProtoVersion() const;
 
+	// 是否保持连接(HTTP/1.1默认保持，除非Connection为close；HTTP/1.0需要Connection为keep-alive)
+	bool IsKeepAlive() const;
+
 private:
+	friend class HttpDecoder;
+
+	size_t GetFirstLineLength() const override;
 
-	void WriteFirstLine(std::ostringstream & oss) const override;
+	void WriteFirstLine(std::string & out) const override;
 
 private:
 	std::string _method;
@@ -138,8 +159,11 @@ public:
 	const std::string & GetStatusDesc() const;
 
 private:
+	friend class HttpDecoder;
 
-	void WriteFirstLine(std::ostringstream & oss) const override;
+	size_t GetFirstLineLength() const override;
+
+	void WriteFirstLine(std::string & out) const override;
 
 private:
 	std::string _proto_ver;
@@ -148,6 +172,11 @@ private:
 };
 
 
+/*
+	HTTP增量解析器
+	直接在接收缓冲区上查找行尾和分隔符，只为最终保存的首行、头部和内容创建字符串；没有完整的行时记下已查找的位置，数据到达后不重复查找
+	解析完一个请求(响应)即返回，缓冲区中剩余的数据(管线化的请求)在Reset后继续解析，支持定长、chunked和读到连接关闭的内容
+*/
 class HttpDecoder
 {
 public:
@@ -160,6 +189,8 @@ public:
 		kDecodeState_Completed = 3,       // 解析完成
 	};
 
+	static const size_t kMaxHeadLength = 64 * 1024;       // 首行和头部的最大长度
+
 	void Reset();
 
 	bool IsDecodeCompleted() const
@@ -175,7 +206,8 @@ public:
 	}
 
 	// 解析
-	// 返回解析了的有效数据数据的长度
+	// 返回解析了的有效数据数据的长度，没有解析的数据下次需要放在data开头重新传入；解析完成一个后即返回，剩余的数据在Reset后继续解析
+	// 内容读到连接关闭的响应，在连接关闭时以len为0调用来结束
 	size_t Decode(const char * data, size_t len, std::string & err_msg);
 
 protected:
@@ -195,21 +227,43 @@ protected:
 	}
 
 private:
+	// 内容部分的解析状态
+	enum ContentState
+	{
+		kContentState_Length = 0,         // 定长
+		kContentState_ChunkSize = 1,      // chunk长度行
+		kContentState_ChunkData = 2,      // chunk数据
+		kContentState_ChunkDataEnd = 3,   // chunk数据后的换行
+		kContentState_Trailer = 4,        // 最后一个chunk后的尾部
+		kContentState_UntilClose = 5,     // 读到连接关闭
+	};
+
+	// 查找一行(以\n结束，去掉\r)，找到时返回true，line_len为行的长度，next为下一行的开始
+	bool FindLine(const char * data, size_t len, size_t & line_len, size_t & next);
+
 	size_t DecodeFirstLine(const char * data, size_t len, std::string & err_msg);
 
 	size_t DecodeHttpHeader(const char * data, size_t len, std::string & err_msg);
 
 	size_t DecodeContent(const char * data, size_t len, std::string & err_msg);
 
-	const std::string & GetHeader(const std::string & k);
+	// 头部解析完成，确定内容的长度
+	void OnHeadCompleted(std::string & err_msg);
+
+	Http & GetHttp()
+	{
+		return _http_type == kHttpType_Request ? (Http &)*_http_request : (Http &)*_http_response;
+	}
 
 private:
 	int32_t _http_type;
 	std::shared_ptr<HttpRequest> _http_request;
 	std::shared_ptr<HttpResponse> _http_response;
 	int32_t _state;
-	int32_t _remain_content_len;      // -1.chunked不确定长度; -2.内容知道连接关闭才读完; >0.定长
-	std::vector<std::string> _data_list;
+	int32_t _content_state;
+	size_t _remain_content_len;       // 定长内容或当前chunk剩余的长度
+	size_t _scan_pos;                 // 未解析的数据中已经查找过行尾的长度
+	size_t _head_len;                 // 已解析的首行和头部的长度
 };
 
 class HttpRequestDecoder : public HttpDecoder
@@ -98,6 +98,18 @@ private:
 
 #define AUTO_LOCK(_lc) sframe::AutoLock l((_lc))
 
+// 自旋等待时提示CPU(降低功耗，让出超线程的执行资源)
+inline void CpuRelax()
+{
+#ifndef __GNUC__
+	YieldProcessor();
+#elif defined(__x86_64__) || defined(__i386__)
+	__builtin_ia32_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+	__asm__ __volatile__("yield");
+#endif
+}
+
 }
 
 #endif
\ No newline at end of file
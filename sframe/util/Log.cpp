@@ -1,34 +1,75 @@
 ﻿
 #include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
 #include <algorithm>
 #include <iostream>
+#ifndef __GNUC__
+#include <io.h>
+#else
+#include <unistd.h>
+#include <sys/uio.h>
+#endif
 #include "Log.h"
+#include "BinaryLog.h"
 #include "TimeHelper.h"
 
 using namespace sframe;
 
-Logger::Logger(const std::string & log_name) 
-	: _file(nullptr), _open_file_time(0), _log_file_time(0), _log_name(log_name), _waiting_flush(false)
+static inline char * WriteTwoDigits(char * p, int32_t v)
 {
-	_write_log_buffer = new std::vector<LogDataChunk*>();
-	_write_log_buffer->reserve(4);
-	_flush_log_buffer = new std::vector<LogDataChunk*>();
-	_flush_log_buffer->reserve(4);
+	p[0] = (char)('0' + v / 10 % 10);
+	p[1] = (char)('0' + v % 10);
+	return p + 2;
 }
 
-Logger::~Logger()
+// 线程缓存的时间前缀(同一秒内的日志直接复制，跨秒时才重新格式化)
+struct LogTimePrefixCache
 {
-    if (_file)
-    {
-        fclose(_file);
-    }
+	LogTimePrefixCache() : seconds(-1), len(0) {}
 
-	for (LogDataChunk * chunk : (*_write_log_buffer))
+	// 格式：2017-01-02 03:04:05
+	void Refresh(int64_t cur_seconds)
 	{
-		delete chunk;
+		tm cur_tm;
+		TimeHelper::LocalTime(cur_seconds, &cur_tm);
+		int32_t year = cur_tm.tm_year + 1900;
+		char * p = text;
+		p = WriteTwoDigits(p, year / 100);
+		p = WriteTwoDigits(p, year % 100);
+		*(p++) = '-';
+		p = WriteTwoDigits(p, cur_tm.tm_mon + 1);
+		*(p++) = '-';
+		p = WriteTwoDigits(p, cur_tm.tm_mday);
+		*(p++) = ' ';
+		p = WriteTwoDigits(p, cur_tm.tm_hour);
+		*(p++) = ':';
+		p = WriteTwoDigits(p, cur_tm.tm_min);
+		*(p++) = ':';
+		p = WriteTwoDigits(p, cur_tm.tm_sec);
+		len = (int32_t)(p - text);
+		seconds = cur_seconds;
 	}
 
-	for (LogDataChunk * chunk : (*_flush_log_buffer))
+	int64_t seconds;
+	char text[32];
+	int32_t len;
+};
+
+
+Logger::Logger(const std::string & log_name) 
+	: _fd(-1), _check_file_time(0), _log_file_time(0), _file_dev(0), _file_ino(0), _log_name(log_name), _level(kLogLevel_None),
+	_overflow_policy(kLogOverflowPolicy_Default), _dropped_lines(0), _blocked_times(0), _reported_dropped_lines(0)
+{
+	_log_buffer.reserve(4);
+}
+
+Logger::~Logger()
+{
+	CloseLogFile();
+
+	for (LogDataChunk * chunk : _log_buffer)
 	{
 		delete chunk;
 	}
@@ -37,7 +78,7 @@ Logger::~Logger()
 // 写日志
 void Logger::Write(int64_t cur_time, const char * text, int32_t len)
 {
-	if (len <= 0 || !text || !LoggerMgr::Instance().IsRunning())
+	if (len <= 0 || !text)
 	{
 		return;
 	}
@@ -49,15 +90,15 @@ void Logger::Write(int64_t cur_time, const char * text, int32_t len)
 	{
 		LogDataChunk * cur_write_chunk = nullptr;
 
-		if (_write_log_buffer->empty())
+		if (_log_buffer.empty())
 		{
 			cur_write_chunk = new LogDataChunk();
-			_write_log_buffer->push_back(cur_write_chunk);
+			_log_buffer.push_back(cur_write_chunk);
 			cur_write_chunk->time = cur_time;
 		}
 		else
 		{
-			cur_write_chunk = *(_write_log_buffer->end() - 1);
+			cur_write_chunk = *(_log_buffer.end() - 1);
 			if (cur_write_chunk->cur_size > 0)
 			{
 				assert(cur_write_chunk->time > 0);
@@ -65,7 +106,7 @@ void Logger::Write(int64_t cur_time, const char * text, int32_t len)
 					!TimeHelper::IsInSameDay(cur_time, cur_write_chunk->time))
 				{
 					cur_write_chunk = new LogDataChunk();
-					_write_log_buffer->push_back(cur_write_chunk);
+					_log_buffer.push_back(cur_write_chunk);
 					cur_write_chunk->time = cur_time;
 				}
 			}
@@ -83,125 +124,259 @@ void Logger::Write(int64_t cur_time, const char * text, int32_t len)
 		p += write_len;
 		surplus_len -= write_len;
 	}
-
-	if (!_waiting_flush)
-	{
-		LoggerMgr::Instance().PushNeedFlushLogger(this);
-		_waiting_flush = true;
-	}
 }
 
 void Logger::Flush()
 {
-	static int flush_count = 0;
-	flush_count++;
-
+	if (!HaveData())
 	{
-		AUTO_LOCK(_lock);
-		assert(_waiting_flush);
-		// 交换写缓冲区和flush缓冲区
-		auto temp_buffer = _write_log_buffer;
-		_write_log_buffer = _flush_log_buffer;
-		_flush_log_buffer = temp_buffer;
+		return;
 	}
 
-	assert(!_flush_log_buffer->empty());
 	int64_t now = TimeHelper::GetEpochSeconds();
 
-	for (LogDataChunk * data_chunk : (*_flush_log_buffer))
+	// 同一天的数据块一次写入同一个文件
+	size_t begin = 0;
+	while (begin < _log_buffer.size() && _log_buffer[begin]->cur_size > 0)
+	{
+		size_t end = begin + 1;
+		while (end < _log_buffer.size() && _log_buffer[end]->cur_size > 0 &&
+			TimeHelper::IsInSameDay(_log_buffer[begin]->time, _log_buffer[end]->time))
+		{
+			end++;
+		}
+
+		WriteLogDataChunks(begin, end, now);
+		begin = end;
+	}
+
+	for (LogDataChunk * data_chunk : _log_buffer)
 	{
-		FlushLogDataChunk(data_chunk, now);
 		data_chunk->cur_size = 0;
 		data_chunk->time = 0;
 	}
 
 	// 只保留一个数据块
-	while (_flush_log_buffer->size() > 1)
+	while (_log_buffer.size() > 1)
 	{
-		LogDataChunk * data_chunk = (*(_flush_log_buffer->end() - 1));
+		LogDataChunk * data_chunk = (*(_log_buffer.end() - 1));
 		delete data_chunk;
-		_flush_log_buffer->pop_back();
+		_log_buffer.pop_back();
 	}
+}
 
+void Logger::WriteLogDataChunks(size_t begin, size_t end, int64_t now)
+{
+	assert(begin < end && end <= _log_buffer.size());
+	int64_t chunk_time = _log_buffer[begin]->time;
+	assert(chunk_time > 0);
+
+	if (_fd >= 0)
 	{
-		AUTO_LOCK(_lock);
-		if (IsWriteBufferHaveData())
+		assert(_log_file_time > 0);
+		// 时间不在同一天，需要打开新的文件
+		// 每秒最多检查一次文件是否被外部删除或者移走(如logrotate)，是的话重新打开
+		if (!TimeHelper::IsInSameDay(_log_file_time, chunk_time))
 		{
-			LoggerMgr::Instance().PushNeedFlushLogger(this);
-			_waiting_flush = true;
+			CloseLogFile();
 		}
-		else
+		else if (now != _check_file_time)
 		{
-			_waiting_flush = false;
+			_check_file_time = now;
+			if (IsLogFileChanged())
+			{
+				CloseLogFile();
+			}
 		}
 	}
-}
 
-
-
-void Logger::FlushLogDataChunk(LogDataChunk * data_chunk, int64_t now)
-{
-	if (data_chunk->cur_size <= 0)
+	if (_fd < 0 && !OpenLogFile(chunk_time, now))
 	{
-		assert(false);
 		return;
 	}
 
-	assert(data_chunk->time > 0);
-
-	if (_file)
+#ifndef __GNUC__
+	for (size_t i = begin; i < end; i++)
 	{
-		assert(_open_file_time > 0 && _log_file_time);
-		// 时间不在同一天，需要重新打开文件
-		// 打开文件时间超过5秒，重新打开一次，避免外部强制将文件删除了无法写入
-		if(!TimeHelper::IsInSameDay(_log_file_time, data_chunk->time) ||
-			now - _open_file_time >= 5)
+		const char * p = _log_buffer[i]->data;
+		int32_t surplus_len = _log_buffer[i]->cur_size;
+		while (surplus_len > 0)
 		{
-			fclose(_file);
-			_file = nullptr;
-			_open_file_time = 0;
-			_log_file_time = 0;
+			int n = _write(_fd, p, (unsigned int)surplus_len);
+			if (n <= 0)
+			{
+				return;
+			}
+			p += n;
+			surplus_len -= n;
 		}
 	}
+#else
+	static const int32_t kMaxIovCount = 64;
+	iovec iov[kMaxIovCount];
 
-	// 打开文件
-	if (_file == nullptr)
+	while (begin < end)
 	{
-		std::string full_file_name = LoggerMgr::Instance().GetLogDir() + GetLogFileName(data_chunk->time);
-		_file = fopen(full_file_name.c_str(), "a");
-		if (_file == nullptr)
+		int32_t iov_count = 0;
+		for (; begin < end && iov_count < kMaxIovCount; begin++, iov_count++)
 		{
-			std::cerr << "[ERROR] open log file(" << full_file_name << ") error" << std::endl;
-			return;
+			iov[iov_count].iov_base = _log_buffer[begin]->data;
+			iov[iov_count].iov_len = (size_t)_log_buffer[begin]->cur_size;
+		}
+
+		// 处理部分写入
+		iovec * cur_iov = iov;
+		while (iov_count > 0)
+		{
+			ssize_t n = writev(_fd, cur_iov, iov_count);
+			if (n < 0)
+			{
+				if (errno == EINTR)
+				{
+					continue;
+				}
+				std::cerr << "[ERROR] write log file(" << _file_path << ") error|" << errno << std::endl;
+				return;
+			}
+
+			while (iov_count > 0 && (size_t)n >= cur_iov->iov_len)
+			{
+				n -= cur_iov->iov_len;
+				cur_iov++;
+				iov_count--;
+			}
+
+			if (iov_count > 0)
+			{
+				cur_iov->iov_base = (char *)cur_iov->iov_base + n;
+				cur_iov->iov_len -= n;
+			}
 		}
+	}
+#endif
+}
 
-		_log_file_time = data_chunk->time;
-		_open_file_time = now;
+bool Logger::OpenLogFile(int64_t log_time, int64_t now)
+{
+	assert(_fd < 0);
+	_file_path = LoggerMgr::Instance().GetLogDir() + GetLogFileName(log_time);
+
+#ifndef __GNUC__
+	_fd = _open(_file_path.c_str(), _O_WRONLY | _O_APPEND | _O_CREAT | _O_BINARY, _S_IREAD | _S_IWRITE);
+#else
+	_fd = open(_file_path.c_str(), O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+#endif
+	if (_fd < 0)
+	{
+		std::cerr << "[ERROR] open log file(" << _file_path << ") error" << std::endl;
+		return false;
 	}
 
-	// 写入文件
-	if (fwrite(data_chunk->data, data_chunk->cur_size, 1, _file) > 0)
+	bool is_empty = false;
+#ifndef __GNUC__
+	struct _stat64 st;
+	if (_fstat64(_fd, &st) == 0)
 	{
-		fflush(_file);
+		is_empty = st.st_size == 0;
 	}
+#else
+	struct stat st;
+	if (fstat(_fd, &st) == 0)
+	{
+		_file_dev = (uint64_t)st.st_dev;
+		_file_ino = (uint64_t)st.st_ino;
+		is_empty = st.st_size == 0;
+	}
+#endif
+
+	_log_file_time = log_time;
+	_check_file_time = now;
+
+	OnLogFileOpened(is_empty);
+
+	return true;
 }
 
-bool Logger::IsWriteBufferHaveData()
+void Logger::CloseLogFile()
 {
-	if (_write_log_buffer->empty())
+	if (_fd >= 0)
 	{
-		return false;
+#ifndef __GNUC__
+		_close(_fd);
+#else
+		close(_fd);
+#endif
+		_fd = -1;
 	}
 
-	for (LogDataChunk * data_chunk : (*_write_log_buffer))
+	_log_file_time = 0;
+	_check_file_time = 0;
+	_file_dev = 0;
+	_file_ino = 0;
+}
+
+bool Logger::WriteFile(const char * data, size_t len)
+{
+	while (len > 0)
 	{
-		if (data_chunk->cur_size > 0)
+#ifndef __GNUC__
+		int n = _write(_fd, data, (unsigned int)len);
+#else
+		ssize_t n = write(_fd, data, len);
+		if (n < 0 && errno == EINTR)
 		{
-			return true;
+			continue;
 		}
+#endif
+		if (n <= 0)
+		{
+			std::cerr << "[ERROR] write log file(" << _file_path << ") error|" << errno << std::endl;
+			return false;
+		}
+		data += n;
+		len -= (size_t)n;
 	}
 
-	return false;
+	return true;
+}
+
+bool Logger::IsLogFileChanged() const
+{
+#ifndef __GNUC__
+	struct _stat64 st;
+	return _stat64(_file_path.c_str(), &st) != 0;
+#else
+	struct stat st;
+	if (stat(_file_path.c_str(), &st) != 0)
+	{
+		return true;
+	}
+
+	return (uint64_t)st.st_dev != _file_dev || (uint64_t)st.st_ino != _file_ino;
+#endif
+}
+
+bool Logger::WriteDroppedLinesReport(int64_t now)
+{
+	uint64_t dropped_lines = GetDroppedLines();
+	if (dropped_lines == _reported_dropped_lines)
+	{
+		return false;
+	}
+
+	LogTimePrefixCache time_prefix;
+	time_prefix.Refresh(now);
+	std::string text(time_prefix.text, time_prefix.len);
+	text.append("|WARN|Log|dropped ");
+	text.append(std::to_string(dropped_lines - _reported_dropped_lines));
+	text.append(" lines, total ");
+	text.append(std::to_string(dropped_lines));
+	text.append("\n");
+	_reported_dropped_lines = dropped_lines;
+
+	WriteReportText(now, text);
+
+	return true;
 }
 
 // 获取新的日志文件名
@@ -223,7 +398,7 @@ std::string Logger::GetLogFileName(int64_t cur_time)
 	char tail[256];
 	tm cur_tm;
 	TimeHelper::LocalTime(cur_time, &cur_tm);
-	sprintf(tail, "%04d%02d%02d.log", cur_tm.tm_year + 1900, cur_tm.tm_mon + 1, cur_tm.tm_mday);
+	sprintf(tail, "%04d%02d%02d%s", cur_tm.tm_year + 1900, cur_tm.tm_mon + 1, cur_tm.tm_mday, GetLogFileExtension());
 
 	if (!file_name.empty())
 	{
@@ -236,12 +411,24 @@ std::string Logger::GetLogFileName(int64_t cur_time)
 
 
 
+std::atomic<int32_t> LoggerMgr::s_log_level(kLogLevel_Begin);
+
+LoggerMgr::LoggerMgr() : _flush_log_thread(nullptr), _is_running(false), _show_milliseconds(false),
+	_thread_buffer_size(LogThreadBuffer::kDefaultCapacity), _overflow_policy(kLogOverflowPolicy_Block), _flush_signaled(false), _report_time(0)
+{
+	// 先构造二进制日志的格式登记表，保证它在日志管理器之后析构(退出时还要写入剩余的二进制日志)
+	BinaryLogFormatMgr::Instance();
+}
+
 LoggerMgr::~LoggerMgr()
 {
 	if (_is_running)
 	{
-		_is_running = false;
-		_wait_flush_logger_queue.Stop();
+		{
+			AUTO_LOCK(_flush_lock);
+			_is_running = false;
+			_flush_cond.WakeUpOne();
+		}
 		_flush_log_thread->join();
 		delete _flush_log_thread;
 	}
@@ -253,6 +440,14 @@ LoggerMgr::~LoggerMgr()
 			delete pr.second;
 		}
 	}
+
+	for (auto & pr : _binary_loggers)
+	{
+		if (pr.second)
+		{
+			delete pr.second;
+		}
+	}
 }
 
 void LoggerMgr::Initialize(const std::string & log_dir, const std::string & log_base_name)
@@ -318,69 +513,493 @@ Logger & LoggerMgr::GetLogger(const std::string & log_name)
 	return *it->second;
 }
 
+Logger * LoggerMgr::GetEnabledLogger(const std::string & log_name, LogLevel lv)
+{
+	Logger * logger = GetThreadBuffer().GetLogger(log_name);
+	int32_t level = logger->GetLevel();
+	if (level == kLogLevel_None)
+	{
+		level = GetLogLevel();
+	}
+
+	return (lv == kLogLevel_None ? kLogLevel_Error : lv) >= level ? logger : nullptr;
+}
+
+Logger & LoggerMgr::GetBinaryLogger(const std::string & log_name)
+{
+	AUTO_LOCK(_lock);
+
+	auto it = _binary_loggers.find(log_name);
+	if (it == _binary_loggers.end())
+	{
+		Logger * logger = new BinaryLogger(log_name);
+		assert(logger);
+		if (!_binary_loggers.insert(std::make_pair(log_name, logger)).second)
+		{
+			assert(false);
+		}
+
+		return *logger;
+	}
+
+	return *it->second;
+}
+
+Logger * LoggerMgr::GetEnabledBinaryLogger(const std::string & log_name)
+{
+	Logger * logger = GetThreadBuffer().GetBinaryLogger(log_name);
+	int32_t level = logger->GetLevel();
+	if (level == kLogLevel_None)
+	{
+		level = GetLogLevel();
+	}
+
+	return kLogLevel_Error >= level ? logger : nullptr;
+}
+
+void LoggerMgr::SetLoggerLevel(const std::string & log_name, int32_t level)
+{
+	GetLogger(log_name).SetLevel(level);
+}
+
+std::vector<std::pair<std::string, int32_t>> LoggerMgr::GetLoggerLevels()
+{
+	std::vector<std::pair<std::string, int32_t>> logger_levels;
+
+	AUTO_LOCK(_lock);
+
+	for (auto & pr : _loggers)
+	{
+		int32_t level = pr.second->GetLevel();
+		if (level != kLogLevel_None)
+		{
+			logger_levels.push_back(std::make_pair(pr.first, level));
+		}
+	}
+
+	return logger_levels;
+}
+
+// 日志级别文本(kLogLevel_None到kLogLevel_End)
+static const char * const kLogLevelNames[] = { "default", "trace", "info", "warn", "error", "off" };
+
+const char * LoggerMgr::GetLogLevelText(int32_t level)
+{
+	if (level < kLogLevel_None || level > kLogLevel_End)
+	{
+		return "unknown";
+	}
+
+	return kLogLevelNames[level];
+}
+
+bool LoggerMgr::ParseLogLevel(const std::string & text, int32_t & level)
+{
+	for (int32_t i = kLogLevel_None; i <= kLogLevel_End; i++)
+	{
+		if (text == kLogLevelNames[i])
+		{
+			level = i;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void LoggerMgr::SetThreadBufferSize(uint32_t size)
+{
+	uint32_t capacity = LogThreadBuffer::kMinCapacity;
+	while (capacity < size && capacity < 0x40000000)
+	{
+		capacity <<= 1;
+	}
+
+	_thread_buffer_size.store(capacity, std::memory_order_relaxed);
+}
+
+void LoggerMgr::SetLoggerOverflowPolicy(const std::string & log_name, int32_t policy)
+{
+	assert(policy >= kLogOverflowPolicy_Default && policy <= kLogOverflowPolicy_DropOldest);
+	GetLogger(log_name).SetOverflowPolicy(policy);
+}
+
+std::vector<LoggerMgr::LoggerStats> LoggerMgr::GetLoggerStats()
+{
+	std::vector<LoggerStats> stats;
+
+	AUTO_LOCK(_lock);
+
+	stats.reserve(_loggers.size() + _binary_loggers.size() + 1);
+	stats.push_back(LoggerStats{ "", _default_logger.GetOverflowPolicy(), _default_logger.GetDroppedLines(), _default_logger.GetBlockedTimes() });
+	for (auto & pr : _loggers)
+	{
+		stats.push_back(LoggerStats{ pr.first, pr.second->GetOverflowPolicy(), pr.second->GetDroppedLines(), pr.second->GetBlockedTimes() });
+	}
+
+	// 二进制日志以文件扩展名区分
+	for (auto & pr : _binary_loggers)
+	{
+		stats.push_back(LoggerStats{ pr.first + ".blog", pr.second->GetOverflowPolicy(), pr.second->GetDroppedLines(), pr.second->GetBlockedTimes() });
+	}
+
+	return stats;
+}
+
+// 溢出策略文本(kLogOverflowPolicy_Default到kLogOverflowPolicy_DropOldest)
+static const char * const kLogOverflowPolicyNames[] = { "default", "block", "drop_newest", "drop_oldest" };
+
+const char * LoggerMgr::GetOverflowPolicyText(int32_t policy)
+{
+	if (policy < kLogOverflowPolicy_Default || policy > kLogOverflowPolicy_DropOldest)
+	{
+		return "unknown";
+	}
+
+	return kLogOverflowPolicyNames[policy];
+}
+
+bool LoggerMgr::ParseOverflowPolicy(const std::string & text, int32_t & policy)
+{
+	for (int32_t i = kLogOverflowPolicy_Default; i <= kLogOverflowPolicy_DropOldest; i++)
+	{
+		if (text == kLogOverflowPolicyNames[i])
+		{
+			policy = i;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+LogThreadBuffer & LoggerMgr::GetThreadBuffer()
+{
+	// 线程退出时只做标记，由刷新线程取走剩余数据后释放
+	struct ThreadBufferHolder
+	{
+		~ThreadBufferHolder()
+		{
+			if (buf)
+			{
+				buf->SetThreadExited();
+			}
+		}
+
+		std::shared_ptr<LogThreadBuffer> buf;
+	};
+
+	static thread_local ThreadBufferHolder holder;
+	if (!holder.buf)
+	{
+		holder.buf = std::make_shared<LogThreadBuffer>(GetThreadBufferSize());
+		AUTO_LOCK(_lock);
+		_thread_buffers.push_back(holder.buf);
+	}
+
+	return *holder.buf;
+}
+
 void LoggerMgr::ExecFlushLog(LoggerMgr * log_mgr)
 {
 	while (log_mgr->_is_running)
 	{
-		Logger * wait_flush_logger = nullptr;
-		if (log_mgr->_wait_flush_logger_queue.Pop(&wait_flush_logger))
 		{
-			assert(wait_flush_logger);
-			wait_flush_logger->Flush();
+			AUTO_LOCK(log_mgr->_flush_lock);
+			if (!log_mgr->_flush_signaled && log_mgr->_is_running)
+			{
+				log_mgr->_flush_cond.Wait(l, kFlushIntervalMs);
+			}
+		}
+
+		log_mgr->_flush_signaled = false;
+		log_mgr->CollectAndFlush();
+	}
+
+	// 退出前写入剩余的日志
+	log_mgr->CollectAndFlush();
+}
+
+void LoggerMgr::CollectAndFlush()
+{
+	{
+		AUTO_LOCK(_lock);
+		_collecting_buffers = _thread_buffers;
+	}
+
+	std::vector<LogThreadBuffer*> exited_buffers;
+	for (auto & buf : _collecting_buffers)
+	{
+		// 先判断是否已退出，保证退出前压入的数据都能取到
+		bool exited = buf->IsThreadExited();
+		buf->PopAll(_written_loggers);
+		if (exited)
+		{
+			exited_buffers.push_back(buf.get());
 		}
 	}
+
+	if (!exited_buffers.empty())
+	{
+		AUTO_LOCK(_lock);
+		auto it = std::remove_if(_thread_buffers.begin(), _thread_buffers.end(), [&exited_buffers](const std::shared_ptr<LogThreadBuffer> & buf) {
+			return std::find(exited_buffers.begin(), exited_buffers.end(), buf.get()) != exited_buffers.end();
+		});
+		_thread_buffers.erase(it, _thread_buffers.end());
+	}
+
+	_collecting_buffers.clear();
+
+	// 每秒最多报告一次丢弃的日志
+	int64_t now = TimeHelper::GetEpochSeconds();
+	if (now != _report_time)
+	{
+		_report_time = now;
+		ReportDroppedLines(now);
+	}
+
+	for (Logger * logger : _written_loggers)
+	{
+		logger->Flush();
+	}
+
+	_written_loggers.clear();
+}
+
+void LoggerMgr::ReportDroppedLines(int64_t now)
+{
+	auto report = [this, now](Logger * logger) {
+		bool have_data = logger->HaveData();
+		if (logger->WriteDroppedLinesReport(now) && !have_data)
+		{
+			_written_loggers.push_back(logger);
+		}
+	};
+
+	report(&_default_logger);
+
+	AUTO_LOCK(_lock);
+
+	for (auto & pr : _loggers)
+	{
+		report(pr.second);
+	}
+
+	for (auto & pr : _binary_loggers)
+	{
+		report(pr.second);
+	}
 }
 
 
 
 
-LogStreamBuf::LogStreamBuf(Logger & logger, int64_t cur_time) : _cur_time(cur_time), _logger(logger)
+LogThreadBuffer::LogThreadBuffer(uint32_t capacity)
+	: _capacity(capacity), _write_pos(0), _read_pos(0), _thread_exited(false), _next_notify_pos(capacity / 4)
 {
-	setp(_buf, _buf + kMaxBufferLen);
+	assert(_capacity >= kMinCapacity && (_capacity & (_capacity - 1)) == 0);
+	_data = new char[_capacity];
+	_line.reserve(1024);
 }
 
-std::streambuf::int_type LogStreamBuf::overflow(std::streambuf::int_type c)
+LogThreadBuffer::~LogThreadBuffer()
 {
-	if (c != EOF) 
+	delete[] _data;
+}
+
+bool LogThreadBuffer::Push(Logger * logger, int64_t cur_time, const char * text, int32_t len)
+{
+	if (!logger || !text || len <= 0)
 	{
-		*pptr() = (char)c;
-		pbump(1);
+		return false;
 	}
 
-	
-	int32_t len = (int32_t)(pptr() - pbase());
-	if (len > 0)
+	// 过长的数据分成多条记录
+	const int32_t max_len = GetMaxRecordLength();
+	const uint32_t mask = _capacity - 1;
+
+	while (len > 0)
+	{
+		int32_t cur_len = std::min(len, max_len);
+		uint32_t record_size = GetRecordSize(cur_len);
+		uint64_t write_pos = _write_pos.load(std::memory_order_relaxed);
+		// 末尾剩余空间不够时跳到缓冲区开头
+		uint32_t tail = _capacity - (uint32_t)(write_pos & mask);
+		uint32_t need = tail < record_size ? tail + record_size : record_size;
+
+		if (!MakeSpace(logger, write_pos, need))
+		{
+			logger->AddDroppedLines(1);
+			return false;
+		}
+
+		if (tail < record_size)
+		{
+			if (tail >= sizeof(RecordHeader))
+			{
+				((RecordHeader *)(_data + (write_pos & mask)))->logger = nullptr;
+			}
+			write_pos += tail;
+		}
+
+		RecordHeader * header = (RecordHeader *)(_data + (write_pos & mask));
+		header->logger = logger;
+		header->time = cur_time;
+		header->len = cur_len;
+		memcpy(header + 1, text, cur_len);
+		_write_pos.store(write_pos + record_size, std::memory_order_release);
+
+		text += cur_len;
+		len -= cur_len;
+	}
+
+	// 积攒了一定量的数据才通知刷新线程，否则由刷新线程定时收集，减少写文件的次数
+	uint64_t write_pos = _write_pos.load(std::memory_order_relaxed);
+	if (write_pos >= _next_notify_pos)
 	{
-		_vec_ext_buf.push_back(std::vector<char>());
-		std::vector<char> & buf = (*(_vec_ext_buf.end() - 1));
-		buf.assign(_buf, _buf + len);
-		pbump(-len);
+		_next_notify_pos = write_pos + _capacity / 4;
+		LoggerMgr::Instance().NotifyFlush();
 	}
 
-	return c;
+	return true;
 }
 
-int LogStreamBuf::sync()
+bool LogThreadBuffer::MakeSpace(Logger * logger, uint64_t write_pos, uint32_t need)
 {
-	AUTO_LOCK(_logger.GetWriteLock());
+	const uint32_t mask = _capacity - 1;
+	uint64_t read_pos = _read_pos.load(std::memory_order_acquire);
+	if (_capacity - (uint32_t)(write_pos - read_pos) >= need)
+	{
+		return true;
+	}
+
+	LoggerMgr & log_mgr = LoggerMgr::Instance();
+	int32_t policy = log_mgr.GetOverflowPolicy(logger);
 
-	for (auto & ext_buf : _vec_ext_buf)
+	if (policy == kLogOverflowPolicy_DropNewest)
 	{
-		_logger.Write(_cur_time, ext_buf.data(), (int32_t)ext_buf.size());
+		log_mgr.NotifyFlush();
+		return false;
 	}
 
-	_vec_ext_buf.clear();
+	if (policy == kLogOverflowPolicy_DropOldest)
+	{
+		// 推进读位置丢弃最旧的记录，读位置到写位置之间的数据只有本线程会写，读取记录头是安全的
+		while (_capacity - (uint32_t)(write_pos - read_pos) < need)
+		{
+			assert(read_pos < write_pos);
+			uint32_t tail = _capacity - (uint32_t)(read_pos & mask);
+			uint64_t next_pos = read_pos + tail;
+			Logger * dropped_logger = nullptr;
+			if (tail >= sizeof(RecordHeader))
+			{
+				const RecordHeader * header = (const RecordHeader *)(_data + (read_pos & mask));
+				if (header->logger)
+				{
+					dropped_logger = header->logger;
+					next_pos = read_pos + GetRecordSize(header->len);
+				}
+			}
 
-	int32_t len = (int32_t)(pptr() - pbase());
-	if (len > 0)
+			if (_read_pos.compare_exchange_weak(read_pos, next_pos, std::memory_order_acq_rel, std::memory_order_acquire))
+			{
+				read_pos = next_pos;
+				if (dropped_logger)
+				{
+					dropped_logger->AddDroppedLines(1);
+				}
+			}
+		}
+
+		log_mgr.NotifyFlush();
+		return true;
+	}
+
+	// 等待刷新线程取走数据
+	logger->AddBlockedTimes(1);
+	while (_capacity - (uint32_t)(write_pos - _read_pos.load(std::memory_order_acquire)) < need)
 	{
-		_logger.Write(_cur_time, _buf, len);
-		pbump(-len);
+		if (!log_mgr.IsRunning())
+		{
+			return false;
+		}
+
+		log_mgr.NotifyFlush();
+		TimeHelper::ThreadSleep(1);
 	}
 
-	return 0;
+	return true;
 }
 
+void LogThreadBuffer::PopAll(std::vector<Logger*> & written_loggers)
+{
+	const uint32_t mask = _capacity - 1;
+	uint64_t read_pos = _read_pos.load(std::memory_order_acquire);
+	uint64_t write_pos = _write_pos.load(std::memory_order_acquire);
+
+	while (read_pos < write_pos)
+	{
+		uint32_t tail = _capacity - (uint32_t)(read_pos & mask);
+		uint64_t next_pos = read_pos + tail;
+		RecordHeader header;
+		header.logger = nullptr;
+
+		if (tail >= sizeof(RecordHeader))
+		{
+			memcpy(&header, _data + (read_pos & mask), sizeof(header));
+			if (header.logger)
+			{
+				if (header.len <= 0 || GetRecordSize(header.len) > tail)
+				{
+					// 记录已被生产者丢弃并覆盖，重新读取读位置
+					uint64_t cur_read_pos = _read_pos.load(std::memory_order_acquire);
+					assert(cur_read_pos != read_pos);
+					read_pos = (cur_read_pos != read_pos ? cur_read_pos : next_pos);
+					continue;
+				}
+
+				next_pos = read_pos + GetRecordSize(header.len);
+				_pop_buffer.assign(_data + (read_pos & mask) + sizeof(RecordHeader), header.len);
+			}
+		}
+
+		// 失败说明生产者丢弃了这条记录(数据可能已被覆盖)，read_pos被更新为新的读位置
+		if (!_read_pos.compare_exchange_strong(read_pos, next_pos, std::memory_order_acq_rel, std::memory_order_acquire))
+		{
+			continue;
+		}
+
+		read_pos = next_pos;
+
+		if (header.logger)
+		{
+			if (!header.logger->HaveData())
+			{
+				written_loggers.push_back(header.logger);
+			}
+
+			header.logger->Write(header.time, _pop_buffer.data(), header.len);
+		}
+	}
+}
+
+Logger * LogThreadBuffer::GetLogger(const std::string & log_name)
+{
+	auto it = _logger_cache.find(log_name);
+	if (it != _logger_cache.end())
+	{
+		return it->second;
+	}
+
+	Logger * logger = &LoggerMgr::Instance().GetLogger(log_name);
+	_logger_cache.insert(std::make_pair(log_name, logger));
+
+	return logger;
+}
+
+
+
+
 // 日志等级的文本
 const char LogStream::kLogLevelText[kLogLevelCount][8] =
 {
@@ -388,20 +1007,182 @@ const char LogStream::kLogLevelText[kLogLevelCount][8] =
 };
 
 LogStream::LogStream(const std::string & log_name, LogLevel log_lv)
-    : std::ostream(&_log_buf), _log_buf(LoggerMgr::Instance().GetLogger(log_name), TimeHelper::GetEpochSeconds()), _log_lv(log_lv)
+	: LogStream(*LoggerMgr::Instance().GetThreadBuffer().GetLogger(log_name), log_lv) {}
+
+LogStream::LogStream(Logger & logger, LogLevel log_lv)
+	: _thread_buf(LoggerMgr::Instance().GetThreadBuffer()), _line(_thread_buf.GetLineBuffer()), _line_start(_line.size()),
+	_logger(&logger), _cur_time(0), _log_lv(log_lv), _fmt_active(false)
 {
-    tm cur_tm;
-    TimeHelper::LocalTime(_log_buf.GetCurTime(), &cur_tm);
-	(*this) << (cur_tm.tm_year + 1900) << '-' << std::setw(2) << std::setfill('0') << (cur_tm.tm_mon + 1) << '-' << cur_tm.tm_mday 
-		<< ' ' << cur_tm.tm_hour << ':' << cur_tm.tm_min << ':' << cur_tm.tm_sec << '|' << std::setw(0);
-	
+	static thread_local LogTimePrefixCache time_prefix;
+
+	// 格式：2017-01-02 03:04:05| 或 2017-01-02 03:04:05.678|
+	int64_t now_ms = TimeHelper::GetEpochMilliseconds();
+	_cur_time = now_ms / 1000;
+	if (time_prefix.seconds != _cur_time)
+	{
+		time_prefix.Refresh(_cur_time);
+	}
+
+	char ms_text[8];
+	char * p = ms_text;
+	if (LoggerMgr::Instance().IsShowMilliseconds())
+	{
+		int32_t ms = (int32_t)(now_ms % 1000);
+		*(p++) = '.';
+		*(p++) = (char)('0' + ms / 100);
+		p = WriteTwoDigits(p, ms % 100);
+	}
+	*(p++) = '|';
+
+	_line.append(time_prefix.text, time_prefix.len);
+	_line.append(ms_text, p - ms_text);
+
 	if (log_lv >= kLogLevel_Begin && log_lv < kLogLevel_End)
 	{
-		(*this) << kLogLevelText[log_lv - kLogLevel_Begin] << '|';
+		_line.append(kLogLevelText[log_lv - kLogLevel_Begin]);
+		_line.push_back('|');
 	}
 }
 
 LogStream::~LogStream()
 {
-	this->flush();
-}
\ No newline at end of file
+	Commit();
+
+	// 单行过长时释放多余的内存
+	if (_line_start == 0 && _line.capacity() > kMaxKeepLineBufferSize)
+	{
+		std::string().swap(_line);
+	}
+}
+
+LogStream & LogStream::operator<<(const void * p)
+{
+	if (_fmt_active)
+	{
+		return AppendFormatted(p);
+	}
+
+	char buf[32];
+	int len = snprintf(buf, sizeof(buf), "0x%" PRIxPTR, (uintptr_t)p);
+	if (len > 0)
+	{
+		_line.append(buf, std::min((size_t)len, sizeof(buf) - 1));
+	}
+
+	return *this;
+}
+
+LogStream & LogStream::operator<<(StdManipulator manip)
+{
+	if (manip == static_cast<StdManipulator>(std::endl))
+	{
+		_line.push_back('\n');
+		Commit();
+	}
+	else if (manip == static_cast<StdManipulator>(std::flush))
+	{
+		Commit();
+	}
+	else if (manip == static_cast<StdManipulator>(std::ends))
+	{
+		_line.push_back('\0');
+	}
+
+	return *this;
+}
+
+LogStream & LogStream::AppendDouble(double v)
+{
+	if (_fmt_active)
+	{
+		return AppendFormatted(v);
+	}
+
+	char buf[64];
+	int len = snprintf(buf, sizeof(buf), "%g", v);
+	if (len > 0)
+	{
+		_line.append(buf, std::min((size_t)len, sizeof(buf) - 1));
+	}
+
+	return *this;
+}
+
+template<typename T>
+LogStream & LogStream::AppendFormatted(T v)
+{
+	GetFormatStream() << v;
+	return FlushFormatStream();
+}
+
+template LogStream & LogStream::AppendFormatted(const std::string &);
+template LogStream & LogStream::AppendFormatted(const char *);
+template LogStream & LogStream::AppendFormatted(char);
+template LogStream & LogStream::AppendFormatted(signed char);
+template LogStream & LogStream::AppendFormatted(unsigned char);
+template LogStream & LogStream::AppendFormatted(bool);
+template LogStream & LogStream::AppendFormatted(short);
+template LogStream & LogStream::AppendFormatted(unsigned short);
+template LogStream & LogStream::AppendFormatted(int);
+template LogStream & LogStream::AppendFormatted(unsigned int);
+template LogStream & LogStream::AppendFormatted(long);
+template LogStream & LogStream::AppendFormatted(unsigned long);
+template LogStream & LogStream::AppendFormatted(long long);
+template LogStream & LogStream::AppendFormatted(unsigned long long);
+template LogStream & LogStream::AppendFormatted(double);
+template LogStream & LogStream::AppendFormatted(const void *);
+template LogStream & LogStream::AppendFormatted(std::ios_base & (*)(std::ios_base &));
+
+std::ostringstream & LogStream::GetFormatStream()
+{
+	if (!_fmt)
+	{
+		_fmt.reset(new std::ostringstream());
+	}
+
+	return *_fmt;
+}
+
+LogStream & LogStream::FlushFormatStream()
+{
+	std::ostringstream & fmt = *_fmt;
+	_line.append(fmt.str());
+	fmt.str(std::string());
+
+	// std::setw只对下一次输出有效，输出后宽度恢复为0
+	_fmt_active = fmt.flags() != (std::ios_base::skipws | std::ios_base::dec) || fmt.width() != 0 ||
+		fmt.precision() != 6 || fmt.fill() != ' ';
+
+	return *this;
+}
+
+void LogStream::Commit()
+{
+	assert(_line.size() >= _line_start);
+	size_t len = _line.size() - _line_start;
+	if (len == 0)
+	{
+		return;
+	}
+
+	if (LoggerMgr::Instance().IsRunning())
+	{
+		_thread_buf.Push(_logger, _cur_time, _line.data() + _line_start, (int32_t)len);
+	}
+
+	_line.resize(_line_start);
+}
+
+Logger * LogThreadBuffer::GetBinaryLogger(const std::string & log_name)
+{
+	auto it = _binary_logger_cache.find(log_name);
+	if (it != _binary_logger_cache.end())
+	{
+		return it->second;
+	}
+
+	Logger * logger = &LoggerMgr::Instance().GetBinaryLogger(log_name);
+	_binary_logger_cache.insert(std::make_pair(log_name, logger));
+
+	return logger;
+}
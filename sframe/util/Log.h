@@ -1,20 +1,24 @@
-﻿
-#ifndef SFRAME_LOG_H
+﻿#ifndef SFRAME_LOG_H
 #define SFRAME_LOG_H
 
 #include <stdio.h>
 #include <time.h>
 #include <inttypes.h>
 #include <assert.h>
+#include <string.h>
 #include <string>
+#include <vector>
+#include <memory>
+#include <atomic>
 #include <ostream>
+#include <sstream>
+#include <type_traits>
 #include <unordered_map>
 #include <thread>
-#include <iomanip>
 #include "Lock.h"
+#include "ConditionVariable.h"
 #include "Singleton.h"
 #include "FileHelper.h"
-#include "BlockingQueue.h"
 
 namespace sframe{
 
@@ -35,8 +39,22 @@ enum LogLevel : int32_t
 
 static const int32_t kLogLevelCount = kLogLevel_End - kLogLevel_Begin;
 
+// 编译期最低日志级别，低于此级别的日志语句会被整个移除(可在编译选项中定义，如-DSFRAME_LOG_MIN_LEVEL=2)
+#ifndef SFRAME_LOG_MIN_LEVEL
+#define SFRAME_LOG_MIN_LEVEL 1
+#endif
 
-// 日志类
+// 线程日志暂存缓冲区满时的处理策略
+enum LogOverflowPolicy : int32_t
+{
+	kLogOverflowPolicy_Default = 0,      // 使用全局策略(仅用于单独设置Logger)
+	kLogOverflowPolicy_Block,            // 等待刷新线程腾出空间
+	kLogOverflowPolicy_DropNewest,       // 丢弃新的日志
+	kLogOverflowPolicy_DropOldest,       // 丢弃缓冲区中最旧的日志
+};
+
+
+// 日志类(数据的追加和写文件都只在日志刷新线程中进行，无需加锁)
 class Logger : public noncopyable
 {
 public:
@@ -54,42 +72,218 @@ public:
 
 	Logger(const std::string & log_name = "");
 
-    ~Logger();
+    virtual ~Logger();
 
-    void Write(int64_t cur_time, const char * text, int32_t len);
+	// 追加日志数据
+    virtual void Write(int64_t cur_time, const char * text, int32_t len);
 
+	// 将追加的日志数据写入文件
 	void Flush();
 
-	Lock & GetWriteLock()
+	// 是否有待写入文件的数据
+	bool HaveData() const
+	{
+		return !_log_buffer.empty() && _log_buffer[0]->cur_size > 0;
+	}
+
+	const std::string & GetName() const
+	{
+		return _log_name;
+	}
+
+	// 设置本日志的级别(覆盖全局级别)，kLogLevel_None表示使用全局级别
+	void SetLevel(int32_t level)
+	{
+		_level.store(level, std::memory_order_relaxed);
+	}
+
+	int32_t GetLevel() const
+	{
+		return _level.load(std::memory_order_relaxed);
+	}
+
+	// 设置本日志的溢出策略(覆盖全局策略)
+	void SetOverflowPolicy(int32_t policy)
+	{
+		_overflow_policy.store(policy, std::memory_order_relaxed);
+	}
+
+	int32_t GetOverflowPolicy() const
+	{
+		return _overflow_policy.load(std::memory_order_relaxed);
+	}
+
+	// 丢弃的日志条数(累计)
+	void AddDroppedLines(uint64_t n)
+	{
+		_dropped_lines.fetch_add(n, std::memory_order_relaxed);
+	}
+
+	uint64_t GetDroppedLines() const
+	{
+		return _dropped_lines.load(std::memory_order_relaxed);
+	}
+
+	// 写日志时等待缓冲区空间的次数(累计)
+	void AddBlockedTimes(uint64_t n)
+	{
+		_blocked_times.fetch_add(n, std::memory_order_relaxed);
+	}
+
+	uint64_t GetBlockedTimes() const
+	{
+		return _blocked_times.load(std::memory_order_relaxed);
+	}
+
+	// 把新丢弃的日志条数写入日志本身(刷新线程调用)，返回是否写入了
+	bool WriteDroppedLinesReport(int64_t now);
+
+protected:
+
+	// 日志文件的扩展名
+	virtual const char * GetLogFileExtension() const
+	{
+		return ".log";
+	}
+
+	// 打开日志文件后调用，is_empty表示文件是否为空(新文件)
+	virtual void OnLogFileOpened(bool /*is_empty*/) {}
+
+	// 写入一行报告类的文本(如丢弃日志的统计)
+	virtual void WriteReportText(int64_t cur_time, const std::string & text)
 	{
-		return _lock;
+		Write(cur_time, text.data(), (int32_t)text.length());
 	}
 
+	// 直接写入已打开的文件
+	bool WriteFile(const char * data, size_t len);
+
 private:
 
-	void FlushLogDataChunk(LogDataChunk * data_chunk, int64_t now);
+	// 将[begin, end)的数据块(同一天的)一次写入文件
+	void WriteLogDataChunks(size_t begin, size_t end, int64_t now);
+
+	bool OpenLogFile(int64_t log_time, int64_t now);
 
-	bool IsWriteBufferHaveData();
+	void CloseLogFile();
+
+	// 文件是否被删除或者移走了
+	bool IsLogFileChanged() const;
 
 	std::string GetLogFileName(int64_t cur_time);
 
 private:
-    Lock _lock;
-    FILE * _file;
-	int64_t _open_file_time;
+	int _fd;                   // 以追加方式打开的文件描述符
+	int64_t _check_file_time;  // 上次检查文件的时间
 	int64_t _log_file_time;
+	uint64_t _file_dev;
+	uint64_t _file_ino;
+	std::string _file_path;
     std::string _log_name;
-	std::vector<LogDataChunk*> * _write_log_buffer;
-	std::vector<LogDataChunk*> * _flush_log_buffer;
-	bool _waiting_flush;
+	std::vector<LogDataChunk*> _log_buffer;
+	std::atomic<int32_t> _level;
+	std::atomic<int32_t> _overflow_policy;
+	std::atomic<uint64_t> _dropped_lines;
+	std::atomic<uint64_t> _blocked_times;
+	uint64_t _reported_dropped_lines;     // 已写入日志的丢弃条数
+};
+
+// 线程日志暂存缓冲区
+// 单生产者(所属线程)单消费者(日志刷新线程)的无锁环形缓冲区，写日志时不需要任何锁
+// 日志占用的内存由它的容量限定，满了以后按日志的溢出策略处理
+// 丢弃最旧策略下生产者会推进读位置，所以消费者每取一条都通过CAS确认
+class LogThreadBuffer : public noncopyable
+{
+public:
+	static const uint32_t kDefaultCapacity = 256 * 1024;   // 必须是2的幂
+
+	static const uint32_t kMinCapacity = 64 * 1024;
+
+	LogThreadBuffer(uint32_t capacity = kDefaultCapacity);
+
+	~LogThreadBuffer();
+
+	// 压入日志数据(所属线程调用)，缓冲区满时等待刷新线程取走数据
+	bool Push(Logger * logger, int64_t cur_time, const char * text, int32_t len);
+
+	// 取出所有日志数据追加到对应的Logger(刷新线程调用)，新有数据的Logger放入written_loggers
+	void PopAll(std::vector<Logger*> & written_loggers);
+
+	// 获取Logger(所属线程调用，缓存查找结果，避免每次都加锁查找)
+	Logger * GetLogger(const std::string & log_name);
+
+	// 获取二进制日志的Logger(所属线程调用，同样缓存查找结果)
+	Logger * GetBinaryLogger(const std::string & log_name);
+
+	// 单条记录的最大长度(超过的数据会被分成多条记录)
+	int32_t GetMaxRecordLength() const
+	{
+		return (int32_t)(_capacity / 4 - sizeof(RecordHeader));
+	}
+
+	// 所属线程格式化日志行使用的缓冲区
+	std::string & GetLineBuffer()
+	{
+		return _line;
+	}
+
+	void SetThreadExited()
+	{
+		_thread_exited.store(true, std::memory_order_release);
+	}
+
+	bool IsThreadExited() const
+	{
+		return _thread_exited.load(std::memory_order_acquire);
+	}
+
+private:
+
+	struct RecordHeader
+	{
+		Logger * logger;      // 为空表示跳过到缓冲区末尾
+		int64_t time;
+		int32_t len;
+	};
+
+	static uint32_t GetRecordSize(int32_t len)
+	{
+		return (uint32_t)((sizeof(RecordHeader) + len + 7) & ~(size_t)7);
+	}
+
+	// 腾出need字节的空间，返回false表示应丢弃本条日志
+	bool MakeSpace(Logger * logger, uint64_t write_pos, uint32_t need);
+
+private:
+	char * _data;
+	uint32_t _capacity;
+	std::atomic<uint64_t> _write_pos;
+	char _padding[64];                  // 避免读写位置伪共享
+	std::atomic<uint64_t> _read_pos;
+	std::atomic<bool> _thread_exited;
+	uint64_t _next_notify_pos;          // 写到这个位置时通知刷新线程(积攒一批再写文件)
+	std::string _line;
+	std::unordered_map<std::string, Logger *> _logger_cache;
+	std::unordered_map<std::string, Logger *> _binary_logger_cache;
+	std::string _pop_buffer;            // 刷新线程使用
 };
 
 // 日志管理器
 class LoggerMgr : public singleton<LoggerMgr>
 {
 public:
+	static const uint32_t kFlushIntervalMs = 100;   // 没有被通知时，刷新线程的最长等待时间(日志最多延迟这么久写入文件)
+
+	// Logger的统计信息
+	struct LoggerStats
+	{
+		std::string name;
+		int32_t overflow_policy;
+		uint64_t dropped_lines;
+		uint64_t blocked_times;
+	};
 
-	LoggerMgr() : _flush_log_thread(nullptr), _is_running(false) {}
+	LoggerMgr();
 
 	~LoggerMgr();
 
@@ -97,6 +291,49 @@ public:
 
 	Logger & GetLogger(const std::string & log_name);
 
+	Logger & GetDefaultLogger()
+	{
+		return _default_logger;
+	}
+
+	// 获取指定级别可以输出的Logger，不能输出返回nullptr
+	// 没有级别的日志(kLogLevel_None)按错误级别判断
+	Logger * GetEnabledLogger(const std::string & log_name, LogLevel lv);
+
+	// 获取二进制日志的Logger(BinaryLogger，文件扩展名为.blog，与同名的文本日志互不影响)
+	Logger & GetBinaryLogger(const std::string & log_name);
+
+	// 获取可以输出的二进制日志Logger(按错误级别判断)，不能输出返回nullptr
+	Logger * GetEnabledBinaryLogger(const std::string & log_name);
+
+	// 设置全局日志级别，低于此级别的日志不输出(kLogLevel_End表示全部关闭)
+	static void SetLogLevel(int32_t level)
+	{
+		s_log_level.store(level, std::memory_order_relaxed);
+	}
+
+	static int32_t GetLogLevel()
+	{
+		return s_log_level.load(std::memory_order_relaxed);
+	}
+
+	// 全局级别下指定级别是否输出
+	static bool IsLevelEnabled(LogLevel lv)
+	{
+		return (lv == kLogLevel_None ? kLogLevel_Error : lv) >= s_log_level.load(std::memory_order_relaxed);
+	}
+
+	// 设置指定日志的级别(覆盖全局级别)，kLogLevel_None表示使用全局级别
+	void SetLoggerLevel(const std::string & log_name, int32_t level);
+
+	// 获取所有设置了级别的日志
+	std::vector<std::pair<std::string, int32_t>> GetLoggerLevels();
+
+	// 日志级别文本与级别的转换("trace"、"info"、"warn"、"error"、"off")
+	static const char * GetLogLevelText(int32_t level);
+
+	static bool ParseLogLevel(const std::string & text, int32_t & level);
+
 	const std::string & GetLogDir() const
 	{
 		return _log_dir;
@@ -107,16 +344,70 @@ public:
 		return _log_base_name;
 	}
 
-	bool IsRunning()
+	bool IsRunning() const
+	{
+		return _is_running.load(std::memory_order_relaxed);
+	}
+
+	// 设置日志时间是否显示毫秒
+	void SetShowMilliseconds(bool show)
+	{
+		_show_milliseconds.store(show, std::memory_order_relaxed);
+	}
+
+	bool IsShowMilliseconds() const
+	{
+		return _show_milliseconds.load(std::memory_order_relaxed);
+	}
+
+	// 设置每个线程的日志暂存缓冲区大小(即每个线程日志最多占用的内存)，只对之后第一次写日志的线程有效
+	void SetThreadBufferSize(uint32_t size);
+
+	uint32_t GetThreadBufferSize() const
+	{
+		return _thread_buffer_size.load(std::memory_order_relaxed);
+	}
+
+	// 设置全局的溢出策略
+	void SetOverflowPolicy(int32_t policy)
+	{
+		assert(policy > kLogOverflowPolicy_Default && policy <= kLogOverflowPolicy_DropOldest);
+		_overflow_policy.store(policy, std::memory_order_relaxed);
+	}
+
+	int32_t GetOverflowPolicy() const
 	{
-		return _is_running;
+		return _overflow_policy.load(std::memory_order_relaxed);
 	}
 
-	void PushNeedFlushLogger(Logger * logger)
+	// 获取Logger实际使用的溢出策略
+	int32_t GetOverflowPolicy(const Logger * logger) const
 	{
-		if (logger)
+		int32_t policy = logger->GetOverflowPolicy();
+		return policy == kLogOverflowPolicy_Default ? GetOverflowPolicy() : policy;
+	}
+
+	// 设置指定日志的溢出策略，kLogOverflowPolicy_Default表示使用全局策略
+	void SetLoggerOverflowPolicy(const std::string & log_name, int32_t policy);
+
+	// 获取所有日志的统计信息
+	std::vector<LoggerStats> GetLoggerStats();
+
+	// 溢出策略文本与策略的转换("default"、"block"、"drop_newest"、"drop_oldest")
+	static const char * GetOverflowPolicyText(int32_t policy);
+
+	static bool ParseOverflowPolicy(const std::string & text, int32_t & policy);
+
+	// 获取当前线程的日志暂存缓冲区
+	LogThreadBuffer & GetThreadBuffer();
+
+	// 通知刷新线程有日志需要写入(刷新线程处理前只会真正通知一次)
+	void NotifyFlush()
+	{
+		if (!_flush_signaled.load(std::memory_order_relaxed) && !_flush_signaled.exchange(true))
 		{
-			_wait_flush_logger_queue.Push(logger);
+			AUTO_LOCK(_flush_lock);
+			_flush_cond.WakeUpOne();
 		}
 	}
 
@@ -124,57 +415,230 @@ private:
 
 	static void ExecFlushLog(LoggerMgr * log_mgr);
 
+	static std::atomic<int32_t> s_log_level;
+
+	// 收集各线程暂存的日志并写入文件
+	void CollectAndFlush();
+
+	// 把各日志新丢弃的条数写入日志本身
+	void ReportDroppedLines(int64_t now);
+
 private:
 	Lock _lock;
 	std::thread * _flush_log_thread;
-	bool _is_running;
+	std::atomic<bool> _is_running;
+	std::atomic<bool> _show_milliseconds;
+	std::atomic<uint32_t> _thread_buffer_size;
+	std::atomic<int32_t> _overflow_policy;
 	Logger _default_logger;
 	std::unordered_map<std::string, Logger *> _loggers;
+	std::unordered_map<std::string, Logger *> _binary_loggers;
 	std::string _log_dir;
 	std::string _log_base_name;
-	BlockingQueue<Logger *> _wait_flush_logger_queue;
+	std::vector<std::shared_ptr<LogThreadBuffer>> _thread_buffers;      // 各线程的暂存缓冲区
+	Lock _flush_lock;
+	ConditionVariable _flush_cond;
+	std::atomic<bool> _flush_signaled;
+	std::vector<std::shared_ptr<LogThreadBuffer>> _collecting_buffers;  // 以下仅刷新线程使用
+	std::vector<Logger*> _written_loggers;
+	int64_t _report_time;
 };
 
-
-class LogStreamBuf : public std::streambuf
+// 日志流
+// 不使用iostream，直接格式化到线程的行缓冲区，遇到std::endl或析构时提交到线程的暂存缓冲区
+// 没有专门重载的类型通过其operator<<(std::ostream &, ...)格式化
+class LogStream : public noncopyable
 {
-	static const int32_t kMaxBufferLen = 255;
+    static const char kLogLevelText[kLogLevelCount][8];
+
+	static const size_t kMaxKeepLineBufferSize = 64 * 1024;
+
 public:
-	LogStreamBuf(Logger & logger, int64_t cur_time);
+	typedef std::ostream & (*StdManipulator)(std::ostream &);
+
+    LogStream(const std::string & log_name, LogLevel lv = kLogLevel_None);
 
-	~LogStreamBuf() {}
+	LogStream(Logger & logger, LogLevel lv = kLogLevel_None);
 
-	int64_t GetCurTime() const
+	~LogStream();
+
+	LogStream & operator<<(const std::string & s)
 	{
-		return _cur_time;
+		if (_fmt_active)
+		{
+			return AppendFormatted<const std::string &>(s);
+		}
+		_line.append(s);
+		return *this;
 	}
 
-protected:
+	// 其他分配器的字符串(如ArenaString)
+	template<typename T_Alloc>
+	LogStream & operator<<(const std::basic_string<char, std::char_traits<char>, T_Alloc> & s)
+	{
+		if (_fmt_active)
+		{
+			GetFormatStream() << s;
+			return FlushFormatStream();
+		}
+		_line.append(s.data(), s.length());
+		return *this;
+	}
+
+	LogStream & operator<<(const char * s)
+	{
+		s = s ? s : "(null)";
+		if (_fmt_active)
+		{
+			return AppendFormatted(s);
+		}
+		_line.append(s);
+		return *this;
+	}
+
+	LogStream & operator<<(char * s)
+	{
+		return (*this) << (const char *)s;
+	}
+
+	LogStream & operator<<(char c)
+	{
+		if (_fmt_active)
+		{
+			return AppendFormatted(c);
+		}
+		_line.push_back(c);
+		return *this;
+	}
+
+	LogStream & operator<<(signed char c)
+	{
+		if (_fmt_active)
+		{
+			return AppendFormatted(c);
+		}
+		_line.push_back((char)c);
+		return *this;
+	}
 
-	std::streambuf::int_type overflow(std::streambuf::int_type c) override;
+	LogStream & operator<<(unsigned char c)
+	{
+		if (_fmt_active)
+		{
+			return AppendFormatted(c);
+		}
+		_line.push_back((char)c);
+		return *this;
+	}
+
+	LogStream & operator<<(bool b)
+	{
+		if (_fmt_active)
+		{
+			return AppendFormatted(b);
+		}
+		_line.push_back(b ? '1' : '0');
+		return *this;
+	}
+
+	LogStream & operator<<(short v) { return AppendInteger(v); }
+	LogStream & operator<<(unsigned short v) { return AppendInteger(v); }
+	LogStream & operator<<(int v) { return AppendInteger(v); }
+	LogStream & operator<<(unsigned int v) { return AppendInteger(v); }
+	LogStream & operator<<(long v) { return AppendInteger(v); }
+	LogStream & operator<<(unsigned long v) { return AppendInteger(v); }
+	LogStream & operator<<(long long v) { return AppendInteger(v); }
+	LogStream & operator<<(unsigned long long v) { return AppendInteger(v); }
+
+	LogStream & operator<<(float v) { return AppendDouble(v); }
+	LogStream & operator<<(double v) { return AppendDouble(v); }
+	LogStream & operator<<(long double v) { return AppendDouble((double)v); }
 
-	int sync() override;
+	LogStream & operator<<(const void * p);
+
+	// std::endl、std::flush、std::ends
+	LogStream & operator<<(StdManipulator manip);
+
+	// std::hex、std::fixed、std::boolalpha等格式标志，之后的输出按ostream的格式进行
+	LogStream & operator<<(std::ios_base & (*manip)(std::ios_base &))
+	{
+		return AppendFormatted(manip);
+	}
+
+	// 枚举按数值输出
+	template<typename T>
+	typename std::enable_if<std::is_enum<T>::value, LogStream &>::type operator<<(const T & v)
+	{
+		return AppendInteger((long long)v);
+	}
+
+	// 其他类型使用其ostream输出运算符(慢路径)，std::setw、std::setprecision、std::setfill等也从这里设置到格式化流
+	template<typename T>
+	typename std::enable_if<!std::is_enum<T>::value, LogStream &>::type operator<<(const T & v)
+	{
+		GetFormatStream() << v;
+		return FlushFormatStream();
+	}
 
 private:
-	int64_t _cur_time;
-	Logger & _logger;
-	char _buf[kMaxBufferLen + 1];
-	std::vector<std::vector<char> > _vec_ext_buf;
-};
 
-// 日志流
-class LogStream : public std::ostream
-{
-    static const char kLogLevelText[kLogLevelCount][8];
+	// 内置类型通过格式化流输出(保留之前设置的格式)，在Log.cpp中实例化，不展开到每个输出处
+	template<typename T>
+	LogStream & AppendFormatted(T v);
 
-public:
-    LogStream(const std::string & log_name, LogLevel lv = kLogLevel_None);
+	std::ostringstream & GetFormatStream();
 
-	~LogStream();
+	// 把格式化流中的内容追加到行，并记录格式是否已不是默认值
+	LogStream & FlushFormatStream();
+
+	template<typename T>
+	LogStream & AppendInteger(T v)
+	{
+		if (_fmt_active)
+		{
+			return AppendFormatted(v);
+		}
+
+		typedef typename std::make_unsigned<T>::type UnsignedType;
+		char buf[24];
+		char * end = buf + sizeof(buf);
+		char * p = end;
+		UnsignedType u = (UnsignedType)v;
+		bool negative = std::is_signed<T>::value && v < (T)0;
+		if (negative)
+		{
+			u = (UnsignedType)0 - u;
+		}
+
+		do
+		{
+			*(--p) = (char)('0' + u % 10);
+			u /= 10;
+		} while (u > 0);
+
+		if (negative)
+		{
+			*(--p) = '-';
+		}
+
+		_line.append(p, end - p);
+		return *this;
+	}
+
+	LogStream & AppendDouble(double v);
+
+	// 将当前行提交到线程的暂存缓冲区
+	void Commit();
 
 private:
-	LogStreamBuf _log_buf;
+	LogThreadBuffer & _thread_buf;
+	std::string & _line;
+	size_t _line_start;      // 本日志流在行缓冲区中的起始位置(格式化参数时可能嵌套写日志)
+	Logger * _logger;
+	int64_t _cur_time;
     LogLevel _log_lv;
+	std::unique_ptr<std::ostringstream> _fmt;     // 格式化流(第一次用到时创建)
+	bool _fmt_active;                             // 格式化流的格式不是默认值，所有输出都要经过它
 };
 
 #define ENDL std::endl;
@@ -182,8 +646,22 @@ private:
 // 初始化日志模块
 #define INITIALIZE_LOG(log_dir, log_base_name) sframe::LoggerMgr::Instance().Initialize((log_dir), (log_base_name))
 
-// 按级别日志
-#define LOG_LEVEL(lv) sframe::LogStream("", lv) \
+// 设置日志时间是否显示毫秒
+#define SET_LOG_SHOW_MILLISECONDS(show) sframe::LoggerMgr::Instance().SetShowMilliseconds((show))
+
+// 用于在条件表达式中丢弃日志流
+class LogStreamVoidify
+{
+public:
+	void operator&(LogStream &) {}
+};
+
+// 编译期是否开启此级别
+#define SFRAME_LOG_COMPILE_ENABLED(lv) ((lv) == sframe::kLogLevel_None || (lv) >= SFRAME_LOG_MIN_LEVEL)
+
+// 按级别日志(级别不输出时只有一次判断，不会对<<后的参数求值)
+#define LOG_LEVEL(lv) !(SFRAME_LOG_COMPILE_ENABLED(lv) && sframe::LoggerMgr::IsLevelEnabled(lv)) ? (void)0 : \
+	sframe::LogStreamVoidify() & sframe::LogStream(sframe::LoggerMgr::Instance().GetDefaultLogger(), lv) \
 	<< sframe::FileHelper::GetFileName(__FILE__) << ':' << __LINE__ << '|'
 
 #define LOG_TRACE    LOG_LEVEL(sframe::LogLevel::kLogLevel_Trace)
@@ -191,9 +669,20 @@ private:
 #define LOG_WARN     LOG_LEVEL(sframe::LogLevel::kLogLevel_Warn)
 #define LOG_ERROR    LOG_LEVEL(sframe::LogLevel::kLogLevel_Error)
 
-// 分模块日志
-#define FLOG(log_name) sframe::LogStream(log_name) << sframe::FileHelper::GetFileName(__FILE__) << ':' << __LINE__ << '|'
+// 分模块按级别日志(可通过LoggerMgr::SetLoggerLevel单独设置模块的级别)
+#define FLOG_LEVEL(log_name, lv) \
+	for (sframe::Logger * sframe_flog_logger_ = (SFRAME_LOG_COMPILE_ENABLED(lv) ? sframe::LoggerMgr::Instance().GetEnabledLogger((log_name), (lv)) : nullptr); \
+		sframe_flog_logger_; sframe_flog_logger_ = nullptr) \
+		sframe::LogStream(*sframe_flog_logger_, (lv)) << sframe::FileHelper::GetFileName(__FILE__) << ':' << __LINE__ << '|'
+
+#define FLOG_TRACE(log_name)    FLOG_LEVEL(log_name, sframe::LogLevel::kLogLevel_Trace)
+#define FLOG_INFO(log_name)     FLOG_LEVEL(log_name, sframe::LogLevel::kLogLevel_Info)
+#define FLOG_WARN(log_name)     FLOG_LEVEL(log_name, sframe::LogLevel::kLogLevel_Warn)
+#define FLOG_ERROR(log_name)    FLOG_LEVEL(log_name, sframe::LogLevel::kLogLevel_Error)
+
+// 分模块日志(没有级别，按错误级别过滤)
+#define FLOG(log_name) FLOG_LEVEL(log_name, sframe::LogLevel::kLogLevel_None)
 
 }
 
-#endif
\ No newline at end of file
+#endif
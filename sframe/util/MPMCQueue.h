@@ -0,0 +1,178 @@
+
+#ifndef SFRAME_MPMC_QUEUE_H
+#define SFRAME_MPMC_QUEUE_H
+
+#include <inttypes.h>
+#include <assert.h>
+#include <stddef.h>
+#include <new>
+#include <utility>
+#include <type_traits>
+#include <atomic>
+#include "Singleton.h"
+
+namespace sframe {
+
+/*
+	有界无锁多生产者多消费者队列
+	每个单元带一个序号：序号等于写位置时可写，等于读位置+1时可读，生产者和消费者各自用CAS抢位置，
+	抢到后只访问自己的单元，互不干扰。读写位置分别独占缓存行，避免生产者和消费者互相失效
+*/
+template<typename T>
+class MPMCQueue : public noncopyable
+{
+public:
+	static const size_t kCacheLineSize = 64;
+
+	// 容量向上取整为2的幂
+	explicit MPMCQueue(size_t capacity) : _enqueue_pos(0), _dequeue_pos(0)
+	{
+		_capacity = 2;
+		while (_capacity < capacity)
+		{
+			_capacity <<= 1;
+		}
+		_mask = _capacity - 1;
+
+		// 单元数组按缓存行对齐
+		_mem = new char[sizeof(Cell) * _capacity + kCacheLineSize];
+		_cells = (Cell *)(((uintptr_t)_mem + kCacheLineSize - 1) & ~(uintptr_t)(kCacheLineSize - 1));
+		for (size_t i = 0; i < _capacity; i++)
+		{
+			new(&_cells[i]) Cell();
+			_cells[i].seq.store(i, std::memory_order_relaxed);
+		}
+	}
+
+	~MPMCQueue()
+	{
+		while (TryPop(nullptr)) {}
+
+		for (size_t i = 0; i < _capacity; i++)
+		{
+			_cells[i].~Cell();
+		}
+		delete[] _mem;
+	}
+
+	// 压入，队列满时返回false
+	bool TryPush(const T & val)
+	{
+		return Emplace(val);
+	}
+
+	bool TryPush(T && val)
+	{
+		return Emplace(std::move(val));
+	}
+
+	// 弹出，队列空时返回false
+	bool TryPop(T * val)
+	{
+		size_t pos = _dequeue_pos.load(std::memory_order_relaxed);
+		Cell * cell;
+
+		while (true)
+		{
+			cell = &_cells[pos & _mask];
+			size_t seq = cell->seq.load(std::memory_order_acquire);
+			intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);
+			if (diff == 0)
+			{
+				if (_dequeue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+				{
+					break;
+				}
+			}
+			else if (diff < 0)
+			{
+				return false;
+			}
+			else
+			{
+				pos = _dequeue_pos.load(std::memory_order_relaxed);
+			}
+		}
+
+		T * data = cell->GetData();
+		if (val)
+		{
+			*val = std::move(*data);
+		}
+		data->~T();
+		cell->seq.store(pos + _mask + 1, std::memory_order_release);
+		return true;
+	}
+
+	// 是否为空(并发时只是近似值)
+	bool IsEmpty() const
+	{
+		return _dequeue_pos.load(std::memory_order_relaxed) >= _enqueue_pos.load(std::memory_order_relaxed);
+	}
+
+	size_t GetCapacity() const
+	{
+		return _capacity;
+	}
+
+private:
+	struct Cell
+	{
+		T * GetData()
+		{
+			return reinterpret_cast<T *>(&data);
+		}
+
+		std::atomic<size_t> seq;
+		typename std::aligned_storage<sizeof(T), alignof(T)>::type data;
+	};
+
+	template<typename T_Val>
+	bool Emplace(T_Val && val)
+	{
+		size_t pos = _enqueue_pos.load(std::memory_order_relaxed);
+		Cell * cell;
+
+		while (true)
+		{
+			cell = &_cells[pos & _mask];
+			size_t seq = cell->seq.load(std::memory_order_acquire);
+			intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+			if (diff == 0)
+			{
+				if (_enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+				{
+					break;
+				}
+			}
+			else if (diff < 0)
+			{
+				return false;
+			}
+			else
+			{
+				pos = _enqueue_pos.load(std::memory_order_relaxed);
+			}
+		}
+
+		new(cell->GetData()) T(std::forward<T_Val>(val));
+		cell->seq.store(pos + 1, std::memory_order_release);
+		return true;
+	}
+
+private:
+	char _pad0[kCacheLineSize];
+	Cell * _cells;
+	char * _mem;
+	size_t _capacity;
+	size_t _mask;
+	char _pad1[kCacheLineSize];
+	std::atomic<size_t> _enqueue_pos;
+	char _pad2[kCacheLineSize - sizeof(std::atomic<size_t>)];
+	std::atomic<size_t> _dequeue_pos;
+	char _pad3[kCacheLineSize - sizeof(std::atomic<size_t>)];
+};
+
+}
+
+#endif
@@ -1,51 +1,102 @@
 ﻿
 #include "ObjectPool.h"
 #include <assert.h>
+#include <string.h>
+#include <stdlib.h>
+#include <algorithm>
+#ifndef __GNUC__
+#include <malloc.h>
+#else
+#include <cxxabi.h>
+#include <sys/mman.h>
+#endif
 
 using namespace sframe;
 
-FreeMemoryList::FreeMemoryList(int chunk_size, int max_free_list_len)
+// 按align对齐申请内存(align为2的幂)
+static void * AlignedAlloc(size_t size, size_t align)
+{
+#ifndef __GNUC__
+	return _aligned_malloc(size, align);
+#else
+	void * mem = nullptr;
+	return posix_memalign(&mem, align, size) == 0 ? mem : nullptr;
+#endif
+}
+
+static void AlignedFree(void * mem)
+{
+#ifndef __GNUC__
+	_aligned_free(mem);
+#else
+	free(mem);
+#endif
+}
+
+// 类型名(gcc下还原为可读的名字)
+static std::string GetReadableTypeName(const char * name)
+{
+#ifdef __GNUC__
+	int status = 0;
+	char * demangled = abi::__cxa_demangle(name, nullptr, nullptr, &status);
+	if (demangled)
+	{
+		std::string readable(status == 0 ? demangled : name);
+		free(demangled);
+		return readable;
+	}
+#endif
+	return name;
+}
+
+FreeMemoryList::FreeMemoryList(int chunk_size, int max_free_list_len, const char * name, int chunk_align)
+	: _slab_size(0), _slabs(nullptr), _slab_count(0), _carve_pos(nullptr), _carve_end(nullptr),
+	_pending_free_header(nullptr), _pending_free_len(0), _created_count(0), _outstanding(0), _peak_outstanding(0),
+	_retired_alloc_count(0), _retired_free_count(0)
 {
     _max_free_list_len = max_free_list_len;
     _free_list_len = 0;
-    _memory_chunk_size = chunk_size > (int32_t)sizeof(ListNode) ? chunk_size : (int32_t)sizeof(ListNode);
     _free_list_header = nullptr;
+
+	// 内存块大小按对齐要求向上取整，保证切分出的每个内存块都是对齐的
+	_chunk_align = chunk_align > (int32_t)alignof(ListNode) ? chunk_align : (int32_t)alignof(ListNode);
+	assert((_chunk_align & (_chunk_align - 1)) == 0);
+	_memory_chunk_size = chunk_size > (int32_t)sizeof(ListNode) ? chunk_size : (int32_t)sizeof(ListNode);
+	_memory_chunk_size = (_memory_chunk_size + _chunk_align - 1) & ~(_chunk_align - 1);
+	_slab_chunk_offset = ((int32_t)sizeof(SlabHeader) + _chunk_align - 1) & ~(_chunk_align - 1);
+
+	_batch_size = max_free_list_len / 8;
+	_batch_size = _batch_size < 1 ? 1 : (_batch_size > FreeMemoryCache::kMaxBatchSize ? FreeMemoryCache::kMaxBatchSize : _batch_size);
+	_name = GetReadableTypeName(name ? name : "");
+
+	// 先于本对象构造完成，保证在本对象之后析构
+	ObjectPoolMgr::Instance().Regist(this);
 }
 
 FreeMemoryList::~FreeMemoryList()
 {
-    void * cur = _free_list_header;
-    while (cur)
-    {
-        void * next = ((ListNode*)cur)->next;
-        delete[] (unsigned char*)cur;
-        cur = next;
-    }
+	ObjectPoolMgr::Instance().Unregist(this);
+
+	// 还有没释放的对象时不释放内存页(退出时可能还有对象在使用)
+	if (_outstanding.load() != 0)
+	{
+		return;
+	}
+
+	while (_slabs)
+	{
+		SlabHeader * slab = _slabs;
+		_slabs = slab->next;
+		FreeSlab(slab);
+	}
 }
 
 // 获取一个内存块
 void * FreeMemoryList::GetMemoryChunk()
 {
-    AUTO_LOCK(_locker);
-
-    void * chunk = nullptr;
-
-    // 从空闲链表中取
-    if (_free_list_header != nullptr)
-    {
-        chunk = _free_list_header;
-        _free_list_header = ((ListNode*)_free_list_header)->next;
-        _free_list_len--;
-        assert(_free_list_len >= 0);
-    }
-
-    // 没有取到，new一块新内存
-    if (chunk == nullptr)
-    {
-        chunk = new unsigned char[_memory_chunk_size];
-    }
-
-    return chunk;
+	void * chunk = nullptr;
+	GetMemoryChunks(&chunk, 1);
+	return chunk;
 }
 
 // 释放内存块
@@ -54,17 +105,380 @@ void FreeMemoryList::FreeMemoryChunk(void * memory_chunk)
     if (memory_chunk == nullptr)
         return;
 
-    AUTO_LOCK(_locker);
-
-    if (_free_list_len < _max_free_list_len)
-    {
-        // 将内存块插入到头部
-        ((ListNode*)memory_chunk)->next = _free_list_header;
-        _free_list_header = memory_chunk;
-        _free_list_len++;
-    }
-    else
-    {
-        delete[] (unsigned char*)memory_chunk;
-    }
-}
\ No newline at end of file
+    FreeMemoryChunks(&memory_chunk, 1);
+}
+
+int32_t FreeMemoryList::GetMemoryChunks(void ** chunks, int32_t count)
+{
+	int32_t n = 0;
+
+	// 从空闲链表中取
+	{
+		AUTO_LOCK(_locker);
+
+		if (_free_list_len.load(std::memory_order_relaxed) < count)
+		{
+			TakePendingFreeChunks();
+		}
+
+		while (n < count && _free_list_header != nullptr)
+		{
+			chunks[n++] = _free_list_header;
+			_free_list_header = ((ListNode*)_free_list_header)->next;
+			_free_list_len.fetch_sub(1, std::memory_order_relaxed);
+		}
+
+		assert(_free_list_len.load(std::memory_order_relaxed) >= 0);
+
+		// 不够的从内存页切分
+		if (n < count)
+		{
+			CarveChunks(chunks + n, count - n);
+			_created_count.fetch_add(count - n, std::memory_order_relaxed);
+			n = count;
+		}
+	}
+
+	int64_t outstanding = _outstanding.fetch_add(n, std::memory_order_relaxed) + n;
+	int64_t peak = _peak_outstanding.load(std::memory_order_relaxed);
+	while (outstanding > peak && !_peak_outstanding.compare_exchange_weak(peak, outstanding, std::memory_order_relaxed)) {}
+
+	return n;
+}
+
+void FreeMemoryList::FreeMemoryChunks(void ** chunks, int32_t count)
+{
+	if (count <= 0)
+	{
+		return;
+	}
+
+	_outstanding.fetch_sub(count, std::memory_order_relaxed);
+
+	// 串成链后整体压入待回收栈
+	for (int32_t i = 0; i < count - 1; i++)
+	{
+		((ListNode*)chunks[i])->next = chunks[i + 1];
+	}
+
+	ListNode * tail = (ListNode*)chunks[count - 1];
+	void * header = _pending_free_header.load(std::memory_order_relaxed);
+	do
+	{
+		tail->next = header;
+	} while (!_pending_free_header.compare_exchange_weak(header, chunks[0], std::memory_order_release, std::memory_order_relaxed));
+
+	_pending_free_len.fetch_add(count, std::memory_order_relaxed);
+}
+
+int64_t FreeMemoryList::ReleaseFreeSlabs()
+{
+	std::vector<SlabHeader*> free_slabs;
+
+	{
+		AUTO_LOCK(_locker);
+
+		TakePendingFreeChunks();
+
+		// 统计每个内存页中空闲的内存块数
+		for (void * cur = _free_list_header; cur; cur = ((ListNode*)cur)->next)
+		{
+			GetSlab(cur)->free_count++;
+		}
+
+		// 所有切分出的内存块都空闲的页可以释放
+		int32_t free_list_len = _free_list_len.load(std::memory_order_relaxed);
+		for (SlabHeader * slab = _slabs; slab; slab = slab->next)
+		{
+			if (slab->free_count == slab->chunk_count && free_list_len - slab->free_count >= _max_free_list_len)
+			{
+				free_list_len -= slab->free_count;
+				slab->free_count = -1;
+				free_slabs.push_back(slab);
+			}
+		}
+
+		// 从空闲链表中去掉要释放的页中的内存块
+		if (!free_slabs.empty())
+		{
+			void ** link = &_free_list_header;
+			void * cur = _free_list_header;
+			while (cur)
+			{
+				void * next = ((ListNode*)cur)->next;
+				if (GetSlab(cur)->free_count >= 0)
+				{
+					*link = cur;
+					link = &((ListNode*)cur)->next;
+				}
+				cur = next;
+			}
+			*link = nullptr;
+			_free_list_len.store(free_list_len, std::memory_order_relaxed);
+
+			for (SlabHeader * slab : free_slabs)
+			{
+				if (slab->prev)
+				{
+					slab->prev->next = slab->next;
+				}
+				else
+				{
+					_slabs = slab->next;
+				}
+
+				if (slab->next)
+				{
+					slab->next->prev = slab->prev;
+				}
+
+				if (_carve_pos && GetSlab(_carve_pos) == slab)
+				{
+					_carve_pos = nullptr;
+					_carve_end = nullptr;
+				}
+
+				_slab_count--;
+			}
+		}
+
+		for (SlabHeader * slab = _slabs; slab; slab = slab->next)
+		{
+			slab->free_count = 0;
+		}
+	}
+
+	for (SlabHeader * slab : free_slabs)
+	{
+		FreeSlab(slab);
+	}
+
+	return (int64_t)free_slabs.size() * _slab_size;
+}
+
+void FreeMemoryList::TakePendingFreeChunks()
+{
+	void * pending = _pending_free_header.exchange(nullptr, std::memory_order_acquire);
+	if (pending == nullptr)
+	{
+		return;
+	}
+
+	int32_t n = 1;
+	ListNode * tail = (ListNode*)pending;
+	while (tail->next)
+	{
+		tail = (ListNode*)tail->next;
+		n++;
+	}
+
+	tail->next = _free_list_header;
+	_free_list_header = pending;
+	_free_list_len.fetch_add(n, std::memory_order_relaxed);
+	_pending_free_len.fetch_sub(n, std::memory_order_relaxed);
+}
+
+void FreeMemoryList::CarveChunks(void ** chunks, int32_t count)
+{
+	for (int32_t i = 0; i < count; i++)
+	{
+		if (_carve_pos == _carve_end && !AllocSlab())
+		{
+			throw std::bad_alloc();
+		}
+
+		chunks[i] = _carve_pos;
+		GetSlab(_carve_pos)->chunk_count++;
+		_carve_pos += _memory_chunk_size;
+	}
+}
+
+bool FreeMemoryList::AllocSlab()
+{
+	// 页大小在第一次申请时确定(至少能切分出kMinChunksPerSlab个内存块)
+	if (_slab_size == 0)
+	{
+		int64_t min_size = (int64_t)_slab_chunk_offset + (int64_t)_memory_chunk_size * kMinChunksPerSlab;
+		int64_t slab_size = ObjectPoolMgr::Instance().IsHugePageEnabled() ? kHugePageSize : kDefaultSlabSize;
+		while (slab_size < min_size)
+		{
+			slab_size <<= 1;
+		}
+		assert(slab_size <= 0x40000000);
+		_slab_size = (int32_t)slab_size;
+	}
+
+	void * mem = AlignedAlloc((size_t)_slab_size, (size_t)_slab_size);
+	if (!mem)
+	{
+		return false;
+	}
+
+#if defined(__GNUC__) && defined(MADV_HUGEPAGE)
+	if (_slab_size % kHugePageSize == 0 && ObjectPoolMgr::Instance().IsHugePageEnabled())
+	{
+		madvise(mem, (size_t)_slab_size, MADV_HUGEPAGE);
+	}
+#endif
+
+	SlabHeader * slab = (SlabHeader *)mem;
+	slab->prev = nullptr;
+	slab->next = _slabs;
+	slab->chunk_count = 0;
+	slab->free_count = 0;
+	if (_slabs)
+	{
+		_slabs->prev = slab;
+	}
+	_slabs = slab;
+	_slab_count++;
+
+	int32_t chunks_per_slab = (_slab_size - _slab_chunk_offset) / _memory_chunk_size;
+	_carve_pos = (char *)mem + _slab_chunk_offset;
+	_carve_end = _carve_pos + (int64_t)chunks_per_slab * _memory_chunk_size;
+
+	return true;
+}
+
+void FreeMemoryList::FreeSlab(SlabHeader * slab)
+{
+	AlignedFree(slab);
+}
+
+void FreeMemoryList::RegistCache(FreeMemoryCache * cache)
+{
+	AUTO_LOCK(_cache_lock);
+	_caches.push_back(cache);
+}
+
+void FreeMemoryList::UnregistCache(FreeMemoryCache * cache)
+{
+	AUTO_LOCK(_cache_lock);
+	auto it = std::find(_caches.begin(), _caches.end(), cache);
+	if (it != _caches.end())
+	{
+		_caches.erase(it);
+	}
+
+	_retired_alloc_count += cache->GetAllocCount();
+	_retired_free_count += cache->GetFreeCount();
+}
+
+ObjectPoolStats FreeMemoryList::GetStats()
+{
+	ObjectPoolStats stats;
+	stats.name = _name;
+	stats.chunk_size = _memory_chunk_size;
+	stats.cached = _free_list_len.load(std::memory_order_relaxed) + _pending_free_len.load(std::memory_order_relaxed);
+	stats.peak = _peak_outstanding.load(std::memory_order_relaxed);
+	stats.created = _created_count.load(std::memory_order_relaxed);
+	{
+		AUTO_LOCK(_locker);
+		stats.slab_size = _slab_size;
+		stats.slabs = _slab_count;
+	}
+
+	int64_t alloc_count = 0;
+	int64_t free_count = 0;
+	{
+		AUTO_LOCK(_cache_lock);
+		alloc_count = _retired_alloc_count;
+		free_count = _retired_free_count;
+		for (FreeMemoryCache * cache : _caches)
+		{
+			alloc_count += cache->GetAllocCount();
+			free_count += cache->GetFreeCount();
+			stats.cached += cache->GetCachedCount();
+		}
+	}
+
+	// 在一个线程创建、在另一个线程释放时，单个线程的计数可能为负，合计是准确的
+	stats.live = alloc_count - free_count;
+
+	return stats;
+}
+
+
+
+
+FreeMemoryCache::FreeMemoryCache(FreeMemoryList * free_list)
+	: _free_list(free_list), _capacity(free_list->GetBatchSize() * 2), _count(0), _alloc_count(0), _free_count(0), _cached_count(0)
+{
+	assert(_capacity <= kMaxBatchSize * 2);
+	_free_list->RegistCache(this);
+}
+
+FreeMemoryCache::~FreeMemoryCache()
+{
+	Flush(_count);
+	_free_list->UnregistCache(this);
+}
+
+bool FreeMemoryCache::Refill()
+{
+	assert(_count == 0);
+	_count = _free_list->GetMemoryChunks(_chunks, _free_list->GetBatchSize());
+	_cached_count.store(_count, std::memory_order_relaxed);
+	return _count > 0;
+}
+
+void FreeMemoryCache::Flush(int32_t count)
+{
+	count = std::min(count, _count);
+	if (count <= 0)
+	{
+		return;
+	}
+
+	// 还回最早放入的，留下最近释放的(更可能还在CPU缓存中)
+	_free_list->FreeMemoryChunks(_chunks, count);
+	_count -= count;
+	memmove(_chunks, _chunks + count, sizeof(_chunks[0]) * _count);
+	_cached_count.store(_count, std::memory_order_relaxed);
+}
+
+
+
+
+void ObjectPoolMgr::Regist(FreeMemoryList * free_list)
+{
+	AUTO_LOCK(_lock);
+	_free_lists.push_back(free_list);
+}
+
+void ObjectPoolMgr::Unregist(FreeMemoryList * free_list)
+{
+	AUTO_LOCK(_lock);
+	auto it = std::find(_free_lists.begin(), _free_lists.end(), free_list);
+	if (it != _free_lists.end())
+	{
+		_free_lists.erase(it);
+	}
+}
+
+int64_t ObjectPoolMgr::ReleaseFreeMemory()
+{
+	AUTO_LOCK(_lock);
+
+	int64_t released = 0;
+	for (FreeMemoryList * free_list : _free_lists)
+	{
+		released += free_list->ReleaseFreeSlabs();
+	}
+
+	return released;
+}
+
+std::vector<ObjectPoolStats> ObjectPoolMgr::GetAllStats()
+{
+	AUTO_LOCK(_lock);
+
+	std::vector<ObjectPoolStats> stats;
+	stats.reserve(_free_lists.size());
+	for (FreeMemoryList * free_list : _free_lists)
+	{
+		stats.push_back(free_list->GetStats());
+	}
+
+	return stats;
+}
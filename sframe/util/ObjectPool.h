@@ -5,13 +5,35 @@
 #include <inttypes.h>
 #include <new>
 #include <utility>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <typeinfo>
 #include <type_traits>
 #include "Lock.h"
 #include "Singleton.h"
 
 namespace sframe{
 
-// 空闲内存链表
+class FreeMemoryCache;
+
+// 对象池统计
+struct ObjectPoolStats
+{
+	std::string name;        // 对象类型
+	int32_t chunk_size;      // 内存块大小
+	int64_t live;            // 正在使用的对象数
+	int64_t cached;          // 空闲的内存块数(空闲链表和各线程缓存中的)
+	int64_t peak;            // 分配出去的内存块数(正在使用的和线程缓存中的)的峰值
+	int64_t created;         // 累计切分出的内存块数
+	int32_t slab_size;       // 内存页大小
+	int64_t slabs;           // 内存页数
+};
+
+// 空闲内存链表(所有线程共享，各线程通过FreeMemoryCache成批存取)
+// 取内存块需要加锁；释放的内存块无锁压入待回收栈，取的时候空闲链表不够了才整体接过来，所以跨线程释放不会争抢锁
+// 内存块从按页大小对齐的内存页(slab)中切分，空闲链表为空时才从当前页切下一块，页用完了再申请新页
+// 内存页不会自动释放，流量高峰过后可以调用ReleaseFreeSlabs把完全空闲的页还给系统
 class FreeMemoryList
 {
 private:
@@ -21,9 +43,24 @@ private:
         void * next;
     };
 
+	// 内存页头部(位于页的开头，内存块地址按页大小对齐即可找到所在的页)
+	struct SlabHeader
+	{
+		SlabHeader * prev;
+		SlabHeader * next;
+		int32_t chunk_count;      // 已切分的内存块数
+		int32_t free_count;       // 释放内存页时统计用
+	};
+
 public:
 
-    FreeMemoryList(int chunk_size, int max_free_list_len);
+	static const int32_t kDefaultSlabSize = 64 * 1024;
+
+	static const int32_t kHugePageSize = 2 * 1024 * 1024;
+
+	static const int32_t kMinChunksPerSlab = 8;
+
+    FreeMemoryList(int chunk_size, int max_free_list_len, const char * name = "", int chunk_align = (int)alignof(void*));
 
     ~FreeMemoryList();
 
@@ -33,12 +70,174 @@ public:
     // 释放内存块
     void FreeMemoryChunk(void * memory_chunk);
 
+	// 成批获取内存块(不够时新申请)，返回获取的数量
+	int32_t GetMemoryChunks(void ** chunks, int32_t count);
+
+	// 成批释放内存块(无锁)
+	void FreeMemoryChunks(void ** chunks, int32_t count);
+
+	// 把完全空闲的内存页还给系统(线程缓存中的内存块不会被释放)，至少保留max_free_list_len个空闲内存块，返回释放的字节数
+	int64_t ReleaseFreeSlabs();
+
+	// 线程缓存每次成批存取的数量
+	int32_t GetBatchSize() const
+	{
+		return _batch_size;
+	}
+
+	// 线程缓存的注册与注销(注销时合并其计数)
+	void RegistCache(FreeMemoryCache * cache);
+
+	void UnregistCache(FreeMemoryCache * cache);
+
+	ObjectPoolStats GetStats();
+
+private:
+	// 把待回收栈整体接到空闲链表(需持有_locker)
+	void TakePendingFreeChunks();
+
+	// 从内存页切分count个内存块(需持有_locker)
+	void CarveChunks(void ** chunks, int32_t count);
+
+	// 申请新的内存页(需持有_locker)
+	bool AllocSlab();
+
+	void FreeSlab(SlabHeader * slab);
+
+	SlabHeader * GetSlab(void * chunk) const
+	{
+		return (SlabHeader *)((uintptr_t)chunk & ~((uintptr_t)_slab_size - 1));
+	}
+
 private:
     int _memory_chunk_size;   // 内存快大小
     int _max_free_list_len;  // 最大空闲内存快数量
-    int _free_list_len;
+    std::atomic<int> _free_list_len;
     void * _free_list_header; // 空闲内存链表头
     Lock _locker;
+	int32_t _batch_size;
+	std::string _name;
+	int32_t _chunk_align;
+	int32_t _slab_size;                          // 第一次申请内存页时确定
+	int32_t _slab_chunk_offset;                  // 页中第一个内存块的偏移
+	SlabHeader * _slabs;                         // 所有内存页
+	int64_t _slab_count;
+	char * _carve_pos;                           // 当前页未切分部分
+	char * _carve_end;
+	std::atomic<void*> _pending_free_header;     // 待回收栈(无锁压入)
+	std::atomic<int32_t> _pending_free_len;
+	std::atomic<int64_t> _created_count;
+	std::atomic<int64_t> _outstanding;          // 分配出去的内存块数
+	std::atomic<int64_t> _peak_outstanding;
+	Lock _cache_lock;
+	std::vector<FreeMemoryCache*> _caches;      // 各线程的缓存
+	int64_t _retired_alloc_count;               // 已退出线程的分配、释放计数
+	int64_t _retired_free_count;
+};
+
+// 线程的内存块缓存(tcmalloc式的弹匣)
+// 只有所属线程存取，不加锁；空了从空闲链表成批取，满了成批还回去
+class FreeMemoryCache : public noncopyable
+{
+public:
+	static const int32_t kMaxBatchSize = 32;
+
+	FreeMemoryCache(FreeMemoryList * free_list);
+
+	~FreeMemoryCache();
+
+	void * Get()
+	{
+		if (_count == 0 && !Refill())
+		{
+			return nullptr;
+		}
+
+		AddCount(_alloc_count, 1);
+		_cached_count.store(_count - 1, std::memory_order_relaxed);
+		return _chunks[--_count];
+	}
+
+	void Free(void * chunk)
+	{
+		if (_count == _capacity)
+		{
+			Flush(_free_list->GetBatchSize());
+		}
+
+		AddCount(_free_count, 1);
+		_chunks[_count++] = chunk;
+		_cached_count.store(_count, std::memory_order_relaxed);
+	}
+
+	// 统计(其他线程读取)
+	int64_t GetAllocCount() const
+	{
+		return _alloc_count.load(std::memory_order_relaxed);
+	}
+
+	int64_t GetFreeCount() const
+	{
+		return _free_count.load(std::memory_order_relaxed);
+	}
+
+	int32_t GetCachedCount() const
+	{
+		return _cached_count.load(std::memory_order_relaxed);
+	}
+
+private:
+	// 只有所属线程修改，relaxed读写即可
+	static void AddCount(std::atomic<int64_t> & counter, int64_t n)
+	{
+		counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+	}
+
+	bool Refill();
+
+	// 还回count个内存块
+	void Flush(int32_t count);
+
+private:
+	FreeMemoryList * _free_list;
+	int32_t _capacity;
+	int32_t _count;
+	void * _chunks[kMaxBatchSize * 2];
+	std::atomic<int64_t> _alloc_count;
+	std::atomic<int64_t> _free_count;
+	std::atomic<int32_t> _cached_count;
+};
+
+// 所有对象池(用于查看统计)
+class ObjectPoolMgr : public singleton<ObjectPoolMgr>
+{
+public:
+	ObjectPoolMgr() : _huge_page_enabled(false) {}
+
+	void Regist(FreeMemoryList * free_list);
+
+	void Unregist(FreeMemoryList * free_list);
+
+	std::vector<ObjectPoolStats> GetAllStats();
+
+	// 释放所有对象池中完全空闲的内存页，返回释放的字节数
+	int64_t ReleaseFreeMemory();
+
+	// 内存页是否使用大页(2MB，Linux下通过透明大页)，须在创建对象之前设置
+	void SetHugePageEnabled(bool enabled)
+	{
+		_huge_page_enabled.store(enabled, std::memory_order_relaxed);
+	}
+
+	bool IsHugePageEnabled() const
+	{
+		return _huge_page_enabled.load(std::memory_order_relaxed);
+	}
+
+private:
+	Lock _lock;
+	std::vector<FreeMemoryList*> _free_lists;
+	std::atomic<bool> _huge_page_enabled;
 };
 
 class MaxObjectPoolSize
@@ -72,18 +271,18 @@ public:
 	}
 };
 
-// 通用对象池
+// 通用对象池(每个线程有自己的缓存，可以在任意线程创建和释放)
 template<typename T>
 class ObjectPool : public singleton<ObjectPool<T>>
 {
 public:
-    ObjectPool() : _free_memory_list(sizeof(T), MaxObjectPoolSize::GetSize<T>()) {}
+    ObjectPool() : _free_memory_list(sizeof(T), MaxObjectPoolSize::GetSize<T>(), typeid(T).name(), (int)alignof(T)) {}
 
 	// 创建对象
 	template<typename... T_Args>
 	T * New(T_Args&... args)
 	{
-		void * mem = _free_memory_list.GetMemoryChunk();
+		void * mem = GetThreadCache().Get();
 		T * obj = new(mem)T(std::forward<T_Args>(args)...);
 		return obj;
 	}
@@ -94,9 +293,27 @@ public:
         if (obj == nullptr)
             return;
         obj->~T();
-        _free_memory_list.FreeMemoryChunk((char*)obj);
+        GetThreadCache().Free(obj);
     }
 
+	ObjectPoolStats GetStats()
+	{
+		return _free_memory_list.GetStats();
+	}
+
+	// 把完全空闲的内存页还给系统
+	int64_t ReleaseFreeSlabs()
+	{
+		return _free_memory_list.ReleaseFreeSlabs();
+	}
+
+private:
+	FreeMemoryCache & GetThreadCache()
+	{
+		static thread_local FreeMemoryCache cache(&_free_memory_list);
+		return cache;
+	}
+
 private:
     FreeMemoryList _free_memory_list;  // 空闲内存链表
 };
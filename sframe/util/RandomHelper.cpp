@@ -1,30 +1,71 @@
 ﻿
 #include <time.h>
 #include <assert.h>
+#include <chrono>
+#include <thread>
+#include <functional>
 #include "RandomHelper.h"
 
 using namespace sframe;
 
-inline std::default_random_engine& GetEngine()
+// 种子：random_device、时间、线程ID和一个地址混合，random_device不可用(抛异常或者是确定性实现)时也能保证各线程不同
+static uint64_t MakeThreadSeed()
 {
-    static std::default_random_engine eng(static_cast<int>(time(nullptr)));
-    return eng;
+	uint64_t seed = (uint64_t)std::chrono::high_resolution_clock::now().time_since_epoch().count();
+	seed ^= (uint64_t)std::hash<std::thread::id>()(std::this_thread::get_id()) * 0x9e3779b97f4a7c15ull;
+	seed ^= (uint64_t)(uintptr_t)&seed;
+
+	try
+	{
+		std::random_device rd;
+		seed ^= ((uint64_t)rd() << 32) | (uint64_t)rd();
+	}
+	catch (...)
+	{
+		seed ^= (uint64_t)time(nullptr);
+	}
+
+	return seed;
+}
+
+RandomEngine & sframe::GetThreadRandomEngine()
+{
+	static thread_local RandomEngine eng(MakeThreadSeed());
+	return eng;
 }
 
 void sframe::Rand(int min_num, int max_num, int count, std::vector<int> & random_numerbs)
 {
-    assert(max_num > min_num);
-    auto& eng = GetEngine();
-    std::uniform_int_distribution<int> u(min_num, max_num - 1);
-    for (int i = 0; i < count; ++i)
-    {
-        random_numerbs.push_back(u(eng));
-    }
+	assert(max_num > min_num);
+	if (count <= 0)
+	{
+		return;
+	}
+
+	size_t old_size = random_numerbs.size();
+	random_numerbs.resize(old_size + count);
+	Rand(min_num, max_num, &random_numerbs[old_size], count);
+}
+
+void sframe::Rand(int min_num, int max_num, int * arr, int count)
+{
+	assert(max_num > min_num);
+	RandomEngine & eng = GetThreadRandomEngine();
+	uint32_t range = (uint32_t)((int64_t)max_num - (int64_t)min_num);
+	for (int i = 0; i < count; ++i)
+	{
+		arr[i] = (int)((int64_t)min_num + eng.NextBounded(range));
+	}
 }
 
 int sframe::Rand(int min_num, int max_num)
 {
-    assert(max_num > min_num);
-    auto& eng = GetEngine();
-    return std::uniform_int_distribution<int>(min_num, max_num - 1)(eng);
+	assert(max_num > min_num);
+	uint32_t range = (uint32_t)((int64_t)max_num - (int64_t)min_num);
+	return (int)((int64_t)min_num + GetThreadRandomEngine().NextBounded(range));
+}
+
+double sframe::RandDouble()
+{
+	return GetThreadRandomEngine().NextDouble();
 }
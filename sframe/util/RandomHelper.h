@@ -3,16 +3,115 @@
 #ifndef SFRAME_RANDOM_HELPER_H
 #define SFRAME_RANDOM_HELPER_H
 
+#include <inttypes.h>
+#include <vector>
 #include <random>
 
 namespace sframe {
 
+/*
+	xoshiro256**随机数引擎(周期2^256-1，比std::default_random_engine快，统计质量好，不能用于密码学)
+	满足UniformRandomBitGenerator，可以配合std的分布使用；不是线程安全的，多线程使用GetThreadRandomEngine()
+*/
+class RandomEngine
+{
+public:
+	typedef uint64_t result_type;
+
+	static constexpr result_type min()
+	{
+		return 0;
+	}
+
+	static constexpr result_type max()
+	{
+		return UINT64_MAX;
+	}
+
+	explicit RandomEngine(uint64_t seed)
+	{
+		Seed(seed);
+	}
+
+	// 用splitmix64把种子扩展为256位状态
+	void Seed(uint64_t seed)
+	{
+		for (int i = 0; i < 4; i++)
+		{
+			seed += 0x9e3779b97f4a7c15ull;
+			uint64_t z = seed;
+			z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+			z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+			_s[i] = z ^ (z >> 31);
+		}
+	}
+
+	uint64_t Next()
+	{
+		uint64_t result = RotateLeft(_s[1] * 5, 7) * 9;
+		uint64_t t = _s[1] << 17;
+		_s[2] ^= _s[0];
+		_s[3] ^= _s[1];
+		_s[1] ^= _s[2];
+		_s[0] ^= _s[3];
+		_s[2] ^= t;
+		_s[3] = RotateLeft(_s[3], 45);
+		return result;
+	}
+
+	result_type operator()()
+	{
+		return Next();
+	}
+
+	// [0, range)的无偏随机整数(Lemire乘法法，只有极少数情况需要除法和重试)
+	uint32_t NextBounded(uint32_t range)
+	{
+		uint64_t m = (Next() >> 32) * (uint64_t)range;
+		uint32_t low = (uint32_t)m;
+		if (low < range)
+		{
+			uint32_t threshold = (uint32_t)(0 - range) % range;
+			while (low < threshold)
+			{
+				m = (Next() >> 32) * (uint64_t)range;
+				low = (uint32_t)m;
+			}
+		}
+		return (uint32_t)(m >> 32);
+	}
+
+	// [0, 1)
+	double NextDouble()
+	{
+		return (double)(Next() >> 11) * (1.0 / 9007199254740992.0);
+	}
+
+private:
+	static uint64_t RotateLeft(uint64_t x, int k)
+	{
+		return (x << k) | (x >> (64 - k));
+	}
+
+private:
+	uint64_t _s[4];
+};
+
+// 当前线程的随机数引擎(第一次使用时用std::random_device等熵源播种)
+RandomEngine & GetThreadRandomEngine();
+
 // [min_num, max_num)
 void Rand(int min_num, int max_num, int count, std::vector<int> & random_numerbs);
 
+// [min_num, max_num)，填充数组
+void Rand(int min_num, int max_num, int * arr, int count);
+
 // [min_num, max_num)
 int Rand(int min_num, int max_num);
 
+// [0, 1)
+double RandDouble();
+
 }
 
-#endif
\ No newline at end of file
+#endif
@@ -3,6 +3,7 @@
 #define SFRAME_RING_QUEUE_H
 
 #include <inttypes.h>
+#include <assert.h>
 #include <string.h>
 #include <algorithm>
 #include <type_traits>
@@ -4,91 +4,111 @@
 
 using namespace sframe;
 
-size_t StreamWriter::GetSizeFieldSize(size_t s)
+size_t StreamWriter::PutUnsignedNumber(char * p, uint64_t n)
 {
-	return GetUnsignedNumberSize((uint64_t)s);
-}
-
-size_t StreamWriter::GetUnsignedNumberSize(uint64_t n)
-{
-	size_t ret = 0;
+	uint8_t * dst = (uint8_t *)p;
+	size_t num_bytes = 0;
 
 	if (n <= (uint64_t)0xfc)
 	{
-		ret = sizeof(uint8_t);
+		dst[0] = (uint8_t)n;
+		return sizeof(uint8_t);
 	}
 	else if (n <= (uint64_t)0xffff)
 	{
-		ret = sizeof(uint8_t) + sizeof(uint16_t);
+		dst[0] = 0xfd;
+		num_bytes = sizeof(uint16_t);
 	}
 	else if (n <= (uint64_t)0xffffffff)
 	{
-		ret = sizeof(uint8_t) + sizeof(uint32_t);
+		dst[0] = 0xfe;
+		num_bytes = sizeof(uint32_t);
 	}
 	else
 	{
-		ret = sizeof(uint8_t) + sizeof(uint64_t);
+		dst[0] = 0xff;
+		num_bytes = sizeof(uint64_t);
 	}
 
-	return ret;
-}
-
-bool StreamWriter::Write(const void * data, size_t len)
-{
-	if (len == 0 || _data_pos + len > _capacity)
+	// 网络字节序(大端)
+	for (size_t i = num_bytes; i > 0; i--)
 	{
-		return false;
+		dst[i] = (uint8_t)(n & 0xff);
+		n >>= 8;
 	}
 
-	memcpy(_buf + _data_pos, data, len);
-	_data_pos += len;
+	return sizeof(uint8_t) + num_bytes;
+}
 
-	return true;
+void StreamWriter::PutFixedSizeField(char * p, size_t s)
+{
+	uint8_t * dst = (uint8_t *)p;
+	dst[0] = 0xfe;
+	dst[1] = (uint8_t)((s >> 24) & 0xff);
+	dst[2] = (uint8_t)((s >> 16) & 0xff);
+	dst[3] = (uint8_t)((s >> 8) & 0xff);
+	dst[4] = (uint8_t)(s & 0xff);
 }
 
-bool StreamWriter::WriteSizeField(size_t s)
+StreamWriter::StreamWriter(std::string & str_buf, size_t init_capacity)
+	: _buf(nullptr), _capacity(0), _data_pos(0), _str_buf(&str_buf), _str_offset(str_buf.size())
 {
-	return WriteUnsignedNumber(s);
+	_capacity = init_capacity > 0 ? init_capacity : kDefaultInitCapacity;
+	_str_buf->resize(_str_offset + _capacity);
+	_buf = &(*_str_buf)[_str_offset];
 }
 
-bool StreamWriter::WriteUnsignedNumber(uint64_t n)
+StreamWriter::~StreamWriter()
 {
-	if (n <= (uint64_t)0xfc)
+	if (_str_buf)
 	{
-		uint8_t v = (uint8_t)n;
-		return Write((const void *)&v, sizeof(v));
+		_str_buf->resize(_str_offset + _data_pos);
 	}
-	else if (n <= (uint64_t)0xffff)
-	{
-		uint8_t v1 = 0xfd;
-		if (!Write((const void *)&v1, sizeof(v1)))
-		{
-			return false;
-		}
+}
 
-		uint16_t v2 = HTON_16(n);
-		return Write((const void *)&v2, sizeof(v2));
+bool StreamWriter::Grow(size_t len)
+{
+	if (_str_buf == nullptr)
+	{
+		return false;
 	}
-	else if (n <= (uint64_t)0xffffffff)
+
+	size_t new_capacity = std::max(_capacity * 2, _data_pos + len);
+	_str_buf->resize(_str_offset + new_capacity);
+	_buf = &(*_str_buf)[_str_offset];
+	_capacity = new_capacity;
+
+	return true;
+}
+
+bool StreamWriter::Write(const void * data, size_t len)
+{
+	if (len == 0)
 	{
-		uint8_t v1 = 0xfe;
-		if (!Write((const void *)&v1, sizeof(v1)))
-		{
-			return false;
-		}
+		return false;
+	}
 
-		uint32_t v2 = HTON_32(n);
-		return Write((const void *)&v2, sizeof(v2));
+	char * p = Reserve(len);
+	if (p == nullptr)
+	{
+		return false;
 	}
 
-	uint8_t v1 = 0xff;
-	if (!Write((const void *)&v1, sizeof(v1)))
+	memcpy(p, data, len);
+
+	return true;
+}
+
+bool StreamWriter::WriteUnsignedNumberSlow(uint64_t n)
+{
+	char * p = Reserve(GetUnsignedNumberSize(n));
+	if (p == nullptr)
 	{
 		return false;
 	}
 
-	uint64_t v2 = HTON_64(n);
-	return Write((const void *)&v2, sizeof(v2));
+	PutUnsignedNumber(p, n);
+	return true;
 }
 
 
@@ -129,47 +149,52 @@ bool StreamReader::ReadSizeField(size_t & s)
 	return true;
 }
 
-bool StreamReader::ReadUnsignedNumber(uint64_t & n)
+bool StreamReader::ReadUnsignedNumberSlow(uint64_t & n)
 {
-	uint8_t v1 = 0;
-	if (!Read((void*)&v1, sizeof(v1)))
+	if (_cur_pos >= _capacity)
 	{
 		return false;
 	}
 
+	uint8_t v1 = (uint8_t)_buf[_cur_pos];
+	size_t num_bytes = 0;
+
 	if (v1 <= 0xfc)
 	{
 		n = v1;
+		_cur_pos++;
+		return true;
 	}
 	else if (v1 == 0xfd)
 	{
-		uint16_t v2 = 0;
-		if (!Read((void*)&v2, sizeof(v2)))
-		{
-			return false;
-		}
-		n = (uint64_t)NTOH_16(v2);
+		num_bytes = sizeof(uint16_t);
 	}
 	else if (v1 == 0xfe)
 	{
-		uint32_t v2 = 0;
-		if (!Read((void*)&v2, sizeof(v2)))
-		{
-			return false;
-		}
-		n = (uint64_t)NTOH_32(v2);
+		num_bytes = sizeof(uint32_t);
 	}
 	else
 	{
 		assert(v1 == 0xff);
-		uint64_t v2 = 0;
-		if (!Read((void*)&v2, sizeof(v2)))
-		{
-			return false;
-		}
-		n = (uint64_t)NTOH_64(v2);
+		num_bytes = sizeof(uint64_t);
 	}
 
+	if (_cur_pos + sizeof(uint8_t) + num_bytes > _capacity)
+	{
+		return false;
+	}
+
+	// 网络字节序(大端)
+	const uint8_t * src = (const uint8_t *)_buf + _cur_pos + sizeof(uint8_t);
+	uint64_t v2 = 0;
+	for (size_t i = 0; i < num_bytes; i++)
+	{
+		v2 = (v2 << 8) | src[i];
+	}
+
+	n = v2;
+	_cur_pos += sizeof(uint8_t) + num_bytes;
+
 	return true;
 }
 
@@ -15,6 +15,7 @@
 #include <unordered_set>
 #include <memory>
 #include <type_traits>
+#include <tuple>
 
 namespace sframe{
 
@@ -22,11 +23,48 @@ class StreamWriter
 {
 public:
 
-	static size_t GetSizeFieldSize(size_t s);
+	static size_t GetSizeFieldSize(size_t s)
+	{
+		return GetUnsignedNumberSize((uint64_t)s);
+	}
+
+	static size_t GetUnsignedNumberSize(uint64_t n)
+	{
+		if (n <= (uint64_t)0xfc)
+		{
+			return sizeof(uint8_t);
+		}
+		else if (n <= (uint64_t)0xffff)
+		{
+			return sizeof(uint8_t) + sizeof(uint16_t);
+		}
+		else if (n <= (uint64_t)0xffffffff)
+		{
+			return sizeof(uint8_t) + sizeof(uint32_t);
+		}
+
+		return sizeof(uint8_t) + sizeof(uint64_t);
+	}
+
+	// 将无符号数写入指定位置(不检查容量，调用者须保证有GetUnsignedNumberSize(n)的空间)，返回写入长度
+	static size_t PutUnsignedNumber(char * p, uint64_t n);
 
-	static size_t GetUnsignedNumberSize(uint64_t n);
+	// 定长长度字段的长度(0xfe + 4字节，读取方按普通长度字段读取)
+	static const size_t kFixedSizeFieldSize = sizeof(uint8_t) + sizeof(uint32_t);
 
-	StreamWriter(char * buf, size_t len) : _buf(buf), _capacity(len), _data_pos(0) {}
+	// 写入定长的长度字段(不检查容量)
+	static void PutFixedSizeField(char * p, size_t s);
+
+	StreamWriter(char * buf, size_t len) : _buf(buf), _capacity(len), _data_pos(0), _str_buf(nullptr), _str_offset(0) {}
+
+	// 可增长的写入流：从str_buf末尾开始写入，空间不足时自动扩容，析构时截断多余的空间
+	StreamWriter(std::string & str_buf, size_t init_capacity = kDefaultInitCapacity);
+
+	StreamWriter(const StreamWriter &) = delete;
+
+	StreamWriter & operator= (const StreamWriter &) = delete;
+
+	~StreamWriter();
 
 	size_t GetStreamLength() const
 	{
@@ -38,16 +76,71 @@ public:
 		return _buf;
 	}
 
+	// 预留len字节，返回预留区域的起始位置，调用者须写满这len字节；空间不足返回nullptr
+	char * Reserve(size_t len)
+	{
+		if (_data_pos + len > _capacity && !Grow(len))
+		{
+			return nullptr;
+		}
+
+		char * p = _buf + _data_pos;
+		_data_pos += len;
+		return p;
+	}
+
 	bool Write(const void * data, size_t len);
 
-	bool WriteSizeField(size_t s);
+	bool WriteSizeField(size_t s)
+	{
+		return WriteUnsignedNumber(s);
+	}
+
+	// 预留一个定长的长度字段，之后用FillFixedSizeField回填，返回其位置，失败返回-1
+	size_t ReserveFixedSizeField()
+	{
+		size_t pos = _data_pos;
+		return Reserve(kFixedSizeFieldSize) ? pos : (size_t)-1;
+	}
 
-	bool WriteUnsignedNumber(uint64_t n);
+	// 回填定长的长度字段
+	bool FillFixedSizeField(size_t pos, size_t s)
+	{
+		if (pos + kFixedSizeFieldSize > _data_pos || (uint64_t)s > (uint64_t)0xffffffff)
+		{
+			return false;
+		}
+
+		PutFixedSizeField(_buf + pos, s);
+		return true;
+	}
+
+	bool WriteUnsignedNumber(uint64_t n)
+	{
+		// 单字节快速路径
+		if (n <= (uint64_t)0xfc && _data_pos < _capacity)
+		{
+			_buf[_data_pos++] = (char)(uint8_t)n;
+			return true;
+		}
+
+		return WriteUnsignedNumberSlow(n);
+	}
+
+private:
+	static const size_t kDefaultInitCapacity = 256;
+
+	bool WriteUnsignedNumberSlow(uint64_t n);
+
+	// 扩容，保证至少还能写入len字节（只有可增长的写入流才能扩容）
+	bool Grow(size_t len);
 
 private:
-	char * const _buf;       // 缓冲区
-	size_t _capacity;      // 容量
-	size_t _data_pos;      // 数据当前位置
+	char * _buf;             // 缓冲区
+	size_t _capacity;        // 容量
+	size_t _data_pos;        // 数据当前位置
+	std::string * _str_buf;  // 可增长的写入流的底层缓冲区
+	size_t _str_offset;      // 可增长的写入流在_str_buf中的起始位置
 };
 
 class StreamReader
@@ -76,14 +169,40 @@ public:
 
 	bool Read(std::string & s, size_t len);
 
+	// 不拷贝读取：data指向缓冲区中的数据，并前进len字节
+	bool ReadView(const char *& data, size_t len)
+	{
+		if (_cur_pos + len > _capacity)
+		{
+			return false;
+		}
+
+		data = _buf + _cur_pos;
+		_cur_pos += len;
+		return true;
+	}
+
 	bool ReadSizeField(size_t & s);
 
-	bool ReadUnsignedNumber(uint64_t & n);
+	bool ReadUnsignedNumber(uint64_t & n)
+	{
+		// 单字节快速路径
+		if (_cur_pos < _capacity && (uint8_t)_buf[_cur_pos] <= 0xfc)
+		{
+			n = (uint8_t)_buf[_cur_pos++];
+			return true;
+		}
+
+		return ReadUnsignedNumberSlow(n);
+	}
 
 	size_t ForwardCurPos(size_t len);
 
 	size_t BackwardCurPos(size_t len);
 
+private:
+	bool ReadUnsignedNumberSlow(uint64_t & n);
+
 private:
 	const char * const _buf;  // 缓冲区
 	size_t _cur_pos;        // 当前位置
@@ -337,19 +456,30 @@ struct Serializer<uint64_t> : Serializer_Num<uint64_t, uint64_t>
 {
 };
 
-template<>
-struct Serializer<std::string>
+template<typename T_Alloc>
+struct Serializer<std::basic_string<char, std::char_traits<char>, T_Alloc>>
 {
-	static bool Encode(StreamWriter & stream_writer, const std::string & v)
+	typedef std::basic_string<char, std::char_traits<char>, T_Alloc> String;
+
+	static bool Encode(StreamWriter & stream_writer, const String & v)
 	{
-		if (!stream_writer.WriteSizeField(v.length()))
+		size_t len = v.length();
+		char * p = stream_writer.Reserve(StreamWriter::GetSizeFieldSize(len) + len);
+		if (p == nullptr)
 		{
 			return false;
 		}
-		return v.empty() ? true : stream_writer.Write((const void *)v.c_str(), v.length());
+
+		p += StreamWriter::PutUnsignedNumber(p, len);
+		if (len > 0)
+		{
+			memcpy(p, v.data(), len);
+		}
+
+		return true;
 	}
 
-	static bool Decode(StreamReader & stream_reader, std::string & v)
+	static bool Decode(StreamReader & stream_reader, String & v)
 	{
 		v.clear();
 
@@ -359,15 +489,141 @@ struct Serializer<std::string>
 			return false;
 		}
 
-		return len > 0 ? stream_reader.Read(v, len) : true;
+		const char * data = nullptr;
+		if (len > 0 && !stream_reader.ReadView(data, len))
+		{
+			return false;
+		}
+
+		v.assign(data, len);
+		return true;
 	}
 
-	static size_t GetSize(const std::string & v)
+	static size_t GetSize(const String & v)
 	{
 		return StreamWriter::GetSizeFieldSize(v.length()) + v.length();
 	}
 };
 
+/*
+	字符串视图(解码时引用缓冲区中的数据，不拷贝)
+	编码格式与std::string相同
+	只在缓冲区有效期间可用，网络服务消息的缓冲区在处理函数返回前一直有效，
+	若需更长时间持有，可在处理函数中通过Service::GetCurNetMessageBuffer()持有缓冲区
+	不要用于内部服务消息(内部服务消息不经过序列化，视图引用的是发送方的内存)
+*/
+class StringView
+{
+public:
+	StringView() : _data(nullptr), _len(0) {}
+
+	StringView(const char * data, size_t len) : _data(data), _len(len) {}
+
+	StringView(const std::string & s) : _data(s.data()), _len(s.length()) {}
+
+	const char * data() const
+	{
+		return _data;
+	}
+
+	size_t size() const
+	{
+		return _len;
+	}
+
+	size_t length() const
+	{
+		return _len;
+	}
+
+	bool empty() const
+	{
+		return _len == 0;
+	}
+
+	const char * begin() const
+	{
+		return _data;
+	}
+
+	const char * end() const
+	{
+		return _data + _len;
+	}
+
+	char operator[](size_t i) const
+	{
+		assert(i < _len);
+		return _data[i];
+	}
+
+	std::string ToString() const
+	{
+		return _len > 0 ? std::string(_data, _len) : std::string();
+	}
+
+	bool operator==(const StringView & other) const
+	{
+		return _len == other._len && (_len == 0 || memcmp(_data, other._data, _len) == 0);
+	}
+
+	bool operator!=(const StringView & other) const
+	{
+		return !(*this == other);
+	}
+
+private:
+	const char * _data;
+	size_t _len;
+};
+
+template<>
+struct Serializer<StringView>
+{
+	static bool Encode(StreamWriter & stream_writer, const StringView & v)
+	{
+		size_t len = v.size();
+		char * p = stream_writer.Reserve(StreamWriter::GetSizeFieldSize(len) + len);
+		if (p == nullptr)
+		{
+			return false;
+		}
+
+		p += StreamWriter::PutUnsignedNumber(p, len);
+		if (len > 0)
+		{
+			memcpy(p, v.data(), len);
+		}
+
+		return true;
+	}
+
+	static bool Decode(StreamReader & stream_reader, StringView & v)
+	{
+		v = StringView();
+
+		size_t len = 0;
+		if (!stream_reader.ReadSizeField(len))
+		{
+			return false;
+		}
+
+		const char * data = nullptr;
+		if (len > 0 && !stream_reader.ReadView(data, len))
+		{
+			return false;
+		}
+
+		v = StringView(data, len);
+		return true;
+	}
+
+	static size_t GetSize(const StringView & v)
+	{
+		return StreamWriter::GetSizeFieldSize(v.size()) + v.size();
+	}
+};
+
 template<typename T, int Array_Size>
 struct Serializer<T[Array_Size]>
 {
@@ -410,10 +666,100 @@ struct Serializer<T[Array_Size]>
 	}
 };
 
+/*
+	批量序列化格式开关
+	开启后，元素为算术类型的std::vector以"元素数量 + 连续内存(小端字节序)"编码，不再逐个元素编码
+	两种格式互不兼容，通信双方必须一致。可以对单个元素类型特化BulkSerializeFlag开启，
+	也可以定义宏SFRAME_BULK_POD_SERIALIZE对所有算术类型(bool除外)开启
+*/
+template<typename T>
+struct BulkSerializeFlag
+{
+#ifdef SFRAME_BULK_POD_SERIALIZE
+	static const bool value = std::is_arithmetic<T>::value && !std::is_same<T, bool>::value;
+#else
+	static const bool value = false;
+#endif
+};
+
+// 批量序列化辅助
 template<typename T>
-struct Serializer<std::vector<T>>
+struct BulkSerializer
+{
+	static_assert(std::is_arithmetic<T>::value && !std::is_same<T, bool>::value, "bulk serialize only support arithmetic type");
+
+	static bool Encode(StreamWriter & stream_writer, const T * data, size_t count)
+	{
+		char * p = stream_writer.Reserve(GetSize(count));
+		if (p == nullptr)
+		{
+			return false;
+		}
+
+		p += StreamWriter::PutUnsignedNumber(p, count);
+		CopyElements(p, (const char *)data, count);
+		return true;
+	}
+
+	template<typename T_Alloc>
+	static bool Decode(StreamReader & stream_reader, std::vector<T, T_Alloc> & v)
+	{
+		v.clear();
+
+		size_t count = 0;
+		if (!stream_reader.ReadSizeField(count))
+		{
+			return false;
+		}
+
+		if (count == 0)
+		{
+			return true;
+		}
+
+		if (count > stream_reader.GetNotReadLength() / sizeof(T))
+		{
+			return false;
+		}
+
+		v.resize(count);
+		CopyElements((char *)&v[0], stream_reader.GetStreamBuffer() + stream_reader.GetReadedLength(), count);
+		stream_reader.ForwardCurPos(count * sizeof(T));
+		return true;
+	}
+
+	static size_t GetSize(size_t count)
+	{
+		return StreamWriter::GetSizeFieldSize(count) + count * sizeof(T);
+	}
+
+private:
+	// 拷贝元素(编码格式为小端字节序，大端CPU需要逐个元素逆序)
+	static void CopyElements(char * dst, const char * src, size_t count)
+	{
+		if (sizeof(T) == 1 || !CheckCpuEndian())
+		{
+			if (count > 0)
+			{
+				memcpy(dst, src, count * sizeof(T));
+			}
+			return;
+		}
+
+		for (size_t i = 0; i < count; i++)
+		{
+			for (size_t k = 0; k < sizeof(T); k++)
+			{
+				dst[i * sizeof(T) + k] = src[i * sizeof(T) + sizeof(T) - 1 - k];
+			}
+		}
+	}
+};
+
+template<typename T, typename T_Alloc = std::allocator<T>, bool Is_Bulk = BulkSerializeFlag<T>::value>
+struct Serializer_Vector
 {
-	static bool Encode(StreamWriter & stream_writer, const std::vector<T> & v)
+	static bool Encode(StreamWriter & stream_writer, const std::vector<T, T_Alloc> & v)
 	{
 		if (!stream_writer.WriteSizeField(v.size()))
 		{
@@ -431,7 +777,7 @@ struct Serializer<std::vector<T>>
 		return true;
 	}
 
-	static bool Decode(StreamReader & stream_reader, std::vector<T> & v)
+	static bool Decode(StreamReader & stream_reader, std::vector<T, T_Alloc> & v)
 	{
 		v.clear();
 
@@ -455,13 +801,13 @@ struct Serializer<std::vector<T>>
 			{
 				return false;
 			}
-			v.push_back(item);
+			v.push_back(std::move(item));
 		}
 
 		return true;
 	}
 
-	static size_t GetSize(const std::vector<T> & v)
+	static size_t GetSize(const std::vector<T, T_Alloc> & v)
 	{
 		size_t len = StreamWriter::GetSizeFieldSize(v.size());
 
@@ -474,10 +820,161 @@ struct Serializer<std::vector<T>>
 	}
 };
 
+template<typename T, typename T_Alloc>
+struct Serializer_Vector<T, T_Alloc, true>
+{
+	static bool Encode(StreamWriter & stream_writer, const std::vector<T, T_Alloc> & v)
+	{
+		return BulkSerializer<T>::Encode(stream_writer, v.empty() ? nullptr : &v[0], v.size());
+	}
+
+	static bool Decode(StreamReader & stream_reader, std::vector<T, T_Alloc> & v)
+	{
+		return BulkSerializer<T>::Decode(stream_reader, v);
+	}
+
+	static size_t GetSize(const std::vector<T, T_Alloc> & v)
+	{
+		return BulkSerializer<T>::GetSize(v.size());
+	}
+};
+
+template<typename T, typename T_Alloc>
+struct Serializer<std::vector<T, T_Alloc>> : Serializer_Vector<T, T_Alloc>
+{
+};
+
+/*
+	数组视图(解码时引用缓冲区中的数据，不拷贝)
+	编码格式与开启批量序列化格式(BulkSerializeFlag)的std::vector<T>相同
+	只能用于开启了BulkSerializeFlag的元素类型，否则与对方逐元素编码的std::vector<T>格式不一致
+	缓冲区中的数据不保证按T对齐，所以通过At()按值读取元素
+	有效期的限制与StringView相同
+*/
+template<typename T>
+class ArrayView
+{
+	static_assert(std::is_arithmetic<T>::value && !std::is_same<T, bool>::value, "ArrayView only support arithmetic type");
+
+public:
+	ArrayView() : _data(nullptr), _count(0) {}
+
+	ArrayView(const char * data, size_t count) : _data(data), _count(count) {}
+
+	size_t size() const
+	{
+		return _count;
+	}
+
+	bool empty() const
+	{
+		return _count == 0;
+	}
+
+	// 原始数据(小端字节序)
+	const char * data() const
+	{
+		return _data;
+	}
+
+	T At(size_t i) const
+	{
+		assert(i < _count);
+		T v;
+		if (sizeof(T) == 1 || !CheckCpuEndian())
+		{
+			memcpy(&v, _data + i * sizeof(T), sizeof(T));
+		}
+		else
+		{
+			char * dst = (char *)&v;
+			const char * src = _data + i * sizeof(T);
+			for (size_t k = 0; k < sizeof(T); k++)
+			{
+				dst[k] = src[sizeof(T) - 1 - k];
+			}
+		}
+		return v;
+	}
+
+	T operator[](size_t i) const
+	{
+		return At(i);
+	}
+
+	std::vector<T> ToVector() const
+	{
+		std::vector<T> v;
+		v.reserve(_count);
+		for (size_t i = 0; i < _count; i++)
+		{
+			v.push_back(At(i));
+		}
+		return v;
+	}
+
+private:
+	const char * _data;
+	size_t _count;
+};
+
 template<typename T>
-struct Serializer<std::list<T>>
+struct Serializer<ArrayView<T>>
+{
+	static_assert(BulkSerializeFlag<T>::value, "ArrayView requires BulkSerializeFlag<T> to be enabled");
+
+	static bool Encode(StreamWriter & stream_writer, const ArrayView<T> & v)
+	{
+		char * p = stream_writer.Reserve(GetSize(v));
+		if (p == nullptr)
+		{
+			return false;
+		}
+
+		p += StreamWriter::PutUnsignedNumber(p, v.size());
+		if (!v.empty())
+		{
+			memcpy(p, v.data(), v.size() * sizeof(T));
+		}
+
+		return true;
+	}
+
+	static bool Decode(StreamReader & stream_reader, ArrayView<T> & v)
+	{
+		v = ArrayView<T>();
+
+		size_t count = 0;
+		if (!stream_reader.ReadSizeField(count))
+		{
+			return false;
+		}
+
+		if (count > stream_reader.GetNotReadLength() / sizeof(T))
+		{
+			return false;
+		}
+
+		const char * data = nullptr;
+		if (count > 0 && !stream_reader.ReadView(data, count * sizeof(T)))
+		{
+			return false;
+		}
+
+		v = ArrayView<T>(data, count);
+		return true;
+	}
+
+	static size_t GetSize(const ArrayView<T> & v)
+	{
+		return BulkSerializer<T>::GetSize(v.size());
+	}
+};
+
+template<typename T, typename T_Alloc>
+struct Serializer<std::list<T, T_Alloc>>
 {
-	static bool Encode(StreamWriter & stream_writer, const std::list<T> & v)
+	static bool Encode(StreamWriter & stream_writer, const std::list<T, T_Alloc> & v)
 	{
 		if (!stream_writer.WriteSizeField(v.size()))
 		{
@@ -495,7 +992,7 @@ struct Serializer<std::list<T>>
 		return true;
 	}
 
-	static bool Decode(StreamReader & stream_reader, std::list<T> & v)
+	static bool Decode(StreamReader & stream_reader, std::list<T, T_Alloc> & v)
 	{
 		v.clear();
 
@@ -514,13 +1011,13 @@ struct Serializer<std::list<T>>
 				return false;
 			}
 
-			v.push_back(item);
+			v.push_back(std::move(item));
 		}
 
 		return true;
 	}
 
-	static size_t GetSize(const std::list<T> & v)
+	static size_t GetSize(const std::list<T, T_Alloc> & v)
 	{
 		size_t len = StreamWriter::GetSizeFieldSize(v.size());
 
@@ -573,7 +1070,7 @@ struct Serializer_Set
 				return false;
 			}
 
-			v.insert(item);
+			v.insert(std::move(item));
 		}
 
 		return true;
@@ -592,23 +1089,23 @@ struct Serializer_Set
 	}
 };
 
-template<typename T>
-struct Serializer<std::set<T>> : Serializer_Set<std::set<T>>
+template<typename T, typename T_Compare, typename T_Alloc>
+struct Serializer<std::set<T, T_Compare, T_Alloc>> : Serializer_Set<std::set<T, T_Compare, T_Alloc>>
 {
 };
 
-template<typename T>
-struct Serializer<std::unordered_set<T>> : Serializer_Set<std::unordered_set<T>>
+template<typename T, typename T_Hash, typename T_Equal, typename T_Alloc>
+struct Serializer<std::unordered_set<T, T_Hash, T_Equal, T_Alloc>> : Serializer_Set<std::unordered_set<T, T_Hash, T_Equal, T_Alloc>>
 {
 };
 
-template<typename T>
-struct Serializer<std::multiset<T>> : Serializer_Set<std::multiset<T>>
+template<typename T, typename T_Compare, typename T_Alloc>
+struct Serializer<std::multiset<T, T_Compare, T_Alloc>> : Serializer_Set<std::multiset<T, T_Compare, T_Alloc>>
 {
 };
 
-template<typename T>
-struct Serializer<std::unordered_multiset<T>> : Serializer_Set<std::unordered_multiset<T>>
+template<typename T, typename T_Hash, typename T_Equal, typename T_Alloc>
+struct Serializer<std::unordered_multiset<T, T_Hash, T_Equal, T_Alloc>> : Serializer_Set<std::unordered_multiset<T, T_Hash, T_Equal, T_Alloc>>
 {
 };
 
@@ -622,7 +1119,7 @@ struct Serializer_Map
 			return false;
 		}
 
-		for (const auto it : v)
+		for (const auto & it : v)
 		{
 			if (!Encoder::Encode(stream_writer, it.first) || !Encoder::Encode(stream_writer, it.second))
 			{
@@ -653,7 +1150,7 @@ struct Serializer_Map
 				return false;
 			}
 
-			v.insert(std::make_pair(key, val));
+			v.insert(std::make_pair(std::move(key), std::move(val)));
 		}
 
 		return true;
@@ -663,7 +1160,7 @@ struct Serializer_Map
 	{
 		size_t len = StreamWriter::GetSizeFieldSize(v.size());
 
-		for (const auto it : v)
+		for (const auto & it : v)
 		{
 			len += SizeGettor::GetSize(it.first);
 			len += SizeGettor::GetSize(it.second);
@@ -673,23 +1170,23 @@ struct Serializer_Map
 	}
 };
 
-template<typename T_Key, typename T_Val>
-struct Serializer<std::map<T_Key, T_Val>> : Serializer_Map<std::map<T_Key, T_Val>>
+template<typename T_Key, typename T_Val, typename T_Compare, typename T_Alloc>
+struct Serializer<std::map<T_Key, T_Val, T_Compare, T_Alloc>> : Serializer_Map<std::map<T_Key, T_Val, T_Compare, T_Alloc>>
 {
 };
 
-template<typename T_Key, typename T_Val>
-struct Serializer<std::unordered_map<T_Key, T_Val>> : Serializer_Map<std::unordered_map<T_Key, T_Val>>
+template<typename T_Key, typename T_Val, typename T_Hash, typename T_Equal, typename T_Alloc>
+struct Serializer<std::unordered_map<T_Key, T_Val, T_Hash, T_Equal, T_Alloc>> : Serializer_Map<std::unordered_map<T_Key, T_Val, T_Hash, T_Equal, T_Alloc>>
 {
 };
 
-template<typename T_Key, typename T_Val>
-struct Serializer<std::multimap<T_Key, T_Val>> : Serializer_Map<std::multimap<T_Key, T_Val>>
+template<typename T_Key, typename T_Val, typename T_Compare, typename T_Alloc>
+struct Serializer<std::multimap<T_Key, T_Val, T_Compare, T_Alloc>> : Serializer_Map<std::multimap<T_Key, T_Val, T_Compare, T_Alloc>>
 {
 };
 
-template<typename T_Key, typename T_Val>
-struct Serializer<std::unordered_multimap<T_Key, T_Val>> : Serializer_Map<std::unordered_multimap<T_Key, T_Val>>
+template<typename T_Key, typename T_Val, typename T_Hash, typename T_Equal, typename T_Alloc>
+struct Serializer<std::unordered_multimap<T_Key, T_Val, T_Hash, T_Equal, T_Alloc>> : Serializer_Map<std::unordered_multimap<T_Key, T_Val, T_Hash, T_Equal, T_Alloc>>
 {
 };
 
@@ -869,6 +1366,169 @@ struct PlaceHolder { };
 
 constexpr PlaceHolder placeholder;
 
+/*
+	编码长度缓存
+	对象编码时要写入每个字段的长度，嵌套对象逐层计算长度会使内层长度被重复计算，编码开销随嵌套深度成倍增长
+	顶层对象编码前自底向上计算一次全部长度，按计算顺序(先序)记录，编码时按相同顺序依次取用
+	每条记录带有对象地址和类型标记用于校验，顺序对不上时(如自定义序列化方法编码顺序和计算长度顺序不同)，本次编码退化为直接计算长度
+*/
+class EncodeSizeCache
+{
+public:
+	// 工作模式
+	enum Mode : int32_t
+	{
+		kMode_None = 0,      // 不在编码中
+		kMode_Record,        // 计算并记录长度
+		kMode_Replay,        // 编码中，按顺序取用记录的长度
+		kMode_Bypass,        // 编码中，不使用缓存
+	};
+
+	static const size_t kMaxKeepItemCount = 65536;   // 编码结束后最多保留的记录空间
+
+	// 类型标记(每种类型一个唯一地址)
+	template<typename T>
+	struct TypeTag
+	{
+		static const char value;
+	};
+
+	// 模式守卫
+	class ModeGuard
+	{
+	public:
+		ModeGuard(EncodeSizeCache & cache, Mode mode) : _cache(cache), _old_mode(cache._mode)
+		{
+			_cache._mode = mode;
+		}
+
+		~ModeGuard()
+		{
+			_cache._mode = _old_mode;
+		}
+
+	private:
+		ModeGuard(const ModeGuard &) = delete;
+		ModeGuard & operator=(const ModeGuard &) = delete;
+
+		EncodeSizeCache & _cache;
+		Mode _old_mode;
+	};
+
+	// 顶层编码会话(开始时进入记录模式，结束时清空记录)
+	class Session
+	{
+	public:
+		Session(EncodeSizeCache & cache) : _cache(cache)
+		{
+			_cache._items.clear();
+			_cache._cursor = 0;
+			_cache._mode = kMode_Record;
+		}
+
+		~Session()
+		{
+			_cache._items.clear();
+			if (_cache._items.capacity() > kMaxKeepItemCount)
+			{
+				std::vector<Item>().swap(_cache._items);
+			}
+			_cache._cursor = 0;
+			_cache._mode = kMode_None;
+		}
+
+	private:
+		Session(const Session &) = delete;
+		Session & operator=(const Session &) = delete;
+
+		EncodeSizeCache & _cache;
+	};
+
+	// 获取当前线程的缓存
+	static EncodeSizeCache & GetThreadInstance()
+	{
+		static thread_local EncodeSizeCache cache;
+		return cache;
+	}
+
+	EncodeSizeCache() : _cursor(0), _mode(kMode_None) {}
+
+	Mode GetMode() const
+	{
+		return _mode;
+	}
+
+	// 记录完毕，开始取用
+	void BeginReplay()
+	{
+		_cursor = 0;
+		_mode = kMode_Replay;
+	}
+
+	// 添加一条记录，返回其位置(长度计算完后用Set填入)
+	size_t Push(const void * key, const void * tag)
+	{
+		Item item;
+		item.key = key;
+		item.tag = tag;
+		item.size = 0;
+		_items.push_back(item);
+		return _items.size() - 1;
+	}
+
+	void Set(size_t pos, size_t size)
+	{
+		_items[pos].size = size;
+	}
+
+	// 按顺序取用一条记录，对不上时转为不使用缓存
+	bool Take(const void * key, const void * tag, size_t & size)
+	{
+		if (_cursor < _items.size() && _items[_cursor].key == key && _items[_cursor].tag == tag)
+		{
+			size = _items[_cursor++].size;
+			return true;
+		}
+
+		_mode = kMode_Bypass;
+		return false;
+	}
+
+private:
+	struct Item
+	{
+		const void * key;   // 对象地址
+		const void * tag;   // 类型标记
+		size_t size;        // 长度
+	};
+
+	std::vector<Item> _items;
+	size_t _cursor;
+	Mode _mode;
+};
+
+template<typename T>
+const char EncodeSizeCache::TypeTag<T>::value = 0;
+
+// 长度计算开销很小的字段(整数、字符串)不使用长度缓存，省去记录和取用
+template<typename T>
+struct EncodeSizeCacheSkip
+{
+	static const bool value = std::is_integral<T>::value;
+};
+
+template<typename T_Alloc>
+struct EncodeSizeCacheSkip<std::basic_string<char, std::char_traits<char>, T_Alloc>>
+{
+	static const bool value = true;
+};
+
+template<>
+struct EncodeSizeCacheSkip<StringView>
+{
+	static const bool value = true;
+};
+
 /* 
 	对象序列化器(主要用于辅助序列化一个struct或class的对象)
 	只用此类进行序列化、反序列化，会将传入所有参数当成一个整体
@@ -885,7 +1545,37 @@ public:
 	template<typename... T>
 	static bool Encode(StreamWriter & stream_writer, const T&... args)
 	{
-		size_t s = GetSizeImp(kStartSerializeIndex, args...);
+		EncodeSizeCache & cache = EncodeSizeCache::GetThreadInstance();
+		size_t s = 0;
+
+		switch (cache.GetMode())
+		{
+		case EncodeSizeCache::kMode_None:
+			{
+				// 顶层对象，先计算并记录所有嵌套对象和字段的长度，编码时直接取用
+				EncodeSizeCache::Session session(cache);
+				s = GetSizeImp(kStartSerializeIndex, args...);
+				cache.BeginReplay();
+				return stream_writer.WriteSizeField(s) && EncodeImp(kStartSerializeIndex, stream_writer, args...);
+			}
+		case EncodeSizeCache::kMode_Record:
+			{
+				// 计算长度时发生的编码，不能影响记录
+				EncodeSizeCache::ModeGuard guard(cache, EncodeSizeCache::kMode_Bypass);
+				return Encode(stream_writer, args...);
+			}
+		case EncodeSizeCache::kMode_Replay:
+			if (cache.Take(GetObjectKey(args...), &EncodeSizeCache::TypeTag<std::tuple<T...>>::value, s))
+			{
+				break;
+			}
+			s = GetSizeImp(kStartSerializeIndex, args...);
+			break;
+		default:
+			s = GetSizeImp(kStartSerializeIndex, args...);
+			break;
+		}
+
 		return stream_writer.WriteSizeField(s) && EncodeImp(kStartSerializeIndex, stream_writer, args...);
 	}
 
@@ -910,12 +1600,44 @@ public:
 	template<typename... T>
 	static size_t GetSize(const T&... args)
 	{
-		size_t s = GetSizeImp(kStartSerializeIndex, args...);
+		EncodeSizeCache & cache = EncodeSizeCache::GetThreadInstance();
+		size_t s = 0;
+
+		if (cache.GetMode() == EncodeSizeCache::kMode_Record)
+		{
+			size_t pos = cache.Push(GetObjectKey(args...), &EncodeSizeCache::TypeTag<std::tuple<T...>>::value);
+			s = GetSizeImp(kStartSerializeIndex, args...);
+			cache.Set(pos, s);
+		}
+		else
+		{
+			s = GetSizeImp(kStartSerializeIndex, args...);
+		}
+
 		return sframe::StreamWriter::GetSizeFieldSize(s) + s;
 	}
 
 private:
+
+	// 对象在长度缓存中的标识(第一个参数的地址)
+	static const void * GetObjectKey()
+	{
+		return nullptr;
+	}
+
+	template<typename T, typename... T_Args>
+	static const void * GetObjectKey(const T & t, const T_Args&...)
+	{
+		return std::addressof(t);
+	}
 
+	// 编码中取用记录的长度
+	static bool TakeCachedSize(const void * key, const void * tag, size_t & s)
+	{
+		EncodeSizeCache & cache = EncodeSizeCache::GetThreadInstance();
+		return cache.GetMode() == EncodeSizeCache::kMode_Replay && cache.Take(key, tag, s);
+	}
+
 	static bool EncodeImp(size_t, StreamWriter & stream_writer)
 	{
 		return true;
@@ -929,8 +1651,21 @@ private:
 	template<typename T_CurArg>
 	static bool EncodeImp(size_t index, StreamWriter & stream_writer, const T_CurArg & t)
 	{
-		size_t s = SizeGettor::GetSize<T_CurArg>(t);
-		return stream_writer.WriteSizeField(index) && stream_writer.WriteSizeField(s) + Encoder::Encode<T_CurArg>(stream_writer, t);
+		size_t s = 0;
+		if (EncodeSizeCacheSkip<T_CurArg>::value ||
+			!TakeCachedSize(std::addressof(t), &EncodeSizeCache::TypeTag<T_CurArg>::value, s))
+		{
+			s = SizeGettor::GetSize<T_CurArg>(t);
+		}
+		// index和长度字段一次预留
+		char * p = stream_writer.Reserve(StreamWriter::GetSizeFieldSize(index) + StreamWriter::GetSizeFieldSize(s));
+		if (p == nullptr)
+		{
+			return false;
+		}
+		p += StreamWriter::PutUnsignedNumber(p, index);
+		StreamWriter::PutUnsignedNumber(p, s);
+		return Encoder::Encode<T_CurArg>(stream_writer, t);
 	}
 
 	template<typename T_CurArg, typename... T_Args>
@@ -1036,7 +1771,18 @@ private:
 	template<typename T>
 	static size_t GetSizeImp(size_t index, const T & t)
 	{
-		size_t s = SizeGettor::GetSize<T>(t);
+		size_t s = 0;
+		if (EncodeSizeCacheSkip<T>::value || EncodeSizeCache::GetThreadInstance().GetMode() != EncodeSizeCache::kMode_Record)
+		{
+			s = SizeGettor::GetSize<T>(t);
+		}
+		else
+		{
+			EncodeSizeCache & cache = EncodeSizeCache::GetThreadInstance();
+			size_t pos = cache.Push(std::addressof(t), &EncodeSizeCache::TypeTag<T>::value);
+			s = SizeGettor::GetSize<T>(t);
+			cache.Set(pos, s);
+		}
 		return StreamWriter::GetSizeFieldSize(index) + StreamWriter::GetSizeFieldSize(s) + s;
 	}
 
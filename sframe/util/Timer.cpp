@@ -6,15 +6,59 @@
 
 using namespace sframe;
 
-TimerList::~TimerList()
+TimerNodePool::~TimerNodePool()
 {
-	Timer * t = timer_head;
-	while (t)
+	for (Node * chunk : _chunks)
 	{
-		Timer * next = t->GetNext();
-		delete t;
-		t = next;
+		delete[] chunk;
+	}
+	_chunks.clear();
+	_free_list = nullptr;
+}
+
+// 分配一个节点
+void * TimerNodePool::Alloc()
+{
+	if (_free_list == nullptr)
+	{
+		Node * chunk = new Node[kNodeCountPerChunk];
+		_chunks.push_back(chunk);
+		for (size_t i = 0; i < kNodeCountPerChunk; i++)
+		{
+			chunk[i].next = _free_list;
+			_free_list = &chunk[i];
+		}
+	}
+
+	Node * node = _free_list;
+	_free_list = node->next;
+	return node;
+}
+
+// 释放节点
+void TimerNodePool::Free(void * p)
+{
+	Node * node = (Node *)p;
+	node->next = _free_list;
+	_free_list = node;
+}
+
+TimerManager::~TimerManager()
+{
+	for (int32_t i = 0; i < TVR_SIZE; i++)
+	{
+		FreeTimerList(_tv1[i]);
+	}
+
+	for (int32_t i = 0; i < TVN_SIZE; i++)
+	{
+		FreeTimerList(_tv2[i]);
+		FreeTimerList(_tv3[i]);
+		FreeTimerList(_tv4[i]);
+		FreeTimerList(_tv5[i]);
 	}
+
+	FreeTimerList(_add_timer_cache);
 }
 
 // 注册普通定时器
@@ -24,7 +68,7 @@ TimerHandle TimerManager::RegistNormalTimer(int32_t after_msec, NormalTimer::Tim
 	if (!func || after_msec < 0)
 	{
 		assert(false);
-		return 0;
+		return TimerHandle();
 	}
 
 	int64_t now = Now();
@@ -35,25 +79,19 @@ TimerHandle TimerManager::RegistNormalTimer(int32_t after_msec, NormalTimer::Tim
 		_exec_time = now;
 	}
 
-	NormalTimer * t = new  NormalTimer(func);
+	NormalTimer * t = NewTimer<NormalTimer>(func);
 	t->SetExecTime(now + after_msec);
 	AddTimer(t);
 
-	return t->GetHandle();
+	return GetHandle(t);
 }
 
 // 删除定时器
-void TimerManager::DeleteTimer(TimerHandle timer_handle)
+void TimerManager::DeleteTimer(const TimerHandle & timer_handle)
 {
-	if (!Timer::IsTimerAlive(timer_handle))
-	{
-		return;
-	}
-
-	Timer * timer = timer_handle->GetTimerPtr();
+	Timer * timer = GetTimer(timer_handle);
 	if (timer == nullptr)
 	{
-		assert(false);
 		return;
 	}
 
@@ -66,36 +104,101 @@ void TimerManager::DeleteTimer(TimerHandle timer_handle)
 
 	int32_t level = -1;
 	int32_t index = -1;
-	timer_handle->GetLocation(&level, &index);
+	timer->GetLocation(&level, &index);
+	if (level == 0)
+	{
+		// 在添加缓存中
+		_add_timer_cache.DeleteTimer(timer);
+		FreeTimer(timer);
+		return;
+	}
+
 	int32_t tv_size;
 	TimerList * tv = GetTV(level, &tv_size);
-	if (tv)
+	if (tv == nullptr || index < 0 || index >= tv_size)
 	{
-		if (index < 0 || index >= tv_size)
+		assert(false);
+		return;
+	}
+
+	tv[index].DeleteTimer(timer);
+	if (tv[index].IsEmpty())
+	{
+		switch (level)
 		{
-			assert(false);
-			return;
+		case 1: _tv1_bits.Clear(index); break;
+		case 2: _tv2_bits.Clear(index); break;
+		case 3: _tv3_bits.Clear(index); break;
+		case 4: _tv4_bits.Clear(index); break;
+		case 5: _tv5_bits.Clear(index); break;
 		}
+	}
+	FreeTimer(timer);
+}
 
-		TimerList & timer_list = tv[index];
-		timer_list.DeleteTimer(timer);
-		delete timer;
+// 释放定时器
+void TimerManager::FreeTimer(Timer * t)
+{
+	// 槽位代数增加，使旧句柄失效
+	uint32_t slot_index = t->_slot;
+	TimerSlot & slot = _slots[slot_index];
+	assert(slot.timer == t);
+	slot.timer = nullptr;
+	slot.generation++;
+	slot.next_free = _free_slot;
+	_free_slot = slot_index;
+
+	bool pooled = t->_pooled;
+	void * mem = dynamic_cast<void *>(t);
+	t->~Timer();
+	if (pooled)
+	{
+		_node_pool.Free(mem);
 	}
 	else
 	{
-		auto it = std::find(_add_timer_cache.begin(), _add_timer_cache.end(), timer);
-		if (it == _add_timer_cache.end())
-		{
-			// 没有在执行组中，肯定在cache中，没有找到说明逻辑有错误
-			assert(false);
-			return;
-		}
+		::operator delete(mem);
+	}
+}
 
-		_add_timer_cache.erase(it);
-		delete timer;
+// 释放链表中所有定时器
+void TimerManager::FreeTimerList(TimerList & timer_list)
+{
+	Timer * t = timer_list.timer_head;
+	timer_list.timer_head = nullptr;
+	timer_list.timer_tail = nullptr;
+
+	while (t)
+	{
+		Timer * next = t->GetNext();
+		FreeTimer(t);
+		t = next;
 	}
 }
 
+uint32_t TimerManager::AllocSlot(Timer * t)
+{
+	uint32_t slot_index = _free_slot;
+	if (slot_index == kInvalidSlot)
+	{
+		TimerSlot slot;
+		slot.timer = nullptr;
+		slot.generation = 0;
+		slot.next_free = kInvalidSlot;
+		_slots.push_back(slot);
+		slot_index = (uint32_t)(_slots.size() - 1);
+	}
+	else
+	{
+		_free_slot = _slots[slot_index].next_free;
+	}
+
+	TimerSlot & slot = _slots[slot_index];
+	slot.timer = t;
+	slot.next_free = kInvalidSlot;
+	return slot_index;
+}
+
 // 执行
 void TimerManager::Execute()
 {
@@ -112,14 +215,17 @@ void TimerManager::Execute()
 
 	do
 	{
+		// 直接跳到下一个有定时器需要处理的tick
+		_exec_time = SkipIdleTicks(now);
+
 		int64_t init_to_exec_tick = (_exec_time - _init_time) / kMilliSecOneTick;
 		int64_t index = init_to_exec_tick & TVR_MASK;
 		if (index <= 0 && _exec_time != _init_time &&
-			Cascade(_tv2, (int32_t)((init_to_exec_tick >> TVR_BITS) & TVN_MASK)) <= 0 &&
-			Cascade(_tv3, (int32_t)((init_to_exec_tick >> (TVR_BITS + TVN_BITS)) & TVN_MASK)) <= 0 &&
-			Cascade(_tv4, (int32_t)((init_to_exec_tick >> (TVR_BITS + 2 * TVN_BITS)) & TVN_MASK)) <= 0)
+			Cascade(_tv2, _tv2_bits, (int32_t)((init_to_exec_tick >> TVR_BITS) & TVN_MASK)) <= 0 &&
+			Cascade(_tv3, _tv3_bits, (int32_t)((init_to_exec_tick >> (TVR_BITS + TVN_BITS)) & TVN_MASK)) <= 0 &&
+			Cascade(_tv4, _tv4_bits, (int32_t)((init_to_exec_tick >> (TVR_BITS + 2 * TVN_BITS)) & TVN_MASK)) <= 0)
 		{
-			Cascade(_tv5, (int32_t)((init_to_exec_tick >> (TVR_BITS + 3 * TVN_BITS)) & TVN_MASK));
+			Cascade(_tv5, _tv5_bits, (int32_t)((init_to_exec_tick >> (TVR_BITS + 3 * TVN_BITS)) & TVN_MASK));
 		}
 
 		TimerList & cur_list = _tv1[index];
@@ -150,26 +256,31 @@ void TimerManager::Execute()
 			if (_del_cur_timer || after < 0)
 			{
 				_del_cur_timer = false;
-				delete _cur_exec_timer;
+				FreeTimer(_cur_exec_timer);
 			}
 			else
 			{
 				_cur_exec_timer->SetExecTime(now + after);
-				_add_timer_cache.push_back(_cur_exec_timer);
+				_add_timer_cache.AddTimer(_cur_exec_timer);
+				_cur_exec_timer->SetLocation(0, 0);
 			}
 
 			_cur_exec_timer = next_timer;
 		}
+		_tv1_bits.Clear((int32_t)index);
 
 		if (now - _exec_time < kMilliSecOneTick)
 		{
-			if (!_add_timer_cache.empty())
+			Timer * t = _add_timer_cache.timer_head;
+			_add_timer_cache.timer_head = nullptr;
+			_add_timer_cache.timer_tail = nullptr;
+			while (t)
 			{
-				for (Timer * t : _add_timer_cache)
-				{
-					AddTimer(t);
-				}
-				_add_timer_cache.clear();
+				Timer * next = t->GetNext();
+				t->SetPrev(nullptr);
+				t->SetNext(nullptr);
+				AddTimer(t);
+				t = next;
 			}
 		}
 
@@ -178,9 +289,14 @@ void TimerManager::Execute()
 	} while (now >= _exec_time);
 }
 
-int32_t TimerManager::Cascade(TimerList * tv, int32_t index)
+int32_t TimerManager::Cascade(TimerList * tv, TimerSlotBitmap<TVN_SIZE> & tv_bits, int32_t index)
 {
 	TimerList & timer_list = tv[index];
+	if (timer_list.IsEmpty())
+	{
+		return index;
+	}
+	tv_bits.Clear(index);
 
 	Timer * cur = timer_list.timer_head;
 	timer_list.timer_head = nullptr;
@@ -203,7 +319,8 @@ void TimerManager::AddTimer(Timer * t)
 {
 	if (_cur_exec_timer)
 	{
-		_add_timer_cache.push_back(t);
+		_add_timer_cache.AddTimer(t);
+		t->SetLocation(0, 0);
 		return;
 	}
 
@@ -223,32 +340,160 @@ void TimerManager::AddTimer(Timer * t)
 	{
 		int64_t index = init_to_exec_tick & TVR_MASK;
 		_tv1[index].AddTimer(t);
-		t->GetHandle()->SetLocation(1, (int32_t)index);
+		_tv1_bits.Set((int32_t)index);
+		t->SetLocation(1, (int32_t)index);
 	}
 	else if (after_tick < (1 << (TVR_BITS + TVN_BITS)))
 	{
 		int64_t index = (init_to_exec_tick >> TVR_BITS) & TVN_MASK;
 		_tv2[index].AddTimer(t);
-		t->GetHandle()->SetLocation(2, (int32_t)index);
+		_tv2_bits.Set((int32_t)index);
+		t->SetLocation(2, (int32_t)index);
 	}
 	else if (after_tick < (1 << (TVR_BITS + 2 * TVN_BITS)))
 	{
 		int64_t index = (init_to_exec_tick >> (TVR_BITS + TVN_BITS)) & TVN_MASK;
 		_tv3[index].AddTimer(t);
-		t->GetHandle()->SetLocation(3, (int32_t)index);
+		_tv3_bits.Set((int32_t)index);
+		t->SetLocation(3, (int32_t)index);
 	}
 	else if (after_tick < (1 << (TVR_BITS + 3 * TVN_BITS)))
 	{
 		int64_t index = (init_to_exec_tick >> (TVR_BITS + 2 * TVN_BITS)) & TVN_MASK;
 		_tv4[index].AddTimer(t);
-		t->GetHandle()->SetLocation(4, (int32_t)index);
+		_tv4_bits.Set((int32_t)index);
+		t->SetLocation(4, (int32_t)index);
 	}
 	else
 	{
 		int64_t index = (init_to_exec_tick >> (TVR_BITS + 3 * TVN_BITS)) & TVN_MASK;
 		_tv5[index].AddTimer(t);
-		t->GetHandle()->SetLocation(5, (int32_t)index);
+		_tv5_bits.Set((int32_t)index);
+		t->SetLocation(5, (int32_t)index);
+	}
+}
+
+// 获取下次需要执行的时间(steady毫秒)，没有定时器返回-1
+int64_t TimerManager::GetNextExecuteTime() const
+{
+	if (_init_time <= 0 || _exec_time <= 0)
+	{
+		return -1;
+	}
+
+	if (!_add_timer_cache.IsEmpty())
+	{
+		return _exec_time;
+	}
+
+	if (!HasTimerAtOrBelow(5))
+	{
+		return -1;
+	}
+
+	int64_t tick = (_exec_time - _init_time) / kMilliSecOneTick;
+	if (IsTickBusy(tick))
+	{
+		return _exec_time;
+	}
+
+	return _exec_time + (NextBusyTick(tick, INT64_MAX) - tick) * kMilliSecOneTick;
+}
+
+// 跳过没有定时器需要处理的tick，返回下一个需要处理的执行时间(不超过now)
+int64_t TimerManager::SkipIdleTicks(int64_t now) const
+{
+	int64_t tick = (_exec_time - _init_time) / kMilliSecOneTick;
+	int64_t max_tick = (now - _init_time) / kMilliSecOneTick;
+	if (tick >= max_tick || IsTickBusy(tick))
+	{
+		return _exec_time;
+	}
+
+	return _exec_time + (NextBusyTick(tick, max_tick) - tick) * kMilliSecOneTick;
+}
+
+// 指定tick是否有定时器需要执行或级联(与Execute中的级联条件一致)
+bool TimerManager::IsTickBusy(int64_t tick) const
+{
+	int32_t index = (int32_t)(tick & TVR_MASK);
+	if (_tv1_bits.Test(index))
+	{
+		return true;
+	}
+
+	if (index != 0 || tick == 0)
+	{
+		return false;
+	}
+
+	for (int32_t level = 2; level <= 5; level++)
+	{
+		int32_t level_index = (int32_t)((tick >> GetLevelShift(level)) & TVN_MASK);
+		if (FindNextSlot(level, level_index) == level_index)
+		{
+			return true;
+		}
+
+		if (level_index != 0)
+		{
+			break;
+		}
 	}
+
+	return false;
+}
+
+// 查找tick之后下一个需要处理的tick(不超过max_tick)
+// 先在本层本轮中查找下一个非空槽位，没有则跳到本轮结束(上层级联点)，低层都空时到上一层查找
+int64_t TimerManager::NextBusyTick(int64_t tick, int64_t max_tick) const
+{
+	int32_t level = 1;
+	while (tick < max_tick && level <= 5)
+	{
+		int32_t shift = GetLevelShift(level);
+		int32_t bits = GetLevelBits(level);
+		int32_t index = (int32_t)((tick >> shift) & (((int64_t)1 << bits) - 1));
+		int32_t next = FindNextSlot(level, index + 1);
+		if (next >= 0)
+		{
+			return std::min(tick + ((int64_t)(next - index) << shift), max_tick);
+		}
+
+		tick = ((tick >> (shift + bits)) + 1) << (shift + bits);
+		if (tick >= max_tick || IsTickBusy(tick))
+		{
+			break;
+		}
+
+		level = HasTimerAtOrBelow(level) ? 1 : level + 1;
+	}
+
+	return std::min(tick, max_tick);
+}
+
+// 在指定层的占用位图中查找[from, 层大小)中第一个非空槽位
+int32_t TimerManager::FindNextSlot(int32_t level, int32_t from) const
+{
+	switch (level)
+	{
+	case 1: return _tv1_bits.FindNext(from);
+	case 2: return _tv2_bits.FindNext(from);
+	case 3: return _tv3_bits.FindNext(from);
+	case 4: return _tv4_bits.FindNext(from);
+	case 5: return _tv5_bits.FindNext(from);
+	}
+	return -1;
+}
+
+// 指定层及以下是否还有定时器
+bool TimerManager::HasTimerAtOrBelow(int32_t level) const
+{
+	return (level >= 1 && !_tv1_bits.IsEmpty()) ||
+		(level >= 2 && !_tv2_bits.IsEmpty()) ||
+		(level >= 3 && !_tv3_bits.IsEmpty()) ||
+		(level >= 4 && !_tv4_bits.IsEmpty()) ||
+		(level >= 5 && !_tv5_bits.IsEmpty());
 }
 
 TimerList * TimerManager::GetTV(int32_t level, int32_t * size)
@@ -6,68 +6,59 @@
 #include <inttypes.h>
 #include <vector>
 #include <memory>
+#include <new>
+#include <utility>
+#include <type_traits>
 
 namespace sframe {
 
 class Timer;
+class TimerManager;
 
-class TimerWrapper
+// 定时器句柄(槽位索引 + 代数，定时器删除后槽位代数增加，旧句柄随之失效)
+// 句柄引用所属的TimerManager，TimerManager销毁后不能再使用其句柄
+class TimerHandle
 {
 	friend class Timer;
 	friend class TimerManager;
-	friend struct TimerList;
 public:
-	TimerWrapper(Timer * timer) : _timer(timer), _level(-1), _index(-1) {}
-	~TimerWrapper() {}
+	TimerHandle() : _timer_mgr(nullptr), _slot(0), _generation(0) {}
 
-private:
-	void SetDeleted() { _timer = nullptr; }
-
-	void SetLocation(int32_t level, int32_t index) 
+	explicit operator bool() const
 	{
-		_level = level;
-		_index = index;
+		return _timer_mgr != nullptr;
 	}
 
-	Timer * GetTimerPtr() { return _timer; }
+	bool operator==(const TimerHandle & h) const
+	{
+		return _timer_mgr == h._timer_mgr && _slot == h._slot && _generation == h._generation;
+	}
 
-	void GetLocation(int32_t * level, int32_t * index) const
+	bool operator!=(const TimerHandle & h) const
 	{
-		(*level) = _level;
-		(*index) = _index;
+		return !(*this == h);
 	}
 
-	Timer * _timer;
-	int32_t _level;
-	int32_t _index;
-};
+private:
+	TimerHandle(TimerManager * timer_mgr, uint32_t slot, uint32_t generation)
+		: _timer_mgr(timer_mgr), _slot(slot), _generation(generation) {}
 
-typedef std::shared_ptr<TimerWrapper> TimerHandle;
+	TimerManager * _timer_mgr;
+	uint32_t _slot;
+	uint32_t _generation;
+};
 
 // 定时器
 class Timer
 {
+	friend class TimerManager;
 public:
 
-	static bool IsTimerAlive(const TimerHandle & timer_handle)
-	{
-		return timer_handle ? timer_handle->_timer != nullptr : false;
-	}
+	static bool IsTimerAlive(const TimerHandle & timer_handle);
 
-	Timer() : _exec_time(0), _prev(nullptr), _next(nullptr)
-	{
-		_handle = std::make_shared<TimerWrapper>(this);
-	}
-
-	virtual ~Timer()
-	{
-		_handle->SetDeleted();
-	}
+	Timer() : _exec_time(0), _prev(nullptr), _next(nullptr), _slot(0), _level(-1), _index(-1), _pooled(false) {}
 
-	const TimerHandle & GetHandle() const
-	{
-		return _handle;
-	}
+	virtual ~Timer() {}
 
 	void SetExecTime(int64_t exec_time)
 	{
@@ -99,13 +90,28 @@ public:
 		_next = t;
 	}
 
+	void SetLocation(int32_t level, int32_t index)
+	{
+		_level = level;
+		_index = index;
+	}
+
+	void GetLocation(int32_t * level, int32_t * index) const
+	{
+		(*level) = _level;
+		(*index) = _index;
+	}
+
 	virtual int32_t Invoke() const = 0;
 
 protected:
-	TimerHandle _handle;
 	int64_t _exec_time;     // 执行时间
 	Timer * _prev;
 	Timer * _next;
+	uint32_t _slot;         // 所在槽位
+	int32_t _level;         // 所在时间轮层级(0为添加缓存，-1为不在任何链表中)
+	int32_t _index;         // 所在时间轮下标
+	bool _pooled;           // 内存是否来自节点池
 };
 
 // 普通Timer(执行静态函数)
@@ -263,8 +269,6 @@ struct TimerList
 {
 	TimerList() : timer_head(nullptr), timer_tail(nullptr) {}
 
-	~TimerList();
-
 	void DeleteTimer(Timer * t)
 	{
 		if (t == nullptr)
@@ -301,7 +305,7 @@ struct TimerList
 
 		t->SetPrev(nullptr);
 		t->SetNext(nullptr);
-		t->GetHandle()->SetLocation(-1, -1);
+		t->SetLocation(-1, -1);
 	}
 
 	void AddTimer(Timer * t)
@@ -345,18 +349,141 @@ struct tvec_root {
 	struct TimerList vec[TVR_SIZE];
 };
 
+// 时间轮槽位占用位图(用于快速查找下一个非空槽位)
+template<int32_t Slot_Count>
+class TimerSlotBitmap
+{
+	static const int32_t kWordCount = (Slot_Count + 63) / 64;
+
+public:
+	TimerSlotBitmap()
+	{
+		for (int32_t i = 0; i < kWordCount; i++)
+		{
+			_words[i] = 0;
+		}
+	}
+
+	bool Test(int32_t index) const
+	{
+		assert(index >= 0 && index < Slot_Count);
+		return (_words[index >> 6] & ((uint64_t)1 << (index & 63))) != 0;
+	}
+
+	void Set(int32_t index)
+	{
+		assert(index >= 0 && index < Slot_Count);
+		_words[index >> 6] |= ((uint64_t)1 << (index & 63));
+	}
+
+	void Clear(int32_t index)
+	{
+		assert(index >= 0 && index < Slot_Count);
+		_words[index >> 6] &= ~((uint64_t)1 << (index & 63));
+	}
+
+	bool IsEmpty() const
+	{
+		for (int32_t i = 0; i < kWordCount; i++)
+		{
+			if (_words[i] != 0)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// 查找[from, Slot_Count)中第一个被占用的槽位，没有返回-1
+	int32_t FindNext(int32_t from) const
+	{
+		if (from < 0)
+		{
+			from = 0;
+		}
+
+		for (int32_t i = from >> 6; i < kWordCount && from < Slot_Count; i++)
+		{
+			uint64_t w = _words[i];
+			if (i == (from >> 6))
+			{
+				w &= ~(uint64_t)0 << (from & 63);
+			}
+
+			if (w != 0)
+			{
+				return (i << 6) + LowestBit(w);
+			}
+		}
+
+		return -1;
+	}
+
+private:
+	static int32_t LowestBit(uint64_t w)
+	{
+#ifdef __GNUC__
+		return __builtin_ctzll(w);
+#else
+		int32_t n = 0;
+		while ((w & 1) == 0)
+		{
+			w >>= 1;
+			n++;
+		}
+		return n;
+#endif
+	}
+
+	uint64_t _words[kWordCount];
+};
+
+// 定时器节点池(定长内存块，单线程使用，避免每个定时器都进行一次堆分配)
+class TimerNodePool
+{
+public:
+	static const size_t kNodeSize = 128;              // 节点大小(超过此大小的定时器直接从堆上分配)
+	static const size_t kNodeCountPerChunk = 256;     // 每次分配的节点数量
+
+	TimerNodePool() : _free_list(nullptr) {}
+
+	~TimerNodePool();
+
+	// 分配一个节点
+	void * Alloc();
+
+	// 释放节点
+	void Free(void * p);
+
+private:
+	TimerNodePool(const TimerNodePool &) = delete;
+	TimerNodePool & operator=(const TimerNodePool &) = delete;
+
+	union Node
+	{
+		Node * next;
+		int64_t align_i;
+		double align_d;
+		void * align_p;
+		char data[kNodeSize];
+	};
+
+	std::vector<Node *> _chunks;
+	Node * _free_list;
+};
+
 // 定时器管理器
 class TimerManager
 {
 public:
 	static const int32_t kMilliSecOneTick = 1;                  // 一个tick多少毫秒
 
-	TimerManager() : _exec_time(0), _cur_exec_timer(nullptr), _del_cur_timer(false)
+	TimerManager() : _exec_time(0), _init_time(0), _cur_exec_timer(nullptr), _del_cur_timer(false), _free_slot(kInvalidSlot)
 	{
-		_add_timer_cache.reserve(128);
+		_slots.reserve(128);
 	}
 
-	~TimerManager() {}
+	~TimerManager();
 
 	// 注册普通定时器
 	// after_msec: 多少毫秒后执行
@@ -369,7 +496,7 @@ public:
 		if (!func || after_msec < 0)
 		{
 			assert(false);
-			return 0;
+			return TimerHandle();
 		}
 
 		int64_t now = Now();
@@ -380,24 +507,104 @@ public:
 			_exec_time = now;
 		}
 
-		ObjectTimer<T_ObjPtr> * t = new ObjectTimer<T_ObjPtr>(obj_ptr, func);
+		ObjectTimer<T_ObjPtr> * t = NewTimer<ObjectTimer<T_ObjPtr>>(obj_ptr, func);
 		t->SetExecTime(now + after_msec);
 		AddTimer(t);
 
-		return t->GetHandle();
+		return GetHandle(t);
 	}
 
 	// 删除定时器
-	void DeleteTimer(TimerHandle timer_handle);
+	void DeleteTimer(const TimerHandle & timer_handle);
+
+	// 定时器是否还存在
+	bool IsTimerAlive(const TimerHandle & timer_handle) const
+	{
+		return GetTimer(timer_handle) != nullptr;
+	}
 
 	// 执行
 	void Execute();
 
+	// 获取下次需要执行的时间(steady毫秒)，没有定时器返回-1
+	int64_t GetNextExecuteTime() const;
+
 private:
-	int32_t Cascade(TimerList * tv, int32_t index);
+	static const uint32_t kInvalidSlot = 0xffffffff;
+
+	// 句柄槽位
+	struct TimerSlot
+	{
+		Timer * timer;          // 定时器(空闲时为空)
+		uint32_t generation;    // 代数
+		uint32_t next_free;     // 下一个空闲槽位
+	};
+
+	// 创建定时器(优先从节点池分配)
+	template<typename T_Timer, typename... T_Args>
+	T_Timer * NewTimer(T_Args&&... args)
+	{
+		bool pooled = sizeof(T_Timer) <= TimerNodePool::kNodeSize;
+		void * mem = pooled ? _node_pool.Alloc() : ::operator new(sizeof(T_Timer));
+		T_Timer * t = new(mem) T_Timer(std::forward<T_Args>(args)...);
+		t->_pooled = pooled;
+		t->_slot = AllocSlot(t);
+		return t;
+	}
+
+	// 释放定时器
+	void FreeTimer(Timer * t);
+
+	// 释放链表中所有定时器
+	void FreeTimerList(TimerList & timer_list);
+
+	uint32_t AllocSlot(Timer * t);
+
+	TimerHandle GetHandle(const Timer * t) const
+	{
+		return TimerHandle(const_cast<TimerManager*>(this), t->_slot, _slots[t->_slot].generation);
+	}
+
+	Timer * GetTimer(const TimerHandle & timer_handle) const
+	{
+		if (timer_handle._timer_mgr != this || timer_handle._slot >= _slots.size())
+		{
+			return nullptr;
+		}
+
+		const TimerSlot & slot = _slots[timer_handle._slot];
+		return slot.generation == timer_handle._generation ? slot.timer : nullptr;
+	}
+
+	int32_t Cascade(TimerList * tv, TimerSlotBitmap<TVN_SIZE> & tv_bits, int32_t index);
 
 	void AddTimer(Timer * t);
 
+	// 跳过没有定时器需要处理的tick，返回下一个需要处理的执行时间(不超过now)
+	int64_t SkipIdleTicks(int64_t now) const;
+
+	// 指定tick是否有定时器需要执行或级联
+	bool IsTickBusy(int64_t tick) const;
+
+	// 查找tick之后下一个需要处理的tick(不超过max_tick)
+	int64_t NextBusyTick(int64_t tick, int64_t max_tick) const;
+
+	// 在指定层的占用位图中查找[from, 层大小)中第一个非空槽位
+	int32_t FindNextSlot(int32_t level, int32_t from) const;
+
+	// 指定层及以下是否还有定时器
+	bool HasTimerAtOrBelow(int32_t level) const;
+
+	static int32_t GetLevelShift(int32_t level)
+	{
+		return level <= 1 ? 0 : TVR_BITS + (level - 2) * TVN_BITS;
+	}
+
+	static int32_t GetLevelBits(int32_t level)
+	{
+		return level <= 1 ? TVR_BITS : TVN_BITS;
+	}
+
 	TimerList * GetTV(int32_t level, int32_t * size);
 
 	static int64_t MilliSecToTick(int64_t millisec, bool ceil);
@@ -405,18 +612,34 @@ private:
 	int64_t Now();
 
 private:
+	TimerManager(const TimerManager &) = delete;
+	TimerManager & operator=(const TimerManager &) = delete;
+
 	TimerList _tv1[TVR_SIZE];
 	TimerList _tv2[TVN_SIZE];
 	TimerList _tv3[TVN_SIZE];
 	TimerList _tv4[TVN_SIZE];
 	TimerList _tv5[TVN_SIZE];
+	TimerSlotBitmap<TVR_SIZE> _tv1_bits;                 // 各层槽位占用位图
+	TimerSlotBitmap<TVN_SIZE> _tv2_bits;
+	TimerSlotBitmap<TVN_SIZE> _tv3_bits;
+	TimerSlotBitmap<TVN_SIZE> _tv4_bits;
+	TimerSlotBitmap<TVN_SIZE> _tv5_bits;
 	int64_t _exec_time;
 	int64_t _init_time;
-	std::vector<Timer*> _add_timer_cache;                // 添加定时器缓存
+	TimerList _add_timer_cache;                          // 添加定时器缓存(执行定时器期间添加的定时器)
 	Timer * _cur_exec_timer;
 	bool _del_cur_timer;
+	TimerNodePool _node_pool;                            // 定时器节点池
+	std::vector<TimerSlot> _slots;                       // 句柄槽位
+	uint32_t _free_slot;                                 // 空闲槽位链表头
 };
 
+inline bool Timer::IsTimerAlive(const TimerHandle & timer_handle)
+{
+	return timer_handle._timer_mgr ? timer_handle._timer_mgr->IsTimerAlive(timer_handle) : false;
+}
+
 
 // 安全Timer注册，派生此类，用其注册定时器，对象析构后不用手动删除定时器
 template<typename T>
@@ -452,7 +675,7 @@ public:
 		if (_timer_mgr == nullptr)
 		{
 			assert(false);
-			return 0;
+			return TimerHandle();
 		}
 
 		if (!_safe_timer_obj)
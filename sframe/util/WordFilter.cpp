@@ -1,244 +1,727 @@
-﻿
-#include <assert.h>
-#include <sstream>
-#include <memory.h>
-#include <algorithm>
-#include "WordFilter.h"
-
-using namespace sframe;
-
-TrieNode::~TrieNode()
-{
-	for (auto & pr : _children)
-	{
-		if (pr.second)
-		{
-			delete pr.second;
-		}
-	}
-}
-
-TrieNode * TrieNode::GetChild(uint8_t c, bool create_when_null)
-{
-	auto it = _children.find(c);
-	if (it == _children.end())
-	{
-		if (create_when_null)
-		{
-			TrieNode * node = new TrieNode();
-			if (!_children.insert(std::make_pair(c, node)).second)
-			{
-				assert(false);
-				return nullptr;
-			}
-			return node;
-		}
-
-		return nullptr;
-	}
-
-	return it->second;
-}
-
-
-
-Trie::Trie(bool ignore_case)
-{
-	memset(_nodes, 0, sizeof(_nodes));
-	_ignore_case = ignore_case;
-	memset(_is_ignore, 0, sizeof(_is_ignore));
-}
-
-Trie::~Trie()
-{
-	for (int i = 0; i < kMaxCharCount; i++)
-	{
-		if (_nodes[i])
-		{
-			delete _nodes[i];
-		}
-	}
-}
-
-void Trie::AddIgnoreCharacters(const char * str)
-{
-	if (str == nullptr)
-	{
-		return;
-	}
-
-	while ((*str) != '\0')
-	{
-		uint8_t c = (uint8_t)(*str);
-		if (_ignore_case && c >= (uint8_t)'A' && c <= (uint8_t)'Z')
-		{
-			c += (uint8_t)32;
-		}
-
-		_is_ignore[c] = true;
-		str++;
-	}
-}
-
-void Trie::AddWord(const char * str, size_t len)
-{
-	if (str == nullptr || len == 0)
-	{
-		return;
-	}
-
-	uint8_t c = (uint8_t)str[0];
-	if (_ignore_case && c >= (uint8_t)'A' && c <= (uint8_t)'Z')
-	{
-		c += (uint8_t)32;
-	}
-
-	auto node = _nodes[c];
-	if (!node)
-	{
-		node = new TrieNode();
-		_nodes[c] = node;
-	}
-
-	for (size_t i = 1; i < len; i++)
-	{
-		c = (uint8_t)str[i];
-		if (_ignore_case && c >= (uint8_t)'A' && c <= (uint8_t)'Z')
-		{
-			c += (uint8_t)32;
-		}
-
-		if (_is_ignore[c])
-		{
-			continue;
-		}
-
-		TrieNode * cur_node = node->GetChild(c, true);
-		assert(cur_node);
-		node = cur_node;
-	}
-
-	node->SetIsEndNode(true);
-}
-
-size_t Trie::FindWord(const char * str, size_t len)
-{
-	if (str == nullptr || len == 0)
-	{
-		return 0;
-	}
-
-	uint8_t c = (uint8_t)str[0];
-	if (_ignore_case && c >= (uint8_t)'A' && c <= (uint8_t)'Z')
-	{
-		c += (uint8_t)32;
-	}
-
-	TrieNode * node = _nodes[c];
-	if (node == nullptr)
-	{
-		return 0;
-	}
-
-	size_t ret = node->IsEndNode() ? 1 : 0;
-
-	for (size_t i = 1; i < len; i++)
-	{
-		c = (uint8_t)str[i];
-		if (_ignore_case && c >= (uint8_t)'A' && c <= (uint8_t)'Z')
-		{
-			c += (uint8_t)32;
-		}
-
-		if (_is_ignore[c])
-		{
-			continue;
-		}
-
-		TrieNode * cur_node = node->GetChild(c, false);
-		if (cur_node == nullptr)
-		{
-			break;
-		}
-
-		if (cur_node->IsEndNode())
-		{
-			ret = i + 1;
-		}
-
-		node = cur_node;
-	}
-
-	return ret;
-}
-
-
-
-
-bool WordFilter::HaveBadWord(const std::string & text)
-{
-	if (text.empty())
-	{
-		return false;
-	}
-
-	const char * str = text.c_str();
-	size_t len = text.length();
-
-	for (size_t i = 0; i < len; i++)
-	{
-		if (_trie.FindWord(str + i, len - i) > 0)
-		{
-			return true;
-		}
-	}
-
-	return false;
-}
-
-std::string WordFilter::ReplaceBadWord(const std::string & text, char replace_char, size_t replace_char_count)
-{
-	if (text.empty())
-	{
-		return "";
-	}
-
-	std::ostringstream oss;
-	const char * str = text.c_str();
-	size_t len = text.length();
-	char replace_str[33] = { 0 };
-	if (replace_char_count > 0)
-	{
-		memset(replace_str, (int)replace_char, std::min(replace_char_count, (size_t)32));
-	}
-
-	while (len > 0)
-	{
-		size_t bad_word_len = _trie.FindWord(str, len);
-		assert(bad_word_len <= len);
-		if (bad_word_len == 0)
-		{
-			oss << *str;
-			str++;
-			len--;
-		}
-		else
-		{
-			if (replace_char_count > 0)
-			{
-				oss << replace_str;
-			}
-			else
-			{
-				for (size_t i = 0; i < bad_word_len; i++)
-				{
-					oss << replace_char;
-				}
-			}
-			str += bad_word_len;
-			len -= bad_word_len;
-		}
-	}
-
-	return oss.str();
-}
+﻿
+#include <assert.h>
+#include <string.h>
+#include <algorithm>
+#include "WordFilter.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SFRAME_WORD_FILTER_SSE2
+#include <emmintrin.h>
+#endif
+
+using namespace sframe;
+
+// 零宽字符和格式控制字符(归一化时总是去掉)
+static bool IsFormatCodePoint(uint32_t cp)
+{
+	if (cp < 0x2000)
+	{
+		return cp == 0x00AD || cp == 0x034F || cp == 0x061C || cp == 0x115F || cp == 0x1160 ||
+			cp == 0x17B4 || cp == 0x17B5 || (cp >= 0x180B && cp <= 0x180F);
+	}
+
+	return (cp >= 0x200B && cp <= 0x200F) || (cp >= 0x202A && cp <= 0x202E) || (cp >= 0x2060 && cp <= 0x206F) ||
+		cp == 0x3164 || (cp >= 0xFE00 && cp <= 0xFE0F) || cp == 0xFEFF || cp == 0xFFA0 ||
+		(cp >= 0xE0000 && cp <= 0xE0FFF);
+}
+
+// 写入UTF-8编码，返回字节数
+static size_t EncodeChar(uint32_t cp, char * out)
+{
+	if (cp < 0x80)
+	{
+		out[0] = (char)cp;
+		return 1;
+	}
+	else if (cp < 0x800)
+	{
+		out[0] = (char)(0xC0 | (cp >> 6));
+		out[1] = (char)(0x80 | (cp & 0x3F));
+		return 2;
+	}
+	else if (cp < 0x10000)
+	{
+		out[0] = (char)(0xE0 | (cp >> 12));
+		out[1] = (char)(0x80 | ((cp >> 6) & 0x3F));
+		out[2] = (char)(0x80 | (cp & 0x3F));
+		return 3;
+	}
+
+	out[0] = (char)(0xF0 | (cp >> 18));
+	out[1] = (char)(0x80 | ((cp >> 12) & 0x3F));
+	out[2] = (char)(0x80 | ((cp >> 6) & 0x3F));
+	out[3] = (char)(0x80 | (cp & 0x3F));
+	return 4;
+}
+
+WordNormalizer::WordNormalizer(const std::string & ignore_chars, bool ignore_case) : _ignore_case(ignore_case)
+{
+	for (int i = 0; i < 128; i++)
+	{
+		_ascii_map[i] = (ignore_case && i >= 'A' && i <= 'Z') ? (uint8_t)(i + 32) : (uint8_t)i;
+	}
+
+	const char * str = ignore_chars.data();
+	size_t len = ignore_chars.size();
+	for (size_t i = 0; i < len; )
+	{
+		uint32_t cp;
+		i += DecodeChar(str + i, len - i, cp);
+		if (cp == kInvalidCodePoint)
+		{
+			continue;
+		}
+
+		cp = FoldCodePoint(cp);
+		if (cp >= 0x80)
+		{
+			_ignore_code_points.push_back(cp);
+			continue;
+		}
+
+		// 折叠后相同的字符都去掉
+		uint8_t folded = _ascii_map[cp];
+		for (int c = 0; c < 128; c++)
+		{
+			if (_ascii_map[c] == folded)
+			{
+				_ascii_map[c] = 0;
+			}
+		}
+	}
+
+	_ascii_map[0] = 0;
+	for (int c = 0; c < 128; c++)
+	{
+		if (_ascii_map[c] == 0)
+		{
+			_ascii_dropped.push_back((char)c);
+		}
+	}
+
+	std::sort(_ignore_code_points.begin(), _ignore_code_points.end());
+	_ignore_code_points.erase(std::unique(_ignore_code_points.begin(), _ignore_code_points.end()), _ignore_code_points.end());
+
+	_bmp_special.assign(0x10000 / 64, 0);
+	for (uint32_t cp = 0x80; cp < 0x10000; cp++)
+	{
+		if (FoldCodePoint(cp) != cp || IsIgnoredCodePoint(cp))
+		{
+			_bmp_special[cp >> 6] |= (uint64_t)1 << (cp & 63);
+		}
+	}
+}
+
+size_t WordNormalizer::DecodeChar(const char * str, size_t len, uint32_t & code_point)
+{
+	const uint8_t * s = (const uint8_t *)str;
+	uint8_t c = s[0];
+	if (c < 0x80)
+	{
+		code_point = c;
+		return 1;
+	}
+
+	size_t n;
+	uint32_t cp;
+	uint32_t min_cp;
+	if (c >= 0xC2 && c <= 0xDF)
+	{
+		n = 2;
+		cp = c & 0x1F;
+		min_cp = 0x80;
+	}
+	else if (c >= 0xE0 && c <= 0xEF)
+	{
+		n = 3;
+		cp = c & 0x0F;
+		min_cp = 0x800;
+	}
+	else if (c >= 0xF0 && c <= 0xF4)
+	{
+		n = 4;
+		cp = c & 0x07;
+		min_cp = 0x10000;
+	}
+	else
+	{
+		code_point = kInvalidCodePoint;
+		return 1;
+	}
+
+	if (n > len)
+	{
+		code_point = kInvalidCodePoint;
+		return 1;
+	}
+
+	for (size_t i = 1; i < n; i++)
+	{
+		if ((s[i] & 0xC0) != 0x80)
+		{
+			code_point = kInvalidCodePoint;
+			return 1;
+		}
+		cp = (cp << 6) | (s[i] & 0x3F);
+	}
+
+	// 过长编码、代理项、超出范围
+	if (cp < min_cp || cp > 0x10FFFF || (cp >= 0xD800 && cp <= 0xDFFF))
+	{
+		code_point = kInvalidCodePoint;
+		return 1;
+	}
+
+	code_point = cp;
+	return n;
+}
+
+uint32_t WordNormalizer::FoldCodePoint(uint32_t cp) const
+{
+	// 全角ASCII、全角空格
+	if (cp >= 0xFF01 && cp <= 0xFF5E)
+	{
+		return cp - 0xFEE0;
+	}
+	else if (cp == 0x3000)
+	{
+		return ' ';
+	}
+
+	if (!_ignore_case || cp < 0xC0 || cp >= 0x430)
+	{
+		return cp;
+	}
+
+	// 拉丁、希腊、西里尔大写字母(折叠后UTF-8长度不变)
+	if ((cp <= 0xDE && cp != 0xD7) || (cp >= 0x391 && cp <= 0x3A9 && cp != 0x3A2) || (cp >= 0x410 && cp <= 0x42F))
+	{
+		return cp + 0x20;
+	}
+	else if (cp >= 0x400 && cp <= 0x40F)
+	{
+		return cp + 0x50;
+	}
+
+	return cp;
+}
+
+bool WordNormalizer::IsIgnoredCodePoint(uint32_t cp) const
+{
+	return IsFormatCodePoint(cp) || (!_ignore_code_points.empty() &&
+		std::binary_search(_ignore_code_points.begin(), _ignore_code_points.end(), cp));
+}
+
+size_t WordNormalizer::NormalizeChar(const char * str, size_t len, char * & out) const
+{
+	uint8_t c = (uint8_t)str[0];
+	if (c < 0x80)
+	{
+		*out = (char)_ascii_map[c];
+		out += _ascii_map[c] != 0;
+		return 1;
+	}
+
+	uint32_t cp;
+	size_t n = DecodeChar(str, len, cp);
+	if (cp == kInvalidCodePoint)
+	{
+		*out++ = str[0];
+		return 1;
+	}
+
+	// 大多数字符不需要变换，直接复制
+	if (cp < 0x10000 && (_bmp_special[cp >> 6] & ((uint64_t)1 << (cp & 63))) == 0)
+	{
+		memcpy(out, str, n);
+		out += n;
+		return n;
+	}
+
+	cp = FoldCodePoint(cp);
+	if (cp < 0x80)
+	{
+		*out = (char)_ascii_map[cp];
+		out += _ascii_map[cp] != 0;
+	}
+	else if (!IsIgnoredCodePoint(cp))
+	{
+		out += EncodeChar(cp, out);
+	}
+
+	return n;
+}
+
+void WordNormalizer::Normalize(const char * str, size_t len, std::string & out, std::vector<uint32_t> * offsets) const
+{
+	out.resize(len);
+	if (offsets)
+	{
+		offsets->resize(len);
+	}
+
+	if (len == 0)
+	{
+		return;
+	}
+
+	char * out_begin = &out[0];
+	char * o = out_begin;
+	uint32_t * off = offsets ? &(*offsets)[0] : nullptr;
+	size_t i = 0;
+
+	while (i < len)
+	{
+		size_t scalar_end = i + 1;
+
+#ifdef SFRAME_WORD_FILTER_SSE2
+		if (len - i >= 16)
+		{
+			__m128i v = _mm_loadu_si128((const __m128i *)(str + i));
+			if (_mm_movemask_epi8(v) == 0)
+			{
+				// 纯ASCII：整块折叠大小写，没有要去掉的字符时整块写入
+				__m128i dropped = _mm_setzero_si128();
+				bool compare_all = _ascii_dropped.size() <= 8;
+				if (compare_all)
+				{
+					for (char c : _ascii_dropped)
+					{
+						dropped = _mm_or_si128(dropped, _mm_cmpeq_epi8(v, _mm_set1_epi8(c)));
+					}
+				}
+
+				if (compare_all && _mm_movemask_epi8(dropped) == 0)
+				{
+					if (_ignore_case)
+					{
+						__m128i upper = _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8('A' - 1)), _mm_cmplt_epi8(v, _mm_set1_epi8('Z' + 1)));
+						v = _mm_add_epi8(v, _mm_and_si128(upper, _mm_set1_epi8(0x20)));
+					}
+					_mm_storeu_si128((__m128i *)o, v);
+
+					if (off)
+					{
+						uint32_t * p = off + (o - out_begin);
+						for (uint32_t k = 0; k < 16; k++)
+						{
+							p[k] = (uint32_t)i + k;
+						}
+					}
+
+					o += 16;
+					i += 16;
+					continue;
+				}
+
+				// 有要去掉的字符：逐字节查表压缩
+				for (size_t end = i + 16; i < end; i++)
+				{
+					uint8_t m = _ascii_map[(uint8_t)str[i]];
+					if (off)
+					{
+						off[o - out_begin] = (uint32_t)i;
+					}
+					*o = (char)m;
+					o += m != 0;
+				}
+				continue;
+			}
+
+			// 含非ASCII字符的块逐字符处理
+			scalar_end = i + 16;
+		}
+#endif
+
+		while (i < scalar_end)
+		{
+			// 三字节字符(中日韩文字)不需要变换时直接复制
+			const uint8_t * s = (const uint8_t *)str + i;
+			if ((s[0] & 0xF0) == 0xE0 && len - i >= 3 && (s[1] & 0xC0) == 0x80 && (s[2] & 0xC0) == 0x80)
+			{
+				uint32_t cp = ((uint32_t)(s[0] & 0x0F) << 12) | ((uint32_t)(s[1] & 0x3F) << 6) | (s[2] & 0x3F);
+				if (cp >= 0x800 && (cp < 0xD800 || cp > 0xDFFF) && (_bmp_special[cp >> 6] & ((uint64_t)1 << (cp & 63))) == 0)
+				{
+					o[0] = (char)s[0];
+					o[1] = (char)s[1];
+					o[2] = (char)s[2];
+					if (off)
+					{
+						uint32_t * p = off + (o - out_begin);
+						p[0] = p[1] = p[2] = (uint32_t)i;
+					}
+					o += 3;
+					i += 3;
+					continue;
+				}
+			}
+
+			char * char_out = o;
+			size_t n = NormalizeChar(str + i, len - i, o);
+			if (off)
+			{
+				for (char * p = char_out; p < o; p++)
+				{
+					off[p - out_begin] = (uint32_t)i;
+				}
+			}
+			i += n;
+		}
+	}
+
+	size_t out_len = (size_t)(o - out_begin);
+	out.resize(out_len);
+	if (offsets)
+	{
+		offsets->resize(out_len);
+	}
+}
+
+// 每个线程复用的匹配缓冲区
+struct WordMatchBuffer
+{
+	std::string text;                     // 归一化后的文本
+	std::vector<uint32_t> offsets;        // 归一化文本每个字节在原文中的位置
+	std::vector<uint32_t> match_end;      // 归一化文本中的匹配结束位置
+	std::vector<uint32_t> src_match_end;  // 原文中的匹配结束位置
+};
+
+static WordMatchBuffer & GetWordMatchBuffer()
+{
+	static thread_local WordMatchBuffer buf;
+	return buf;
+}
+
+// 双数组中的空闲位置(并查集，查找不小于指定位置的第一个空闲位置)
+class DoubleArrayFreeSlots
+{
+public:
+	// 不小于pos的第一个空闲位置
+	size_t Find(size_t pos)
+	{
+		Reserve(pos + 1);
+		size_t root = pos;
+		while (_next[root] != root)
+		{
+			root = _next[root];
+			Reserve(root + 1);
+		}
+
+		// 路径压缩
+		while (_next[pos] != root)
+		{
+			size_t next = _next[pos];
+			_next[pos] = root;
+			pos = next;
+		}
+
+		return root;
+	}
+
+	void MarkUsed(size_t pos)
+	{
+		Reserve(pos + 2);
+		_next[pos] = pos + 1;
+	}
+
+private:
+	void Reserve(size_t size)
+	{
+		while (_next.size() < size)
+		{
+			_next.push_back(_next.size());
+		}
+	}
+
+private:
+	std::vector<size_t> _next;
+};
+
+// 编译时使用的临时单词查找树
+struct BuildTrieNode
+{
+	BuildTrieNode() : word_len(0) {}
+
+	int32_t FindChild(uint8_t c) const
+	{
+		for (auto & child : children)
+		{
+			if (child.first == c)
+			{
+				return child.second;
+			}
+		}
+		return -1;
+	}
+
+	std::vector<std::pair<uint8_t, int32_t>> children;
+	int32_t word_len;
+};
+
+std::shared_ptr<const WordAutomaton> WordAutomaton::Build(const std::vector<std::string> & words, const std::string & ignore_chars, bool ignore_case)
+{
+	std::shared_ptr<WordAutomaton> automaton(new WordAutomaton());
+	WordAutomaton & am = *automaton;
+
+	am._normalizer = WordNormalizer(ignore_chars, ignore_case);
+
+	// 1. 用归一化后的词构造单词查找树
+	std::vector<BuildTrieNode> trie(1);
+	std::string normalized;
+	for (const std::string & word : words)
+	{
+		am._normalizer.Normalize(word.data(), word.size(), normalized, nullptr);
+		int32_t node = 0;
+		int32_t word_len = 0;
+		for (char ch : normalized)
+		{
+			uint8_t c = (uint8_t)ch;
+			int32_t child = trie[node].FindChild(c);
+			if (child < 0)
+			{
+				child = (int32_t)trie.size();
+				trie[node].children.push_back(std::make_pair(c, child));
+				trie.push_back(BuildTrieNode());
+			}
+			node = child;
+			word_len++;
+		}
+
+		if (node > 0)
+		{
+			trie[node].word_len = word_len;
+		}
+	}
+
+	// 2. 按层次放入双数组(每个节点找一个base，使所有子节点的位置都空闲)
+	std::vector<int32_t> trie_to_state(trie.size(), 0);
+	std::vector<int32_t> bfs_order;
+	bfs_order.reserve(trie.size());
+	bfs_order.push_back(0);
+
+	am._units.assign(kMaxCharCount + 1, Unit{ 0, -1 });
+	am._units[0].check = -2;
+	DoubleArrayFreeSlots free_slots;
+	free_slots.MarkUsed(0);
+
+	for (size_t i = 0; i < bfs_order.size(); i++)
+	{
+		int32_t node = bfs_order[i];
+		int32_t state = trie_to_state[node];
+		BuildTrieNode & trie_node = trie[node];
+		if (trie_node.children.empty())
+		{
+			continue;
+		}
+
+		std::sort(trie_node.children.begin(), trie_node.children.end());
+		uint8_t first_c = trie_node.children[0].first;
+
+		// 只在第一个子节点能放下的空闲位置上尝试
+		int32_t base = 0;
+		for (size_t pos = free_slots.Find((size_t)first_c + 1); ; pos = free_slots.Find(pos + 1))
+		{
+			base = (int32_t)pos - (int32_t)first_c - 1;
+			size_t need_size = (size_t)base + kMaxCharCount + 1;
+			if (am._units.size() < need_size)
+			{
+				am._units.resize(need_size, Unit{ 0, -1 });
+			}
+
+			bool ok = true;
+			for (auto & child : trie_node.children)
+			{
+				if (am._units[base + child.first + 1].check != -1)
+				{
+					ok = false;
+					break;
+				}
+			}
+
+			if (ok)
+			{
+				break;
+			}
+		}
+
+		am._units[state].base = base;
+		for (auto & child : trie_node.children)
+		{
+			int32_t child_state = base + child.first + 1;
+			am._units[child_state].check = state;
+			free_slots.MarkUsed(child_state);
+			trie_to_state[child.second] = child_state;
+			bfs_order.push_back(child.second);
+		}
+	}
+
+	// 去掉末尾没用的单元
+	size_t units_size = am._units.size();
+	while (units_size > 1 && am._units[units_size - 1].check == -1)
+	{
+		units_size--;
+	}
+	am._units.resize(units_size);
+	am._units.shrink_to_fit();
+
+	// 3. 按层次计算失败指针和输出链
+	am._fail.assign(units_size, 0);
+	am._word_len.assign(units_size, 0);
+	am._output_link.assign(units_size, 0);
+
+	for (int32_t node : bfs_order)
+	{
+		int32_t state = trie_to_state[node];
+		am._word_len[state] = trie[node].word_len;
+
+		for (auto & child : trie[node].children)
+		{
+			int32_t child_state = trie_to_state[child.second];
+			int32_t fail = state == 0 ? 0 : am.Next(am._fail[state], child.first);
+			am._fail[child_state] = fail;
+		}
+	}
+
+	for (int32_t node : bfs_order)
+	{
+		int32_t state = trie_to_state[node];
+		if (state != 0)
+		{
+			int32_t fail = am._fail[state];
+			am._output_link[state] = am._word_len[fail] > 0 ? fail : am._output_link[fail];
+		}
+	}
+
+	return automaton;
+}
+
+bool WordAutomaton::Match(const char * text, size_t len, std::vector<uint32_t> * match_end, bool stop_at_first) const
+{
+	bool found = false;
+	int32_t state = 0;
+	for (size_t i = 0; i < len; i++)
+	{
+		state = Next(state, (uint8_t)text[i]);
+		int32_t out = _word_len[state] > 0 ? state : _output_link[state];
+		if (out == 0)
+		{
+			continue;
+		}
+
+		found = true;
+		if (stop_at_first)
+		{
+			return true;
+		}
+
+		// 结束位置递增，后写入的即为该开始位置的最长敏感词
+		for (; out != 0; out = _output_link[out])
+		{
+			(*match_end)[i + 1 - _word_len[out]] = (uint32_t)i + 1;
+		}
+	}
+
+	return found;
+}
+
+bool WordAutomaton::HaveBadWord(const char * str, size_t len) const
+{
+	WordMatchBuffer & buf = GetWordMatchBuffer();
+	_normalizer.Normalize(str, len, buf.text, nullptr);
+	return Match(buf.text.data(), buf.text.size(), nullptr, true);
+}
+
+std::string WordAutomaton::ReplaceBadWord(const char * str, size_t len, char replace_char, size_t replace_char_count) const
+{
+	WordMatchBuffer & buf = GetWordMatchBuffer();
+	_normalizer.Normalize(str, len, buf.text, &buf.offsets);
+	size_t text_len = buf.text.size();
+	buf.match_end.assign(text_len, 0);
+	if (!Match(buf.text.data(), text_len, &buf.match_end, false))
+	{
+		return std::string(str, len);
+	}
+
+	// 映射回原文：开始于首字节对应字符的开始，结束于末字节对应字符的结尾
+	std::vector<uint32_t> & match_end = buf.src_match_end;
+	match_end.assign(len, 0);
+	for (size_t i = 0; i < text_len; i++)
+	{
+		if (buf.match_end[i] == 0)
+		{
+			continue;
+		}
+
+		uint32_t begin = buf.offsets[i];
+		uint32_t last = buf.offsets[buf.match_end[i] - 1];
+		uint32_t cp;
+		uint32_t end = last + (uint32_t)WordNormalizer::DecodeChar(str + last, len - last, cp);
+		if (end > match_end[begin])
+		{
+			match_end[begin] = end;
+		}
+	}
+
+	std::string result;
+	result.reserve(len);
+	replace_char_count = std::min(replace_char_count, (size_t)32);
+
+	size_t i = 0;
+	while (i < len)
+	{
+		if (match_end[i] == 0)
+		{
+			result.push_back(str[i]);
+			i++;
+			continue;
+		}
+
+		size_t end = match_end[i];
+		result.append(replace_char_count > 0 ? replace_char_count : end - i, replace_char);
+		i = end;
+	}
+
+	return result;
+}
+
+
+
+
+bool WordFilter::HaveBadWord(const std::string & text) const
+{
+	if (text.empty())
+	{
+		return false;
+	}
+
+	return GetCompiledAutomaton()->HaveBadWord(text.c_str(), text.length());
+}
+
+std::string WordFilter::ReplaceBadWord(const std::string & text, char replace_char, size_t replace_char_count) const
+{
+	if (text.empty())
+	{
+		return "";
+	}
+
+	return GetCompiledAutomaton()->ReplaceBadWord(text.c_str(), text.length(), replace_char, replace_char_count);
+}
+
+std::shared_ptr<const WordAutomaton> WordFilter::GetAutomaton() const
+{
+	Compile();
+	AUTO_LOCK(_lock);
+	return _automaton;
+}
+
+const WordAutomaton * WordFilter::CompileAutomaton() const
+{
+	AUTO_LOCK(_lock);
+	if (!_automaton)
+	{
+		_automaton = WordAutomaton::Build(_words, _ignore_chars, _ignore_case);
+		_compiled.store(_automaton.get(), std::memory_order_release);
+	}
+
+	return _automaton.get();
+}
@@ -1,92 +1,183 @@
-﻿
-#ifndef SFRAME_WORD_FILTER_H
+﻿#ifndef SFRAME_WORD_FILTER_H
 #define SFRAME_WORD_FILTER_H
 
 #include <inttypes.h>
 #include <string>
 #include <vector>
-#include <unordered_map>
+#include <memory>
+#include <atomic>
+#include "Lock.h"
 
 namespace sframe {
 
-// 单词查找树节点
-class TrieNode
+/*
+	敏感词文本归一化
+	按UTF-8解码，全角字符转为半角，折叠大小写(ASCII、拉丁、希腊、西里尔字母)，去掉零宽字符、格式控制字符和忽略字符
+	不合法的UTF-8字节原样保留；归一化后的长度不会超过原文，可以同时输出每个字节在原文中的位置
+	纯ASCII的部分每次处理16个字节(SSE2)
+*/
+class WordNormalizer
 {
 public:
+	static const uint32_t kInvalidCodePoint = 0xFFFFFFFF;
 
-	TrieNode() : _is_end_node(false) {}
+	WordNormalizer(const std::string & ignore_chars = std::string(), bool ignore_case = true);
 
-	~TrieNode();
+	// 归一化，offsets不为nullptr时写入out中每个字节对应的原文字符的开始位置
+	void Normalize(const char * str, size_t len, std::string & out, std::vector<uint32_t> * offsets) const;
 
-	bool IsEndNode() const
-	{
-		return _is_end_node;
-	}
+	// 解码一个UTF-8字符(len大于0)，返回字节数；不合法时按单字节处理，code_point为kInvalidCodePoint
+	static size_t DecodeChar(const char * str, size_t len, uint32_t & code_point);
 
-	void SetIsEndNode(bool b)
-	{
-		_is_end_node = b;
-	}
+private:
+	// 全角转半角、大小写折叠
+	uint32_t FoldCodePoint(uint32_t code_point) const;
+
+	// 非ASCII字符是否去掉
+	bool IsIgnoredCodePoint(uint32_t code_point) const;
 
-	TrieNode * GetChild(uint8_t c, bool create_when_null);
+	// 处理一个字符，返回字节数
+	size_t NormalizeChar(const char * str, size_t len, char * & out) const;
 
 private:
-	std::unordered_map<uint8_t, TrieNode*> _children;
-	bool _is_end_node;
+	bool _ignore_case;
+	uint8_t _ascii_map[128];                      // ASCII字符折叠后的字符，0表示去掉
+	std::string _ascii_dropped;                   // 要去掉的ASCII字符(SIMD比较用)
+	std::vector<uint32_t> _ignore_code_points;    // 要去掉的非ASCII字符(有序)
+	std::vector<uint64_t> _bmp_special;           // 基本平面中需要折叠或去掉的字符(位图)，其他字符原样复制
 };
 
-// 单词查找树
-class Trie
+/*
+	敏感词自动机(Aho-Corasick，转移表为双数组)
+	由词表一次编译生成，之后只读，可以在多个服务(线程)间共享
+	文本和词先经过WordNormalizer归一化再匹配，替换时按偏移映射回原文
+*/
+class WordAutomaton
 {
 public:
-
 	static const int kMaxCharCount = 256;
 
-	Trie(bool ignore_case);
+	// 编译词表
+	static std::shared_ptr<const WordAutomaton> Build(const std::vector<std::string> & words, const std::string & ignore_chars, bool ignore_case);
 
-	~Trie();
+	// 是否包含敏感词
+	bool HaveBadWord(const char * str, size_t len) const;
 
-	void AddIgnoreCharacters(const char * str);
+	// 替换敏感词(从左到右，每个位置取最长的敏感词)，replace_char_count大于0时每个敏感词替换为replace_char_count(最多32)个replace_char，否则逐字节替换
+	std::string ReplaceBadWord(const char * str, size_t len, char replace_char, size_t replace_char_count) const;
 
-	void AddWord(const char * str, size_t len);
+	// 状态数
+	size_t GetStateCount() const
+	{
+		return _fail.size();
+	}
+
+private:
+	WordAutomaton() {}
 
-	size_t FindWord(const char * str, size_t len);
+	// 双数组的一个单元：状态s经字符c转移到t = base[s] + c + 1，要求check[t] == s
+	struct Unit
+	{
+		int32_t base;
+		int32_t check;
+	};
+
+	// 在归一化后的文本中标记每个位置开始的最长敏感词的结束位置(开区间，0表示没有)，有敏感词时返回true；stop_at_first为true时找到第一个就返回
+	bool Match(const char * text, size_t len, std::vector<uint32_t> * match_end, bool stop_at_first) const;
+
+	int32_t Next(int32_t state, uint8_t c) const
+	{
+		while (true)
+		{
+			uint32_t t = (uint32_t)(_units[state].base + c + 1);
+			if (t < _units.size() && _units[t].check == state)
+			{
+				return (int32_t)t;
+			}
+
+			if (state == 0)
+			{
+				return 0;
+			}
+
+			state = _fail[state];
+		}
+	}
 
 private:
-	TrieNode * _nodes[kMaxCharCount];
-	bool _ignore_case;
-	bool _is_ignore[kMaxCharCount];
+	WordNormalizer _normalizer;
+	std::vector<Unit> _units;
+	std::vector<int32_t> _fail;           // 失败指针
+	std::vector<int32_t> _word_len;       // 以该状态结束的敏感词归一化后的长度，0表示不是词尾
+	std::vector<int32_t> _output_link;    // 沿失败指针最近的词尾状态，0表示没有
 };
 
-
 // 敏感词过滤
+// 添加完敏感词后调用Compile()编译自动机，没有调用时第一次查找会编译；此后再添加敏感词或忽略字符会重新编译
+// 查找是只读的，多个线程可以并发查找(添加敏感词、忽略字符不能与查找并发)
+// 需要在多个服务间共享时，用GetAutomaton()取得编译好的自动机，它是只读的，可以并发使用
 class WordFilter
 {
 public:
 
-	WordFilter(bool ignore_case = true) : _trie(ignore_case) {}
+	WordFilter(bool ignore_case = true) : _ignore_case(ignore_case), _compiled(nullptr) {}
 
 	~WordFilter() {}
 
 	void AddIgnoreCharacters(const char * str)
 	{
-		_trie.AddIgnoreCharacters(str);
+		if (str)
+		{
+			_ignore_chars.append(str);
+			ResetAutomaton();
+		}
 	}
 
 	void AddWord(const std::string & word)
 	{
-		_trie.AddWord(word.c_str(), word.length());
+		_words.push_back(word);
+		ResetAutomaton();
+	}
+
+	// 编译自动机
+	void Compile() const
+	{
+		GetCompiledAutomaton();
 	}
 
-	bool HaveBadWord(const std::string & text);
+	bool HaveBadWord(const std::string & text) const;
 
-	std::string ReplaceBadWord(const std::string & text, char replace_char = '*', size_t replace_char_count = 0);
+	std::string ReplaceBadWord(const std::string & text, char replace_char = '*', size_t replace_char_count = 0) const;
+
+	// 获取编译好的自动机
+	std::shared_ptr<const WordAutomaton> GetAutomaton() const;
 
 private:
-	Trie _trie;
+	void ResetAutomaton()
+	{
+		AUTO_LOCK(_lock);
+		_compiled.store(nullptr, std::memory_order_relaxed);
+		_automaton.reset();
+	}
+
+	// 获取编译好的自动机，还没有编译时加锁编译(多个线程同时第一次查找时只编译一次)
+	const WordAutomaton * GetCompiledAutomaton() const
+	{
+		const WordAutomaton * automaton = _compiled.load(std::memory_order_acquire);
+		return automaton ? automaton : CompileAutomaton();
+	}
 
+	const WordAutomaton * CompileAutomaton() const;
+
+private:
+	bool _ignore_case;
+	std::vector<std::string> _words;
+	std::string _ignore_chars;
+	mutable Lock _lock;                                         // 保护自动机的编译
+	mutable std::shared_ptr<const WordAutomaton> _automaton;
+	mutable std::atomic<const WordAutomaton *> _compiled;       // 编译好的自动机(查找时无锁读取)
 };
 
 }
 
-#endif
\ No newline at end of file
+#endif